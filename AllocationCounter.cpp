@@ -0,0 +1,58 @@
+//
+// Process-wide heap allocation counting - for asserting the allocations of loading in tests.
+//
+
+#include "AllocationCounter.h"
+
+#ifdef OBJMASTER_COUNT_ALLOCATIONS
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+// Rem.: Plain (not constructed) atomics of static storage are zero before any dynamic
+//       initialization, so allocations of other static constructors are counted properly.
+static std::atomic<uint64_t> omAllocationCount;
+static std::atomic<uint64_t> omAllocatedBytes;
+
+// The other forms (arrays, nothrow, sized delete) call these by default
+void* operator new(std::size_t size) {
+    omAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    omAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    void *p = std::malloc((size > 0) ? size : 1);
+    if(p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+#endif
+
+namespace ObjMaster {
+
+    bool AllocationCounter::isCounting() {
+#ifdef OBJMASTER_COUNT_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    uint64_t AllocationCounter::getAllocationCount() {
+#ifdef OBJMASTER_COUNT_ALLOCATIONS
+        return omAllocationCount.load(std::memory_order_relaxed);
+#else
+        return 0;
+#endif
+    }
+
+    uint64_t AllocationCounter::getAllocatedBytes() {
+#ifdef OBJMASTER_COUNT_ALLOCATIONS
+        return omAllocatedBytes.load(std::memory_order_relaxed);
+#else
+        return 0;
+#endif
+    }
+}
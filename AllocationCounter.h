@@ -0,0 +1,76 @@
+//
+// Process-wide heap allocation counting - for asserting the allocations of loading in tests.
+//
+
+#ifndef OBJMASTER_ALLOCATIONCOUNTER_H
+#define OBJMASTER_ALLOCATIONCOUNTER_H
+
+#include "objmasterlog.h"
+#include <new>
+#include <stdint.h>
+
+namespace ObjMaster {
+
+    /**
+     * Counts the heap allocations (the operator new calls) of the whole process. Counting only
+     * happens when the library is compiled with OBJMASTER_COUNT_ALLOCATIONS defined: then the
+     * global operator new and delete are replaced by counting ones (so define it only for test
+     * and profiling builds of applications that do not replace them themselves). Without it the
+     * counts are always zero. An instance measures the allocations since it was created - the
+     * allocations of every thread are counted, like the ones of parallel builds.
+     */
+    class AllocationCounter final {
+    public:
+        /** Starts measuring from the current counts */
+        AllocationCounter() : startCount(getAllocationCount()), startBytes(getAllocatedBytes()) {}
+
+        /** The number of allocations since this counter was created */
+        inline uint64_t getAllocationsSince() const {
+            return getAllocationCount() - startCount;
+        }
+
+        /** The number of allocated bytes since this counter was created (frees are not subtracted) */
+        inline uint64_t getBytesSince() const {
+            return getAllocatedBytes() - startBytes;
+        }
+
+        /** True when the allocations are counted (see OBJMASTER_COUNT_ALLOCATIONS) */
+        static bool isCounting();
+        /** The number of allocations in the process so far */
+        static uint64_t getAllocationCount();
+        /** The number of bytes allocated in the process so far */
+        static uint64_t getAllocatedBytes();
+
+    private:
+        uint64_t startCount;
+        uint64_t startBytes;
+    };
+
+// Very simple unit-testing approach
+// it is better to have these run on the device itself and callable as normal functions than to
+// test it compile-time with some unit testing framework as this way we rule out architectural
+// differences better. Tests will start by logging test starts to error (when #DEBUG is set!)
+// and info logs and the method returns false when anything has failed...
+    static bool TEST_AllocationCounter() {
+#ifdef DEBUG
+        OMLOGI("TEST_AllocationCounter...");
+#endif
+        // Rem.: Calling the operator itself - new expressions can be optimized out
+        AllocationCounter counter;
+        void *allocated = ::operator new(100);
+        uint64_t allocations = counter.getAllocationsSince();
+        uint64_t bytes = counter.getBytesSince();
+        ::operator delete(allocated);
+        if(AllocationCounter::isCounting() ? ((allocations < 1) || (bytes < 100)) : ((allocations != 0) || (bytes != 0))) {
+            OMLOGE("Bad allocation counts: %d allocations of %d bytes!", (int)allocations, (int)bytes);
+            return false;
+        }
+
+#ifdef DEBUG
+        OMLOGI("...TEST_AllocationCounter completed (OK)");
+#endif
+        return true;
+    }
+}
+
+#endif //OBJMASTER_ALLOCATIONCOUNTER_H
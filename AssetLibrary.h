@@ -7,6 +7,21 @@
 
 #include <istream> // std::istream header
 #include <memory>
+#include <cstddef> // size_t
+
+/**
+ * A read-only, continous view of a whole asset in memory - for example a memory mapped file.
+ * The pointed memory is valid as long as this object is alive (RAII releases the mapping).
+ * BEWARE: The data is NOT zero terminated! Always use size() to find the end of it!
+ */
+class AssetMemory {
+public:
+	virtual ~AssetMemory() {}
+	/** Pointer to the first byte of the asset */
+	virtual const char *data() const = 0;
+	/** The number of bytes in the asset */
+	virtual size_t size() const = 0;
+};
 
 /**
  * An abstract class for loosely coupled asset loading. An android application should use the
@@ -17,6 +32,17 @@ public:
 	/** Pure virtual function for getting a stream to the given asset(path contains '/' in the end) */
 	virtual std::unique_ptr<std::istream> getAssetStream(const char *path,
 				const char *assetFileName) const = 0;
+
+	/**
+	 * Optional capability: get the whole asset as one read-only memory block (path contains '/' in the end).
+	 * Libraries that can do this cheaply (for example by memory mapping files) should override this so
+	 * parsers can work right out of the memory without any stream machinery and line copies.
+	 * The default implementation returns nullptr, which means the caller must use getAssetStream(..)!
+	 */
+	virtual std::unique_ptr<AssetMemory> getAssetMemory(const char * /*path*/,
+				const char * /*assetFileName*/) const {
+		return nullptr;
+	}
 };
 
 // Rem.: This is a seperate class for better compatibility with earlier codes.
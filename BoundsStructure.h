@@ -0,0 +1,25 @@
+//
+// Bounding volumes of meshes and models - for culling without walking the vertex data again.
+// This code should be able to get included as a C-header, because it is used in the interop facade layer!
+//
+// BECAUSE OF THIS: NO C++ FEATURES SHOULD BE USED HERE EVER!
+//
+
+#ifndef OBJMASTER_BOUNDSSTRUCTURE_H
+#define OBJMASTER_BOUNDSSTRUCTURE_H
+
+/**
+ * Axis aligned bounding box and bounding sphere of the positions of some vertices. The sphere is
+ * centered on the center of the box. Empty vertex sets have everything zero except the radius,
+ * which is -1 in that case (so a negative radius means there is nothing to cull or render).
+ */
+struct BoundingVolume {
+    // axis aligned bounding box
+    float minX, minY, minZ;
+    float maxX, maxY, maxZ;
+    // bounding sphere
+    float centerX, centerY, centerZ;
+    float radius;
+};
+
+#endif //OBJMASTER_BOUNDSSTRUCTURE_H
@@ -0,0 +1,48 @@
+//
+// Compact (quantized) vertex layout in parallel to VertexStructure - for saving GPU memory.
+// This code should be able to get included as a C-header, because it is used in the interop facade layer!
+//
+// BECAUSE OF THIS: NO C++ FEATURES SHOULD BE USED HERE EVER!
+//
+
+#ifndef OBJMASTER_COMPACTVERTEXSTRUCTURE_H
+#define OBJMASTER_COMPACTVERTEXSTRUCTURE_H
+
+#include <stdint.h>
+
+/**
+ * The 16 byte compact version of the 32 byte VertexStructure. The same rules apply: the structure
+ * starts with the position and you should refer to the attributes by their first element, like:
+ * glVertexAttribPointer(positionAttribLocation, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertexStructure), &modelVertices[0].x);
+ * glVertexAttribPointer(normalAttribLocation, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertexStructure), &modelVertices[0].i);
+ * glVertexAttribPointer(texCoordAttribLocation, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertexStructure), &modelVertices[0].u);
+ *
+ * The attributes need some extra work in the vertex shader:
+ *  - position: normalized 16 bit values in the [0, 1] range of the bounding box of the mesh. Use
+ *    the VertexQuantization of the mesh to get the original: offset + scale * position. This can
+ *    be (and usually is) folded into the model matrix.
+ *  - normal: octahedral encoded unit vector as normalized 16 bit values. Decode like this:
+ *        vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+ *        if(n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+ *        n = normalize(n);
+ *    Zero (missing) normals are encoded as (0, 0) - which decodes to (0, 0, 1).
+ *  - texture0 uv: IEEE half floats - GL_HALF_FLOAT (or GL_HALF_FLOAT_OES on ES 2.0) attributes.
+ */
+struct CompactVertexStructure {
+    // position (normalized - see above)
+    uint16_t x, y, z;
+    // padding to keep the normals 4 byte aligned (always zero)
+    uint16_t w;
+    // normal (octahedral - see above)
+    int16_t i, j;
+    // texture0 uv (half floats)
+    uint16_t u, v;
+};
+
+/** Per-mesh transformation that gets back the original positions from the normalized ones: offset + scale * position */
+struct VertexQuantization {
+    float offsetX, offsetY, offsetZ;
+    float scaleX, scaleY, scaleZ;
+};
+
+#endif //OBJMASTER_COMPACTVERTEXSTRUCTURE_H
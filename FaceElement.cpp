@@ -3,9 +3,8 @@
 //
 
 #include "FaceElement.h"
-#include <cstring>    /* strtok_r */
-#include "ObjCommon.h"
-#include "wincompat.h" // msvc hax
+#include <cstring>    /* strlen */
+#include "ObjTokenizer.h"
 
 namespace ObjMaster {
     bool FaceElement::isParsable(const char *fields) {
@@ -14,53 +13,51 @@ namespace ObjMaster {
     }
 
     FaceElement::FaceElement(const char *fields) {
-	// The strtok_r changes the string so we need to duplicate it
-	char copy[256];	// The line never should be longer than this anyways...
-	copy[255] = 0;	// ensure terminator
-	strncpy(copy, fields, 254);
-	constructionHelper(copy);
-	// Remark: The original code below makes very small malloc and free pairs and fragment memory!
-	// char *copy = strdup(fields);
-	// constructionHelper(copy);
-	// free(copy);
+	// No copy is necessary anymore as the tokenizer never modifies the string
+	constructionHelper(fields, fields + strlen(fields), nullptr);
     }
 
-    // This variant modifies the provided 'string' but it is faster as it do this without the copy
+    // Kept for compatibility: earlier this variant was the in-place one, now both are the same
     FaceElement::FaceElement(char *fields) {
-	constructionHelper(fields);
+	constructionHelper(fields, fields + strlen(fields), nullptr);
     }
 
-    // Common parts of constructors
-    void FaceElement::constructionHelper(char* fields) {
-	if (isParsable(fields)) {
-	    // Count delimiters
-	    // The first delimiter delimits the 'f' and the first FacePoint
-	    // so to get the number of facePoints all we need to do is to count the delimiters!
-	    int delimCount = 0;
-	    for (int i = 0; (fields[i] != 0); ++i) {
-		if (fields[i] == OBJ_DELIMITER[0]) {
-		    ++delimCount;
-		}
-	    }
-
-	    // Tokenization
-	    char *savePtr;
-	    // The 'f' is the first token...
-	    char *key = strtok_r(fields, OBJ_DELIMITER, &savePtr);
+    FaceElement::FaceElement(const char *fields, const char *fieldsEnd) {
+	constructionHelper(fields, fieldsEnd, nullptr);
+    }
 
-	    // This both sets the facePointCount and fills in the face-points
-	    // The facePointCount can be less than the delimCount when we handle only 3 points and
-	    // there are more delimiters than that!
-	    for (facePointCount = 0;
-		 facePointCount < delimCount && facePointCount < MAX_FACEPOINT_COUNT;
-		 ++facePointCount) {
+    FaceElement::FaceElement(const char *fields, const char *fieldsEnd, std::vector<FacePoint> *ngonFacePointPool) {
+	constructionHelper(fields, fieldsEnd, ngonFacePointPool);
+    }
 
-		// Extract the currently latest FacePoint
-		char *facePointStr = strtok_r(nullptr, OBJ_DELIMITER, &savePtr);
-		// Parse the given facePoint and save it - with added extra check
-		// in case of nasty errors that should never be there!
-		if (facePointStr != nullptr) {
-			facePoints[facePointCount] = FacePoint(facePointStr, true);
+    // Common parts of constructors
+    void FaceElement::constructionHelper(const char *fields, const char *fieldsEnd, std::vector<FacePoint> *ngonFacePointPool) {
+	facePointCount = 0;
+	ngonFacePointIndex = -1;
+	// Same check as isParsable(..) but without reading over the end of the range
+	if ((fieldsEnd - fields > 1) && (fields[0] == 'f') && ObjTokenizer::isBlank(fields[1])) {
+	    // Single pass: step over the 'f' then parse the face points one after the other.
+	    const char *p = fields + 1;
+	    while (true) {
+		p = ObjTokenizer::skipSpaces(p, fieldsEnd);
+		if (p == fieldsEnd) {
+		    break;
+		}
+		FacePoint fp;
+		ObjTokenizer::parseIndexTriplet(p, fieldsEnd, fp.vIndex, fp.vtIndex, fp.vnIndex);
+		if (facePointCount < MAX_FACEPOINT_COUNT) {
+		    facePoints[facePointCount++] = fp;
+		} else if (ngonFacePointPool != nullptr) {
+		    if (facePointCount == MAX_FACEPOINT_COUNT) {
+			// This is an n-gon: the pool gets all of its points (the first ones too)
+			ngonFacePointIndex = (int)ngonFacePointPool->size();
+			ngonFacePointPool->insert(ngonFacePointPool->end(), facePoints, facePoints + MAX_FACEPOINT_COUNT);
+		    }
+		    ngonFacePointPool->push_back(fp);
+		    ++facePointCount;
+		} else {
+		    // Without a pool we can only keep the first MAX_FACEPOINT_COUNT points
+		    break;
 		}
 	    }
 	}
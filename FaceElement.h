@@ -8,20 +8,27 @@
 #include "FacePoint.h"
 #include "objmasterlog.h"
 #include <string>
+#include <vector>
 
 namespace ObjMaster {
 
 class FaceElement {
 public:
+	/** The number of points of the face - can be more than MAX_FACEPOINT_COUNT for n-gons */
 	int facePointCount;
-	// REMARK: Currently we handle faces with at most 3 points
-	// If you want to handle quads or other things(obj tristrips), never use alloc/dealloc all the way
-	// as it can result in contention for memory manager resorces and direct sizes are faster.
-	// If you need to handle other cases, just make the array able to hold the longest sequence
-	// that you want! The memory overuse is much less than the overhead of many release/aquire
-	// in my opinion...
+	// REMARK: Only the points of triangles are stored inline in the face. We never alloc/dealloc
+	// per face as it can result in contention for memory manager resorces and direct sizes are
+	// faster. The points of n-gons are stored in one common face-point pool instead (see the
+	// ngonFacePointIndex and Obj::ngonFacePoints) so that the usual triangles stay small.
 	static const int MAX_FACEPOINT_COUNT = 3;
+	/** The face points of triangles. For n-gons these are the first three points of the n-gon */
 	FacePoint facePoints[MAX_FACEPOINT_COUNT];
+	/**
+	 * For n-gons (facePointCount > MAX_FACEPOINT_COUNT) this is the offset of the first point
+	 * in the face-point pool that holds all the points of the face. It is -1 for other faces.
+	 * Rem.: Prefer using Obj::getFacePoints(face) instead of using this directly!
+	 */
+	int ngonFacePointIndex = -1;
 
 	// Copies are defeaulted
 	FaceElement(const FaceElement &other) = default;
@@ -39,25 +46,46 @@ public:
 		facePoints[1] = b;
 		facePoints[2] = c;
 	}
-	/** Create FaceElement by parsing the given string */
+	/** Create FaceElement by parsing the given string - n-gons are cut to their first three points */
 	FaceElement(char *fields);
-	/** Create FaceElement by parsing the given string */
+	/** Create FaceElement by parsing the given string - n-gons are cut to their first three points */
 	FaceElement(const char *fields);
+	/** Create FaceElement by parsing the [fields, fieldsEnd) range - no zero terminator needed */
+	FaceElement(const char *fields, const char *fieldsEnd);
+	/**
+	 * Create FaceElement by parsing the [fields, fieldsEnd) range. All the points of n-gons are
+	 * appended to the given face-point pool (when it is not nullptr) and referred by the offset.
+	 */
+	FaceElement(const char *fields, const char *fieldsEnd, std::vector<FacePoint> *ngonFacePointPool);
 	static bool isParsable(const char *fields);
 
-	/** Gets the textual representation */
+	/** Tells if this face is an n-gon with its points in a face-point pool */
+	inline bool isNgon() const {
+		return ngonFacePointIndex >= 0;
+	}
+
+	/**
+	 * Gets the textual representation.
+	 * Rem.: For n-gons use the variant with the points (see Obj::getFacePoints) to get all points!
+	 */
 	inline std::string asText() {
+		return asText(facePoints, (facePointCount < MAX_FACEPOINT_COUNT) ? facePointCount : MAX_FACEPOINT_COUNT);
+	}
+
+	/** Gets the textual representation using the given points of this face */
+	inline std::string asText(const FacePoint *points, int pointCount) const {
 		// Rem.: What to do if the facePointCount is 0? I better return an empty string then...
-		std::string faceStr = (facePointCount > 0) ? "f " : "";
-		for(int i = 0; i < facePointCount; ++i) {
-			faceStr += (facePoints[i].asText() + " ");
+		std::string faceStr = (pointCount > 0) ? "f " : "";
+		for(int i = 0; i < pointCount; ++i) {
+			FacePoint fp = points[i];
+			faceStr += (fp.asText() + " ");
 		}
 		return faceStr;
 	}
 
     private:
 	// Common parts of constructors
-	void constructionHelper(char* fields);
+	void constructionHelper(const char *fields, const char *fieldsEnd, std::vector<FacePoint> *ngonFacePointPool);
 };
 
 // Very simple unit-testing approach
@@ -37,6 +37,8 @@ namespace ObjMaster {
         FacePoint(const char *fields);
         FacePoint(char *fields, bool forceParser);
         FacePoint(const char *fields, bool forceParser);
+        /** Parse the [fields, fieldsEnd) range without an isParsable check - no zero terminator needed */
+        FacePoint(const char *fields, const char *fieldsEnd);
         static bool isParsable(const char *fields);
 
 	/** Gets the textual representation */
@@ -47,7 +49,7 @@ namespace ObjMaster {
 
     private:
         // Common parts of constructors
-        void constructorHelper(char *fields);
+        void constructorHelper(const char *fields, const char *fieldsEnd);
     };
 
 // Very simple unit-testing approach
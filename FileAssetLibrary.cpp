@@ -8,6 +8,15 @@
 #include <memory>
 #include <cerrno> /* for strerror(errno) */
 
+// Memory mapping is only supported on POSIX systems - other platforms fall back to streams
+#if (defined (__linux__) || defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))) && !defined (__EMSCRIPTEN__)
+#define OBJMASTER_USE_MMAP 1
+#include <sys/mman.h>	/* mmap, madvise, munmap */
+#include <sys/stat.h>	/* fstat */
+#include <fcntl.h>	/* open */
+#include <unistd.h>	/* close */
+#endif
+
 // The maximum size of error messages to print on error logging
 #define ERR_MSG_SIZE 512
 
@@ -23,6 +32,60 @@ void strerror_secure(char* errMsgHolder, size_t bufLen, int errnum){
 
 namespace ObjMaster {
 
+#ifdef OBJMASTER_USE_MMAP
+	/** A read-only memory mapped file - the mapping is released when the object gets destroyed */
+	class MappedFileAssetMemory : public AssetMemory {
+	public:
+		MappedFileAssetMemory(void *mappedAddress, size_t mappedSize) : address(mappedAddress), length(mappedSize) {}
+		~MappedFileAssetMemory() { munmap(address, length); }
+		const char *data() const { return (const char*)address; }
+		size_t size() const { return length; }
+	private:
+		void *address;
+		size_t length;
+	};
+#endif
+
+	std::unique_ptr<AssetMemory> FileAssetLibrary::getAssetMemory(const char *path, const char *assetFileName) const {
+#ifdef OBJMASTER_USE_MMAP
+		// We are just concatenating the two values
+		const std::string utf8FullPath = std::string(path) + assetFileName;
+		OMLOGI("Mapping file at %s ...", utf8FullPath.c_str());
+
+		int fd = open(utf8FullPath.c_str(), O_RDONLY);
+		if(fd < 0) {
+			// Rem.: No error log here - the stream fallback will log about the real problem anyways...
+			OMLOGI("...Cannot map file - falling back to streams!");
+			return nullptr;
+		}
+		struct stat st;
+		if((fstat(fd, &st) != 0) || (st.st_size <= 0)) {
+			// Empty files cannot be mapped - the stream path handles them just fine
+			close(fd);
+			OMLOGI("...Cannot map empty file - falling back to streams!");
+			return nullptr;
+		}
+		size_t length = (size_t)st.st_size;
+		void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		// Rem.: The mapping keeps its own reference to the file so we can close it right now
+		close(fd);
+		if(address == MAP_FAILED) {
+			char errMsgHolder[ERR_MSG_SIZE];
+			strerror_secure(errMsgHolder, ERR_MSG_SIZE, errno);
+			OMLOGW("...Cannot map file because: %s - falling back to streams!", errMsgHolder);
+			return nullptr;
+		}
+		// We will read the file front-to-back exactly once: let the kernel read-ahead aggressively
+		madvise(address, length, MADV_SEQUENTIAL);
+
+		OMLOGI("...Successfully mapped %s%s (%zu bytes)", path, assetFileName, length);
+		return std::unique_ptr<AssetMemory>(new MappedFileAssetMemory(address, length));
+#else
+		// Not supported on this platform: the caller falls back to getAssetStream(..)
+		return nullptr;
+#endif
+	}
+
 	std::unique_ptr<std::istream> FileAssetLibrary::getAssetStream(const char *path, const char *assetFileName) const {
 		// We are just concatenating the two values
 		const std::string spath(path);
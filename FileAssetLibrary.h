@@ -8,9 +8,13 @@
 #include <memory>
 
 namespace ObjMaster {
-	/** Basic asset library using c++ file I/O - can be used for input and output too! */
+	/**
+	 * Basic asset library using c++ file I/O - can be used for input and output too!
+	 * On POSIX systems the files can be also memory mapped for fast, zero-copy parsing (see getAssetMemory).
+	 */
 	class FileAssetLibrary : public AssetLibrary, public AssetOutputLibrary {
 		std::unique_ptr<std::istream> getAssetStream(const char *path, const char *assetFileName) const;
+		std::unique_ptr<AssetMemory> getAssetMemory(const char *path, const char *assetFileName) const;
 		std::unique_ptr<std::ostream> getAssetOutputStream(const char *path, const char *assetFileName) const;
 	};
 }
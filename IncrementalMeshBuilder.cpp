@@ -0,0 +1,74 @@
+//
+// Keeps the meshes of an Obj up to date while faces get appended to it (like with ObjCreator).
+//
+
+#include "IncrementalMeshBuilder.h"
+#include <algorithm>
+
+namespace ObjMaster {
+
+    /** The not yet absorbed faces of one group */
+    struct NewGroupFaces {
+        uint64_t key;
+        const ObjectMaterialFaceGroup *group;
+        int faceIndex;
+        int faceCount;
+    };
+
+    std::vector<IncrementalMeshBuilder::MeshUpdate> IncrementalMeshBuilder::update(const Obj &obj) {
+        std::vector<MeshUpdate> updates;
+        if((int)obj.fs.size() < absorbedFaceCount) {
+            OMLOGE("The obj has less faces (%d) than the already absorbed ones (%d) - not updating!", (int)obj.fs.size(), absorbedFaceCount);
+            return updates;
+        }
+
+        // Rem.: The groups of the obj are unordered - the new faces are absorbed in face order
+        std::vector<NewGroupFaces> newFaces;
+        int absorbedEnd = absorbedFaceCount;
+        for(auto &gPair : obj.objectMaterialGroups) {
+            const ObjectMaterialFaceGroup &group = gPair.second;
+            int groupEnd = group.faceIndex + group.meshFaceCount;
+            int start = std::max(group.faceIndex, absorbedFaceCount);
+            if(groupEnd > start) {
+                newFaces.push_back(NewGroupFaces { gPair.first, &group, start, groupEnd - start });
+                absorbedEnd = std::max(absorbedEnd, groupEnd);
+            }
+        }
+        std::sort(newFaces.begin(), newFaces.end(), [](const NewGroupFaces &a, const NewGroupFaces &b) {
+            return a.faceIndex < b.faceIndex;
+        });
+
+        for(auto &faces : newFaces) {
+            MeshUpdate meshUpdate;
+            auto found = meshIndices.find(faces.key);
+            if(found == meshIndices.end()) {
+                // An empty mesh that gets all of its faces appended
+                meshUpdate.meshIndex = (int)meshes.size();
+                meshUpdate.isNewMesh = true;
+                meshes.emplace_back(obj, nullptr, 0, faces.group->materialId, obj.getGroupName(*faces.group), buildFlags);
+                states.emplace_back(buildFlags, (size_t)faces.faceCount);
+                meshIndices[faces.key] = meshUpdate.meshIndex;
+            } else {
+                meshUpdate.meshIndex = found->second;
+                meshUpdate.isNewMesh = false;
+            }
+            MaterializedObjMeshObject &mesh = meshes[meshUpdate.meshIndex];
+            meshUpdate.firstVertex = mesh.vertexCount;
+            meshUpdate.firstIndex = mesh.indexCount;
+            if(!mesh.appendFaces(obj, &obj.fs[faces.faceIndex], faces.faceCount, states[meshUpdate.meshIndex])) {
+                continue;
+            }
+            meshUpdate.vertexCount = mesh.vertexCount - meshUpdate.firstVertex;
+            meshUpdate.indexCount = mesh.indexCount - meshUpdate.firstIndex;
+            updates.push_back(meshUpdate);
+        }
+        absorbedFaceCount = absorbedEnd;
+
+        // The bounds come from the mesh bounds - no need to walk the vertices again
+        bounds = MeshBounds::empty();
+        for(auto &mesh : meshes) {
+            bounds = MeshBounds::merge(bounds, mesh.bounds);
+        }
+        return updates;
+    }
+}
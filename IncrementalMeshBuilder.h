@@ -0,0 +1,90 @@
+//
+// Keeps the meshes of an Obj up to date while faces get appended to it (like with ObjCreator).
+//
+
+#ifndef OBJMASTER_INCREMENTALMESHBUILDER_H
+#define OBJMASTER_INCREMENTALMESHBUILDER_H
+
+#include "MaterializedObjMeshObject.h"
+#include "ObjCreator.h"
+#include "Obj.h"
+#include "MeshBounds.h"
+#include "objmasterlog.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+namespace ObjMaster {
+
+    /**
+     * Builds one mesh for each object/material group of an Obj - just like MaterializedObjModel -
+     * but keeps the de-duplication state of the meshes alive, so when faces are appended to the
+     * Obj later, update(..) only processes those new faces (see ObjMeshObject::appendFaces). New
+     * vertices and indices always go to the end of the vectors of the meshes, so the updates tell
+     * which ranges changed and the uploaded buffers can be updated partially.
+     *
+     * The groups are taken in the order of their faces. Faces are absorbed by group key, so a
+     * group that is used again later (ObjCreator overwrites the face range of such groups in the
+     * Obj) keeps its earlier faces in the mesh too. Faces that are not in a group yet (like the
+     * ones of the still open group of an ObjCreator) are absorbed by a later update. Only the
+     * de-duplication flags are used - the optimization passes, the meshlets, the LODs and the
+     * generated normals and tangents need the whole mesh, so build a MaterializedObjModel from the
+     * finished Obj for those. The Obj is not stored: it should be the same (growing) one on updates.
+     * The materials of the meshes are looked up in the library of the Obj by their materialId.
+     */
+    class IncrementalMeshBuilder final {
+    public:
+        /** Tells what changed in one mesh in an update */
+        struct MeshUpdate {
+            /** The index of the mesh in meshes */
+            int meshIndex;
+            /** True when the mesh is created in this update (so all of it is new) */
+            bool isNewMesh;
+            /** The first changed vertex - from baseVertexLocation (the earlier vertexCount) */
+            unsigned int firstVertex;
+            /** The number of new vertices (all at the end) */
+            unsigned int vertexCount;
+            /** The first changed index - from startIndexLocation (the earlier indexCount) */
+            unsigned int firstIndex;
+            /** The number of new indices (all at the end) */
+            unsigned int indexCount;
+        };
+
+        /** The meshes - the vector can grow (reallocate) on updates when new groups appear */
+        std::vector<MaterializedObjMeshObject> meshes;
+        /** The merged bounding volumes of the meshes (see MeshBounds::merge) */
+        BoundingVolume bounds = MeshBounds::empty();
+
+        /** Create a builder without meshes - only the de-duplication flags are used from the build flags */
+        IncrementalMeshBuilder(ObjMeshObject::MeshBuildFlags buildFlags = ObjMeshObject::MeshBuildFlags::DEDUP_BY_VALUE)
+            : buildFlags((ObjMeshObject::MeshBuildFlags)(buildFlags & ObjMeshObject::MeshBuildFlags::DEDUP_BY_INDEX)) {}
+
+        /**
+         * Absorbs the faces of the groups of the Obj that are not absorbed yet (the first update
+         * absorbs everything). Returns the changes of the meshes in the order of their face
+         * ranges - meshes without changes are not listed.
+         */
+        std::vector<MeshUpdate> update(const Obj &obj);
+
+        /** The same as above for the Obj of the creator - the group that is open in it is finished first */
+        inline std::vector<MeshUpdate> update(ObjCreator &creator) {
+            return update(*creator.getOwnedObj());
+        }
+
+        /** The number of the faces of the Obj that are absorbed into the meshes */
+        inline int getAbsorbedFaceCount() const {
+            return absorbedFaceCount;
+        }
+
+    private:
+        ObjMeshObject::MeshBuildFlags buildFlags;
+        /** Faces before this are already absorbed */
+        int absorbedFaceCount = 0;
+        /** The de-duplication state of each mesh */
+        std::vector<MeshAppendState> states;
+        /** The mesh index of each group key (see Obj::objectMaterialGroups) */
+        std::unordered_map<uint64_t, int> meshIndices;
+    };
+}
+
+#endif //OBJMASTER_INCREMENTALMESHBUILDER_H
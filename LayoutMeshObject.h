@@ -0,0 +1,162 @@
+//
+// Meshes built with compile-time specialized vertex layouts - only storing the attributes a model has.
+//
+
+#ifndef OBJMASTER_LAYOUTMESHOBJECT_H
+#define OBJMASTER_LAYOUTMESHOBJECT_H
+
+#include "ObjMeshObject.h"
+#include "VertexStructure.h"
+#include "PartialVertexStructure.h"
+#include "MeshletStructure.h"
+#include "BoundsStructure.h"
+#include <vector>
+
+namespace ObjMaster {
+
+	// Rem.: bit trickery here
+	/** The optional vertex attributes a model has (positions are always there) */
+	enum VertexAttributeFlags {
+		POSITION_ATTRIBUTES = 0,
+		NORMAL_ATTRIBUTES = 1,
+		TEXCOORD_ATTRIBUTES = 2,
+		/** Both of the above - this is VertexStructure */
+		ALL_ATTRIBUTES = 1+2,
+	};
+
+	/**
+	 * Compile-time description of a vertex layout: which attributes it has and how to fill it from
+	 * the elements of a face-point. Missing elements (nullptr) become zero just like in ObjMeshObject.
+	 */
+	template<typename Vertex>
+	struct VertexLayoutTraits;
+
+	template<>
+	struct VertexLayoutTraits<PositionVertexStructure> {
+		static const int ATTRIBUTES = POSITION_ATTRIBUTES;
+		static inline PositionVertexStructure make(const VertexElement *v, const VertexTextureElement *, const VertexNormalElement *) {
+			return PositionVertexStructure { v != nullptr ? v->x : 0, v != nullptr ? v->y : 0, v != nullptr ? v->z : 0 };
+		}
+	};
+
+	template<>
+	struct VertexLayoutTraits<PositionNormalVertexStructure> {
+		static const int ATTRIBUTES = NORMAL_ATTRIBUTES;
+		static inline PositionNormalVertexStructure make(const VertexElement *v, const VertexTextureElement *, const VertexNormalElement *vn) {
+			return PositionNormalVertexStructure {
+					v != nullptr ? v->x : 0, v != nullptr ? v->y : 0, v != nullptr ? v->z : 0,
+					vn != nullptr ? vn->x : 0, vn != nullptr ? vn->y : 0, vn != nullptr ? vn->z : 0 };
+		}
+	};
+
+	template<>
+	struct VertexLayoutTraits<PositionTexCoordVertexStructure> {
+		static const int ATTRIBUTES = TEXCOORD_ATTRIBUTES;
+		static inline PositionTexCoordVertexStructure make(const VertexElement *v, const VertexTextureElement *vt, const VertexNormalElement *) {
+			return PositionTexCoordVertexStructure {
+					v != nullptr ? v->x : 0, v != nullptr ? v->y : 0, v != nullptr ? v->z : 0,
+					vt != nullptr ? vt->u : 0, vt != nullptr ? vt->v : 0 };
+		}
+	};
+
+	template<>
+	struct VertexLayoutTraits<VertexStructure> {
+		static const int ATTRIBUTES = ALL_ATTRIBUTES;
+		static inline VertexStructure make(const VertexElement *v, const VertexTextureElement *vt, const VertexNormalElement *vn) {
+			return VertexStructure {
+					v != nullptr ? v->x : 0, v != nullptr ? v->y : 0, v != nullptr ? v->z : 0,
+					vn != nullptr ? vn->x : 0, vn != nullptr ? vn->y : 0, vn != nullptr ? vn->z : 0,
+					vt != nullptr ? vt->u : 0, vt != nullptr ? vt->v : 0 };
+		}
+	};
+
+	/**
+	 * A mesh like ObjMeshObject, but with vertices of the given layout: attributes that are not in
+	 * the layout are neither stored nor hashed or compared when de-duplicating. The vertex and
+	 * index vectors are always owned and the indices start from zero.
+	 *
+	 * Supported layouts: PositionVertexStructure, PositionNormalVertexStructure,
+	 * PositionTexCoordVertexStructure and VertexStructure (see withLayoutMeshObject(..) for
+	 * choosing by the contents of the Obj). The build flags are the same as for ObjMeshObject,
+	 * but PARALLEL_DEDUP is ignored - these meshes are always de-duplicated serially - and so is
+ * BUILD_LODS as the simplification needs all the attributes of VertexStructure. GENERATE_NORMALS
+	 * only has an effect for layouts with normals and GENERATE_TANGENTS is ignored (only
+	 * ObjMeshObject has tangents).
+	 */
+	template<typename Vertex>
+	class LayoutMeshObject final {
+	public:
+		/** Says if the mesh has been initialized or not */
+		bool inited = false;
+		/** Render-ready vertex data with only the attributes of the layout */
+		std::vector<Vertex> vertexData;
+		/** Index data - refers to vertexData from zero */
+		std::vector<OM_INDEX_TYPE> indices;
+		/** The number of vertices */
+		unsigned int vertexCount = 0;
+		/** The number of indices */
+		unsigned int indexCount = 0;
+		/** The bounding box and sphere of the vertices */
+		BoundingVolume bounds = BoundingVolume { 0, 0, 0, 0, 0, 0, 0, 0, 0, -1 };
+		/** Meshlets of the mesh when built with BUILD_MESHLETS (see ObjMeshObject for the meaning) */
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint8_t> meshletTriangles;
+
+		// Empty constructor
+		LayoutMeshObject() {}
+
+		/** Create a mesh using all faces available in the given Obj */
+		LayoutMeshObject(const Obj& obj, ObjMeshObject::MeshBuildFlags buildFlags = ObjMeshObject::MeshBuildFlags::DEDUP_BY_VALUE);
+
+		/** Create a mesh using the explicitly given faces from the given Obj */
+		LayoutMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount,
+				ObjMeshObject::MeshBuildFlags buildFlags = ObjMeshObject::MeshBuildFlags::DEDUP_BY_VALUE);
+
+	private:
+		void creationHelper(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount, ObjMeshObject::MeshBuildFlags buildFlags);
+	};
+
+	/** Returns the optional attributes (VertexAttributeFlags) the given Obj has */
+	static inline int vertexAttributesOf(const Obj &obj) {
+		return (obj.vns.empty() ? 0 : NORMAL_ATTRIBUTES) | (obj.vts.empty() ? 0 : TEXCOORD_ATTRIBUTES);
+	}
+
+	/**
+	 * Builds the mesh of the given faces with the smallest layout that still holds all attributes
+	 * of the Obj (and the normals of GENERATE_NORMALS) and calls visitor(mesh) with it - use a generic lambda like this:
+	 *     withLayoutMeshObject(obj, &obj.fs[0], (int)obj.fs.size(), flags, [&](auto &mesh) { upload(mesh); });
+	 * The mesh only lives until the visitor returns (move the vectors out if needed).
+	 */
+	template<typename Visitor>
+	static void withLayoutMeshObject(const Obj &obj, const FaceElement *meshFaces, int meshFaceCount,
+			ObjMeshObject::MeshBuildFlags buildFlags, Visitor visitor) {
+		// Rem.: generated normals need a layout with normals even if the obj has none
+		int attributes = vertexAttributesOf(obj) |
+				(((buildFlags & ObjMeshObject::MeshBuildFlags::GENERATE_NORMALS) != 0) ? NORMAL_ATTRIBUTES : 0);
+		switch(attributes) {
+			case POSITION_ATTRIBUTES: {
+				LayoutMeshObject<PositionVertexStructure> mesh(obj, meshFaces, meshFaceCount, buildFlags);
+				visitor(mesh);
+				break;
+			}
+			case NORMAL_ATTRIBUTES: {
+				LayoutMeshObject<PositionNormalVertexStructure> mesh(obj, meshFaces, meshFaceCount, buildFlags);
+				visitor(mesh);
+				break;
+			}
+			case TEXCOORD_ATTRIBUTES: {
+				LayoutMeshObject<PositionTexCoordVertexStructure> mesh(obj, meshFaces, meshFaceCount, buildFlags);
+				visitor(mesh);
+				break;
+			}
+			default: {
+				LayoutMeshObject<VertexStructure> mesh(obj, meshFaces, meshFaceCount, buildFlags);
+				visitor(mesh);
+				break;
+			}
+		}
+	}
+}
+
+#endif //OBJMASTER_LAYOUTMESHOBJECT_H
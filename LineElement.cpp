@@ -3,10 +3,8 @@
 //
 
 #include "LineElement.h"
-#include <cstring>    /* strtok_r, strdup */
-#include <cstdlib>     /* atof */
-#include "wincompat.h" /* msvc hax */
-#include "ObjCommon.h" /* OBJ_DELIMITER */
+#include <cstring>    /* strlen */
+#include "ObjTokenizer.h"
 
 namespace ObjMaster {
     bool LineElement::isParsable(const char *fields) {
@@ -15,31 +13,24 @@ namespace ObjMaster {
     }
 
     LineElement::LineElement(const char *fields) {
-        // The strtok_r changes the string so we need to duplicate it
-        char copy[256];	// The line never should be longer than this anyways...
-	copy[255] = 0;	// ensure terminator
-        strncpy(copy, fields, 254);
-        constructionHelper(copy);
-	// Remark: The original code below makes very small malloc and free pairs and fragment memory!
-        // char *copy = strdup(fields);
-        // constructionHelper(copy);
-        // free(copy);
+        // No copy (and no line length limit) as the tokenizer never modifies the string
+        constructionHelper(fields, fields + strlen(fields));
     }
 
-    // This variant modifies the provided 'string' but is it faster as it do this without the copy
+    // Kept for compatibility: earlier this variant was the in-place one, now both are the same
     LineElement::LineElement(char *fields) {
-        constructionHelper(fields);
+        constructionHelper(fields, fields + strlen(fields));
     }
 
-    void LineElement::constructionHelper(char *fields) {
+    void LineElement::constructionHelper(const char *fields, const char *fieldsEnd) {
         if(isParsable(fields)) {
-            char *savePtr;
-            char *key = strtok_r(fields, OBJ_DELIMITER, &savePtr);
-            char *bStr = strtok_r(nullptr, OBJ_DELIMITER, &savePtr);
-            char *eStr = strtok_r(nullptr, OBJ_DELIMITER, &savePtr);
-
-            bVindex = (int)atoi(bStr);
-            eVindex = (int)atoi(eStr);
+            // Step over the 'l' then parse the two indices
+            const char *p = ObjTokenizer::skipSpaces(fields + 1, fieldsEnd);
+            int value = 0;
+            bVindex = ObjTokenizer::parseInt(p, fieldsEnd, value) ? value : 0;
+            p = ObjTokenizer::skipSpaces(ObjTokenizer::skipToken(p, fieldsEnd), fieldsEnd);
+            value = 0;
+            eVindex = ObjTokenizer::parseInt(p, fieldsEnd, value) ? value : 0;
         }
     }
 }
@@ -42,7 +42,7 @@ namespace ObjMaster {
 			return "l " + std::to_string(bVindex) + " " + std::to_string(eVindex);
 		}
 	private:
-		void constructionHelper(char *fields);
+		void constructionHelper(const char *fields, const char *fieldsEnd);
 	};
     /** testing output-related operations (like asText()) */
     static int TEST_LineElement_Output(){
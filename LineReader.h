@@ -0,0 +1,99 @@
+//
+// Line-by-line reading of *.obj and *.mtl data - either from memory or from a stream.
+//
+
+#ifndef _OBJMASTER_LINE_READER_H
+#define _OBJMASTER_LINE_READER_H
+
+#include <istream>
+#include <string>
+#include <cstring> /* memchr */
+#include "ObjCommon.h"
+
+namespace ObjMaster {
+
+    /**
+     * Reads lines of arbitrary length and gives them as [line, lineEnd) ranges without the '\n'.
+     * Rem.: The given ranges are NOT zero terminated and only valid until the next call of next(..)!
+     *
+     * In memory mode the ranges simply point into the memory. In stream mode the usual lines are
+     * read into a fixed (DEFAULT_LINE_PARSE_LEN) buffer so there is no heap allocation per line.
+     * Only lines that do not fit there are collected in a string - which is then reused.
+     */
+    class LineReader final {
+    public:
+        /** Read lines from the given [data, data + size) memory - like a mapped file */
+        LineReader(const char *data, size_t size) : p(data), end(data + size), input(nullptr) {}
+
+        /** Read lines from the given stream - the stream is not owned and must outlive the reader */
+        LineReader(std::istream &inputStream) : p(nullptr), end(nullptr), input(&inputStream) {}
+
+        // The ranges can point into the buffer so copies would be misleading...
+        LineReader(const LineReader &other) = delete;
+        LineReader& operator=(const LineReader &other) = delete;
+
+        /** Fetch the next line. Returns false if there are no more lines. */
+        inline bool next(const char *&line, const char *&lineEnd) {
+            if(input == nullptr) {
+                if(p >= end) {
+                    return false;
+                }
+                // Find the end of the current line (or the end of the data for the last line)
+                const char *eol = (const char*)memchr(p, '\n', end - p);
+                if(eol == nullptr) {
+                    eol = end;
+                }
+                line = p;
+                lineEnd = eol;
+                // Step over the newline
+                p = eol + 1;
+                return true;
+            } else {
+                // Fast path: the line fits in the buffer
+                if(input->getline(buffer, DEFAULT_LINE_PARSE_LEN)) {
+                    line = buffer;
+                    lineEnd = buffer + readLength();
+                    return true;
+                }
+                // The failbit is set at the end of the data - or when the line was too long
+                if(input->eof() || input->bad()) {
+                    return false;
+                }
+                // Collect the too long line in the overflow string
+                overflow.assign(buffer, (size_t)input->gcount());
+                input->clear();
+                while(true) {
+                    if(input->getline(buffer, DEFAULT_LINE_PARSE_LEN)) {
+                        overflow.append(buffer, readLength());
+                        break;
+                    }
+                    if(input->eof() || input->bad()) {
+                        // The line ended right at the end of the data
+                        break;
+                    }
+                    overflow.append(buffer, (size_t)input->gcount());
+                    input->clear();
+                }
+                line = overflow.data();
+                lineEnd = line + overflow.size();
+                return true;
+            }
+        }
+    private:
+        /** Length of the last successful getline - the extracted '\n' is not part of the line */
+        inline size_t readLength() const {
+            size_t count = (size_t)input->gcount();
+            return ((count > 0) && !input->eof()) ? (count - 1) : count;
+        }
+
+        // Memory mode
+        const char *p;
+        const char *end;
+        // Stream mode
+        std::istream *input;
+        char buffer[DEFAULT_LINE_PARSE_LEN];
+        std::string overflow;
+    };
+}
+
+#endif // _OBJMASTER_LINE_READER_H
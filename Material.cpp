@@ -27,6 +27,22 @@ namespace ObjMaster {
         }
     }
 
+    /** Copies the (at most four) color components - the alpha is one when it is not given */
+    static inline void copyColor(const std::vector<float> &color, float *target) {
+        for(size_t i = 0; i < 4; ++i) {
+            target[i] = (i < color.size()) ? color[i] : ((i == 3) ? 1.0f : 0.0f);
+        }
+    }
+
+    MaterialStructure Material::asStructure() const {
+        MaterialStructure structure;
+        structure.enabledFields = (unsigned int)enabledFields.to_ulong();
+        copyColor(ka, structure.ka);
+        copyColor(kd, structure.kd);
+        copyColor(ks, structure.ks);
+        return structure;
+    }
+
     // Private helper method to fetch rgb values
     std::vector<float> Material::fetchRGBParam(std::string &mtlLine) {
         // Tokenize the string
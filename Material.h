@@ -9,6 +9,7 @@
 #include <vector>
 #include <bitset>
 #include "objmasterlog.h"
+#include "MaterialStructure.h"
 
 #include <unordered_set> /* - Used for test code */
 
@@ -135,6 +136,9 @@ namespace ObjMaster {
 		other->name = name;
 	}
 
+	/** Returns the colors and the enabled fields of this material as plain old data (see MaterialStructure) */
+	MaterialStructure asStructure() const;
+
 	/** Returns the *.mtl supported text representation as a vector of strings (one per each line) - empty vector is returned for empty material! */
 	inline std::vector<std::string> asText() const {
 		
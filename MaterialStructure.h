@@ -0,0 +1,27 @@
+//
+// Compact, fixed-size representation of the colors of a material - see MtlLib::getMaterialStructure.
+// This code should be able to get included as a C-header, because it is used in the interop facade layer!
+//
+// BECAUSE OF THIS: NO C++ FEATURES SHOULD BE USED HERE EVER!
+//
+
+#ifndef OBJMASTER_MATERIALSTRUCTURE_H
+#define OBJMASTER_MATERIALSTRUCTURE_H
+
+/**
+ * The non-texture data of a material as plain old data: can be copied and stored in arrays without
+ * any heap allocations. The colors always have four (rgba) components: the ones missing from the
+ * material are zero - except the alpha, which is one.
+ */
+struct MaterialStructure {
+    // bits of the enabled fields (use the Material::F_* values for indexing)
+    unsigned int enabledFields;
+    // ambient color
+    float ka[4];
+    // diffuse color
+    float kd[4];
+    // specular color
+    float ks[4];
+};
+
+#endif //OBJMASTER_MATERIALSTRUCTURE_H
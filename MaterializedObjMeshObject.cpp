@@ -3,17 +3,36 @@
 //
 
 #include "MaterializedObjMeshObject.h"
+#include <utility> // std::move
 
 namespace ObjMaster {
 
-    // Rem.: Copy construction of material here is really okay. It happens only once and on the
-    // side of the calling code we will ensure that those materials are not having loaded texture
-    // data yet. Without loaded texture data, a copy is not wasting much resources here and saves
-    // us from using shared pointers and such things...
+    /** Tangents are only generated for materials that have a bump map */
+    static inline ObjMeshObject::MeshBuildFlags meshBuildFlagsFor(ObjMeshObject::MeshBuildFlags buildFlags,
+            const TextureDataHoldingMaterial &material) {
+        if(material.enabledFields[Material::F_MAP_BUMP]) {
+            return buildFlags;
+        }
+        return (ObjMeshObject::MeshBuildFlags)(buildFlags & ~ObjMeshObject::MeshBuildFlags::GENERATE_TANGENTS);
+    }
+
+    // Rem.: Only the id of the material is stored - no material copies per mesh. The name is taken
+    // by value and moved into the member, so callers passing it as a temporary do not copy at all.
+    MaterializedObjMeshObject::MaterializedObjMeshObject(const Obj& obj,
+                                                         const FaceElement *meshFaces,
+                                                         int meshFaceCount,
+                                                         uint32_t meshMaterialId,
+                                                         std::string mName,
+                                                         MeshBuildFlags buildFlags,
+                                                         ThreadPool *threadPool)
+    : materialId(meshMaterialId), name(std::move(mName)), ObjMeshObject(obj, meshFaces, meshFaceCount, meshBuildFlagsFor(buildFlags, obj.mtlLib.getMaterial(meshMaterialId)), threadPool){}
+
     MaterializedObjMeshObject::MaterializedObjMeshObject(const Obj& obj,
                                                          const FaceElement *meshFaces,
                                                          int meshFaceCount,
-                                                         TextureDataHoldingMaterial meshObjectMaterial,
-                                                         std::string mName)
-    : material(meshObjectMaterial), name(mName), ObjMeshObject(obj, meshFaces, meshFaceCount){}
+                                                         SharedMeshBuffers &sharedBuffers,
+                                                         uint32_t meshMaterialId,
+                                                         std::string mName,
+                                                         MeshBuildFlags buildFlags)
+    : materialId(meshMaterialId), name(std::move(mName)), ObjMeshObject(obj, meshFaces, meshFaceCount, sharedBuffers, meshBuildFlagsFor(buildFlags, obj.mtlLib.getMaterial(meshMaterialId))){}
 }
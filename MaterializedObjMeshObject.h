@@ -8,6 +8,7 @@
 #include "TextureDataHoldingMaterial.h"
 #include "ObjMeshObject.h"
 #include <string>
+#include <stdint.h>
 
 namespace ObjMaster {
     /**
@@ -20,8 +21,14 @@ namespace ObjMaster {
     public:
 	/** The name of the materialized obj mesh object. This usually contains the objFaceMatGroup key when built from an Obj object. */
 	std::string name;
-        /** The corresponding material and possibly the texture data in it */
-        TextureDataHoldingMaterial material;
+        /**
+         * The id of the material in the material library of the Obj the mesh is built from - and in
+         * the copy of that library in the model (see MaterializedObjModel::mtlLib), where the meshes
+         * without a material (MtlLib::NO_MATERIAL) get the id of an empty material. The material
+         * (and possibly the texture data in it) is looked up in the library of the owner - see
+         * MaterializedObjModel::getMaterialOf - so the meshes of one material share it.
+         */
+        uint32_t materialId;
 
 	// Rem.: As you can try this out yourself too, the defaults here mean that user-defined copies and moves are called in the parent class!!!
 	//       That is necessary as the ObjMeshObject is using user-defined stuff
@@ -32,8 +39,11 @@ namespace ObjMaster {
 	MaterializedObjMeshObject(MaterializedObjMeshObject &&other) = default;
 	MaterializedObjMeshObject& operator=(MaterializedObjMeshObject &&other) = default;
 
-        /** Create an obj mesh-object that is having an associated material */
-        MaterializedObjMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount, TextureDataHoldingMaterial textureDataHoldingMaterial, std::string name);
+        /** Create an obj mesh-object that is having an associated material (an id in the material library of the obj) */
+        MaterializedObjMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount, uint32_t materialId, std::string name, MeshBuildFlags buildFlags = MeshBuildFlags::DEDUP_BY_VALUE, ThreadPool *threadPool = nullptr);
+
+        /** The same, but the mesh is built into the (possibly not empty) shared buffers - see the ObjMeshObject constructor */
+        MaterializedObjMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount, SharedMeshBuffers &sharedBuffers, uint32_t materialId, std::string name, MeshBuildFlags buildFlags = MeshBuildFlags::DEDUP_BY_VALUE);
     };
 }
 
@@ -10,6 +10,11 @@
 #include "MaterializedObjMeshObject.h"
 #include "GpuTexturePreparationLibrary.h"
 #include "Obj.h"
+#include "ThreadPool.h"
+#include "MeshBounds.h"
+#include "MeshInstancing.h"
+#include <algorithm> // std::stable_sort
+#include <string> // std::to_string
 
 namespace ObjMaster {
 
@@ -25,32 +30,126 @@ namespace ObjMaster {
 	bool inited = false;
 	std::vector<MaterializedObjMeshObject> meshes;
 	std::string path;
+	/** The merged bounding volumes of the meshes (see MeshBounds::merge) */
+	BoundingVolume bounds = MeshBounds::empty();
+	/** The vertex and index buffers of all the meshes when built with SHARED_BUFFERS (nullptr otherwise) */
+	std::shared_ptr<SharedMeshBuffers> sharedBuffers;
+	/** One for each mesh after shareInstancedGeometry(..) - empty otherwise (see MeshInstancing) */
+	std::vector<MeshInstance> instances;
+	/**
+	 * The copy of the material library of the Obj: the meshes refer to its materials by their ids
+	 * (see getMaterialOf), so each material (and its texture data) is there only once. Serves the
+	 * plain old data of the materials too (see MtlLib::getMaterialStructure).
+	 */
+	MtlLib mtlLib;
 
-	// Copies are defeaulted
-	MaterializedObjModel(const MaterializedObjModel &other) = default;
-	MaterializedObjModel& operator=(const MaterializedObjModel &other) = default;
-	// Moves are defaulted
+	// Copies are memberwise - then the instances refer to the geometry of the copied prototypes
+	MaterializedObjModel(const MaterializedObjModel &other)
+		: inited(other.inited), meshes(other.meshes), path(other.path), bounds(other.bounds),
+		  sharedBuffers(other.sharedBuffers), instances(other.instances), mtlLib(other.mtlLib),
+		  gpuTexLibrary(other.gpuTexLibrary) {
+		relinkInstances();
+	}
+	MaterializedObjModel& operator=(const MaterializedObjModel &other) {
+		inited = other.inited;
+		meshes = other.meshes;
+		path = other.path;
+		bounds = other.bounds;
+		sharedBuffers = other.sharedBuffers;
+		instances = other.instances;
+		mtlLib = other.mtlLib;
+		gpuTexLibrary = other.gpuTexLibrary;
+		relinkInstances();
+		return *this;
+	}
+	// Moves are defaulted - the moved vectors keep their elements, so the pointers stay valid
 	MaterializedObjModel(MaterializedObjModel &&other) = default;
 	MaterializedObjModel& operator=(MaterializedObjModel &&other) = default;
 
-	/** Create a materialized obj model using the given obj representation */
-	MaterializedObjModel(const Obj &obj) {
-		// The path of the model is the same as the path for obj
-		path = obj.objPath;
-		// We create one mesh per each object material group
-		for(auto gPair : obj.objectMaterialGroups) {
-#ifdef DEBUG
-        	OMLOGI("!!!!! Object material group have found as %s", gPair.first.c_str());
-#endif
-			meshes.push_back(std::move(MaterializedObjMeshObject(obj,
-				&(obj.fs[gPair.second.faceIndex]),
-				gPair.second.meshFaceCount,
-				gPair.second.textureDataHoldingMaterial,
-				gPair.first)));
+	// Rem.: bit trickery here
+	/** Defines how the meshes of the model get built */
+	enum ModelBuildModeFlags{
+		/** Build the meshes one after the other on the calling thread */
+		SERIAL_BUILD = 0,
+		/**
+		 * Build the meshes of the object/material groups in parallel on a thread pool. The
+		 * result is the very same (and in the very same order) as with serial building.
+		 */
+		PARALLEL_BUILD = 1,
+		/**
+		 * Build all the meshes into one vertex and one index buffer (see sharedBuffers) so the
+		 * whole model needs only one buffer binding. Vertices that are the same in more meshes
+		 * are only stored once. The indices of each mesh are local to its vertex range, so the
+		 * meshes are drawn with their baseVertexLocation as the base vertex. The meshes are built
+		 * one after the other (PARALLEL_BUILD is ignored) and without OPTIMIZE_VERTEX_FETCH and
+		 * GENERATE_TANGENTS (a warning is logged when given). Vertices are only reused while the
+		 * range of the mesh stays small enough for 16 bit indices - they are stored again otherwise.
+		 */
+		SHARED_BUFFERS = 2,
+	};
+
+	/** Create a materialized obj model using the given obj representation (see ObjMeshObject for the build flags) */
+	MaterializedObjModel(const Obj &obj, ObjMeshObject::MeshBuildFlags buildFlags = ObjMeshObject::MeshBuildFlags::DEDUP_BY_VALUE) {
+		constructionHelper(obj, buildFlags, nullptr);
+	}
+
+	/**
+	 * Create a materialized obj model using the given build mode. The threadCount is only used for
+	 * parallel building - zero means using the number of hardware threads. Groups that are bigger
+	 * than a fair share of one thread are not built in parallel with the others, but their faces
+	 * get de-duplicated in parallel instead (see ObjMeshObject::PARALLEL_DEDUP).
+	 */
+	MaterializedObjModel(const Obj &obj, ObjMeshObject::MeshBuildFlags buildFlags, ModelBuildModeFlags buildMode, int threadCount = 0) {
+		if(((int)buildMode & ModelBuildModeFlags::SHARED_BUFFERS) != 0) {
+			// The vertex count of the model is unknown yet, but it is similar to the face count for usual models
+			sharedBuffers = std::make_shared<SharedMeshBuffers>(obj.fs.size());
+			// Rem.: Warned here once - instead of for every mesh
+			if((buildFlags & ObjMeshObject::SHARED_BUFFERS_IGNORED_FLAGS) != 0) {
+				OMLOGW("The build flags %d are ignored for the shared buffers of the model!",
+						(int)(buildFlags & ObjMeshObject::SHARED_BUFFERS_IGNORED_FLAGS));
+			}
+			constructionHelper(obj, (ObjMeshObject::MeshBuildFlags)(buildFlags & ~ObjMeshObject::SHARED_BUFFERS_IGNORED_FLAGS), nullptr);
+			sharedBuffers->finishBuilding();
+		} else if(((int)buildMode & ModelBuildModeFlags::PARALLEL_BUILD) != 0) {
+			ThreadPool pool(threadCount);
+			constructionHelper(obj, buildFlags, &pool);
+		} else {
+			constructionHelper(obj, buildFlags, nullptr);
 		}
+	}
 
-		// Indicate that the model is loaded
-		inited = true;
+	/**
+	 * Create a materialized obj model building the meshes in parallel on the given (not owned)
+	 * thread pool. Useful when loading many models as the threads are not started per model.
+	 */
+	MaterializedObjModel(const Obj &obj, ObjMeshObject::MeshBuildFlags buildFlags, ThreadPool &threadPool) {
+		constructionHelper(obj, buildFlags, &threadPool);
+	}
+
+	/**
+	 * Finds the meshes that are instances of an earlier mesh of the model (see MeshInstancing) and
+	 * makes them share the geometry of that prototype (see ObjMeshObject::shareGeometryOf): the
+	 * instances tell the prototype and the transform to draw it with for each mesh. The materials
+	 * and the bounds of the meshes stay their own. Returns the number of meshes that became instances.
+	 */
+	int shareInstancedGeometry(bool moduloRigidTransform = false, float tolerance = MeshInstancing::DEFAULT_TOLERANCE) {
+		std::vector<const ObjMeshObject*> meshPointers;
+		meshPointers.reserve(meshes.size());
+		for(auto &mesh : meshes) {
+			meshPointers.push_back(&mesh);
+		}
+		instances = MeshInstancing::findInstances(meshPointers, moduloRigidTransform, tolerance);
+		int instanceCount = 0;
+		for(size_t i = 0; i < meshes.size(); ++i) {
+			if(instances[i].prototypeMesh != (int)i) {
+				meshes[i].shareGeometryOf(meshes[instances[i].prototypeMesh]);
+				++instanceCount;
+			}
+		}
+		if(instanceCount > 0) {
+			OMLOGI("%d of the %d meshes are instances of other meshes (model path: %s)", instanceCount, (int)meshes.size(), path.c_str());
+		}
+		return instanceCount;
 	}
 
 	/** Create a materialized obj model that is not inited (empty) */
@@ -70,21 +169,183 @@ namespace ObjMaster {
 	 * fields will be filled according to this and the model can be rendered!
 	 */
 	void loadAllTextures(const TexturePreparationLibrary &texLibrary) {
-		for(auto &mesh : meshes) {
-			mesh.material.loadTexturesIntoMemory(path.c_str(), texLibrary);
-			mesh.material.loadTexturesIntoGPU(gpuTexLibrary);
-			mesh.material.unloadTexturesFromMemory();
-		}
+		forEachUsedMaterial([this, &texLibrary](TextureDataHoldingMaterial &material) {
+			material.loadTexturesIntoMemory(path.c_str(), texLibrary);
+			material.loadTexturesIntoGPU(gpuTexLibrary);
+			material.unloadTexturesFromMemory();
+		});
 	}
 
 	/** First unload all model textures from the GPU then also unload any textures from main memory */
 	void unloadAllTextures() {
+		forEachUsedMaterial([this](TextureDataHoldingMaterial &material) {
+			material.unloadTexturesFromGPU(gpuTexLibrary);
+			material.unloadTexturesFromMemory();
+		});
+	}
+
+	/** Returns the material of the mesh (of this model) from the library of the model - an empty one for bad ids */
+	inline const TextureDataHoldingMaterial& getMaterialOf(const MaterializedObjMeshObject &mesh) const {
+		return mtlLib.getMaterial(mesh.materialId);
+	}
+
+	/** Returns the material of the mesh (of this model) with its texture data - like for rendering. Nullptr for bad ids. */
+	inline TextureDataHoldingMaterial* getLoadableMaterialOf(const MaterializedObjMeshObject &mesh) {
+		return mtlLib.getLoadableMaterial(mesh.materialId);
+	}
+    private:
+	/** Points the instances at the vectors of their own prototypes (after copying the meshes) */
+	void relinkInstances() {
+		for(size_t i = 0; i < instances.size(); ++i) {
+			if(instances[i].prototypeMesh != (int)i) {
+				meshes[i].vertexData = meshes[instances[i].prototypeMesh].vertexData;
+				meshes[i].indices = meshes[instances[i].prototypeMesh].indices;
+			}
+		}
+	}
+
+	/** Calls the function once for each material that is used by a mesh - in the order of the meshes */
+	template<typename Function>
+	void forEachUsedMaterial(Function function) {
+		std::vector<char> handled(mtlLib.getMaterialCount(), 0);
 		for(auto &mesh : meshes) {
-			mesh.material.unloadTexturesFromGPU(gpuTexLibrary);
-			mesh.material.unloadTexturesFromMemory();
+			TextureDataHoldingMaterial *material = mtlLib.getLoadableMaterial(mesh.materialId);
+			if((material != nullptr) && !handled[mesh.materialId]) {
+				handled[mesh.materialId] = 1;
+				function(*material);
+			}
 		}
 	}
-    private:
+
+	/** The faces of one mesh to build: a whole object/material group or a part of it */
+	struct MeshPart {
+		const ObjectMaterialFaceGroup *group;
+		int faceIndex;
+		int meshFaceCount;
+		std::string name;
+	};
+
+	/**
+	 * Builds one mesh per object/material group - in parallel if there is a pool with more than one
+	 * thread. With SPLIT_FOR_16BIT_INDICES the too big groups become more meshes: the first part
+	 * keeps the name of the group and the others get "#1", "#2"... appended.
+	 */
+	void constructionHelper(const Obj &obj, ObjMeshObject::MeshBuildFlags buildFlags, ThreadPool *threadPool) {
+		// The path of the model is the same as the path for obj
+		path = obj.objPath;
+		// We create one mesh per each object material group (part) - in the iteration order of the groups
+		std::vector<MeshPart> groups;
+		groups.reserve(obj.objectMaterialGroups.size());
+		bool split = ((buildFlags & ObjMeshObject::MeshBuildFlags::SPLIT_FOR_16BIT_INDICES) != 0);
+		for(auto &gPair : obj.objectMaterialGroups) {
+			const ObjectMaterialFaceGroup &group = gPair.second;
+			if(split && (group.meshFaceCount > 0)) {
+				auto ranges = ObjMeshObject::splitFaceRanges(obj, &(obj.fs[group.faceIndex]), group.meshFaceCount,
+						ObjMeshObject::MAX_16BIT_INDEXED_VERTICES, buildFlags);
+				std::string name = obj.getGroupName(group);
+				for(size_t r = 0; r < ranges.size(); ++r) {
+					groups.push_back(MeshPart { &group, group.faceIndex + ranges[r].first, ranges[r].second,
+							(r == 0) ? name : name + "#" + std::to_string(r) });
+				}
+				if(ranges.size() > 1) {
+					OMLOGI("Group %s is split into %d meshes to fit 16 bit indices", name.c_str(), (int)ranges.size());
+				}
+			} else {
+				groups.push_back(MeshPart { &group, group.faceIndex, group.meshFaceCount, obj.getGroupName(group) });
+			}
+		}
+		meshes.reserve(groups.size());
+		if(sharedBuffers) {
+			for(auto &part : groups) {
+				meshes.emplace_back(obj,
+					&(obj.fs[part.faceIndex]),
+					part.meshFaceCount,
+					*sharedBuffers,
+					part.group->materialId,
+					std::move(part.name),
+					buildFlags);
+			}
+		} else if((threadPool == nullptr) || (threadPool->getThreadCount() <= 1)) {
+			for(auto &part : groups) {
+#ifdef DEBUG
+        		OMLOGI("!!!!! Object material group have found as %s", part.name.c_str());
+#endif
+				meshes.emplace_back(obj,
+					&(obj.fs[part.faceIndex]),
+					part.meshFaceCount,
+					part.group->materialId,
+					std::move(part.name),
+					buildFlags);
+			}
+		} else {
+			// Groups that are bigger than a fair share of a thread are built one-by-one with
+			// their faces de-duplicated in parallel (like a huge single group of scan data).
+			// The other groups are built in parallel - biggest first so that a big one does
+			// not end up as the last task.
+			int threadCount = threadPool->getThreadCount();
+			int64_t totalFaceCount = 0;
+			for(auto &part : groups) {
+				totalFaceCount += part.meshFaceCount;
+			}
+			std::vector<int> bigGroups;
+			std::vector<int> otherGroups;
+			for(int i = 0; i < (int)groups.size(); ++i) {
+				int meshFaceCount = groups[i].meshFaceCount;
+				if(((int64_t)meshFaceCount * threadCount > totalFaceCount) &&
+				   (meshFaceCount >= 2 * ObjMeshObject::MIN_PARALLEL_DEDUP_FACES)) {
+					bigGroups.push_back(i);
+				} else {
+					otherGroups.push_back(i);
+				}
+			}
+			std::stable_sort(otherGroups.begin(), otherGroups.end(), [&groups](int a, int b) {
+				return groups[a].meshFaceCount > groups[b].meshFaceCount;
+			});
+
+			// Every mesh has its own slot so the output order stays the same as the group order
+			std::vector<std::unique_ptr<MaterializedObjMeshObject>> built(groups.size());
+			auto buildMesh = [&obj, &groups, &built](int i, ObjMeshObject::MeshBuildFlags meshBuildFlags, ThreadPool *meshThreadPool) {
+				MeshPart &part = groups[i];
+				built[i].reset(new MaterializedObjMeshObject(obj,
+					&(obj.fs[part.faceIndex]),
+					part.meshFaceCount,
+					part.group->materialId,
+					std::move(part.name),
+					meshBuildFlags,
+					meshThreadPool));
+			};
+			for(int i : bigGroups) {
+				buildMesh(i, (ObjMeshObject::MeshBuildFlags)(buildFlags | ObjMeshObject::MeshBuildFlags::PARALLEL_DEDUP), threadPool);
+			}
+			// Rem.: These run on the workers already - PARALLEL_DEDUP would start nested pools in them
+			ObjMeshObject::MeshBuildFlags workerBuildFlags =
+					(ObjMeshObject::MeshBuildFlags)(buildFlags & ~ObjMeshObject::MeshBuildFlags::PARALLEL_DEDUP);
+			threadPool->parallelFor((int)otherGroups.size(), [&otherGroups, &buildMesh, workerBuildFlags](int i) {
+				buildMesh(otherGroups[i], workerBuildFlags, nullptr);
+			});
+			for(auto &mesh : built) {
+				meshes.push_back(std::move(*mesh));
+			}
+		}
+
+		// One copy of the materials for the whole model - the meshes without a material get an empty one
+		mtlLib = obj.mtlLib;
+		for(auto &mesh : meshes) {
+			if(mesh.materialId == MtlLib::NO_MATERIAL) {
+				mesh.materialId = mtlLib.getOrCreateMaterialId("");
+			}
+		}
+
+		// The model bounds come from the mesh bounds - no need to walk the vertices again
+		bounds = MeshBounds::empty();
+		for(auto &mesh : meshes) {
+			bounds = MeshBounds::merge(bounds, mesh.bounds);
+		}
+
+		// Indicate that the model is loaded
+		inited = true;
+	}
+
 	/**
 	 * Have to keep a library because the GPU-unload need to be managed by this! The unload
 	 * from memory does not need the library, but unloading from the GPU is different and
@@ -0,0 +1,143 @@
+//
+// Bounding volume computation of meshes and models (SIMD accelerated where available).
+//
+
+#include "MeshBounds.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define OM_BOUNDS_SSE 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OM_BOUNDS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace ObjMaster {
+
+    static inline const float* positionOf(const float *positions, size_t positionStride, unsigned int vertex) {
+        return (const float *)((const char *)positions + vertex * positionStride);
+    }
+
+    BoundingVolume MeshBounds::compute(const float *positions, size_t positionStride, unsigned int vertexCount) {
+        if(vertexCount == 0) {
+            return empty();
+        }
+        float minPos[4], maxPos[4];
+        const float *first = positionOf(positions, positionStride, 0);
+        for(int k = 0; k < 3; ++k) {
+            minPos[k] = maxPos[k] = first[k];
+        }
+        // Rem.: the vector loops read 4 floats from each position, so the last vertex is always
+        // done by the scalar code (its fourth float might be outside of the vertex data).
+        unsigned int vectorCount = (positionStride >= 4 * sizeof(float)) ? vertexCount - 1 : 0;
+        unsigned int v = 0;
+#if OM_BOUNDS_SSE
+        __m128 minVector = _mm_loadu_ps(first);
+        __m128 maxVector = minVector;
+        for(; v < vectorCount; ++v) {
+            __m128 p = _mm_loadu_ps(positionOf(positions, positionStride, v));
+            minVector = _mm_min_ps(minVector, p);
+            maxVector = _mm_max_ps(maxVector, p);
+        }
+        _mm_storeu_ps(minPos, minVector);
+        _mm_storeu_ps(maxPos, maxVector);
+#elif OM_BOUNDS_NEON
+        float32x4_t minVector = vld1q_f32(first);
+        float32x4_t maxVector = minVector;
+        for(; v < vectorCount; ++v) {
+            float32x4_t p = vld1q_f32(positionOf(positions, positionStride, v));
+            minVector = vminq_f32(minVector, p);
+            maxVector = vmaxq_f32(maxVector, p);
+        }
+        vst1q_f32(minPos, minVector);
+        vst1q_f32(maxPos, maxVector);
+#endif
+        for(; v < vertexCount; ++v) {
+            const float *p = positionOf(positions, positionStride, v);
+            for(int k = 0; k < 3; ++k) {
+                minPos[k] = std::min(minPos[k], p[k]);
+                maxPos[k] = std::max(maxPos[k], p[k]);
+            }
+        }
+
+        BoundingVolume bounds;
+        bounds.minX = minPos[0];
+        bounds.minY = minPos[1];
+        bounds.minZ = minPos[2];
+        bounds.maxX = maxPos[0];
+        bounds.maxY = maxPos[1];
+        bounds.maxZ = maxPos[2];
+        bounds.centerX = (minPos[0] + maxPos[0]) / 2;
+        bounds.centerY = (minPos[1] + maxPos[1]) / 2;
+        bounds.centerZ = (minPos[2] + maxPos[2]) / 2;
+
+        // The radius: the biggest squared distance from the center
+        float radiusSquared = 0;
+        v = 0;
+#if OM_BOUNDS_SSE
+        __m128 center = _mm_setr_ps(bounds.centerX, bounds.centerY, bounds.centerZ, 0);
+        __m128 xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+        __m128 maxSquared = _mm_setzero_ps();
+        for(; v < vectorCount; ++v) {
+            __m128 d = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(positionOf(positions, positionStride, v)), center), xyzMask);
+            __m128 squared = _mm_mul_ps(d, d);
+            // Horizontal sum into every lane
+            squared = _mm_add_ps(squared, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(2, 3, 0, 1)));
+            squared = _mm_add_ps(squared, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(1, 0, 3, 2)));
+            maxSquared = _mm_max_ps(maxSquared, squared);
+        }
+        radiusSquared = _mm_cvtss_f32(maxSquared);
+#elif OM_BOUNDS_NEON
+        const float centerValues[4] = { bounds.centerX, bounds.centerY, bounds.centerZ, 0 };
+        const uint32_t maskValues[4] = { 0xffffffff, 0xffffffff, 0xffffffff, 0 };
+        float32x4_t center = vld1q_f32(centerValues);
+        uint32x4_t xyzMask = vld1q_u32(maskValues);
+        float32x4_t maxSquared = vdupq_n_f32(0);
+        for(; v < vectorCount; ++v) {
+            float32x4_t d = vsubq_f32(vld1q_f32(positionOf(positions, positionStride, v)), center);
+            d = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(d), xyzMask));
+            float32x4_t squared = vmulq_f32(d, d);
+            float32x2_t pairs = vadd_f32(vget_low_f32(squared), vget_high_f32(squared));
+            maxSquared = vmaxq_f32(maxSquared, vdupq_lane_f32(vpadd_f32(pairs, pairs), 0));
+        }
+        radiusSquared = vgetq_lane_f32(maxSquared, 0);
+#endif
+        for(; v < vertexCount; ++v) {
+            const float *p = positionOf(positions, positionStride, v);
+            float d[3] = { p[0] - bounds.centerX, p[1] - bounds.centerY, p[2] - bounds.centerZ };
+            radiusSquared = std::max(radiusSquared, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        }
+        bounds.radius = std::sqrt(radiusSquared);
+        return bounds;
+    }
+
+    BoundingVolume MeshBounds::merge(const BoundingVolume &a, const BoundingVolume &b) {
+        if(isEmpty(a)) {
+            return b;
+        }
+        if(isEmpty(b)) {
+            return a;
+        }
+        BoundingVolume bounds;
+        bounds.minX = std::min(a.minX, b.minX);
+        bounds.minY = std::min(a.minY, b.minY);
+        bounds.minZ = std::min(a.minZ, b.minZ);
+        bounds.maxX = std::max(a.maxX, b.maxX);
+        bounds.maxY = std::max(a.maxY, b.maxY);
+        bounds.maxZ = std::max(a.maxZ, b.maxZ);
+        bounds.centerX = (bounds.minX + bounds.maxX) / 2;
+        bounds.centerY = (bounds.minY + bounds.maxY) / 2;
+        bounds.centerZ = (bounds.minZ + bounds.maxZ) / 2;
+        bounds.radius = 0;
+        for(const BoundingVolume *part : { &a, &b }) {
+            float d[3] = { part->centerX - bounds.centerX, part->centerY - bounds.centerY, part->centerZ - bounds.centerZ };
+            bounds.radius = std::max(bounds.radius, std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) + part->radius);
+        }
+        // Rem.: the sphere never needs to be bigger than the one around the merged box
+        float halfDiagonal[3] = { bounds.maxX - bounds.centerX, bounds.maxY - bounds.centerY, bounds.maxZ - bounds.centerZ };
+        bounds.radius = std::min(bounds.radius, std::sqrt(halfDiagonal[0] * halfDiagonal[0] +
+                halfDiagonal[1] * halfDiagonal[1] + halfDiagonal[2] * halfDiagonal[2]));
+        return bounds;
+    }
+}
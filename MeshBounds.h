@@ -0,0 +1,110 @@
+//
+// Bounding volume computation of meshes and models (SIMD accelerated where available).
+//
+
+#ifndef OBJMASTER_MESHBOUNDS_H
+#define OBJMASTER_MESHBOUNDS_H
+
+#include "VertexStructure.h"
+#include "BoundsStructure.h"
+#include "objmasterlog.h"
+#include <cmath>
+#include <cstddef>
+
+namespace ObjMaster {
+
+    /**
+     * Computes bounding volumes in (at most) two linear passes over the positions: one for the box
+     * and one for the radius around its center. The min/max and distance computations use SSE or
+     * NEON when the compiler targets them and plain floats otherwise - the results are the same.
+     */
+    class MeshBounds final {
+    public:
+        /** The bounding volume of nothing (see BoundsStructure.h) */
+        static inline BoundingVolume empty() {
+            return BoundingVolume { 0, 0, 0, 0, 0, 0, 0, 0, 0, -1 };
+        }
+
+        /** Says if the bounding volume is the one of an empty vertex set */
+        static inline bool isEmpty(const BoundingVolume &bounds) {
+            return bounds.radius < 0;
+        }
+
+        /** The bounding volume of the vertices */
+        static inline BoundingVolume compute(const VertexStructure *vertices, unsigned int vertexCount) {
+            return compute(&vertices[0].x, sizeof(VertexStructure), vertexCount);
+        }
+
+        /**
+         * The same as above for any vertex layout: the x, y, z floats of vertex n are at
+         * positions + n * positionStride bytes.
+         */
+        static BoundingVolume compute(const float *positions, size_t positionStride, unsigned int vertexCount);
+
+        /**
+         * The bounding volume of both - without the vertices: the sphere is centered on the merged
+         * box and encloses both spheres, so it can be a bit bigger than the one compute(..) would give.
+         */
+        static BoundingVolume merge(const BoundingVolume &a, const BoundingVolume &b);
+    };
+
+// Very simple unit-testing approach
+// it is better to have these run on the device itself and callable as normal functions than to
+// test it compile-time with some unit testing framework as this way we rule out architectural
+// differences better. Tests will start by logging test starts to error (when #DEBUG is set!)
+// and info logs and the method returns false when anything has failed...
+    static bool TEST_MeshBounds() {
+#ifdef DEBUG
+        OMLOGI("TEST_MeshBounds...");
+#endif
+        // Odd count to test the scalar tail too - the extremes are on different vertices
+        VertexStructure vertices[] = {
+            { 1, 2, 3, 0, 0, 1, 0, 0 },
+            { -4, 0.5f, 3, 0, 0, 1, 0, 0 },
+            { 0, 7, -1, 0, 0, 1, 0, 0 },
+            { 2, 1, 9, 0, 0, 1, 0, 0 },
+            { 0.25f, -3, 0, 0, 0, 1, 0, 0 },
+        };
+        BoundingVolume bounds = MeshBounds::compute(vertices, 5);
+        if((bounds.minX != -4) || (bounds.minY != -3) || (bounds.minZ != -1) ||
+           (bounds.maxX != 2) || (bounds.maxY != 7) || (bounds.maxZ != 9) ||
+           (bounds.centerX != -1) || (bounds.centerY != 2) || (bounds.centerZ != 4)) {
+            OMLOGE("Bad bounding box: (%f, %f, %f) - (%f, %f, %f)!", bounds.minX, bounds.minY, bounds.minZ,
+                   bounds.maxX, bounds.maxY, bounds.maxZ);
+            return false;
+        }
+        // The farthest vertex from (-1, 2, 4) is (0, 7, -1): sqrt(1 + 25 + 25)
+        if(std::fabs(bounds.radius - std::sqrt(51.0f)) > 0.0001f) {
+            OMLOGE("Bad bounding sphere radius: %f!", bounds.radius);
+            return false;
+        }
+
+        // Empty sets and merging
+        BoundingVolume single = MeshBounds::compute(vertices, 1);
+        if(!MeshBounds::isEmpty(MeshBounds::compute(vertices, 0)) || (single.radius != 0) || (single.centerZ != 3)) {
+            OMLOGE("Bad bounds of empty or single vertex sets!");
+            return false;
+        }
+        BoundingVolume merged = MeshBounds::merge(MeshBounds::merge(MeshBounds::empty(), single),
+                                                  MeshBounds::compute(&vertices[1], 4));
+        if((merged.minX != bounds.minX) || (merged.maxZ != bounds.maxZ) || (merged.centerY != bounds.centerY) ||
+           (merged.radius < bounds.radius)) {
+            OMLOGE("Bad merged bounds!");
+            return false;
+        }
+        for(const VertexStructure &v : vertices) {
+            float dx = v.x - merged.centerX, dy = v.y - merged.centerY, dz = v.z - merged.centerZ;
+            if(std::sqrt(dx * dx + dy * dy + dz * dz) > merged.radius * 1.0001f) {
+                OMLOGE("A vertex is outside of the merged bounding sphere!");
+                return false;
+            }
+        }
+
+#ifdef DEBUG
+        OMLOGI("...TEST_MeshBounds completed (OK)");
+#endif
+        return true;
+    }
+}
+
+#endif //OBJMASTER_MESHBOUNDS_H
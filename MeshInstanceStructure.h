@@ -0,0 +1,25 @@
+//
+// References of meshes to the (identical) geometry of other meshes - see MeshInstancing.
+// This code should be able to get included as a C-header, because it is used in the interop facade layer!
+//
+// BECAUSE OF THIS: NO C++ FEATURES SHOULD BE USED HERE EVER!
+//
+
+#ifndef OBJMASTER_MESHINSTANCESTRUCTURE_H
+#define OBJMASTER_MESHINSTANCESTRUCTURE_H
+
+/**
+ * Tells which mesh of a model has the geometry to draw for a mesh and how to place it. Meshes that
+ * are not instances of others refer to themselves with the identity transform. The transform is a
+ * row-major 3x4 matrix (a rotation and a translation): a vertex of the prototype mesh is placed
+ * at (transform[0..2] dot (x, y, z) + transform[3], transform[4..6] dot (x, y, z) + transform[7],
+ * transform[8..10] dot (x, y, z) + transform[11]). Normals and tangents only get the rotation.
+ */
+struct MeshInstance {
+    // the index of the mesh that has the geometry
+    int prototypeMesh;
+    // rotation and translation of the prototype geometry
+    float transform[12];
+};
+
+#endif //OBJMASTER_MESHINSTANCESTRUCTURE_H
@@ -0,0 +1,277 @@
+//
+// Detection of meshes with identical geometry (optionally modulo a rigid transform) for instancing.
+//
+
+#include "MeshInstancing.h"
+#include "VertexDedupTable.h"
+#include <unordered_map>
+#include <cstring>
+
+namespace ObjMaster {
+
+    static inline uint64_t floatBits(float f) {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        return bits;
+    }
+
+    /** The vertices of the mesh-range (nullptr for empty meshes) */
+    static inline const VertexStructure* meshVertices(const ObjMeshObject &mesh) {
+        return (mesh.vertexCount > 0) ? &(*mesh.vertexData)[mesh.baseVertexLocation] : nullptr;
+    }
+
+    /** The n-th index of the mesh made local: zero is the first vertex of the mesh-range */
+    static inline OM_INDEX_TYPE localIndex(const ObjMeshObject &mesh, unsigned int n) {
+        return (OM_INDEX_TYPE)((*mesh.indices)[mesh.startIndexLocation + n] - (OM_INDEX_TYPE)(mesh.lastIndex - mesh.vertexCount));
+    }
+
+    uint64_t MeshInstancing::fingerprint(const ObjMeshObject &mesh, bool moduloRigidTransform) {
+        uint64_t hash = dedupCombine(dedupCombine(0, mesh.vertexCount), mesh.indexCount);
+        hash = dedupCombine(hash, mesh.tangents.size());
+        for(unsigned int n = 0; n < mesh.indexCount; ++n) {
+            hash = dedupCombine(hash, localIndex(mesh, n));
+        }
+        const VertexStructure *vertices = meshVertices(mesh);
+        if(!moduloRigidTransform) {
+            for(unsigned int n = 0; n < mesh.vertexCount; ++n) {
+                const VertexStructure &v = vertices[n];
+                hash = dedupCombine(hash, floatBits(v.x) | (floatBits(v.y) << 32));
+                hash = dedupCombine(hash, floatBits(v.z) | (floatBits(v.i) << 32));
+                hash = dedupCombine(hash, floatBits(v.j) | (floatBits(v.k) << 32));
+                hash = dedupCombine(hash, floatBits(v.u) | (floatBits(v.v) << 32));
+            }
+            for(const TangentStructure &t : mesh.tangents) {
+                hash = dedupCombine(hash, floatBits(t.x) | (floatBits(t.y) << 32));
+                hash = dedupCombine(hash, floatBits(t.z) | (floatBits(t.w) << 32));
+            }
+            return dedupMix64(hash);
+        }
+
+        // Texture coordinates stay the same under rigid transforms and so does the size of the mesh
+        double centroid[3] = { 0, 0, 0 };
+        for(unsigned int n = 0; n < mesh.vertexCount; ++n) {
+            const VertexStructure &v = vertices[n];
+            hash = dedupCombine(hash, floatBits(v.u) | (floatBits(v.v) << 32));
+            centroid[0] += v.x;
+            centroid[1] += v.y;
+            centroid[2] += v.z;
+        }
+        double squareSum = 0;
+        if(mesh.vertexCount > 0) {
+            for(int k = 0; k < 3; ++k) {
+                centroid[k] /= mesh.vertexCount;
+            }
+            for(unsigned int n = 0; n < mesh.vertexCount; ++n) {
+                const VertexStructure &v = vertices[n];
+                double d[3] = { v.x - centroid[0], v.y - centroid[1], v.z - centroid[2] };
+                squareSum += d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+            }
+        }
+        // Rem.: the root mean square distance from the centroid on a logarithmic scale of 1/256 octaves
+        int64_t size = (squareSum > 0) ? (int64_t)std::floor(std::log2(std::sqrt(squareSum / mesh.vertexCount)) * 256 + 0.5) : INT64_MIN;
+        hash = dedupCombine(hash, (uint64_t)size);
+        return dedupMix64(hash);
+    }
+
+    /** Builds the orthonormal frame of the anchors: the columns are the axes */
+    static bool anchorFrame(const VertexStructure &first, const VertexStructure &second, const double *centroid, double frame[3][3]) {
+        double e1[3] = { first.x - centroid[0], first.y - centroid[1], first.z - centroid[2] };
+        double e2[3] = { second.x - centroid[0], second.y - centroid[1], second.z - centroid[2] };
+        double length1 = std::sqrt(e1[0] * e1[0] + e1[1] * e1[1] + e1[2] * e1[2]);
+        if(length1 <= 0) {
+            return false;
+        }
+        for(int k = 0; k < 3; ++k) {
+            e1[k] /= length1;
+        }
+        double along = e1[0] * e2[0] + e1[1] * e2[1] + e1[2] * e2[2];
+        for(int k = 0; k < 3; ++k) {
+            e2[k] -= along * e1[k];
+        }
+        double length2 = std::sqrt(e2[0] * e2[0] + e2[1] * e2[1] + e2[2] * e2[2]);
+        if(length2 <= 0) {
+            return false;
+        }
+        for(int k = 0; k < 3; ++k) {
+            e2[k] /= length2;
+        }
+        double e3[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        for(int k = 0; k < 3; ++k) {
+            frame[k][0] = e1[k];
+            frame[k][1] = e2[k];
+            frame[k][2] = e3[k];
+        }
+        return true;
+    }
+
+    static inline void centroidOf(const VertexStructure *vertices, unsigned int vertexCount, double *centroid) {
+        centroid[0] = centroid[1] = centroid[2] = 0;
+        for(unsigned int n = 0; n < vertexCount; ++n) {
+            centroid[0] += vertices[n].x;
+            centroid[1] += vertices[n].y;
+            centroid[2] += vertices[n].z;
+        }
+        for(int k = 0; k < 3; ++k) {
+            centroid[k] /= vertexCount;
+        }
+    }
+
+    bool MeshInstancing::findRigidTransform(const VertexStructure *prototype, const VertexStructure *instance, unsigned int vertexCount,
+            float tolerance, float *transform) {
+        if(vertexCount == 0) {
+            return false;
+        }
+        double centroidA[3], centroidB[3];
+        centroidOf(prototype, vertexCount, centroidA);
+        centroidOf(instance, vertexCount, centroidB);
+
+        // The anchors: the farthest position from the centroid and the farthest one from that axis
+        unsigned int first = 0;
+        double firstDistance = -1;
+        for(unsigned int n = 0; n < vertexCount; ++n) {
+            double d[3] = { prototype[n].x - centroidA[0], prototype[n].y - centroidA[1], prototype[n].z - centroidA[2] };
+            double distance = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+            if(distance > firstDistance) {
+                first = n;
+                firstDistance = distance;
+            }
+        }
+        double size = std::sqrt(firstDistance);
+        if(size <= 0) {
+            return false;
+        }
+        double axis[3] = { (prototype[first].x - centroidA[0]) / size, (prototype[first].y - centroidA[1]) / size,
+                (prototype[first].z - centroidA[2]) / size };
+        unsigned int second = 0;
+        double secondDistance = -1;
+        for(unsigned int n = 0; n < vertexCount; ++n) {
+            double d[3] = { prototype[n].x - centroidA[0], prototype[n].y - centroidA[1], prototype[n].z - centroidA[2] };
+            double c[3] = { axis[1] * d[2] - axis[2] * d[1], axis[2] * d[0] - axis[0] * d[2], axis[0] * d[1] - axis[1] * d[0] };
+            double distance = c[0] * c[0] + c[1] * c[1] + c[2] * c[2];
+            if(distance > secondDistance) {
+                second = n;
+                secondDistance = distance;
+            }
+        }
+        // Rem.: (nearly) collinear positions do not determine the rotation around their line
+        if(std::sqrt(secondDistance) <= tolerance * size) {
+            return false;
+        }
+        double frameA[3][3], frameB[3][3];
+        if(!anchorFrame(prototype[first], prototype[second], centroidA, frameA) ||
+           !anchorFrame(instance[first], instance[second], centroidB, frameB)) {
+            return false;
+        }
+
+        // rotation = frameB * transpose(frameA) and translation = centroidB - rotation * centroidA
+        double rotation[3][3];
+        for(int r = 0; r < 3; ++r) {
+            for(int c = 0; c < 3; ++c) {
+                rotation[r][c] = frameB[r][0] * frameA[c][0] + frameB[r][1] * frameA[c][1] + frameB[r][2] * frameA[c][2];
+            }
+        }
+        double translation[3];
+        for(int r = 0; r < 3; ++r) {
+            translation[r] = centroidB[r] - (rotation[r][0] * centroidA[0] + rotation[r][1] * centroidA[1] + rotation[r][2] * centroidA[2]);
+        }
+
+        // Every vertex has to be moved onto its pair
+        const double positionTolerance = tolerance * size;
+        for(unsigned int n = 0; n < vertexCount; ++n) {
+            const VertexStructure &a = prototype[n];
+            const VertexStructure &b = instance[n];
+            double p[3] = { a.x, a.y, a.z };
+            double normal[3] = { a.i, a.j, a.k };
+            double placed[3] = { b.x, b.y, b.z };
+            double placedNormal[3] = { b.i, b.j, b.k };
+            for(int r = 0; r < 3; ++r) {
+                double position = rotation[r][0] * p[0] + rotation[r][1] * p[1] + rotation[r][2] * p[2] + translation[r];
+                double rotatedNormal = rotation[r][0] * normal[0] + rotation[r][1] * normal[1] + rotation[r][2] * normal[2];
+                if((std::fabs(position - placed[r]) > positionTolerance) || (std::fabs(rotatedNormal - placedNormal[r]) > tolerance)) {
+                    return false;
+                }
+            }
+        }
+        for(int r = 0; r < 3; ++r) {
+            for(int c = 0; c < 3; ++c) {
+                transform[4 * r + c] = (float)rotation[r][c];
+            }
+            transform[4 * r + 3] = (float)translation[r];
+        }
+        return true;
+    }
+
+    bool MeshInstancing::matchInstance(const ObjMeshObject &prototype, const ObjMeshObject &mesh, bool moduloRigidTransform,
+            float tolerance, float *transform) {
+        if(!prototype.inited || !mesh.inited || (prototype.vertexCount != mesh.vertexCount) ||
+           (prototype.indexCount != mesh.indexCount) || (prototype.tangents.size() != mesh.tangents.size())) {
+            return false;
+        }
+        for(unsigned int n = 0; n < mesh.indexCount; ++n) {
+            if(localIndex(prototype, n) != localIndex(mesh, n)) {
+                return false;
+            }
+        }
+        const VertexStructure *a = meshVertices(prototype);
+        const VertexStructure *b = meshVertices(mesh);
+        if((mesh.vertexCount == 0) ||
+           ((memcmp(a, b, mesh.vertexCount * sizeof(VertexStructure)) == 0) &&
+            (mesh.tangents.empty() || (memcmp(&prototype.tangents[0], &mesh.tangents[0], mesh.tangents.size() * sizeof(TangentStructure)) == 0)))) {
+            setIdentity(transform);
+            return true;
+        }
+        if(!moduloRigidTransform) {
+            return false;
+        }
+        for(unsigned int n = 0; n < mesh.vertexCount; ++n) {
+            if((a[n].u != b[n].u) || (a[n].v != b[n].v)) {
+                return false;
+            }
+        }
+        float rigid[12];
+        if(!findRigidTransform(a, b, mesh.vertexCount, tolerance, rigid)) {
+            return false;
+        }
+        for(size_t n = 0; n < mesh.tangents.size(); ++n) {
+            const TangentStructure &t = prototype.tangents[n];
+            const TangentStructure &placed = mesh.tangents[n];
+            if(t.w != placed.w) {
+                return false;
+            }
+            float placedTangent[3] = { placed.x, placed.y, placed.z };
+            for(int r = 0; r < 3; ++r) {
+                if(std::fabs(rigid[4 * r] * t.x + rigid[4 * r + 1] * t.y + rigid[4 * r + 2] * t.z - placedTangent[r]) > tolerance) {
+                    return false;
+                }
+            }
+        }
+        memcpy(transform, rigid, sizeof(rigid));
+        return true;
+    }
+
+    std::vector<MeshInstance> MeshInstancing::findInstances(const std::vector<const ObjMeshObject*> &meshes, bool moduloRigidTransform,
+            float tolerance) {
+        std::vector<MeshInstance> instances(meshes.size());
+        // The prototypes (the meshes that are not instances) for each fingerprint
+        std::unordered_map<uint64_t, std::vector<int>> prototypes;
+        for(int i = 0; i < (int)meshes.size(); ++i) {
+            MeshInstance &instance = instances[i];
+            instance.prototypeMesh = i;
+            setIdentity(instance.transform);
+            if(!meshes[i]->inited || (meshes[i]->indexCount == 0)) {
+                continue;
+            }
+            std::vector<int> &candidates = prototypes[fingerprint(*meshes[i], moduloRigidTransform)];
+            for(int candidate : candidates) {
+                if(matchInstance(*meshes[candidate], *meshes[i], moduloRigidTransform, tolerance, instance.transform)) {
+                    instance.prototypeMesh = candidate;
+                    break;
+                }
+            }
+            if(instance.prototypeMesh == i) {
+                candidates.push_back(i);
+            }
+        }
+        return instances;
+    }
+}
@@ -0,0 +1,134 @@
+//
+// Detection of meshes with identical geometry (optionally modulo a rigid transform) for instancing.
+//
+
+#ifndef OBJMASTER_MESHINSTANCING_H
+#define OBJMASTER_MESHINSTANCING_H
+
+#include "ObjMeshObject.h"
+#include "VertexStructure.h"
+#include "MeshInstanceStructure.h"
+#include "objmasterlog.h"
+#include <vector>
+#include <cmath>
+#include <stdint.h>
+
+namespace ObjMaster {
+
+    /**
+     * Finds the meshes that can be drawn as instances of another one. Meshes are identical when
+     * their local indices and the vertices of their range are the same bytes (like props exported
+     * once per placement). Modulo a rigid transform, the positions, normals and tangents can also
+     * be rotated and translated: the indices, the texture coordinates and the order of the vertices
+     * still have to be the same, as they are for copies of a sub-object. Mirrored copies are not
+     * rigid transforms. Candidates are found by fingerprint (a hash of the content) and always
+     * verified vertex by vertex, so false instances are never reported. Meshes with a rotation that
+     * the positions do not determine (all positions on one line) are never instances modulo rigid
+     * transforms - only of identical meshes.
+     */
+    class MeshInstancing final {
+    public:
+        /** The default tolerance of the rigid matching - relative to the size of the mesh */
+        static constexpr float DEFAULT_TOLERANCE = 1e-4f;
+
+        /**
+         * The hash of the geometry of the mesh: identical meshes (or with moduloRigidTransform,
+         * rigidly transformed ones) have the same fingerprint. Modulo rigid transforms, the size
+         * of the mesh is hashed with a (fine) quantization, so a copy very rarely gets a different
+         * fingerprint because of float rounding at a quantization step - that only misses an instance.
+         */
+        static uint64_t fingerprint(const ObjMeshObject &mesh, bool moduloRigidTransform);
+
+        /**
+         * Finds the rotation and translation that moves the prototype vertices onto the instance
+         * vertices (vertex n onto vertex n). The positions should match within tolerance times the
+         * biggest distance of a prototype position from the centroid and the normals within the
+         * tolerance. Returns false (and leaves transform untouched) when there is no such transform.
+         * The transform is the 3x4 matrix of MeshInstance.
+         */
+        static bool findRigidTransform(const VertexStructure *prototype, const VertexStructure *instance, unsigned int vertexCount,
+                float tolerance, float *transform);
+
+        /**
+         * Tells if mesh can be drawn as the (transformed) prototype. The transform is written only
+         * when it returns true - it is the identity for identical meshes.
+         */
+        static bool matchInstance(const ObjMeshObject &prototype, const ObjMeshObject &mesh, bool moduloRigidTransform,
+                float tolerance, float *transform);
+
+        /**
+         * Finds the instances among the meshes: one MeshInstance for each mesh, referring to the first
+         * earlier mesh it is an instance of (or itself). Meshes without triangles are never instances.
+         */
+        static std::vector<MeshInstance> findInstances(const std::vector<const ObjMeshObject*> &meshes, bool moduloRigidTransform,
+                float tolerance = DEFAULT_TOLERANCE);
+
+        /** Sets the transform to the identity */
+        static inline void setIdentity(float *transform) {
+            for(int i = 0; i < 12; ++i) {
+                transform[i] = ((i % 5) == 0) ? 1.0f : 0.0f;
+            }
+        }
+    };
+
+// Very simple unit-testing approach
+// it is better to have these run on the device itself and callable as normal functions than to
+// test it compile-time with some unit testing framework as this way we rule out architectural
+// differences better. Tests will start by logging test starts to error (when #DEBUG is set!)
+// and info logs and the method returns false when anything has failed...
+    static bool TEST_MeshInstancing() {
+#ifdef DEBUG
+        OMLOGI("TEST_MeshInstancing...");
+#endif
+        // A tetrahedron-like point set with normals - then rotated by 90 degrees around z and moved
+        std::vector<VertexStructure> prototype = {
+            { 0, 0, 0, 0, 0, 1, 0, 0 },
+            { 2, 0, 0, 1, 0, 0, 1, 0 },
+            { 0, 1, 0, 0, 1, 0, 0, 1 },
+            { 0, 0, 3, 0, 0, 1, 1, 1 },
+        };
+        std::vector<VertexStructure> instance;
+        for(const VertexStructure &v : prototype) {
+            // (x, y, z) -> (-y, x, z) + (10, 20, 30)
+            instance.push_back(VertexStructure { -v.y + 10, v.x + 20, v.z + 30, -v.j, v.i, v.k, v.u, v.v });
+        }
+        float transform[12];
+        if(!MeshInstancing::findRigidTransform(&prototype[0], &instance[0], 4, MeshInstancing::DEFAULT_TOLERANCE, transform)) {
+            OMLOGE("No rigid transform is found for a rotated copy!");
+            return false;
+        }
+        const float expected[12] = { 0, -1, 0, 10,  1, 0, 0, 20,  0, 0, 1, 30 };
+        for(int i = 0; i < 12; ++i) {
+            if(std::fabs(transform[i] - expected[i]) > 0.0001f) {
+                OMLOGE("Bad rigid transform element %d: %f instead of %f!", i, transform[i], expected[i]);
+                return false;
+            }
+        }
+
+        // Mirrored and scaled copies are not rigid transforms - and neither are wrong normals
+        std::vector<VertexStructure> mirrored = prototype;
+        std::vector<VertexStructure> scaled = prototype;
+        std::vector<VertexStructure> badNormal = instance;
+        for(size_t i = 0; i < prototype.size(); ++i) {
+            mirrored[i].x = -mirrored[i].x;
+            mirrored[i].i = -mirrored[i].i;
+            scaled[i].x *= 2;
+            scaled[i].y *= 2;
+            scaled[i].z *= 2;
+        }
+        badNormal[0].k = -1;
+        if(MeshInstancing::findRigidTransform(&prototype[0], &mirrored[0], 4, MeshInstancing::DEFAULT_TOLERANCE, transform) ||
+           MeshInstancing::findRigidTransform(&prototype[0], &scaled[0], 4, MeshInstancing::DEFAULT_TOLERANCE, transform) ||
+           MeshInstancing::findRigidTransform(&prototype[0], &badNormal[0], 4, MeshInstancing::DEFAULT_TOLERANCE, transform)) {
+            OMLOGE("A rigid transform is found for a copy that is not rigidly transformed!");
+            return false;
+        }
+
+#ifdef DEBUG
+        OMLOGI("...TEST_MeshInstancing completed (OK)");
+#endif
+        return true;
+    }
+}
+
+#endif //OBJMASTER_MESHINSTANCING_H
@@ -0,0 +1,362 @@
+//
+// Post-processing of the index (and vertex) buffers of meshes for faster rendering.
+//
+
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <cstring>
+
+namespace ObjMaster {
+
+    /** Returns the mesh-local vertex number of the index (wraps around just like the index building does) */
+    static inline unsigned int localVertex(OM_INDEX_TYPE index, OM_INDEX_TYPE firstIndex) {
+        return (OM_INDEX_TYPE)(index - firstIndex);
+    }
+
+    float MeshOptimizer::computeACMR(const OM_INDEX_TYPE *indices, unsigned int indexCount,
+            OM_INDEX_TYPE firstIndex, unsigned int vertexCount, int cacheSize) {
+        if(indexCount < 3) {
+            return 0;
+        }
+        // FIFO cache: a vertex is in the cache if it was loaded in one of the last cacheSize misses
+        std::vector<unsigned int> loadTime(vertexCount, 0);
+        unsigned int misses = 0;
+        for(unsigned int i = 0; i < indexCount; ++i) {
+            unsigned int v = localVertex(indices[i], firstIndex);
+            if(v >= vertexCount) {
+                // Not in this mesh - always a miss
+                ++misses;
+                continue;
+            }
+            // Rem.: load times start from 1 so that zero means never loaded. The vertex is
+            // evicted when cacheSize other vertices were loaded after it.
+            if((loadTime[v] == 0) || (misses - loadTime[v] >= (unsigned int)cacheSize)) {
+                ++misses;
+                loadTime[v] = misses;
+            }
+        }
+        return (float)misses / (float)(indexCount / 3);
+    }
+
+    bool MeshOptimizer::optimizeVertexCache(OM_INDEX_TYPE *indices, unsigned int indexCount,
+            OM_INDEX_TYPE firstIndex, unsigned int vertexCount, int cacheSize) {
+        unsigned int triangleCount = indexCount / 3;
+        if(triangleCount == 0) {
+            return true;
+        }
+
+        // Vertex -> triangles adjacency (in the compact offset + list form) and the live
+        // triangle counts that tell how many not yet emitted triangles use the vertex
+        std::vector<unsigned int> liveCount(vertexCount, 0);
+        for(unsigned int i = 0; i < triangleCount * 3; ++i) {
+            unsigned int v = localVertex(indices[i], firstIndex);
+            if(v >= vertexCount) {
+                OMLOGE("Index %u (%u) is out of the mesh vertex range - not optimizing vertex cache!", i, (unsigned int)indices[i]);
+                return false;
+            }
+            ++liveCount[v];
+        }
+        std::vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+        for(unsigned int v = 0; v < vertexCount; ++v) {
+            adjacencyStart[v + 1] = adjacencyStart[v] + liveCount[v];
+        }
+        std::vector<unsigned int> adjacency(triangleCount * 3);
+        {
+            std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+            for(unsigned int i = 0; i < triangleCount * 3; ++i) {
+                adjacency[fill[localVertex(indices[i], firstIndex)]++] = i / 3;
+            }
+        }
+
+        std::vector<OM_INDEX_TYPE> output;
+        output.reserve(triangleCount * 3);
+        std::vector<bool> emitted(triangleCount, false);
+        // Cache time stamps of the vertices - a vertex is in the cache if time - stamp < cacheSize
+        std::vector<unsigned int> cacheTime(vertexCount, 0);
+        unsigned int time = cacheSize + 1;
+        // Recently used vertices - the candidates for the next fanning vertex when we get stuck
+        std::vector<unsigned int> deadEnd;
+        std::vector<unsigned int> candidates;
+        unsigned int cursor = 0;
+
+        int fanning = 0;
+        while(fanning >= 0) {
+            // Emit all the not yet emitted triangles around the fanning vertex
+            candidates.clear();
+            for(unsigned int a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; ++a) {
+                unsigned int t = adjacency[a];
+                if(emitted[t]) {
+                    continue;
+                }
+                for(int k = 0; k < 3; ++k) {
+                    OM_INDEX_TYPE index = indices[t * 3 + k];
+                    unsigned int v = localVertex(index, firstIndex);
+                    output.push_back(index);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    --liveCount[v];
+                    if(time - cacheTime[v] > (unsigned int)cacheSize) {
+                        cacheTime[v] = time;
+                        ++time;
+                    }
+                }
+                emitted[t] = true;
+            }
+
+            // Choose the next fanning vertex: the candidate that is still in the cache after its
+            // remaining triangles are emitted and was loaded the earliest - otherwise any live one
+            int next = -1;
+            int bestPriority = -1;
+            for(unsigned int v : candidates) {
+                if(liveCount[v] > 0) {
+                    int priority = 0;
+                    if(time - cacheTime[v] + 2 * liveCount[v] <= (unsigned int)cacheSize) {
+                        priority = (int)(time - cacheTime[v]);
+                    }
+                    if(priority > bestPriority) {
+                        bestPriority = priority;
+                        next = (int)v;
+                    }
+                }
+            }
+            if(next < 0) {
+                // Dead end: try the recently used vertices first, then just go on in the input order
+                while(!deadEnd.empty() && (next < 0)) {
+                    unsigned int d = deadEnd.back();
+                    deadEnd.pop_back();
+                    if(liveCount[d] > 0) {
+                        next = (int)d;
+                    }
+                }
+                while((next < 0) && (cursor < vertexCount)) {
+                    if(liveCount[cursor] > 0) {
+                        next = (int)cursor;
+                    }
+                    ++cursor;
+                }
+            }
+            fanning = next;
+        }
+
+        std::copy(output.begin(), output.end(), indices);
+        return true;
+    }
+
+    bool MeshOptimizer::optimizeVertexCache(ObjMeshObject &mesh, int cacheSize) {
+        if(!mesh.inited || (mesh.indexCount < 3)) {
+            return true;
+        }
+        OM_INDEX_TYPE *indices = &(*mesh.indices)[mesh.startIndexLocation];
+        OM_INDEX_TYPE firstIndex = (OM_INDEX_TYPE)(mesh.lastIndex - mesh.vertexCount);
+        float before = computeACMR(indices, mesh.indexCount, firstIndex, mesh.vertexCount, cacheSize);
+        bool success = optimizeVertexCache(indices, mesh.indexCount, firstIndex, mesh.vertexCount, cacheSize);
+        float after = computeACMR(indices, mesh.indexCount, firstIndex, mesh.vertexCount, cacheSize);
+        OMLOGI(" - Vertex cache optimization (cache size: %d) ACMR: %f -> %f", cacheSize, before, after);
+        return success;
+    }
+
+    /** The x, y, z floats of the vertex in a vertex array with the given stride (in bytes) */
+    static inline const float* positionOf(const float *positions, size_t positionStride, unsigned int vertex) {
+        return (const float *)((const char *)positions + vertex * positionStride);
+    }
+
+    /**
+     * Simulates the FIFO cache for one triangle and returns its number of misses (see computeACMR).
+     * Increasing time by more than cacheSize empties the cache.
+     */
+    static inline unsigned int triangleMisses(const OM_INDEX_TYPE *triangle, OM_INDEX_TYPE firstIndex,
+            std::vector<unsigned int> &cacheTime, unsigned int &time, int cacheSize) {
+        unsigned int misses = 0;
+        for(int k = 0; k < 3; ++k) {
+            unsigned int v = localVertex(triangle[k], firstIndex);
+            if(time - cacheTime[v] > (unsigned int)cacheSize) {
+                cacheTime[v] = time;
+                ++time;
+                ++misses;
+            }
+        }
+        return misses;
+    }
+
+    bool MeshOptimizer::optimizeOverdraw(OM_INDEX_TYPE *indices, unsigned int indexCount, const float *positions,
+            size_t positionStride, OM_INDEX_TYPE firstIndex, unsigned int vertexCount, float threshold, int cacheSize) {
+        unsigned int triangleCount = indexCount / 3;
+        if(triangleCount == 0) {
+            return true;
+        }
+        for(unsigned int i = 0; i < triangleCount * 3; ++i) {
+            if(localVertex(indices[i], firstIndex) >= vertexCount) {
+                OMLOGE("Index %u (%u) is out of the mesh vertex range - not optimizing overdraw!", i, (unsigned int)indices[i]);
+                return false;
+            }
+        }
+
+        // Hard cluster boundaries: triangles where all three vertices are misses start a new
+        // patch of the mesh anyways, so cutting there costs nothing in cache efficiency
+        std::vector<unsigned int> cacheTime(vertexCount, 0);
+        unsigned int time = cacheSize + 1;
+        std::vector<unsigned int> hardBoundaries;
+        for(unsigned int t = 0; t < triangleCount; ++t) {
+            if((triangleMisses(&indices[t * 3], firstIndex, cacheTime, time, cacheSize) == 3) || (t == 0)) {
+                hardBoundaries.push_back(t);
+            }
+        }
+        hardBoundaries.push_back(triangleCount);
+
+        // Soft boundaries: cut a hard cluster where the ACMR of the part (measured from an empty
+        // cache) is already within threshold times the ACMR of the whole cluster
+        std::vector<unsigned int> boundaries;
+        for(size_t c = 0; c + 1 < hardBoundaries.size(); ++c) {
+            unsigned int start = hardBoundaries[c];
+            unsigned int end = hardBoundaries[c + 1];
+            time += cacheSize + 1;
+            unsigned int clusterMisses = 0;
+            for(unsigned int t = start; t < end; ++t) {
+                clusterMisses += triangleMisses(&indices[t * 3], firstIndex, cacheTime, time, cacheSize);
+            }
+            float clusterThreshold = threshold * (float)clusterMisses / (float)(end - start);
+
+            size_t firstOfCluster = boundaries.size();
+            boundaries.push_back(start);
+            time += cacheSize + 1;
+            unsigned int runningMisses = 0;
+            unsigned int runningTriangles = 0;
+            for(unsigned int t = start; t < end; ++t) {
+                runningMisses += triangleMisses(&indices[t * 3], firstIndex, cacheTime, time, cacheSize);
+                ++runningTriangles;
+                if((float)runningMisses <= clusterThreshold * (float)runningTriangles) {
+                    boundaries.push_back(t + 1);
+                    time += cacheSize + 1;
+                    runningMisses = 0;
+                    runningTriangles = 0;
+                }
+            }
+            if(boundaries.back() == end) {
+                // The last cut was at the very end - no empty cluster please
+                boundaries.pop_back();
+            } else if((runningTriangles > 0) && (boundaries.size() - firstOfCluster > 1) &&
+                      ((float)runningMisses > clusterThreshold * (float)runningTriangles)) {
+                // The remaining tail is too expensive on its own - better merge it to the previous part
+                boundaries.pop_back();
+            }
+        }
+        boundaries.push_back(triangleCount);
+        unsigned int clusterCount = (unsigned int)boundaries.size() - 1;
+
+        // Sort key of a cluster: how much it faces away from the center of the mesh. Clusters on
+        // the outside of the mesh (facing outwards) are likely to occlude the others.
+        std::vector<float> clusterData(clusterCount * 7, 0.0f);
+        float meshCentroid[3] = { 0, 0, 0 };
+        float meshArea = 0;
+        for(unsigned int c = 0; c < clusterCount; ++c) {
+            float *data = &clusterData[c * 7]; // centroid (3), normal (3), area
+            for(unsigned int t = boundaries[c]; t < boundaries[c + 1]; ++t) {
+                const float *a = positionOf(positions, positionStride, localVertex(indices[t * 3 + 0], firstIndex));
+                const float *b = positionOf(positions, positionStride, localVertex(indices[t * 3 + 1], firstIndex));
+                const float *d = positionOf(positions, positionStride, localVertex(indices[t * 3 + 2], firstIndex));
+                float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                float e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+                // Rem.: the length of the cross product is twice the area - both are area-weighted
+                float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+                float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                float center[3] = { (a[0] + b[0] + d[0]) / 3, (a[1] + b[1] + d[1]) / 3, (a[2] + b[2] + d[2]) / 3 };
+                for(int k = 0; k < 3; ++k) {
+                    data[k] += center[k] * area;
+                    data[3 + k] += n[k];
+                    meshCentroid[k] += center[k] * area;
+                }
+                data[6] += area;
+                meshArea += area;
+            }
+        }
+        if(meshArea > 0) {
+            for(int k = 0; k < 3; ++k) {
+                meshCentroid[k] /= meshArea;
+            }
+        }
+        std::vector<float> sortKey(clusterCount, 0.0f);
+        for(unsigned int c = 0; c < clusterCount; ++c) {
+            const float *data = &clusterData[c * 7];
+            float length = std::sqrt(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+            if((data[6] > 0) && (length > 0)) {
+                for(int k = 0; k < 3; ++k) {
+                    sortKey[c] += (data[k] / data[6] - meshCentroid[k]) * (data[3 + k] / length);
+                }
+            }
+        }
+        std::vector<unsigned int> order(clusterCount);
+        for(unsigned int c = 0; c < clusterCount; ++c) {
+            order[c] = c;
+        }
+        std::stable_sort(order.begin(), order.end(), [&sortKey](unsigned int a, unsigned int b) {
+            return sortKey[a] > sortKey[b];
+        });
+
+        std::vector<OM_INDEX_TYPE> output;
+        output.reserve(triangleCount * 3);
+        for(unsigned int c : order) {
+            output.insert(output.end(), &indices[boundaries[c] * 3], &indices[boundaries[c + 1] * 3]);
+        }
+        std::copy(output.begin(), output.end(), indices);
+        return true;
+    }
+
+    bool MeshOptimizer::optimizeOverdraw(ObjMeshObject &mesh, float threshold, int cacheSize) {
+        if(!mesh.inited || (mesh.indexCount < 3)) {
+            return true;
+        }
+        OM_INDEX_TYPE *indices = &(*mesh.indices)[mesh.startIndexLocation];
+        const VertexStructure *vertices = &(*mesh.vertexData)[mesh.baseVertexLocation];
+        OM_INDEX_TYPE firstIndex = (OM_INDEX_TYPE)(mesh.lastIndex - mesh.vertexCount);
+        float before = computeACMR(indices, mesh.indexCount, firstIndex, mesh.vertexCount, cacheSize);
+        bool success = optimizeOverdraw(indices, mesh.indexCount, vertices, firstIndex, mesh.vertexCount, threshold, cacheSize);
+        float after = computeACMR(indices, mesh.indexCount, firstIndex, mesh.vertexCount, cacheSize);
+        OMLOGI(" - Overdraw optimization (threshold: %f) ACMR: %f -> %f", threshold, before, after);
+        return success;
+    }
+
+    bool MeshOptimizer::optimizeVertexFetch(void *vertices, size_t vertexSize, OM_INDEX_TYPE *indices, unsigned int indexCount,
+            OM_INDEX_TYPE firstIndex, unsigned int vertexCount) {
+        // Old local vertex number -> new local vertex number (NOT_YET for not yet used ones)
+        const unsigned int NOT_YET = ~0u;
+        std::vector<unsigned int> remap(vertexCount, NOT_YET);
+        unsigned int nextVertex = 0;
+        for(unsigned int i = 0; i < indexCount; ++i) {
+            unsigned int v = localVertex(indices[i], firstIndex);
+            if(v >= vertexCount) {
+                OMLOGE("Index %u (%u) is out of the mesh vertex range - not optimizing vertex fetch!", i, (unsigned int)indices[i]);
+                return false;
+            }
+            if(remap[v] == NOT_YET) {
+                remap[v] = nextVertex++;
+            }
+        }
+        for(unsigned int v = 0; v < vertexCount; ++v) {
+            if(remap[v] == NOT_YET) {
+                remap[v] = nextVertex++;
+            }
+        }
+
+        std::vector<char> reordered(vertexCount * vertexSize);
+        for(unsigned int v = 0; v < vertexCount; ++v) {
+            memcpy(&reordered[remap[v] * vertexSize], (const char *)vertices + v * vertexSize, vertexSize);
+        }
+        if(vertexCount > 0) {
+            memcpy(vertices, &reordered[0], reordered.size());
+        }
+        for(unsigned int i = 0; i < indexCount; ++i) {
+            indices[i] = (OM_INDEX_TYPE)(firstIndex + remap[localVertex(indices[i], firstIndex)]);
+        }
+        return true;
+    }
+
+    bool MeshOptimizer::optimizeVertexFetch(ObjMeshObject &mesh) {
+        if(!mesh.inited || (mesh.vertexCount == 0)) {
+            return true;
+        }
+        OM_INDEX_TYPE *indices = (mesh.indexCount > 0) ? &(*mesh.indices)[mesh.startIndexLocation] : nullptr;
+        VertexStructure *vertices = &(*mesh.vertexData)[mesh.baseVertexLocation];
+        OM_INDEX_TYPE firstIndex = (OM_INDEX_TYPE)(mesh.lastIndex - mesh.vertexCount);
+        return optimizeVertexFetch(vertices, indices, mesh.indexCount, firstIndex, mesh.vertexCount);
+    }
+}
@@ -0,0 +1,200 @@
+//
+// Post-processing of the index (and vertex) buffers of meshes for faster rendering.
+//
+
+#ifndef OBJMASTER_MESHOPTIMIZER_H
+#define OBJMASTER_MESHOPTIMIZER_H
+
+#include "ObjMeshObject.h"
+#include "VertexStructure.h"
+#include "objmasterlog.h"
+#include <vector>
+#include <algorithm>
+
+namespace ObjMaster {
+
+    /**
+     * Reorders the triangles (and vertices) of index buffers to make better use of the vertex
+     * caches of the GPU and to reduce overdraw. All methods work on one mesh-range of a (possibly shared) index buffer:
+     * the indices of the range should refer to [firstIndex, firstIndex + vertexCount) - just like
+     * the indices of an ObjMeshObject refer to [lastIndex - vertexCount, lastIndex).
+     */
+    class MeshOptimizer final {
+    public:
+        /** The usual number of entries in the post-transform cache - a bit smaller than most GPUs have */
+        static const int DEFAULT_CACHE_SIZE = 16;
+
+        /**
+         * Average cache miss ratio: the number of transformed vertices per triangle when a FIFO
+         * cache of the given size is used. It is 3 at worst, 0.5 is the theoretical optimum for
+         * big regular grids and ~0.6-0.7 is considered good.
+         */
+        static float computeACMR(const OM_INDEX_TYPE *indices, unsigned int indexCount,
+                OM_INDEX_TYPE firstIndex, unsigned int vertexCount, int cacheSize = DEFAULT_CACHE_SIZE);
+
+        /**
+         * Reorders the triangles in place using the linear-time Tipsify algorithm of Sander, Nehab
+         * and Barczak (Fast Triangle Reordering for Vertex Locality and Reduced Overdraw, 2007).
+         * The triangles themselves (and their winding) stay the same - only their order changes.
+         * Returns false (leaving the indices untouched) if an index is outside of the range.
+         */
+        static bool optimizeVertexCache(OM_INDEX_TYPE *indices, unsigned int indexCount,
+                OM_INDEX_TYPE firstIndex, unsigned int vertexCount, int cacheSize = DEFAULT_CACHE_SIZE);
+
+        /** The same as above, but for the mesh-range of the mesh. Logs the ACMR before and after. */
+        static bool optimizeVertexCache(ObjMeshObject &mesh, int cacheSize = DEFAULT_CACHE_SIZE);
+
+        /** By default the overdraw optimization can make the ACMR this many times worse */
+        static constexpr float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+
+        /**
+         * Reorders the triangles to reduce overdraw - best used right after optimizeVertexCache.
+         * The triangles are cut to clusters where the cache gets flushed anyways (all three
+         * vertices of a triangle are misses) and these are cut further where the ACMR of the
+         * cluster-part is not worse than threshold times the ACMR of the whole cluster. Then the
+         * clusters are sorted so that the ones facing outwards from the center of the mesh come
+         * first - these tend to occlude the others (Sander, Nehab and Barczak, 2007). Bigger
+         * threshold means smaller clusters: better overdraw, but worse vertex cache usage.
+         * Returns false (leaving the indices untouched) if an index is outside of the range.
+         */
+        static inline bool optimizeOverdraw(OM_INDEX_TYPE *indices, unsigned int indexCount, const VertexStructure *vertices,
+                OM_INDEX_TYPE firstIndex, unsigned int vertexCount, float threshold = DEFAULT_OVERDRAW_THRESHOLD,
+                int cacheSize = DEFAULT_CACHE_SIZE) {
+            return optimizeOverdraw(indices, indexCount, (const float *)vertices, sizeof(VertexStructure),
+                    firstIndex, vertexCount, threshold, cacheSize);
+        }
+
+        /**
+         * The same as above for any vertex layout: the x, y, z floats of vertex n (of the range)
+         * are at positions + n * positionStride bytes.
+         */
+        static bool optimizeOverdraw(OM_INDEX_TYPE *indices, unsigned int indexCount, const float *positions,
+                size_t positionStride, OM_INDEX_TYPE firstIndex, unsigned int vertexCount,
+                float threshold = DEFAULT_OVERDRAW_THRESHOLD, int cacheSize = DEFAULT_CACHE_SIZE);
+
+        /** The same as above, but for the mesh-range of the mesh. Logs the ACMR before and after. */
+        static bool optimizeOverdraw(ObjMeshObject &mesh, float threshold = DEFAULT_OVERDRAW_THRESHOLD,
+                int cacheSize = DEFAULT_CACHE_SIZE);
+
+        /**
+         * Renumbers the vertices in the order of their first use in the index buffer and moves the
+         * vertex data accordingly, so the GPU reads the vertex data (almost) linearly. Should be the
+         * last pass as it does not change the triangle order. Vertices that are not used by any
+         * triangle are moved to the end of the range (keeping their order).
+         * Returns false (leaving the data untouched) if an index is outside of the range.
+         */
+        static inline bool optimizeVertexFetch(VertexStructure *vertices, OM_INDEX_TYPE *indices, unsigned int indexCount,
+                OM_INDEX_TYPE firstIndex, unsigned int vertexCount) {
+            return optimizeVertexFetch((void *)vertices, sizeof(VertexStructure), indices, indexCount, firstIndex, vertexCount);
+        }
+
+        /** The same as above for any vertex layout: the vertices are vertexSize bytes each */
+        static bool optimizeVertexFetch(void *vertices, size_t vertexSize, OM_INDEX_TYPE *indices, unsigned int indexCount,
+                OM_INDEX_TYPE firstIndex, unsigned int vertexCount);
+
+        /** The same as above, but for the mesh-range of the mesh */
+        static bool optimizeVertexFetch(ObjMeshObject &mesh);
+    };
+
+// Very simple unit-testing approach
+// it is better to have these run on the device itself and callable as normal functions than to
+// test it compile-time with some unit testing framework as this way we rule out architectural
+// differences better. Tests will start by logging test starts to error (when #DEBUG is set!)
+// and info logs and the method returns false when anything has failed...
+    static bool TEST_MeshOptimizer() {
+#ifdef DEBUG
+        OMLOGI("TEST_MeshOptimizer...");
+#endif
+        // A grid with its triangles in a pathological (column major, alternating) order
+        const int SIZE = 24;
+        const OM_INDEX_TYPE FIRST = 7;
+        std::vector<OM_INDEX_TYPE> indices;
+        for(int x = 0; x + 1 < SIZE; ++x) {
+            for(int y = 0; y + 1 < SIZE; y += 2) {
+                for(int row : { y, y + 1 }) {
+                    if(row + 1 >= SIZE) continue;
+                    OM_INDEX_TYPE a = (OM_INDEX_TYPE)(FIRST + row * SIZE + x), b = a + 1, c = a + SIZE, d = c + 1;
+                    indices.insert(indices.end(), { a, b, d, a, d, c });
+                }
+            }
+        }
+        std::vector<OM_INDEX_TYPE> original = indices;
+        unsigned int count = (unsigned int)indices.size();
+        float before = MeshOptimizer::computeACMR(&indices[0], count, FIRST, SIZE * SIZE);
+        if(!MeshOptimizer::optimizeVertexCache(&indices[0], count, FIRST, SIZE * SIZE)) {
+            OMLOGE("Vertex cache optimization failed on a valid grid!");
+            return false;
+        }
+        float after = MeshOptimizer::computeACMR(&indices[0], count, FIRST, SIZE * SIZE);
+        if(!(after < before) || (after > 1.0f)) {
+            OMLOGE("Vertex cache optimization did not help enough: ACMR %f -> %f", before, after);
+            return false;
+        }
+
+        // The very same triangles should be there with their winding - so compare them rotated to
+        // start with their smallest index
+        auto normalized = [](const std::vector<OM_INDEX_TYPE> &in) {
+            std::vector<std::vector<OM_INDEX_TYPE>> tris;
+            for(size_t i = 0; i < in.size(); i += 3) {
+                std::vector<OM_INDEX_TYPE> t = { in[i], in[i + 1], in[i + 2] };
+                std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+                tris.push_back(t);
+            }
+            std::sort(tris.begin(), tris.end());
+            return tris;
+        };
+        if(normalized(original) != normalized(indices)) {
+            OMLOGE("Vertex cache optimization has changed the triangles!");
+            return false;
+        }
+
+        // Overdraw optimization should keep the triangles and the ACMR within the threshold
+        std::vector<VertexStructure> vertices(SIZE * SIZE);
+        for(int i = 0; i < SIZE * SIZE; ++i) {
+            vertices[i] = VertexStructure { (float)(i % SIZE), (float)(i / SIZE), 0, 0, 0, 1, 0, 0 };
+        }
+        if(!MeshOptimizer::optimizeOverdraw(&indices[0], count, &vertices[0], FIRST, SIZE * SIZE, 1.05f) ||
+           (normalized(original) != normalized(indices))) {
+            OMLOGE("Overdraw optimization has failed or changed the triangles!");
+            return false;
+        }
+        float overdrawAfter = MeshOptimizer::computeACMR(&indices[0], count, FIRST, SIZE * SIZE);
+        if(overdrawAfter > after * 1.05f + 0.01f) {
+            OMLOGE("Overdraw optimization has made the ACMR worse than allowed: %f -> %f", after, overdrawAfter);
+            return false;
+        }
+
+        // Vertex fetch optimization should number the vertices in their order of first use
+        for(int i = 0; i < SIZE * SIZE; ++i) {
+            vertices[i].u = (float)i; // remember the original number
+        }
+        std::vector<OM_INDEX_TYPE> beforeFetch = indices;
+        if(!MeshOptimizer::optimizeVertexFetch(&vertices[0], &indices[0], count, FIRST, SIZE * SIZE)) {
+            OMLOGE("Vertex fetch optimization failed on a valid grid!");
+            return false;
+        }
+        unsigned int nextNew = 0;
+        for(unsigned int i = 0; i < count; ++i) {
+            unsigned int v = (OM_INDEX_TYPE)(indices[i] - FIRST);
+            if((v > nextNew) || ((int)vertices[v].u != (int)(OM_INDEX_TYPE)(beforeFetch[i] - FIRST))) {
+                OMLOGE("Bad vertex fetch order at index %u!", i);
+                return false;
+            }
+            if(v == nextNew) ++nextNew;
+        }
+
+        // Out of range indices should be refused
+        std::vector<OM_INDEX_TYPE> bad = { 0, 1, 2 };
+        if(MeshOptimizer::optimizeVertexCache(&bad[0], 3, 1, 2)) {
+            OMLOGE("Vertex cache optimization accepted out of range indices!");
+            return false;
+        }
+
+#ifdef DEBUG
+        OMLOGI("...TEST_MeshOptimizer completed (OK)");
+#endif
+        return true;
+    }
+}
+
+#endif //OBJMASTER_MESHOPTIMIZER_H
@@ -0,0 +1,635 @@
+//
+// Quadric error metric based simplification of meshes - for building LOD chains.
+//
+
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <numeric>
+
+namespace ObjMaster {
+
+    /** Returns the mesh-local vertex number of the index (wraps around just like the index building does) */
+    static inline unsigned int localVertex(OM_INDEX_TYPE index, OM_INDEX_TYPE firstIndex) {
+        return (OM_INDEX_TYPE)(index - firstIndex);
+    }
+
+    /** Border and seam edges are kept in place by planes perpendicular to their triangles - with this much weight */
+    static const float BOUNDARY_WEIGHT = 10.0f;
+
+    /** The number of attributes in the attribute quadrics: normal (3) and texture coordinates (2) */
+    static const int ATTRIBUTE_COUNT = 5;
+
+    /** Symmetric quadric of the sum of the weighted squared plane distances: p'Ap + 2b'p + c */
+    struct Quadric {
+        float a00, a11, a22, a10, a20, a21;
+        float b0, b1, b2;
+        float c;
+        float w;
+    };
+
+    /**
+     * Quadric of the attribute errors: the sum over the triangles and attributes of the weighted
+     * squared differences from the linear attribute fields of the triangles, (g'p + d - a)^2. The
+     * parts that do not depend on the attribute values a are summed into q.
+     */
+    struct AttributeQuadric {
+        Quadric q;
+        float g[ATTRIBUTE_COUNT][3];
+        float d[ATTRIBUTE_COUNT];
+    };
+
+    static inline void addTo(Quadric &q, const Quadric &other) {
+        q.a00 += other.a00; q.a11 += other.a11; q.a22 += other.a22;
+        q.a10 += other.a10; q.a20 += other.a20; q.a21 += other.a21;
+        q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+        q.c += other.c;
+        q.w += other.w;
+    }
+
+    static inline void addTo(AttributeQuadric &q, const AttributeQuadric &other) {
+        addTo(q.q, other.q);
+        for(int k = 0; k < ATTRIBUTE_COUNT; ++k) {
+            q.g[k][0] += other.g[k][0];
+            q.g[k][1] += other.g[k][1];
+            q.g[k][2] += other.g[k][2];
+            q.d[k] += other.d[k];
+        }
+    }
+
+    /** Adds the weighted outer product of the (n, d) plane or gradient - without the weight sum */
+    static inline void addPlane(Quadric &q, const float n[3], float d, float weight) {
+        q.a00 += weight * n[0] * n[0]; q.a11 += weight * n[1] * n[1]; q.a22 += weight * n[2] * n[2];
+        q.a10 += weight * n[1] * n[0]; q.a20 += weight * n[2] * n[0]; q.a21 += weight * n[2] * n[1];
+        q.b0 += weight * n[0] * d; q.b1 += weight * n[1] * d; q.b2 += weight * n[2] * d;
+        q.c += weight * d * d;
+    }
+
+    /** The raw (not normalized) value of the quadric at p */
+    static inline float evaluate(const Quadric &q, const float p[3]) {
+        return q.a00 * p[0] * p[0] + q.a11 * p[1] * p[1] + q.a22 * p[2] * p[2] +
+               2 * (q.a10 * p[0] * p[1] + q.a20 * p[0] * p[2] + q.a21 * p[1] * p[2]) +
+               2 * (q.b0 * p[0] + q.b1 * p[1] + q.b2 * p[2]) + q.c;
+    }
+
+    /** The weighted mean squared distance of p from the planes of the quadric */
+    static inline float quadricError(const Quadric &q, const float p[3]) {
+        return (q.w > 0) ? std::fabs(evaluate(q, p)) / q.w : 0;
+    }
+
+    /** The weighted mean squared attribute error at p when the attributes are the given ones */
+    static inline float quadricError(const AttributeQuadric &q, const float p[3], const float attributes[ATTRIBUTE_COUNT]) {
+        if(q.q.w <= 0) {
+            return 0;
+        }
+        float r = evaluate(q.q, p);
+        for(int k = 0; k < ATTRIBUTE_COUNT; ++k) {
+            float a = attributes[k];
+            r += -2 * a * (q.g[k][0] * p[0] + q.g[k][1] * p[1] + q.g[k][2] * p[2] + q.d[k]) + a * a * q.q.w;
+        }
+        return std::fabs(r) / q.q.w;
+    }
+
+    static inline void cross(const float a[3], const float b[3], float out[3]) {
+        out[0] = a[1] * b[2] - a[2] * b[1];
+        out[1] = a[2] * b[0] - a[0] * b[2];
+        out[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    static inline float dot(const float a[3], const float b[3]) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    /** How a position can move - see the class comment */
+    enum PositionKind {
+        MANIFOLD_POSITION,
+        BORDER_POSITION,
+        SEAM_POSITION,
+        LOCKED_POSITION,
+    };
+
+    /**
+     * The state of one simplification. Vertices are mesh-local numbers and every vertex belongs to
+     * one position: the vertices with the same position (wedges) form a circular list by nextWedge.
+     */
+    class Simplification {
+    public:
+        Simplification(const VertexStructure *vertices, unsigned int vertexCount, std::vector<unsigned int> &&initialTriangles,
+                int flags, float normalWeight, float texCoordWeight)
+                : triangles(std::move(initialTriangles)), vertexCount(vertexCount), flags(flags) {
+            collectPositions(vertices);
+            collectAttributes(vertices, normalWeight, texCoordWeight);
+            buildAdjacency();
+            buildQuadrics();
+        }
+
+        /** Collapses edges until the target is reached - the result is in triangles */
+        void run(unsigned int targetIndexCount, float targetError) {
+            float maxCost = targetError * targetError;
+            while(triangles.size() > targetIndexCount) {
+                classifyPositions();
+                std::vector<Collapse> collapses = collectCollapses(maxCost);
+                if(!applyCollapses(collapses, (unsigned int)(triangles.size() - targetIndexCount) / 3)) {
+                    break;
+                }
+                buildAdjacency();
+            }
+        }
+
+        /** The biggest error of the done collapses (relative to the extent of the mesh) */
+        float resultError() const { return std::sqrt(worstCost); }
+
+        std::vector<unsigned int> triangles;
+
+    private:
+        struct Collapse {
+            unsigned int from;
+            unsigned int to;
+            float cost;
+        };
+
+        static const unsigned int NONE = (unsigned int)-1;
+        static const unsigned int AMBIGUOUS = (unsigned int)-2;
+
+        unsigned int vertexCount;
+        int flags;
+        float worstCost = 0;
+        /** Positions normalized to the unit cube - errors are relative to the extent of the mesh this way */
+        std::vector<float> positions;
+        std::vector<float> attributes;
+        /** The position (the number of its first vertex) of each vertex */
+        std::vector<unsigned int> positionOf;
+        std::vector<unsigned int> nextWedge;
+        /** The vertex each vertex is replaced with (itself until it is collapsed) */
+        std::vector<unsigned int> remap;
+        std::vector<Quadric> quadrics;
+        std::vector<AttributeQuadric> attributeQuadrics;
+        std::vector<PositionKind> kinds;
+        /** Triangles of each position: adjacency[adjacencyOffset[p]] .. adjacency[adjacencyOffset[p + 1]] */
+        std::vector<unsigned int> adjacencyOffset;
+        std::vector<unsigned int> adjacency;
+
+        inline const float* positionAt(unsigned int position) const { return &positions[position * 3]; }
+
+        inline unsigned int cornerPosition(unsigned int triangle, unsigned int corner) const {
+            return positionOf[triangles[triangle * 3 + corner]];
+        }
+
+        void collectPositions(const VertexStructure *vertices) {
+            float minPos[3] = { 0, 0, 0 }, maxPos[3] = { 0, 0, 0 };
+            for(unsigned int v = 0; v < vertexCount; ++v) {
+                const float p[3] = { vertices[v].x, vertices[v].y, vertices[v].z };
+                for(int k = 0; k < 3; ++k) {
+                    minPos[k] = (v == 0) ? p[k] : std::min(minPos[k], p[k]);
+                    maxPos[k] = (v == 0) ? p[k] : std::max(maxPos[k], p[k]);
+                }
+            }
+            float extent = std::max(maxPos[0] - minPos[0], std::max(maxPos[1] - minPos[1], maxPos[2] - minPos[2]));
+            float scale = (extent > 0) ? 1 / extent : 1;
+            positions.resize(vertexCount * 3);
+            for(unsigned int v = 0; v < vertexCount; ++v) {
+                positions[v * 3 + 0] = (vertices[v].x - minPos[0]) * scale;
+                positions[v * 3 + 1] = (vertices[v].y - minPos[1]) * scale;
+                positions[v * 3 + 2] = (vertices[v].z - minPos[2]) * scale;
+            }
+
+            // Vertices with the same position are found by sorting
+            std::vector<unsigned int> order(vertexCount);
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&vertices](unsigned int a, unsigned int b) {
+                const VertexStructure &va = vertices[a], &vb = vertices[b];
+                return (va.x < vb.x) || ((va.x == vb.x) && ((va.y < vb.y) || ((va.y == vb.y) && ((va.z < vb.z) ||
+                       ((va.z == vb.z) && (a < b))))));
+            });
+            positionOf.resize(vertexCount);
+            nextWedge.resize(vertexCount);
+            remap.resize(vertexCount);
+            for(unsigned int i = 0; i < vertexCount; ++i) {
+                unsigned int v = order[i];
+                const VertexStructure &previous = vertices[order[(i > 0) ? i - 1 : 0]];
+                bool same = (i > 0) && (previous.x == vertices[v].x) && (previous.y == vertices[v].y) && (previous.z == vertices[v].z);
+                positionOf[v] = same ? positionOf[order[i - 1]] : v;
+                nextWedge[v] = v;
+                remap[v] = v;
+                if(same) {
+                    unsigned int p = positionOf[v];
+                    nextWedge[v] = nextWedge[p];
+                    nextWedge[p] = v;
+                }
+            }
+        }
+
+        void collectAttributes(const VertexStructure *vertices, float normalWeight, float texCoordWeight) {
+            attributes.resize(vertexCount * ATTRIBUTE_COUNT);
+            for(unsigned int v = 0; v < vertexCount; ++v) {
+                float *a = &attributes[v * ATTRIBUTE_COUNT];
+                a[0] = vertices[v].i * normalWeight;
+                a[1] = vertices[v].j * normalWeight;
+                a[2] = vertices[v].k * normalWeight;
+                a[3] = vertices[v].u * texCoordWeight;
+                a[4] = vertices[v].v * texCoordWeight;
+            }
+        }
+
+        void buildAdjacency() {
+            adjacencyOffset.assign(vertexCount + 1, 0);
+            for(unsigned int index : triangles) {
+                ++adjacencyOffset[positionOf[index] + 1];
+            }
+            for(unsigned int p = 0; p < vertexCount; ++p) {
+                adjacencyOffset[p + 1] += adjacencyOffset[p];
+            }
+            adjacency.resize(triangles.size());
+            std::vector<unsigned int> filled(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for(unsigned int i = 0; i < triangles.size(); ++i) {
+                adjacency[filled[positionOf[triangles[i]]]++] = i / 3;
+            }
+        }
+
+        /** Says if there is a triangle with the from->to (position) edge in its winding order */
+        bool hasPositionEdge(unsigned int from, unsigned int to) const {
+            for(unsigned int a = adjacencyOffset[from]; a < adjacencyOffset[from + 1]; ++a) {
+                for(unsigned int k = 0; k < 3; ++k) {
+                    if((cornerPosition(adjacency[a], k) == from) && (cornerPosition(adjacency[a], (k + 1) % 3) == to)) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        /** Says if there is a triangle with the from->to (vertex) edge in its winding order */
+        bool hasVertexEdge(unsigned int from, unsigned int to) const {
+            unsigned int position = positionOf[from];
+            for(unsigned int a = adjacencyOffset[position]; a < adjacencyOffset[position + 1]; ++a) {
+                const unsigned int *triangle = &triangles[adjacency[a] * 3];
+                for(unsigned int k = 0; k < 3; ++k) {
+                    if((triangle[k] == from) && (triangle[(k + 1) % 3] == to)) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        /** Border edges have no opposite position edge, seam edges only have an opposite with other vertices */
+        inline bool isBorderEdge(unsigned int from, unsigned int to) const {
+            return !hasPositionEdge(positionOf[to], positionOf[from]);
+        }
+        inline bool isSeamEdge(unsigned int from, unsigned int to) const {
+            return !isBorderEdge(from, to) && !hasVertexEdge(to, from);
+        }
+
+        void buildQuadrics() {
+            quadrics.assign(vertexCount, Quadric());
+            attributeQuadrics.assign(vertexCount, AttributeQuadric());
+            for(unsigned int t = 0; t < triangles.size() / 3; ++t) {
+                const unsigned int *triangle = &triangles[t * 3];
+                const float *p0 = positionAt(triangle[0]), *p1 = positionAt(triangle[1]), *p2 = positionAt(triangle[2]);
+                float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+                float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+                float n[3];
+                cross(e1, e2, n);
+                float length = std::sqrt(dot(n, n));
+                if(length <= 0) {
+                    continue;
+                }
+                float area = length / 2;
+                float unit[3] = { n[0] / length, n[1] / length, n[2] / length };
+
+                // Plane of the triangle for all of its positions
+                Quadric plane = Quadric();
+                addPlane(plane, unit, -dot(unit, p0), area);
+                plane.w = area;
+                for(unsigned int k = 0; k < 3; ++k) {
+                    addTo(quadrics[positionOf[triangle[k]]], plane);
+                }
+
+                // Linear fields of the attributes over the triangle for all of its vertices
+                AttributeQuadric field = AttributeQuadric();
+                float e2n[3], ne1[3];
+                cross(e2, n, e2n);
+                cross(n, e1, ne1);
+                for(int k = 0; k < ATTRIBUTE_COUNT; ++k) {
+                    float a0 = attributes[triangle[0] * ATTRIBUTE_COUNT + k];
+                    float da1 = attributes[triangle[1] * ATTRIBUTE_COUNT + k] - a0;
+                    float da2 = attributes[triangle[2] * ATTRIBUTE_COUNT + k] - a0;
+                    float gradient[3];
+                    for(int c = 0; c < 3; ++c) {
+                        gradient[c] = (da1 * e2n[c] + da2 * ne1[c]) / (length * length);
+                    }
+                    float d = a0 - dot(gradient, p0);
+                    addPlane(field.q, gradient, d, area);
+                    for(int c = 0; c < 3; ++c) {
+                        field.g[k][c] = gradient[c] * area;
+                    }
+                    field.d[k] = d * area;
+                }
+                field.q.w = area;
+                for(unsigned int k = 0; k < 3; ++k) {
+                    addTo(attributeQuadrics[triangle[k]], field);
+                }
+
+                // Border and seam edges are kept in place by perpendicular planes
+                for(unsigned int k = 0; k < 3; ++k) {
+                    unsigned int from = triangle[k], to = triangle[(k + 1) % 3];
+                    if(!isBorderEdge(from, to) && !isSeamEdge(from, to)) {
+                        continue;
+                    }
+                    const float *a = positionAt(from), *b = positionAt(to);
+                    float edge[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                    float normal[3];
+                    cross(edge, unit, normal);
+                    float normalLength = std::sqrt(dot(normal, normal));
+                    if(normalLength <= 0) {
+                        continue;
+                    }
+                    for(int c = 0; c < 3; ++c) {
+                        normal[c] /= normalLength;
+                    }
+                    Quadric edgePlane = Quadric();
+                    float weight = dot(edge, edge) * BOUNDARY_WEIGHT;
+                    addPlane(edgePlane, normal, -dot(normal, a), weight);
+                    edgePlane.w = weight;
+                    addTo(quadrics[positionOf[from]], edgePlane);
+                    addTo(quadrics[positionOf[to]], edgePlane);
+                }
+            }
+        }
+
+        void classifyPositions() {
+            std::vector<unsigned int> borderOut(vertexCount, 0), borderIn(vertexCount, 0);
+            std::vector<unsigned int> seamOut(vertexCount, 0), seamIn(vertexCount, 0);
+            for(unsigned int i = 0; i < triangles.size(); ++i) {
+                unsigned int from = triangles[i], to = triangles[(i % 3 == 2) ? i - 2 : i + 1];
+                if(isBorderEdge(from, to)) {
+                    ++borderOut[positionOf[from]];
+                    ++borderIn[positionOf[to]];
+                } else if(isSeamEdge(from, to)) {
+                    ++seamOut[from];
+                    ++seamIn[to];
+                }
+            }
+            kinds.assign(vertexCount, LOCKED_POSITION);
+            for(unsigned int p = 0; p < vertexCount; ++p) {
+                if(positionOf[p] != p) {
+                    continue;
+                }
+                unsigned int wedges = 0;
+                bool seamChain = true;
+                unsigned int w = p;
+                do {
+                    ++wedges;
+                    seamChain = seamChain && (seamOut[w] == 1) && (seamIn[w] == 1);
+                    w = nextWedge[w];
+                } while(w != p);
+                if((borderOut[p] > 0) || (borderIn[p] > 0)) {
+                    bool simpleBorder = (borderOut[p] == 1) && (borderIn[p] == 1) && (wedges == 1);
+                    kinds[p] = (simpleBorder && ((flags & SIMPLIFY_LOCK_BORDER) == 0)) ? BORDER_POSITION : LOCKED_POSITION;
+                } else if(wedges == 1) {
+                    kinds[p] = MANIFOLD_POSITION;
+                } else if((wedges == 2) && seamChain) {
+                    kinds[p] = SEAM_POSITION;
+                }
+            }
+        }
+
+        /** The vertex of the position that the wedge shares triangles with (NONE if unused, AMBIGUOUS if more) */
+        unsigned int wedgeTarget(unsigned int wedge, unsigned int position) const {
+            unsigned int target = NONE;
+            unsigned int from = positionOf[wedge];
+            for(unsigned int a = adjacencyOffset[from]; a < adjacencyOffset[from + 1]; ++a) {
+                const unsigned int *triangle = &triangles[adjacency[a] * 3];
+                if((triangle[0] != wedge) && (triangle[1] != wedge) && (triangle[2] != wedge)) {
+                    continue;
+                }
+                for(unsigned int k = 0; k < 3; ++k) {
+                    if(positionOf[triangle[k]] == position) {
+                        if((target != NONE) && (target != triangle[k])) {
+                            return AMBIGUOUS;
+                        }
+                        target = triangle[k];
+                    }
+                }
+            }
+            return target;
+        }
+
+        /** Says if the from position can move onto the to position and the cost of it */
+        bool canCollapse(unsigned int from, unsigned int to, float &cost) const {
+            switch(kinds[from]) {
+                case LOCKED_POSITION:
+                    return false;
+                case BORDER_POSITION:
+                    // Only along the border
+                    if(hasPositionEdge(from, to) == hasPositionEdge(to, from)) {
+                        return false;
+                    }
+                    break;
+                case SEAM_POSITION: {
+                    // Only along the seam
+                    bool alongSeam = false;
+                    for(unsigned int a = adjacencyOffset[from]; (a < adjacencyOffset[from + 1]) && !alongSeam; ++a) {
+                        const unsigned int *triangle = &triangles[adjacency[a] * 3];
+                        for(unsigned int k = 0; k < 3; ++k) {
+                            unsigned int u = triangle[k], v = triangle[(k + 1) % 3];
+                            if((positionOf[u] == from) && (positionOf[v] == to) && isSeamEdge(u, v)) {
+                                alongSeam = true;
+                            } else if((positionOf[u] == to) && (positionOf[v] == from) && isSeamEdge(u, v)) {
+                                alongSeam = true;
+                            }
+                        }
+                    }
+                    if(!alongSeam) {
+                        return false;
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+            const float *target = positionAt(to);
+            cost = quadricError(quadrics[from], target);
+            unsigned int wedge = from;
+            do {
+                unsigned int wedgeTo = wedgeTarget(wedge, to);
+                if(wedgeTo == AMBIGUOUS) {
+                    return false;
+                }
+                if(wedgeTo != NONE) {
+                    cost += quadricError(attributeQuadrics[wedge], target, &attributes[wedgeTo * ATTRIBUTE_COUNT]);
+                }
+                wedge = nextWedge[wedge];
+            } while(wedge != from);
+            return true;
+        }
+
+        std::vector<Collapse> collectCollapses(float maxCost) const {
+            std::vector<Collapse> collapses;
+            for(unsigned int i = 0; i < triangles.size(); ++i) {
+                unsigned int a = positionOf[triangles[i]], b = positionOf[triangles[(i % 3 == 2) ? i - 2 : i + 1]];
+                // Each edge once: from the triangle with a < b or from the only triangle of it
+                if((a == b) || ((a > b) && hasPositionEdge(b, a))) {
+                    continue;
+                }
+                float costAB = 0, costBA = 0;
+                bool ab = canCollapse(a, b, costAB);
+                bool ba = canCollapse(b, a, costBA);
+                if(ab && (!ba || (costAB <= costBA))) {
+                    if(costAB <= maxCost) {
+                        collapses.push_back(Collapse { a, b, costAB });
+                    }
+                } else if(ba && (costBA <= maxCost)) {
+                    collapses.push_back(Collapse { b, a, costBA });
+                }
+            }
+            std::stable_sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) {
+                return x.cost < y.cost;
+            });
+            return collapses;
+        }
+
+        /** Says if moving the from position onto the to position would flip a triangle that remains */
+        bool flipsTriangle(unsigned int from, unsigned int to) const {
+            for(unsigned int a = adjacencyOffset[from]; a < adjacencyOffset[from + 1]; ++a) {
+                unsigned int t = adjacency[a];
+                unsigned int p[3] = { cornerPosition(t, 0), cornerPosition(t, 1), cornerPosition(t, 2) };
+                if((p[0] == to) || (p[1] == to) || (p[2] == to)) {
+                    continue;
+                }
+                const float *before[3] = { positionAt(p[0]), positionAt(p[1]), positionAt(p[2]) };
+                const float *after[3] = { before[0], before[1], before[2] };
+                for(unsigned int k = 0; k < 3; ++k) {
+                    if(p[k] == from) {
+                        after[k] = positionAt(to);
+                    }
+                }
+                float e1[3] = { before[1][0] - before[0][0], before[1][1] - before[0][1], before[1][2] - before[0][2] };
+                float e2[3] = { before[2][0] - before[0][0], before[2][1] - before[0][1], before[2][2] - before[0][2] };
+                float f1[3] = { after[1][0] - after[0][0], after[1][1] - after[0][1], after[1][2] - after[0][2] };
+                float f2[3] = { after[2][0] - after[0][0], after[2][1] - after[0][1], after[2][2] - after[0][2] };
+                float n[3], m[3];
+                cross(e1, e2, n);
+                cross(f1, f2, m);
+                if(dot(n, m) <= 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * Does the cheapest collapses that do not touch each other (the neighbourhood of a moved
+         * position is locked for the rest of the pass) until enough triangles are removed. Then
+         * rewrites the triangles and drops the degenerate ones. Returns false if nothing collapsed.
+         */
+        bool applyCollapses(const std::vector<Collapse> &collapses, unsigned int trianglesToRemove) {
+            std::vector<bool> locked(vertexCount, false);
+            unsigned int removed = 0;
+            bool collapsed = false;
+            for(const Collapse &collapse : collapses) {
+                if(removed >= trianglesToRemove) {
+                    break;
+                }
+                if(locked[collapse.from] || locked[collapse.to] || flipsTriangle(collapse.from, collapse.to)) {
+                    continue;
+                }
+                unsigned int wedge = collapse.from;
+                do {
+                    unsigned int wedgeTo = wedgeTarget(wedge, collapse.to);
+                    if(wedgeTo != NONE) {
+                        remap[wedge] = wedgeTo;
+                        addTo(attributeQuadrics[wedgeTo], attributeQuadrics[wedge]);
+                    }
+                    wedge = nextWedge[wedge];
+                } while(wedge != collapse.from);
+                addTo(quadrics[collapse.to], quadrics[collapse.from]);
+                for(unsigned int a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1]; ++a) {
+                    bool degenerates = false;
+                    for(unsigned int k = 0; k < 3; ++k) {
+                        unsigned int p = cornerPosition(adjacency[a], k);
+                        locked[p] = true;
+                        degenerates = degenerates || (p == collapse.to);
+                    }
+                    removed += degenerates ? 1 : 0;
+                }
+                worstCost = std::max(worstCost, collapse.cost);
+                collapsed = true;
+            }
+            if(!collapsed) {
+                return false;
+            }
+
+            unsigned int kept = 0;
+            for(unsigned int i = 0; i < triangles.size(); i += 3) {
+                unsigned int a = remap[triangles[i]], b = remap[triangles[i + 1]], c = remap[triangles[i + 2]];
+                if((positionOf[a] != positionOf[b]) && (positionOf[b] != positionOf[c]) && (positionOf[c] != positionOf[a])) {
+                    triangles[kept++] = a;
+                    triangles[kept++] = b;
+                    triangles[kept++] = c;
+                }
+            }
+            triangles.resize(kept);
+            return true;
+        }
+    };
+
+    unsigned int MeshSimplifier::simplify(OM_INDEX_TYPE *destination, const OM_INDEX_TYPE *indices, unsigned int indexCount,
+            const VertexStructure *vertices, OM_INDEX_TYPE firstIndex, unsigned int vertexCount,
+            unsigned int targetIndexCount, float targetError, int flags, float normalWeight, float texCoordWeight,
+            float *resultError) {
+        if(resultError != nullptr) {
+            *resultError = 0;
+        }
+        unsigned int triangleIndexCount = indexCount / 3 * 3;
+        std::vector<unsigned int> triangles(triangleIndexCount);
+        for(unsigned int i = 0; i < triangleIndexCount; ++i) {
+            triangles[i] = localVertex(indices[i], firstIndex);
+            if(triangles[i] >= vertexCount) {
+                OMLOGE("Index %u (%u) is out of the mesh vertex range - not simplifying!", i, (unsigned int)indices[i]);
+                std::copy(indices, indices + indexCount, destination);
+                return indexCount;
+            }
+        }
+        Simplification simplification(vertices, vertexCount, std::move(triangles), flags, normalWeight, texCoordWeight);
+        simplification.run(targetIndexCount, targetError);
+        const std::vector<unsigned int> &result = simplification.triangles;
+        for(unsigned int i = 0; i < result.size(); ++i) {
+            destination[i] = (OM_INDEX_TYPE)(firstIndex + result[i]);
+        }
+        if(resultError != nullptr) {
+            *resultError = simplification.resultError();
+        }
+        return (unsigned int)result.size();
+    }
+
+    void MeshSimplifier::buildLodChain(ObjMeshObject &mesh, const std::vector<LodLevel> &levels, int flags) {
+        mesh.lods.clear();
+        mesh.lodIndices.clear();
+        if(!mesh.inited || (mesh.indexCount < 3)) {
+            return;
+        }
+        const OM_INDEX_TYPE *indices = &(*mesh.indices)[mesh.startIndexLocation];
+        const VertexStructure *vertices = &(*mesh.vertexData)[mesh.baseVertexLocation];
+        OM_INDEX_TYPE firstIndex = (OM_INDEX_TYPE)(mesh.lastIndex - mesh.vertexCount);
+        std::vector<OM_INDEX_TYPE> simplified(mesh.indexCount);
+        unsigned int previousCount = mesh.indexCount;
+        for(const LodLevel &level : levels) {
+            unsigned int target = (unsigned int)(mesh.indexCount / 3 * level.targetRatio) * 3;
+            float error = 0;
+            unsigned int count = simplify(&simplified[0], indices, mesh.indexCount, vertices, firstIndex, mesh.vertexCount,
+                    target, level.targetError, flags, DEFAULT_NORMAL_WEIGHT, DEFAULT_TEXCOORD_WEIGHT, &error);
+            if(count >= previousCount) {
+                continue;
+            }
+            if(count > 0) {
+                MeshOptimizer::optimizeVertexCache(&simplified[0], count, firstIndex, mesh.vertexCount);
+            }
+            mesh.lods.push_back(MeshLod { (unsigned int)mesh.lodIndices.size(), count, error });
+            mesh.lodIndices.insert(mesh.lodIndices.end(), simplified.begin(), simplified.begin() + count);
+            OMLOGI(" - LOD %d (ratio: %f, max error: %f): %u triangles with %f error", (int)mesh.lods.size(),
+                    level.targetRatio, level.targetError, count / 3, error);
+            previousCount = count;
+        }
+    }
+}
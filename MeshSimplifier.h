@@ -0,0 +1,177 @@
+//
+// Quadric error metric based simplification of meshes - for building LOD chains.
+//
+
+#ifndef OBJMASTER_MESHSIMPLIFIER_H
+#define OBJMASTER_MESHSIMPLIFIER_H
+
+#include "ObjMeshObject.h"
+#include "VertexStructure.h"
+#include "objmasterlog.h"
+#include <vector>
+#include <cmath>
+
+namespace ObjMaster {
+
+    // Rem.: bit trickery here
+    /** Options of the simplification */
+    enum SimplifyFlags {
+        SIMPLIFY_DEFAULT = 0,
+        /**
+         * Vertices on the open borders of the mesh are never moved. Use this when meshes of a model
+         * meet at their borders (like the material groups of MaterializedObjModel) to avoid cracks.
+         */
+        SIMPLIFY_LOCK_BORDER = 1,
+    };
+
+    /** One requested level of a LOD chain */
+    struct LodLevel {
+        /** The ratio of triangles to keep (of the full resolution mesh) */
+        float targetRatio;
+        /** The biggest error allowed - relative to the extent of the mesh (0.01 is 1% of the size) */
+        float targetError;
+    };
+
+    /**
+     * Simplifies meshes by collapsing edges in the order of their quadric error (Garland and
+     * Heckbert, Surface Simplification Using Quadric Error Metrics, 1997) extended with attribute
+     * quadrics (Hoppe, New Quadric Metric for Simplifying Meshes with Appearance Attributes, 1999)
+     * for the normals and texture coordinates. Vertices always collapse onto other existing vertices,
+     * so the simplified meshes are only new index data referring to the same vertex data.
+     *
+     * Vertices that share a position but not the other attributes (UV seams and hard edges) move
+     * together and only along the seam. Vertices of open borders only move along the border (or not
+     * at all with SIMPLIFY_LOCK_BORDER) and more complex (non-manifold) vertices never move.
+     *
+     * Just like with MeshOptimizer, the indices of the range should refer to [firstIndex, firstIndex + vertexCount).
+     */
+    class MeshSimplifier final {
+    public:
+        /** Default weight of the normal errors compared to the (relative) position errors */
+        static constexpr float DEFAULT_NORMAL_WEIGHT = 0.1f;
+        /** Default weight of the texture coordinate errors compared to the (relative) position errors */
+        static constexpr float DEFAULT_TEXCOORD_WEIGHT = 1.0f;
+
+        /**
+         * Writes the simplified triangles to destination (which should have room for indexCount
+         * indices and can be the same as indices) and returns the number of written indices. The
+         * simplification stops when the number of indices is at most targetIndexCount or when the
+         * next collapse would have a bigger error than targetError (relative to the extent of the
+         * mesh). The biggest error of the done collapses is written to resultError if it is not null.
+         * An index that is outside of the range results in an unchanged copy of the indices.
+         */
+        static unsigned int simplify(OM_INDEX_TYPE *destination, const OM_INDEX_TYPE *indices, unsigned int indexCount,
+                const VertexStructure *vertices, OM_INDEX_TYPE firstIndex, unsigned int vertexCount,
+                unsigned int targetIndexCount, float targetError, int flags = SIMPLIFY_DEFAULT,
+                float normalWeight = DEFAULT_NORMAL_WEIGHT, float texCoordWeight = DEFAULT_TEXCOORD_WEIGHT,
+                float *resultError = nullptr);
+
+        /**
+         * Builds the LOD chain of the mesh into its lods and lodIndices: each level is simplified
+         * from the full resolution mesh and gets its vertex cache optimized. Levels that would not
+         * be smaller than the level before them (because of their error bound) are left out.
+         */
+        static void buildLodChain(ObjMeshObject &mesh, const std::vector<LodLevel> &levels,
+                int flags = SIMPLIFY_LOCK_BORDER);
+
+        /** Builds the default LOD chain: 1/2, 1/4 and 1/8 of the triangles with at most 1%, 2% and 4% error */
+        static inline void buildLodChain(ObjMeshObject &mesh) {
+            buildLodChain(mesh, { { 0.5f, 0.01f }, { 0.25f, 0.02f }, { 0.125f, 0.04f } });
+        }
+    };
+
+// Very simple unit-testing approach
+// it is better to have these run on the device itself and callable as normal functions than to
+// test it compile-time with some unit testing framework as this way we rule out architectural
+// differences better. Tests will start by logging test starts to error (when #DEBUG is set!)
+// and info logs and the method returns false when anything has failed...
+    static bool TEST_MeshSimplifier() {
+#ifdef DEBUG
+        OMLOGI("TEST_MeshSimplifier...");
+#endif
+        // A flat grid with linear texture coordinates: the interior simplifies without any error
+        const int SIZE = 20;
+        const OM_INDEX_TYPE FIRST = 3;
+        std::vector<VertexStructure> vertices;
+        for(int y = 0; y < SIZE; ++y) {
+            for(int x = 0; x < SIZE; ++x) {
+                vertices.push_back(VertexStructure { (float)x, (float)y, 0, 0, 0, 1, x / (SIZE - 1.0f), y / (SIZE - 1.0f) });
+            }
+        }
+        std::vector<OM_INDEX_TYPE> indices;
+        for(int y = 0; y + 1 < SIZE; ++y) {
+            for(int x = 0; x + 1 < SIZE; ++x) {
+                OM_INDEX_TYPE a = (OM_INDEX_TYPE)(FIRST + y * SIZE + x), b = a + 1, c = a + SIZE, d = c + 1;
+                indices.insert(indices.end(), { a, b, d, a, d, c });
+            }
+        }
+        unsigned int indexCount = (unsigned int)indices.size();
+        std::vector<OM_INDEX_TYPE> simplified(indexCount);
+        float error = -1;
+        unsigned int simplifiedCount = MeshSimplifier::simplify(&simplified[0], &indices[0], indexCount, &vertices[0],
+                FIRST, SIZE * SIZE, indexCount / 10, 0.001f, SIMPLIFY_DEFAULT, MeshSimplifier::DEFAULT_NORMAL_WEIGHT,
+                MeshSimplifier::DEFAULT_TEXCOORD_WEIGHT, &error);
+        if((simplifiedCount > indexCount / 10) || (simplifiedCount % 3 != 0) || (error < 0) || (error > 0.001f)) {
+            OMLOGE("Flat grid is simplified to %u of %u indices with %f error!", simplifiedCount, indexCount, error);
+            return false;
+        }
+        // The result should cover the same area with counter-clockwise triangles on existing vertices
+        float area = 0;
+        for(unsigned int i = 0; i < simplifiedCount; i += 3) {
+            for(unsigned int k = 0; k < 3; ++k) {
+                if((simplified[i + k] < FIRST) || (simplified[i + k] >= FIRST + SIZE * SIZE)) {
+                    OMLOGE("Simplified index is out of range!");
+                    return false;
+                }
+            }
+            const VertexStructure &a = vertices[simplified[i] - FIRST], &b = vertices[simplified[i + 1] - FIRST],
+                                  &c = vertices[simplified[i + 2] - FIRST];
+            float doubleArea = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            if(doubleArea <= 0) {
+                OMLOGE("Simplified triangle is flipped or degenerate!");
+                return false;
+            }
+            area += doubleArea / 2;
+        }
+        if(std::fabs(area - (SIZE - 1) * (SIZE - 1)) > 0.001f) {
+            OMLOGE("Simplified grid covers %f area instead of %d!", area, (SIZE - 1) * (SIZE - 1));
+            return false;
+        }
+
+        // Locked borders: every border vertex of the grid should stay
+        simplifiedCount = MeshSimplifier::simplify(&simplified[0], &indices[0], indexCount, &vertices[0],
+                FIRST, SIZE * SIZE, 0, 0.001f, SIMPLIFY_LOCK_BORDER);
+        std::vector<bool> used(SIZE * SIZE, false);
+        for(unsigned int i = 0; i < simplifiedCount; ++i) {
+            used[simplified[i] - FIRST] = true;
+        }
+        for(int k = 0; k < SIZE; ++k) {
+            if(!used[k] || !used[k * SIZE] || !used[k * SIZE + SIZE - 1] || !used[(SIZE - 1) * SIZE + k]) {
+                OMLOGE("Border vertex is removed even though borders are locked!");
+                return false;
+            }
+        }
+
+        // A bump in the middle of the grid should limit the simplification with small error bounds
+        vertices[(SIZE / 2) * SIZE + SIZE / 2].z = 5;
+        float bumpError = 0;
+        unsigned int bumpCount = MeshSimplifier::simplify(&simplified[0], &indices[0], indexCount, &vertices[0],
+                FIRST, SIZE * SIZE, 0, 0.001f, SIMPLIFY_DEFAULT, MeshSimplifier::DEFAULT_NORMAL_WEIGHT,
+                MeshSimplifier::DEFAULT_TEXCOORD_WEIGHT, &bumpError);
+        bool hasPeak = false;
+        for(unsigned int i = 0; i < bumpCount; ++i) {
+            hasPeak = hasPeak || (simplified[i] - FIRST == (SIZE / 2) * SIZE + SIZE / 2);
+        }
+        if(!hasPeak || (bumpError > 0.001f)) {
+            OMLOGE("The peak of the bump is simplified away with small error bound!");
+            return false;
+        }
+
+#ifdef DEBUG
+        OMLOGI("...TEST_MeshSimplifier completed (OK)");
+#endif
+        return true;
+    }
+}
+
+#endif //OBJMASTER_MESHSIMPLIFIER_H
@@ -0,0 +1,219 @@
+//
+// Partitioning of meshes into small clusters (meshlets) with culling metadata.
+//
+
+#include "MeshletBuilder.h"
+#include <algorithm>
+
+namespace ObjMaster {
+
+    /** Returns the mesh-local vertex number of the index (wraps around just like the index building does) */
+    static inline unsigned int localVertex(OM_INDEX_TYPE index, OM_INDEX_TYPE firstIndex) {
+        return (OM_INDEX_TYPE)(index - firstIndex);
+    }
+
+    static inline const float* positionOf(const float *positions, size_t positionStride, unsigned int vertex) {
+        return (const float *)((const char *)positions + vertex * positionStride);
+    }
+
+    /** Fills the bounding sphere and the normal cone of the (otherwise complete) meshlet */
+    static void computeMeshletBounds(Meshlet &meshlet, const uint32_t *vertices, const uint8_t *triangles,
+            const float *positions, size_t positionStride) {
+        // Bounding sphere: the center of the bounding box and the farthest vertex from it
+        float minPos[3], maxPos[3];
+        const float *first = positionOf(positions, positionStride, vertices[0]);
+        for(int k = 0; k < 3; ++k) {
+            minPos[k] = maxPos[k] = first[k];
+        }
+        for(unsigned int v = 1; v < meshlet.vertexCount; ++v) {
+            const float *pos = positionOf(positions, positionStride, vertices[v]);
+            for(int k = 0; k < 3; ++k) {
+                minPos[k] = std::min(minPos[k], pos[k]);
+                maxPos[k] = std::max(maxPos[k], pos[k]);
+            }
+        }
+        float center[3] = { (minPos[0] + maxPos[0]) / 2, (minPos[1] + maxPos[1]) / 2, (minPos[2] + maxPos[2]) / 2 };
+        float radiusSquared = 0;
+        for(unsigned int v = 0; v < meshlet.vertexCount; ++v) {
+            const float *pos = positionOf(positions, positionStride, vertices[v]);
+            float d[3] = { pos[0] - center[0], pos[1] - center[1], pos[2] - center[2] };
+            radiusSquared = std::max(radiusSquared, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        }
+        meshlet.centerX = center[0];
+        meshlet.centerY = center[1];
+        meshlet.centerZ = center[2];
+        meshlet.radius = std::sqrt(radiusSquared);
+
+        // Normal cone: the axis is the average of the unit face normals and the cutoff comes from
+        // the biggest angle between the axis and a face normal. Degenerate triangles are skipped.
+        std::vector<float> normals;
+        normals.reserve(meshlet.triangleCount * 3);
+        float axis[3] = { 0, 0, 0 };
+        for(unsigned int t = 0; t < meshlet.triangleCount; ++t) {
+            const float *a = positionOf(positions, positionStride, vertices[triangles[t * 3 + 0]]);
+            const float *b = positionOf(positions, positionStride, vertices[triangles[t * 3 + 1]]);
+            const float *c = positionOf(positions, positionStride, vertices[triangles[t * 3 + 2]]);
+            float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if(length > 0) {
+                for(int k = 0; k < 3; ++k) {
+                    normals.push_back(n[k] / length);
+                    axis[k] += n[k] / length;
+                }
+            }
+        }
+        float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        float minDot = -1;
+        if(axisLength > 0) {
+            minDot = 1;
+            for(int k = 0; k < 3; ++k) {
+                axis[k] /= axisLength;
+            }
+            for(size_t n = 0; n < normals.size(); n += 3) {
+                minDot = std::min(minDot, normals[n] * axis[0] + normals[n + 1] * axis[1] + normals[n + 2] * axis[2]);
+            }
+        }
+        meshlet.coneAxisX = axis[0];
+        meshlet.coneAxisY = axis[1];
+        meshlet.coneAxisZ = axis[2];
+        // Rem.: cos(half angle) = minDot - so the cutoff is its sine. A cone wider than a hemisphere never culls.
+        meshlet.coneCutoff = (minDot <= 0) ? 1.0f : std::sqrt(std::max(0.0f, 1 - minDot * minDot));
+    }
+
+    bool MeshletBuilder::buildMeshlets(const OM_INDEX_TYPE *indices, unsigned int indexCount, const float *positions,
+            size_t positionStride, OM_INDEX_TYPE firstIndex, unsigned int vertexCount, std::vector<Meshlet> &meshlets,
+            std::vector<uint32_t> &meshletVertices, std::vector<uint8_t> &meshletTriangles,
+            unsigned int maxVertices, unsigned int maxTriangles) {
+        meshlets.clear();
+        meshletVertices.clear();
+        meshletTriangles.clear();
+        if((maxVertices < 3) || (maxVertices > MAX_VERTICES_LIMIT) || (maxTriangles < 1)) {
+            OMLOGE("Bad meshlet limits: %u vertices and %u triangles!", maxVertices, maxTriangles);
+            return false;
+        }
+        unsigned int triangleCount = indexCount / 3;
+        for(unsigned int i = 0; i < triangleCount * 3; ++i) {
+            if(localVertex(indices[i], firstIndex) >= vertexCount) {
+                OMLOGE("Index %u (%u) is out of the mesh vertex range - not building meshlets!", i, (unsigned int)indices[i]);
+                return false;
+            }
+        }
+
+        // Triangles of each vertex: the first liveCount[v] ones from adjacencyOffset[v] are not emitted yet
+        std::vector<unsigned int> liveCount(vertexCount, 0);
+        std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+        std::vector<unsigned int> adjacency(triangleCount * 3);
+        for(unsigned int i = 0; i < triangleCount * 3; ++i) {
+            ++liveCount[localVertex(indices[i], firstIndex)];
+        }
+        for(unsigned int v = 0; v < vertexCount; ++v) {
+            adjacencyOffset[v + 1] = adjacencyOffset[v] + liveCount[v];
+            liveCount[v] = 0;
+        }
+        for(unsigned int i = 0; i < triangleCount * 3; ++i) {
+            unsigned int v = localVertex(indices[i], firstIndex);
+            adjacency[adjacencyOffset[v] + liveCount[v]++] = i / 3;
+        }
+
+        // The local index of each vertex in the current meshlet (NOT_YET when the meshlet does not have it)
+        const unsigned int NOT_YET = (unsigned int)-1;
+        std::vector<unsigned int> localIndex(vertexCount, NOT_YET);
+        std::vector<bool> emitted(triangleCount, false);
+        auto newVerticesOf = [&](unsigned int t) {
+            unsigned int v[3] = { localVertex(indices[t * 3 + 0], firstIndex), localVertex(indices[t * 3 + 1], firstIndex),
+                                  localVertex(indices[t * 3 + 2], firstIndex) };
+            return (unsigned int)((localIndex[v[0]] == NOT_YET) +
+                                  ((localIndex[v[1]] == NOT_YET) && (v[1] != v[0])) +
+                                  ((localIndex[v[2]] == NOT_YET) && (v[2] != v[0]) && (v[2] != v[1])));
+        };
+
+        // Greedy growth: the next triangle is the one of the meshlet vertices that adds the least
+        // new vertices (the earliest one on ties - keeping the locality of the triangle order).
+        // Without adjacent triangles the first triangle (in the index buffer order) that is not
+        // emitted yet comes next. When the chosen triangle does not fit, the meshlet is closed.
+        Meshlet current = Meshlet();
+        unsigned int nextSeed = 0;
+        for(unsigned int emittedCount = 0; emittedCount < triangleCount; ++emittedCount) {
+            unsigned int best = NOT_YET;
+            unsigned int bestNewVertices = 4;
+            for(unsigned int k = current.vertexOffset; k < meshletVertices.size(); ++k) {
+                unsigned int v = meshletVertices[k];
+                for(unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v] + liveCount[v]; ++a) {
+                    unsigned int t = adjacency[a];
+                    unsigned int newVertices = newVerticesOf(t);
+                    if((newVertices < bestNewVertices) || ((newVertices == bestNewVertices) && (t < best))) {
+                        best = t;
+                        bestNewVertices = newVertices;
+                    }
+                }
+            }
+            if(best == NOT_YET) {
+                // Nothing adjacent (a new meshlet or a separate part of the mesh) - continue in the triangle order
+                while(emitted[nextSeed]) {
+                    ++nextSeed;
+                }
+                best = nextSeed;
+                bestNewVertices = newVerticesOf(best);
+            }
+            if((current.vertexCount + bestNewVertices > maxVertices) || (current.triangleCount + 1 > maxTriangles)) {
+                // Close the current meshlet and start a new one (an empty meshlet always fits a triangle)
+                computeMeshletBounds(current, &meshletVertices[current.vertexOffset],
+                        &meshletTriangles[current.triangleOffset], positions, positionStride);
+                meshlets.push_back(current);
+                for(unsigned int k = current.vertexOffset; k < meshletVertices.size(); ++k) {
+                    localIndex[meshletVertices[k]] = NOT_YET;
+                }
+                current = Meshlet();
+                current.vertexOffset = (unsigned int)meshletVertices.size();
+                current.triangleOffset = (unsigned int)meshletTriangles.size();
+                while(emitted[nextSeed]) {
+                    ++nextSeed;
+                }
+                best = nextSeed;
+            }
+
+            // Emit the triangle and remove it from the live triangles of its vertices
+            emitted[best] = true;
+            for(unsigned int k = 0; k < 3; ++k) {
+                unsigned int v = localVertex(indices[best * 3 + k], firstIndex);
+                if(localIndex[v] == NOT_YET) {
+                    localIndex[v] = current.vertexCount++;
+                    meshletVertices.push_back(v);
+                }
+                meshletTriangles.push_back((uint8_t)localIndex[v]);
+                unsigned int *live = &adjacency[adjacencyOffset[v]];
+                unsigned int a = 0;
+                while(live[a] != best) {
+                    ++a;
+                }
+                live[a] = live[--liveCount[v]];
+            }
+            ++current.triangleCount;
+        }
+        if(current.triangleCount > 0) {
+            computeMeshletBounds(current, &meshletVertices[current.vertexOffset], &meshletTriangles[current.triangleOffset],
+                    positions, positionStride);
+            meshlets.push_back(current);
+        }
+        return true;
+    }
+
+    bool MeshletBuilder::buildMeshlets(ObjMeshObject &mesh, unsigned int maxVertices, unsigned int maxTriangles) {
+        if(!mesh.inited || (mesh.indexCount < 3)) {
+            mesh.meshlets.clear();
+            mesh.meshletVertices.clear();
+            mesh.meshletTriangles.clear();
+            return true;
+        }
+        const OM_INDEX_TYPE *indices = &(*mesh.indices)[mesh.startIndexLocation];
+        const VertexStructure *vertices = &(*mesh.vertexData)[mesh.baseVertexLocation];
+        OM_INDEX_TYPE firstIndex = (OM_INDEX_TYPE)(mesh.lastIndex - mesh.vertexCount);
+        bool result = buildMeshlets(indices, mesh.indexCount, vertices, firstIndex, mesh.vertexCount,
+                mesh.meshlets, mesh.meshletVertices, mesh.meshletTriangles, maxVertices, maxTriangles);
+        OMLOGI(" - Meshlets (max %u vertices, %u triangles): %d for %u triangles", maxVertices, maxTriangles,
+                (int)mesh.meshlets.size(), mesh.indexCount / 3);
+        return result;
+    }
+}
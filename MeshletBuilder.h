@@ -0,0 +1,193 @@
+//
+// Partitioning of meshes into small clusters (meshlets) with culling metadata.
+//
+
+#ifndef OBJMASTER_MESHLETBUILDER_H
+#define OBJMASTER_MESHLETBUILDER_H
+
+#include "ObjMeshObject.h"
+#include "VertexStructure.h"
+#include "MeshletStructure.h"
+#include "objmasterlog.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+namespace ObjMaster {
+
+    /**
+     * Cuts the triangles of one mesh-range of a (possibly shared) index buffer into meshlets with
+     * bounded vertex and triangle counts - see MeshletStructure.h for the output format. Just like
+     * with MeshOptimizer, the indices of the range should refer to [firstIndex, firstIndex + vertexCount).
+     */
+    class MeshletBuilder final {
+    public:
+        /** The usual limits of mesh shader friendly meshlets */
+        static const unsigned int DEFAULT_MAX_VERTICES = 64;
+        static const unsigned int DEFAULT_MAX_TRIANGLES = 124;
+        /** The local triangle indices are one byte each */
+        static const unsigned int MAX_VERTICES_LIMIT = 256;
+
+        /**
+         * Builds the meshlets by greedy growth: each meshlet is extended with the adjacent triangle
+         * that needs the least new vertices until nothing fits, which gives compact patches (tight
+         * bounds and cones). Ties and new meshlets follow the current triangle order, so running the
+         * MeshOptimizer passes first helps. Every triangle ends up in exactly one meshlet with its
+         * winding kept. The outputs are replaced: the meshlet vertices are mesh-local vertex numbers.
+         * Returns false (leaving the outputs empty) if the limits are bad (maxVertices should be
+         * in [3, MAX_VERTICES_LIMIT] and maxTriangles at least 1) or an index is outside of the range.
+         */
+        static inline bool buildMeshlets(const OM_INDEX_TYPE *indices, unsigned int indexCount, const VertexStructure *vertices,
+                OM_INDEX_TYPE firstIndex, unsigned int vertexCount, std::vector<Meshlet> &meshlets,
+                std::vector<uint32_t> &meshletVertices, std::vector<uint8_t> &meshletTriangles,
+                unsigned int maxVertices = DEFAULT_MAX_VERTICES, unsigned int maxTriangles = DEFAULT_MAX_TRIANGLES) {
+            return buildMeshlets(indices, indexCount, (const float *)vertices, sizeof(VertexStructure), firstIndex, vertexCount,
+                    meshlets, meshletVertices, meshletTriangles, maxVertices, maxTriangles);
+        }
+
+        /**
+         * The same as above for any vertex layout: the x, y, z floats of vertex n (of the range)
+         * are at positions + n * positionStride bytes.
+         */
+        static bool buildMeshlets(const OM_INDEX_TYPE *indices, unsigned int indexCount, const float *positions,
+                size_t positionStride, OM_INDEX_TYPE firstIndex, unsigned int vertexCount, std::vector<Meshlet> &meshlets,
+                std::vector<uint32_t> &meshletVertices, std::vector<uint8_t> &meshletTriangles,
+                unsigned int maxVertices = DEFAULT_MAX_VERTICES, unsigned int maxTriangles = DEFAULT_MAX_TRIANGLES);
+
+        /** The same as above, but for the mesh-range of the mesh - the results go into the meshlet vectors of the mesh */
+        static bool buildMeshlets(ObjMeshObject &mesh, unsigned int maxVertices = DEFAULT_MAX_VERTICES,
+                unsigned int maxTriangles = DEFAULT_MAX_TRIANGLES);
+
+        /** The back-face culling test of the normal cone (see MeshletStructure.h) - true when the meshlet can be skipped */
+        static inline bool isBackFacing(const Meshlet &meshlet, float cameraX, float cameraY, float cameraZ) {
+            float d[3] = { meshlet.centerX - cameraX, meshlet.centerY - cameraY, meshlet.centerZ - cameraZ };
+            float distance = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            return d[0] * meshlet.coneAxisX + d[1] * meshlet.coneAxisY + d[2] * meshlet.coneAxisZ >=
+                   meshlet.coneCutoff * distance + meshlet.radius;
+        }
+    };
+
+    /** Test helper: the triangles with their smallest index rotated to the front (keeps the winding) - sorted */
+    static std::vector<uint32_t> sortedTriangles(const std::vector<uint32_t> &indices) {
+        std::vector<std::vector<uint32_t>> triangles;
+        for(size_t i = 0; i + 2 < indices.size(); i += 3) {
+            std::vector<uint32_t> triangle = { indices[i], indices[i + 1], indices[i + 2] };
+            std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+            triangles.push_back(triangle);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        std::vector<uint32_t> result;
+        for(auto &triangle : triangles) {
+            result.insert(result.end(), triangle.begin(), triangle.end());
+        }
+        return result;
+    }
+
+// Very simple unit-testing approach
+// it is better to have these run on the device itself and callable as normal functions than to
+// test it compile-time with some unit testing framework as this way we rule out architectural
+// differences better. Tests will start by logging test starts to error (when #DEBUG is set!)
+// and info logs and the method returns false when anything has failed...
+    static bool TEST_MeshletBuilder() {
+#ifdef DEBUG
+        OMLOGI("TEST_MeshletBuilder...");
+#endif
+        // A flat grid in the z=0 plane facing +z (counter-clockwise triangles)
+        const int SIZE = 24;
+        const OM_INDEX_TYPE FIRST = 7;
+        std::vector<VertexStructure> vertices;
+        for(int y = 0; y < SIZE; ++y) {
+            for(int x = 0; x < SIZE; ++x) {
+                vertices.push_back(VertexStructure { (float)x, (float)y, 0, 0, 0, 1, 0, 0 });
+            }
+        }
+        std::vector<OM_INDEX_TYPE> indices;
+        for(int y = 0; y + 1 < SIZE; ++y) {
+            for(int x = 0; x + 1 < SIZE; ++x) {
+                OM_INDEX_TYPE a = (OM_INDEX_TYPE)(FIRST + y * SIZE + x), b = a + 1, c = a + SIZE, d = c + 1;
+                indices.insert(indices.end(), { a, b, d, a, d, c });
+            }
+        }
+        std::vector<Meshlet> meshlets;
+        std::vector<uint32_t> meshletVertices;
+        std::vector<uint8_t> meshletTriangles;
+        const unsigned int MAX_VERTICES = 32, MAX_TRIANGLES = 40;
+        if(!MeshletBuilder::buildMeshlets(&indices[0], (unsigned int)indices.size(), &vertices[0], FIRST, SIZE * SIZE,
+                meshlets, meshletVertices, meshletTriangles, MAX_VERTICES, MAX_TRIANGLES) || (meshlets.size() < 2)) {
+            OMLOGE("Meshlet building failed!");
+            return false;
+        }
+
+        // The meshlets should give back the very same triangles (with the same winding) and respect the limits
+        std::vector<uint32_t> original, fromMeshlets;
+        for(OM_INDEX_TYPE index : indices) {
+            original.push_back((uint32_t)(index - FIRST));
+        }
+        for(const Meshlet &meshlet : meshlets) {
+            if((meshlet.vertexCount > MAX_VERTICES) || (meshlet.triangleCount > MAX_TRIANGLES) || (meshlet.triangleCount == 0)) {
+                OMLOGE("Meshlet limits are not respected: %u vertices and %u triangles!", meshlet.vertexCount, meshlet.triangleCount);
+                return false;
+            }
+            for(unsigned int t = 0; t < meshlet.triangleCount * 3; ++t) {
+                uint8_t local = meshletTriangles[meshlet.triangleOffset + t];
+                if(local >= meshlet.vertexCount) {
+                    OMLOGE("Meshlet triangle refers to a missing meshlet vertex!");
+                    return false;
+                }
+                uint32_t vertex = meshletVertices[meshlet.vertexOffset + local];
+                fromMeshlets.push_back(vertex);
+                const VertexStructure &v = vertices[vertex];
+                float dx = v.x - meshlet.centerX, dy = v.y - meshlet.centerY, dz = v.z - meshlet.centerZ;
+                if(std::sqrt(dx * dx + dy * dy + dz * dz) > meshlet.radius * 1.0001f) {
+                    OMLOGE("A vertex is outside of the bounding sphere of its meshlet!");
+                    return false;
+                }
+            }
+            // Flat meshlet: the cone is the plane normal and is culled only from behind the plane
+            if((std::fabs(meshlet.coneAxisZ - 1.0f) > 0.0001f) || (meshlet.coneCutoff > 0.001f) ||
+               !MeshletBuilder::isBackFacing(meshlet, meshlet.centerX, meshlet.centerY, -100.0f) ||
+               MeshletBuilder::isBackFacing(meshlet, meshlet.centerX + 3, meshlet.centerY, 10.0f)) {
+                OMLOGE("Bad normal cone of a flat meshlet!");
+                return false;
+            }
+        }
+        if(sortedTriangles(original) != sortedTriangles(fromMeshlets)) {
+            OMLOGE("Meshlet triangles do not give back the original triangles!");
+            return false;
+        }
+        // Compact patches: the grid meshlets should be mostly vertex-bound squares, not strips
+        if(meshlets.size() > (indices.size() / 3) / 24) {
+            OMLOGE("Too many (%d) meshlets for the grid!", (int)meshlets.size());
+            return false;
+        }
+
+        // Normals pointing to every direction can never be culled
+        std::vector<VertexStructure> tetrahedron = {
+            { 0, 0, 0, 0, 0, 0, 0, 0 }, { 1, 0, 0, 0, 0, 0, 0, 0 }, { 0, 1, 0, 0, 0, 0, 0, 0 }, { 0, 0, 1, 0, 0, 0, 0, 0 },
+        };
+        std::vector<OM_INDEX_TYPE> closed = { 0, 2, 1, 0, 1, 3, 0, 3, 2, 1, 2, 3 };
+        if(!MeshletBuilder::buildMeshlets(&closed[0], (unsigned int)closed.size(), &tetrahedron[0], 0, 4,
+                meshlets, meshletVertices, meshletTriangles) || (meshlets.size() != 1) || (meshlets[0].coneCutoff != 1.0f) ||
+           MeshletBuilder::isBackFacing(meshlets[0], 5, 5, 5) || MeshletBuilder::isBackFacing(meshlets[0], -5, -5, -5)) {
+            OMLOGE("Bad meshlet of a closed tetrahedron!");
+            return false;
+        }
+
+        // Bad limits and out of range indices should be refused
+        if(MeshletBuilder::buildMeshlets(&closed[0], (unsigned int)closed.size(), &tetrahedron[0], 0, 4,
+                meshlets, meshletVertices, meshletTriangles, 2, 10) ||
+           MeshletBuilder::buildMeshlets(&closed[0], (unsigned int)closed.size(), &tetrahedron[0], 1, 3,
+                meshlets, meshletVertices, meshletTriangles) || !meshlets.empty()) {
+            OMLOGE("Bad meshlet parameters are not refused!");
+            return false;
+        }
+
+#ifdef DEBUG
+        OMLOGI("...TEST_MeshletBuilder completed (OK)");
+#endif
+        return true;
+    }
+}
+
+#endif //OBJMASTER_MESHLETBUILDER_H
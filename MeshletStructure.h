@@ -0,0 +1,40 @@
+//
+// Cluster (meshlet) descriptors with culling metadata for mesh shading and cluster culling.
+// This code should be able to get included as a C-header, because it is used in the interop facade layer!
+//
+// BECAUSE OF THIS: NO C++ FEATURES SHOULD BE USED HERE EVER!
+//
+
+#ifndef OBJMASTER_MESHLETSTRUCTURE_H
+#define OBJMASTER_MESHLETSTRUCTURE_H
+
+/**
+ * One cluster of triangles of a mesh. The meshlet has its own small vertex list (vertexCount
+ * mesh-local vertex numbers from vertexOffset in the meshlet vertex array) and its triangles refer
+ * to this list with one byte indices (3 * triangleCount bytes from triangleOffset in the meshlet
+ * triangle array). The vertex of local index n of meshlet m is therefore:
+ *     vertexData[baseVertexLocation + meshletVertices[meshlets[m].vertexOffset + n]]
+ *
+ * Culling: the meshlet can be skipped when its bounding sphere is outside of the view frustum or
+ * when all of its triangles are back-facing, which is conservatively the case when:
+ *     dot(center - cameraPosition, coneAxis) >= coneCutoff * length(center - cameraPosition) + radius
+ * A coneCutoff of 1 means the normals are too spread out and the meshlet is never back-face culled.
+ */
+struct Meshlet {
+    // offset of the first element in the meshlet vertex array
+    unsigned int vertexOffset;
+    // offset of the first element (byte) in the meshlet triangle array
+    unsigned int triangleOffset;
+    // number of (unique) vertices
+    unsigned int vertexCount;
+    // number of triangles
+    unsigned int triangleCount;
+    // bounding sphere
+    float centerX, centerY, centerZ;
+    float radius;
+    // normal cone: unit axis and the sine of the half angle (see above)
+    float coneAxisX, coneAxisY, coneAxisZ;
+    float coneCutoff;
+};
+
+#endif //OBJMASTER_MESHLETSTRUCTURE_H
@@ -5,6 +5,7 @@
 #include "funhelper.h"
 #include "MtlLib.h"
 #include "ObjCommon.h"
+#include "LineReader.h"
 #include <algorithm>  /* std::mismatch */
 #include <cstring>    /* strtok_r, strdup */
 #include <cstdlib>    /* free */
@@ -13,6 +14,7 @@
 
 namespace ObjMaster {
     const std::string MtlLib::KEYWORD = std::string("mtllib");
+    const uint32_t MtlLib::NO_MATERIAL;
 
     bool MtlLib::isParsable(const char *fields) {
         // First check this: not an empty string, the first character is an 'm'
@@ -20,8 +22,8 @@ namespace ObjMaster {
                && (fields[0] != 0)
                && ((fields[0] == 'm'))){
             // Now check if it has the prefix of mtllib or not
-            const std::string targetString = std::string(fields);
-            return isStartsWith(targetString, KEYWORD);
+            // Rem.: No std::string is built here as this check runs for a lot of lines
+            return strncmp(fields, KEYWORD.c_str(), KEYWORD.size()) == 0;
         } else {
             return false;
         }
@@ -49,17 +51,29 @@ namespace ObjMaster {
             std::string libraryFile(libFileCstr);
             libraryFiles.push_back(libraryFile);
 
-            OMLOGI("Opening input stream for %s/%s", assetPath, libraryFile.c_str());
-            std::unique_ptr<std::istream> input = assetLibrary.getAssetStream(assetPath, libraryFile.c_str());
+            // Read from memory when the asset library supports that, otherwise use a stream.
+            // Rem.: Lines of any length are supported (long map_* paths for example)
+            std::unique_ptr<AssetMemory> memory = assetLibrary.getAssetMemory(assetPath, libraryFile.c_str());
+            std::unique_ptr<std::istream> input;
+            std::unique_ptr<LineReader> reader;
+            if(memory) {
+                reader = std::unique_ptr<LineReader>(new LineReader(memory->data(), memory->size()));
+            } else {
+                OMLOGI("Opening input stream for %s/%s", assetPath, libraryFile.c_str());
+                input = assetLibrary.getAssetStream(assetPath, libraryFile.c_str());
+                reader = std::unique_ptr<LineReader>(new LineReader(*input));
+            }
 
             OMLOGI("Reading mtl data file line-by-line");
-            char line[DEFAULT_LINE_PARSE_LEN];
+            const char *lineBegin, *lineEnd;
             std::vector<std::string> descriptorLineFields;
             bool firstMaterial = true;
             std::string currentMaterialName;
-            while(input->getline(line, DEFAULT_LINE_PARSE_LEN)) {
+            while(reader->next(lineBegin, lineEnd)) {
+                // The mtl files are small so it is fine to work on (zero terminated) string copies
+                std::string line(lineBegin, lineEnd);
                 // See if we have found a new material descriptor
-                if((line[0] == 'n') && isStartsWith(std::string(line), "newmtl")){
+                if((line[0] == 'n') && isStartsWith(line, "newmtl")){
                     // A new material descriptor will start... process data found until now!
                     // If there was a material that we've already started to collect
                     // Then finding the next one means we have all the data for parsing
@@ -72,8 +86,8 @@ namespace ObjMaster {
                         // Create a material with all the collected data from the last newmtl entry
                         // and add this to the material mapping
                         //TextureDataHoldingMaterial createdMat = TextureDataHoldingMaterial(currentMaterialName, descriptorLineFields);
-                        //materials[currentMaterialName] = createdMat;
-                        materials[currentMaterialName] = TextureDataHoldingMaterial(currentMaterialName, descriptorLineFields);
+                        //setMaterial(currentMaterialName, std::move(createdMat));
+                        setMaterial(currentMaterialName, TextureDataHoldingMaterial(currentMaterialName, descriptorLineFields));
                         // Erase the collector vector for the fields corresponding to a material
                         descriptorLineFields.clear();
                         OMLOGI("Added the following material to the %s library: %s",
@@ -81,22 +95,23 @@ namespace ObjMaster {
                                currentMaterialName.c_str());
 #ifdef DEBUG
                         // In case of debug, we also print out detailed material informations...
-                        OMLOGI(" - ka=%d,%d,%d", materials[currentMaterialName].ka[0], materials[currentMaterialName].ka[1], materials[currentMaterialName].ka[2]);
-                        OMLOGI(" - kd=%d,%d,%d", materials[currentMaterialName].kd[0], materials[currentMaterialName].kd[1], materials[currentMaterialName].kd[2]);
-                        OMLOGI(" - ks=%d,%d,%d", materials[currentMaterialName].ks[0], materials[currentMaterialName].ks[1], materials[currentMaterialName].ks[2]);
-                        OMLOGI(" - map_ka=%s", materials[currentMaterialName].map_ka)
-                        OMLOGI(" - map_kd=%s", materials[currentMaterialName].map_kd)
-                        OMLOGI(" - map_ks=%s", materials[currentMaterialName].map_ks)
-                        OMLOGI(" - map_bump=%s", materials[currentMaterialName].map_bump)
+                        const TextureDataHoldingMaterial &added = getMaterial(getMaterialId(currentMaterialName));
+                        OMLOGI(" - ka=%d,%d,%d", added.ka[0], added.ka[1], added.ka[2]);
+                        OMLOGI(" - kd=%d,%d,%d", added.kd[0], added.kd[1], added.kd[2]);
+                        OMLOGI(" - ks=%d,%d,%d", added.ks[0], added.ks[1], added.ks[2]);
+                        OMLOGI(" - map_ka=%s", added.map_ka)
+                        OMLOGI(" - map_kd=%s", added.map_kd)
+                        OMLOGI(" - map_ks=%s", added.map_ks)
+                        OMLOGI(" - map_bump=%s", added.map_bump)
 #endif
                     }
 
                     // BEWARE: this changes the line! This is why this is the last call here!
-                    currentMaterialName = updateCurrentMaterialName(line);
+                    currentMaterialName = updateCurrentMaterialName(&line[0]);
                 } else {
                     // If the line is not a material descriptor, just collect the data
                     // into the string vector for creating the materials later
-                    descriptorLineFields.push_back(line);
+                    descriptorLineFields.push_back(std::move(line));
                 }
             }
             // save the last material (we have always saved only in case of newmtl, so we need
@@ -105,9 +120,9 @@ namespace ObjMaster {
                 // Create a material with all the collected data from the last newmtl entry
                 // and add this to the material mapping
                 //TextureDataHoldingMaterial createdMat = TextureDataHoldingMaterial(currentMaterialName, descriptorLineFields);
-                //materials[currentMaterialName] = createdMat;
-                materials[currentMaterialName] = TextureDataHoldingMaterial(currentMaterialName,
-                                                                            descriptorLineFields);
+                //setMaterial(currentMaterialName, std::move(createdMat));
+                setMaterial(currentMaterialName, TextureDataHoldingMaterial(currentMaterialName,
+                                                                                              descriptorLineFields));
                 // Erase the collector vector for the fields corresponding to a material
                 descriptorLineFields.clear();
                 OMLOGI("Added the following material to the %s library: %s",
@@ -115,13 +130,14 @@ namespace ObjMaster {
                        currentMaterialName.c_str());
 #ifdef DEBUG
                 // In case of debug, we also print out detailed material informations...
-                OMLOGI(" - ka=%d,%d,%d", materials[currentMaterialName].ka[0], materials[currentMaterialName].ka[1], materials[currentMaterialName].ka[2]);
-                OMLOGI(" - kd=%d,%d,%d", materials[currentMaterialName].kd[0], materials[currentMaterialName].kd[1], materials[currentMaterialName].kd[2]);
-                OMLOGI(" - ks=%d,%d,%d", materials[currentMaterialName].ks[0], materials[currentMaterialName].ks[1], materials[currentMaterialName].ks[2]);
-                OMLOGI(" - map_ka=%s", materials[currentMaterialName].map_ka)
-                OMLOGI(" - map_kd=%s", materials[currentMaterialName].map_kd)
-                OMLOGI(" - map_ks=%s", materials[currentMaterialName].map_ks)
-                OMLOGI(" - map_bump=%s", materials[currentMaterialName].map_bump)
+                const TextureDataHoldingMaterial &added = getMaterial(getMaterialId(currentMaterialName));
+                OMLOGI(" - ka=%d,%d,%d", added.ka[0], added.ka[1], added.ka[2]);
+                OMLOGI(" - kd=%d,%d,%d", added.kd[0], added.kd[1], added.kd[2]);
+                OMLOGI(" - ks=%d,%d,%d", added.ks[0], added.ks[1], added.ks[2]);
+                OMLOGI(" - map_ka=%s", added.map_ka)
+                OMLOGI(" - map_kd=%s", added.map_kd)
+                OMLOGI(" - map_ks=%s", added.map_ks)
+                OMLOGI(" - map_bump=%s", added.map_bump)
 #endif
             }
         }
@@ -143,13 +159,11 @@ namespace ObjMaster {
 	std::unique_ptr<std::ostream> output = assetOutputLibrary.getAssetOutputStream(path, fileName);
 
 	bool firstMat = true;
-	for(auto matNameAndMat : materials){
-		std::string matName = matNameAndMat.first;
+	// Rem.: The materials are written in the order of their ids (the order they got into the library)
+	for(auto &mat : materials){
 #ifdef DEBUG
-		OMLOGI("Found material to write out: %s", matName.c_str());
+		OMLOGI("Found material to write out: %s", mat.name.c_str());
 #endif
-		// Auto is necessary here for future-proofing so that asText() can be hidden if we ever want to change its implementation!
-		auto &mat = matNameAndMat.second;
 
 		// Put a seperating newline between materials in the resulting *.mtl
 		if(firstMat) {
@@ -182,7 +196,26 @@ namespace ObjMaster {
     }
 
     // return the number of materials
-    int MtlLib::getMaterialCount() {
+    int MtlLib::getMaterialCount() const {
         return materials.size();
     }
+
+    uint32_t MtlLib::importMaterial(const MtlLib &other, uint32_t otherMaterialId) {
+        if(otherMaterialId >= other.materials.size()) {
+            return NO_MATERIAL;
+        }
+        // Rem.: Materials created for bad names have no name themselves - so the name is looked up
+        //       from the other library (this is rare enough to be fine with a linear search)
+        for(auto &kv : other.materialIds) {
+            if(kv.second == otherMaterialId) {
+                uint32_t materialId = getMaterialId(kv.first);
+                if(materialId != NO_MATERIAL) {
+                    return materialId;
+                }
+                TextureDataHoldingMaterial copy = other.materials[otherMaterialId];
+                return setMaterial(kv.first, std::move(copy));
+            }
+        }
+        return NO_MATERIAL;
+    }
 }
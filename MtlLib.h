@@ -6,12 +6,16 @@
 #define NFTSIMPLEPROJ_MTLLIB_H
 
 #include "TextureDataHoldingMaterial.h"
+#include "MaterialStructure.h"
 #include "AssetLibrary.h"
+#include "objmasterlog.h"
 #include <memory>
 #include <vector>
 #include <string>
 #include <unordered_map>
 #include <algorithm>
+#include <utility>
+#include <stdint.h>
 
 namespace ObjMaster {
     class MtlLib {
@@ -86,40 +90,134 @@ namespace ObjMaster {
 	/** Save this MtlLib as a *.mtl - using the path, fileName and the provided asset-out library - absoluteLibraryFileReferences defines if we reference the already saved files absolutely or relatively! */
 	void saveAs(const AssetOutputLibrary &assetOutputLibrary, const char* path, const char* fileName, bool alwaysGrowLibraryFilesList = false, bool absoluteLibraryFileReferences = false);
 
-	/** Adds the given (runtime generated) material to the material library. If there is a material with the same name, it gets overwritten! */
+	/** Adds the given (runtime generated) material to the material library. If there is a material with the same name, it gets overwritten (keeping its id)! */
 	inline void addRuntimeGeneratedMaterial(Material m) {
 		// Convert the provided to an unloaded TextureDataHoldingMaterial...
-		materials[m.name] = TextureDataHoldingMaterial(m);
+		std::string materialName = m.name;
+		setMaterial(materialName, TextureDataHoldingMaterial(m));
 	}
 
         /**
 	 * Returns a copy of the material with the given name - this material is always non-loaded!
-	 * Rem.: Implementation uses "operator[]" so this adds a new empty material to the MtlLib
-	 *       in case a bad name is provided! This is usually a sensible fallback - but beware!
+	 * The lookup does not change the library so it is safe to call concurrently from multiple
+	 * threads (as long as nobody changes the library meanwhile). An empty material is returned
+	 * in case a bad name is provided.
 	 */
-	inline TextureDataHoldingMaterial getNonLoadedMaterialFor(std::string materialName) {
-		// Just return the material for the name
-		return materials[materialName];
+	inline TextureDataHoldingMaterial getNonLoadedMaterialFor(const std::string &materialName) const {
+		uint32_t materialId = getMaterialId(materialName);
+		if(materialId == NO_MATERIAL) {
+			OMLOGW("Material %s is not found in the material library!", materialName.c_str());
+			return TextureDataHoldingMaterial();
+		}
+		return materials[materialId];
+	}
+
+        /**
+	 * Returns a copy of the material with the given name - this material is always non-loaded!
+	 * Rem.: Implementation uses getOrCreateMaterialId so this adds a new empty material to the MtlLib
+	 *       in case a bad name is provided! This is usually a sensible fallback when building
+	 *       the library (like when parsing "usemtl" lines) - but beware, as this is not const!
+	 */
+	inline TextureDataHoldingMaterial getOrCreateNonLoadedMaterialFor(const std::string &materialName) {
+		return materials[getOrCreateMaterialId(materialName)];
+	}
+
+	// Material table
+	// --------------
+	//
+	// Materials have ids: their (dense) index in the order they got into the library. The ids
+	// stay the same while the library lives - overwriting a material keeps its id - so they can
+	// be stored instead of names or material copies (like in ObjectMaterialFaceGroup).
+
+	/** The id that refers to no material - its material is empty */
+	static const uint32_t NO_MATERIAL = (uint32_t)(-1);
+
+	/** Returns the id of the material with the given name or NO_MATERIAL if there is no such material */
+	inline uint32_t getMaterialId(const std::string &materialName) const {
+		auto it = materialIds.find(materialName);
+		return (it != materialIds.end()) ? it->second : NO_MATERIAL;
+	}
+
+	/**
+	 * Returns the id of the material with the given name. Just like getOrCreateNonLoadedMaterialFor,
+	 * this adds a new empty material (with an empty name) in case a bad name is provided.
+	 */
+	inline uint32_t getOrCreateMaterialId(const std::string &materialName) {
+		uint32_t materialId = getMaterialId(materialName);
+		return (materialId != NO_MATERIAL) ? materialId : setMaterial(materialName, TextureDataHoldingMaterial());
 	}
 
-	/** Gets all material names that are currently stored in the material library */
-	inline std::vector<std::string> getAllMaterialNames() {
-		std::vector<std::string> ret;
-		for(auto kv : materials) {
-			ret.push_back(kv.first);
+	/** Returns the (non-loaded) material of the id - an empty one for NO_MATERIAL and bad ids */
+	inline const TextureDataHoldingMaterial& getMaterial(uint32_t materialId) const {
+		static const TextureDataHoldingMaterial noMaterial;
+		return (materialId < materials.size()) ? materials[materialId] : noMaterial;
+	}
+
+	/**
+	 * Returns the material of the id for loading texture data into it - nullptr for NO_MATERIAL and
+	 * bad ids. Only for the own copies of the library (like the one of MaterializedObjModel)!
+	 */
+	inline TextureDataHoldingMaterial* getLoadableMaterial(uint32_t materialId) {
+		return (materialId < materials.size()) ? &materials[materialId] : nullptr;
+	}
+
+	/**
+	 * Returns the colors and the enabled fields of the material of the id - zeros for NO_MATERIAL and
+	 * bad ids. Made from the material itself, so changes through getLoadableMaterial are seen too.
+	 */
+	inline MaterialStructure getMaterialStructure(uint32_t materialId) const {
+		return getMaterial(materialId).asStructure();
+	}
+
+	/** Returns the plain old data of all the materials (see getMaterialStructure) indexed by their ids - like for an uniform buffer */
+	inline std::vector<MaterialStructure> getMaterialTable() const {
+		std::vector<MaterialStructure> table;
+		table.reserve(materials.size());
+		for(auto &material : materials) {
+			table.push_back(material.asStructure());
+		}
+		return table;
+	}
+
+	/**
+	 * Returns the id in this library for the material of the other library: the id of the material
+	 * with the same name or a copy of the other material added with that name. Used when the
+	 * library of an Obj gets replaced, so the materials of its groups are kept.
+	 */
+	uint32_t importMaterial(const MtlLib &other, uint32_t otherMaterialId);
+
+	/** Gets all material names that are currently stored in the material library (in the order of their ids) */
+	inline std::vector<std::string> getAllMaterialNames() const {
+		std::vector<std::string> ret(materials.size());
+		for(auto &kv : materialIds) {
+			ret[kv.second] = kv.first;
 		}
 		return ret;
 	}
 
         /** Returns the number of materials in this library */
-        int getMaterialCount();
+        int getMaterialCount() const;
 
         /** Returns if this mtllib is a completely empty library or not! */
-        bool isEmpty() { return materials.empty(); }
+        bool isEmpty() const { return materials.empty(); }
     private:
 
-        /** Material name -> material hash for basic material access without loaded texture data */
-        std::unordered_map <std::string, TextureDataHoldingMaterial> materials;
+        /** Material name -> material id for the lookups by name */
+        std::unordered_map<std::string, uint32_t> materialIds;
+        /** The materials (without loaded texture data - except in copies, see getLoadableMaterial) - indexed by their ids */
+        std::vector<TextureDataHoldingMaterial> materials;
+
+        /** Adds or overwrites the material with the given name - returns its id */
+        inline uint32_t setMaterial(const std::string &materialName, TextureDataHoldingMaterial &&material) {
+            auto inserted = materialIds.emplace(materialName, (uint32_t)materials.size());
+            uint32_t materialId = inserted.first->second;
+            if(inserted.second) {
+                materials.push_back(std::move(material));
+            } else {
+                materials[materialId] = std::move(material);
+            }
+            return materialId;
+        }
 
         void constructionHelper(char *fields, const char *assetPath, const AssetLibrary &assetLibrary);
 
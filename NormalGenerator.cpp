@@ -0,0 +1,205 @@
+//
+// Generation of area-weighted vertex normals for meshes without them (respecting smoothing groups).
+//
+
+#include "NormalGenerator.h"
+#include <algorithm>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define OM_NORMALS_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace ObjMaster {
+
+    static inline const float* positionOf(const float *positions, size_t positionStride, uint32_t position) {
+        return (const float *)((const char *)positions + position * positionStride);
+    }
+
+    /**
+     * The area weighted (cross product) and the unit normals of triangles [start, end). Zero area
+     * triangles get a zero unit normal.
+     */
+    static void computeFaceNormals(const float *positions, size_t positionStride, const uint32_t *corners,
+            unsigned int start, unsigned int end, float *weighted, float *units) {
+        unsigned int t = start;
+#if OM_NORMALS_SSE
+        // Four triangles at once: the positions are gathered into x, y, z vectors (one lane per triangle)
+        for(; t + 4 <= end; t += 4) {
+            float p[3][3][4];
+            for(int lane = 0; lane < 4; ++lane) {
+                for(int c = 0; c < 3; ++c) {
+                    const float *position = positionOf(positions, positionStride, corners[3 * (t + lane) + c]);
+                    p[c][0][lane] = position[0];
+                    p[c][1][lane] = position[1];
+                    p[c][2][lane] = position[2];
+                }
+            }
+            __m128 x0 = _mm_loadu_ps(p[0][0]), y0 = _mm_loadu_ps(p[0][1]), z0 = _mm_loadu_ps(p[0][2]);
+            __m128 e1x = _mm_sub_ps(_mm_loadu_ps(p[1][0]), x0);
+            __m128 e1y = _mm_sub_ps(_mm_loadu_ps(p[1][1]), y0);
+            __m128 e1z = _mm_sub_ps(_mm_loadu_ps(p[1][2]), z0);
+            __m128 e2x = _mm_sub_ps(_mm_loadu_ps(p[2][0]), x0);
+            __m128 e2y = _mm_sub_ps(_mm_loadu_ps(p[2][1]), y0);
+            __m128 e2z = _mm_sub_ps(_mm_loadu_ps(p[2][2]), z0);
+            __m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+            __m128 ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+            __m128 nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+            // Rem.: the division is masked out for zero lengths (degenerate triangles)
+            __m128 nonZero = _mm_cmpgt_ps(length, _mm_setzero_ps());
+            __m128 safeLength = _mm_or_ps(_mm_and_ps(nonZero, length), _mm_andnot_ps(nonZero, _mm_set1_ps(1)));
+            __m128 ux = _mm_and_ps(nonZero, _mm_div_ps(nx, safeLength));
+            __m128 uy = _mm_and_ps(nonZero, _mm_div_ps(ny, safeLength));
+            __m128 uz = _mm_and_ps(nonZero, _mm_div_ps(nz, safeLength));
+            float out[6][4];
+            _mm_storeu_ps(out[0], nx);
+            _mm_storeu_ps(out[1], ny);
+            _mm_storeu_ps(out[2], nz);
+            _mm_storeu_ps(out[3], ux);
+            _mm_storeu_ps(out[4], uy);
+            _mm_storeu_ps(out[5], uz);
+            for(int lane = 0; lane < 4; ++lane) {
+                for(int k = 0; k < 3; ++k) {
+                    weighted[3 * (t + lane) + k] = out[k][lane];
+                    units[3 * (t + lane) + k] = out[3 + k][lane];
+                }
+            }
+        }
+#endif
+        for(; t < end; ++t) {
+            const float *p0 = positionOf(positions, positionStride, corners[3 * t]);
+            const float *p1 = positionOf(positions, positionStride, corners[3 * t + 1]);
+            const float *p2 = positionOf(positions, positionStride, corners[3 * t + 2]);
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float *n = &weighted[3 * t];
+            n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+            n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+            n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+            float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for(int k = 0; k < 3; ++k) {
+                units[3 * t + k] = (length > 0) ? n[k] / length : 0;
+            }
+        }
+    }
+
+    /** Runs task(start, end) on the [0, count) range - in parallel chunks when there is a pool */
+    template<typename Task>
+    static void forChunks(unsigned int count, unsigned int parallelThreshold, ThreadPool *threadPool, Task task) {
+        int chunkNum = 1;
+        if((threadPool != nullptr) && (count >= parallelThreshold)) {
+            chunkNum = threadPool->getThreadCount() * 4;
+        }
+        if(chunkNum == 1) {
+            task(0u, count);
+            return;
+        }
+        threadPool->parallelFor(chunkNum, [&](int c) {
+            task((unsigned int)(((uint64_t)count * c) / chunkNum), (unsigned int)(((uint64_t)count * (c + 1)) / chunkNum));
+        });
+    }
+
+    void NormalGenerator::generateNormals(const float *positions, size_t positionStride, const uint32_t *corners,
+            unsigned int triangleCount, const unsigned int *smoothingGroups, float creaseAngle,
+            float *normals, ThreadPool *threadPool) {
+        if(triangleCount == 0) {
+            return;
+        }
+        const size_t cornerCount = 3 * (size_t)triangleCount;
+        const bool crease = (creaseAngle < NO_CREASE_ANGLE);
+        const float minCosine = std::cos(creaseAngle * 3.14159265358979f / 180.0f);
+
+        // 1) Face normals
+        std::vector<float> weighted(cornerCount);
+        std::vector<float> units(cornerCount);
+        forChunks(triangleCount, MIN_PARALLEL_TRIANGLES, threadPool, [&](unsigned int start, unsigned int end) {
+            computeFaceNormals(positions, positionStride, corners, start, end, &weighted[0], &units[0]);
+        });
+
+        // 2) Corners by position (counting sort) - then by smoothing group within each position
+        uint32_t positionCount = 0;
+        for(size_t k = 0; k < cornerCount; ++k) {
+            positionCount = std::max(positionCount, corners[k] + 1);
+        }
+        std::vector<uint32_t> positionStart(positionCount + 1, 0);
+        for(size_t k = 0; k < cornerCount; ++k) {
+            ++positionStart[corners[k] + 1];
+        }
+        for(uint32_t p = 0; p < positionCount; ++p) {
+            positionStart[p + 1] += positionStart[p];
+        }
+        // Rem.: (smoothing group, corner) pairs so that sorting a position range groups them
+        std::vector<std::pair<unsigned int, uint32_t>> sortedCorners(cornerCount);
+        {
+            std::vector<uint32_t> next(positionStart.begin(), positionStart.end() - 1);
+            for(size_t k = 0; k < cornerCount; ++k) {
+                unsigned int group = (smoothingGroups != nullptr) ? smoothingGroups[k / 3] : 1;
+                sortedCorners[next[corners[k]]++] = std::make_pair(group, (uint32_t)k);
+            }
+        }
+
+        // 3) Sum the face normals of the corners with the same position and smoothing group
+        forChunks(positionCount, MIN_PARALLEL_TRIANGLES, threadPool, [&](unsigned int start, unsigned int end) {
+            for(uint32_t p = start; p < end; ++p) {
+                auto first = sortedCorners.begin() + positionStart[p];
+                auto last = sortedCorners.begin() + positionStart[p + 1];
+                if(smoothingGroups != nullptr) {
+                    std::sort(first, last);
+                }
+                while(first != last) {
+                    auto runEnd = first;
+                    while((runEnd != last) && (runEnd->first == first->first)) {
+                        ++runEnd;
+                    }
+                    float runSum[3] = { 0, 0, 0 };
+                    if(!crease) {
+                        for(auto c = first; c != runEnd; ++c) {
+                            const float *n = &weighted[3 * (c->second / 3)];
+                            runSum[0] += n[0];
+                            runSum[1] += n[1];
+                            runSum[2] += n[2];
+                        }
+                    }
+                    for(auto c = first; c != runEnd; ++c) {
+                        uint32_t face = c->second / 3;
+                        const float *unit = &units[3 * face];
+                        float sum[3] = { runSum[0], runSum[1], runSum[2] };
+                        if(first->first == 0) {
+                            // Flat shading
+                            sum[0] = unit[0];
+                            sum[1] = unit[1];
+                            sum[2] = unit[2];
+                        } else if(crease) {
+                            for(auto other = first; other != runEnd; ++other) {
+                                uint32_t otherFace = other->second / 3;
+                                const float *otherUnit = &units[3 * otherFace];
+                                if((otherFace == face) ||
+                                   (unit[0] * otherUnit[0] + unit[1] * otherUnit[1] + unit[2] * otherUnit[2] >= minCosine)) {
+                                    const float *n = &weighted[3 * otherFace];
+                                    sum[0] += n[0];
+                                    sum[1] += n[1];
+                                    sum[2] += n[2];
+                                }
+                            }
+                        }
+                        float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+                        float *normal = &normals[3 * (size_t)c->second];
+                        if(length > 1e-20f) {
+                            normal[0] = sum[0] / length;
+                            normal[1] = sum[1] / length;
+                            normal[2] = sum[2] / length;
+                        } else {
+                            // Opposing faces cancelled out (or degenerate ones): use the own face
+                            normal[0] = unit[0];
+                            normal[1] = unit[1];
+                            normal[2] = unit[2];
+                        }
+                    }
+                    first = runEnd;
+                }
+            }
+        });
+    }
+}
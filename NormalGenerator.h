@@ -0,0 +1,120 @@
+//
+// Generation of area-weighted vertex normals for meshes without them (respecting smoothing groups).
+//
+
+#ifndef OBJMASTER_NORMALGENERATOR_H
+#define OBJMASTER_NORMALGENERATOR_H
+
+#include "ThreadPool.h"
+#include "objmasterlog.h"
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <stdint.h>
+
+namespace ObjMaster {
+
+    /**
+     * Generates one normal for each triangle corner. The normal of a corner is the sum of the
+     * (unnormalized, so area weighted) face normals of the triangles that share its position and
+     * its smoothing group - then normalized. Corners in smoothing group zero ('s off') get the
+     * normal of their own face (flat shading). With a crease angle, only the faces that are within
+     * that angle to the own face of the corner are summed, so hard edges stay hard even inside
+     * one smoothing group. The face normals are computed with SSE (four triangles at once) when
+     * the compiler targets it and both passes run in parallel chunks when a pool is given.
+     */
+    class NormalGenerator final {
+    public:
+        /** The crease angle (in degrees) used by ObjMeshObject::CREASE_NORMALS */
+        static constexpr float DEFAULT_CREASE_ANGLE = 60.0f;
+        /** Crease angles (in degrees) of at least this much mean smoothing without creases */
+        static constexpr float NO_CREASE_ANGLE = 180.0f;
+        /** Less triangles than this are always done on the calling thread */
+        static const unsigned int MIN_PARALLEL_TRIANGLES = 65536;
+
+        /**
+         * Generates the normals of the triangles. The x, y, z floats of position n are at
+         * positions + n * positionStride bytes and the three corners of triangle t refer to the
+         * positions corners[3 * t], corners[3 * t + 1] and corners[3 * t + 2]. The smoothing groups
+         * are given per triangle - nullptr means smoothing all triangles together. The normal of
+         * corner k is written to normals[3 * k .. 3 * k + 2] (so there are 9 floats per triangle).
+         * Corners of degenerate triangles with nothing to smooth with get a zero normal.
+         */
+        static void generateNormals(const float *positions, size_t positionStride, const uint32_t *corners,
+                unsigned int triangleCount, const unsigned int *smoothingGroups, float creaseAngle,
+                float *normals, ThreadPool *threadPool = nullptr);
+    };
+
+// Very simple unit-testing approach
+// it is better to have these run on the device itself and callable as normal functions than to
+// test it compile-time with some unit testing framework as this way we rule out architectural
+// differences better. Tests will start by logging test starts to error (when #DEBUG is set!)
+// and info logs and the method returns false when anything has failed...
+    static bool TEST_NormalGenerator() {
+#ifdef DEBUG
+        OMLOGI("TEST_NormalGenerator...");
+#endif
+        // The bottom and the front of a unit cube corner: two quads sharing the edge (0, 1)
+        const float positions[] = {
+            0, 0, 0,
+            1, 0, 0,
+            1, 0, -1,
+            0, 0, -1,
+            0, 1, 0,
+            1, 1, 0,
+        };
+        const uint32_t corners[] = {
+            0, 1, 2,  0, 2, 3,  // bottom (normal: +y as the winding is seen from above)
+            0, 1, 5,  0, 5, 4,  // front (normal: +z)
+        };
+        std::vector<float> normals(4 * 9);
+        const float invSqrt2 = 1.0f / std::sqrt(2.0f);
+
+        // Smoothed together: the shared corners get the halfway normal
+        NormalGenerator::generateNormals(positions, 3 * sizeof(float), corners, 4, nullptr,
+                NormalGenerator::NO_CREASE_ANGLE, &normals[0]);
+        const float *shared = &normals[0];
+        if((std::fabs(shared[0]) > 0.0001f) || (std::fabs(shared[1] - invSqrt2) > 0.0001f) ||
+           (std::fabs(shared[2] - invSqrt2) > 0.0001f)) {
+            OMLOGE("Bad smoothed normal: (%f, %f, %f)!", shared[0], shared[1], shared[2]);
+            return false;
+        }
+        const float *bottomOnly = &normals[3 * 2];
+        if((std::fabs(bottomOnly[1] - 1) > 0.0001f)) {
+            OMLOGE("Bad normal for a corner of only one face: (%f, %f, %f)!", bottomOnly[0], bottomOnly[1], bottomOnly[2]);
+            return false;
+        }
+
+        // The 90 degree edge is sharper than the crease angle and so are different smoothing groups
+        const unsigned int groups[] = { 1, 1, 2, 2 };
+        for(int pass = 0; pass < 2; ++pass) {
+            NormalGenerator::generateNormals(positions, 3 * sizeof(float), corners, 4, (pass == 0) ? nullptr : groups,
+                    (pass == 0) ? NormalGenerator::DEFAULT_CREASE_ANGLE : NormalGenerator::NO_CREASE_ANGLE, &normals[0]);
+            for(int k = 0; k < 12; ++k) {
+                const float *n = &normals[3 * k];
+                float expectedY = (k < 6) ? 1.0f : 0.0f;
+                if((std::fabs(n[0]) > 0.0001f) || (std::fabs(n[1] - expectedY) > 0.0001f) ||
+                   (std::fabs(n[2] - (1.0f - expectedY)) > 0.0001f)) {
+                    OMLOGE("Bad normal across a crease (pass %d, corner %d): (%f, %f, %f)!", pass, k, n[0], n[1], n[2]);
+                    return false;
+                }
+            }
+        }
+
+        // Group zero means flat shading
+        const unsigned int flat[] = { 0, 0, 0, 0 };
+        NormalGenerator::generateNormals(positions, 3 * sizeof(float), corners, 4, flat,
+                NormalGenerator::NO_CREASE_ANGLE, &normals[0]);
+        if((std::fabs(normals[1] - 1) > 0.0001f) || (std::fabs(normals[3 * 6 + 2] - 1) > 0.0001f)) {
+            OMLOGE("Bad flat normals!");
+            return false;
+        }
+
+#ifdef DEBUG
+        OMLOGI("...TEST_NormalGenerator completed (OK)");
+#endif
+        return true;
+    }
+}
+
+#endif //OBJMASTER_NORMALGENERATOR_H
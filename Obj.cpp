@@ -6,10 +6,17 @@
 #include "Obj.h"
 #include "UseMtl.h"
 #include "ObjectGroupElement.h"
+#include "ObjTokenizer.h"
+#include "LineReader.h"
+#include "ThreadPool.h"
 #include <fstream>
 #include <memory>
 #include <vector>
 #include <climits>
+#include <thread> /* hardware_concurrency */
+#include <algorithm> /* std::min */
+#include <cstring> /* memchr */
+#include <cstdlib> /* strtoul */
 
 #include <map> /* for saveAs *.obj compacting with ordered operations */
 
@@ -20,10 +27,13 @@
 
 namespace ObjMaster {
     Obj::Obj(const AssetLibrary &assetLibrary, const char *path, const char *fileName) {
-        constructionHelper(assetLibrary, path, fileName, Obj::EXPECTED_VERTEX_DATA_NUM, Obj::EXPECTED_FACES_NUM);
+        constructionHelper(assetLibrary, path, fileName, Obj::EXPECTED_VERTEX_DATA_NUM, Obj::EXPECTED_FACES_NUM, ObjLoadModeFlags::SERIAL_LOAD, 0);
     }
     Obj::Obj(const AssetLibrary &assetLibrary, const char *path, const char *fileName, int expectedVertexDataNum, int expectedFaceNum) {
-        constructionHelper(assetLibrary, path, fileName, expectedVertexDataNum, expectedFaceNum);
+        constructionHelper(assetLibrary, path, fileName, expectedVertexDataNum, expectedFaceNum, ObjLoadModeFlags::SERIAL_LOAD, 0);
+    }
+    Obj::Obj(const AssetLibrary &assetLibrary, const char *path, const char *fileName, ObjLoadModeFlags loadMode, int threadCount) {
+        constructionHelper(assetLibrary, path, fileName, Obj::EXPECTED_VERTEX_DATA_NUM, Obj::EXPECTED_FACES_NUM, loadMode, threadCount);
     }
     /** Save this MtlLib as a *.mtl - using the path, fileName and the provided asset-out library */
     void Obj::saveAs(const AssetOutputLibrary &assetOutputLibrary, const char* path, const char* fileName, bool saveAsMtlToo, ObjSaveModeFlags saveMode) {
@@ -81,7 +91,7 @@ namespace ObjMaster {
 	if((int)saveMode == ObjSaveModeFlags::ONLY_UNGROUPED_GEOMETRY) {
 		// Simplest case: only geometry - just write out faces
 		for(auto f : fs) {
-			auto line = f.asText();
+			auto line = f.asText(getFacePoints(f), f.facePointCount);
 			output->write(line.c_str(), line.length())<<'\n';
 		}
 	} else {
@@ -91,7 +101,7 @@ namespace ObjMaster {
 
 		// The sorting key should be either matName:err:groupName or groupName:mtl:matName according to mode!
 		// This ensures that those face elements we can compact together are near each other!
-		for(auto kv : objectMaterialGroups) {
+		for(auto &kv : objectMaterialGroups) {
 			if(((int)saveMode == ObjSaveModeFlags::GROUPS_GEOMETRY) ||
 			   ((int)saveMode == ObjSaveModeFlags::MATERIALS_AND_GROUPS)) {
 				// set the gbit here
@@ -99,15 +109,15 @@ namespace ObjMaster {
 					gbit = true; // indicate 'g' usage
 				}
 
-				// groupName:mtl:matName - it is already available
+				// groupName:mtl:matName
 				// Rem.: Both above cases we need to sort by groups basically!
-				std::string key = kv.first;
+				std::string key = getGroupName(kv.second);
 				sortedObjectMaterialGroups[key] = kv.second;
 			} else if((int)saveMode == ObjSaveModeFlags::MATERIALS_GEOMETRY) {
 				// matName:err:groupName
 				// Rem.: We use :err: deliberately to force ourself handling things as it should!
 				//       We cannot just save out these keys when generating real output - only used for sorting!
-				std::string key = kv.second.textureDataHoldingMaterial.name + ":err:" + kv.second.objectGroupName;
+				std::string key = getMaterialOf(kv.second).name + ":err:" + kv.second.objectGroupName;
 				sortedObjectMaterialGroups[key] = kv.second;
 			} else {
 				// This should never happen - unless someone breaks ObjMaster!
@@ -122,7 +132,7 @@ namespace ObjMaster {
 		int minStartFaceIndex = INT_MAX; // we do a min-search to see if there are faces that does not belong to any materials or groups!
 		constexpr int NO_MAT_FACE_GRP = INT_MAX; // If the minStartFaceIndex stays the INT_MAX it means there were no matFace groups at all!
 		for(auto skv : sortedObjectMaterialGroups) {
-			std::string &matName = skv.second.textureDataHoldingMaterial.name;
+			const std::string &matName = getMaterialOf(skv.second).name;
 			std::string &grpName = skv.second.objectGroupName;
 
 
@@ -163,7 +173,7 @@ namespace ObjMaster {
 			// Print out the faces for this material-face group
 			for(int i = 0; i < faceCount; ++i) {
 				auto f = fs[startFaceIndex + i];
-				auto line = f.asText();
+				auto line = f.asText(getFacePoints(f), f.facePointCount);
 				output->write(line.c_str(), line.length())<<'\n';
 			}
 		}
@@ -191,34 +201,205 @@ namespace ObjMaster {
 			// Simples case: only geometry - just write out faces until that point
 			for(int i = 0; i < ungroupmatFaceEndIndex; ++i) {
 				auto f = fs[i];
-				auto line = f.asText();
+				auto line = f.asText(getFacePoints(f), f.facePointCount);
 				output->write(line.c_str(), line.length())<<'\n';
 			}
 		}
 	}
     }
 
+    /** The kinds of lines we differentiate between when parsing or counting */
+    enum ObjLineKind { LINE_V, LINE_VT, LINE_VN, LINE_F, LINE_GROUPING, LINE_OTHER };
+
+    /**
+     * Tells the kind of the [line, lineEnd) line by dispatching on the first one or two bytes
+     * instead of trying all the isParsable(..) checks one after the other. The LINE_GROUPING
+     * result is only a cheap guess for the (o, g, usemtl) lines, the geometry kinds are exact.
+     */
+    static inline ObjLineKind getLineKind(const char *line, const char *lineEnd) {
+        const size_t len = (size_t)(lineEnd - line);
+        const char c0 = (len > 0) ? line[0] : 0;
+        const char c1 = (len > 1) ? line[1] : 0;
+        const char c2 = (len > 2) ? line[2] : 0;
+        switch(c0) {
+        case 'v':
+            if(ObjTokenizer::isBlank(c1)) return LINE_V;
+            if((c1 == 't') && ObjTokenizer::isBlank(c2)) return LINE_VT;
+            if((c1 == 'n') && ObjTokenizer::isBlank(c2)) return LINE_VN;
+            return LINE_OTHER;
+        case 'f':
+            return ObjTokenizer::isBlank(c1) ? LINE_F : LINE_OTHER;
+        case 'o':
+        case 'g':
+        case 'u':
+            return LINE_GROUPING;
+        default:
+            return LINE_OTHER;
+        }
+    }
+
+    /** Tells if the [line, lineEnd) line has nothing to parse in it (blank lines and comments) */
+    static inline bool isIgnorableLine(const char *line, const char *lineEnd) {
+        line = ObjTokenizer::skipSpaces(line, lineEnd);
+        return (line == lineEnd) || (*line == '#');
+    }
+
+    /**
+     * Tells if the [line, lineEnd) non-geometry line can be a state changing one (mtllib, usemtl,
+     * o, g or s) by its first byte - the exact checks are done when the line gets handled.
+     */
+    static inline bool isKeywordLineCandidate(const char *line, const char *lineEnd) {
+        const char c0 = (line < lineEnd) ? line[0] : 0;
+        return (c0 == 'm') || (c0 == 'u') || (c0 == 'o') || (c0 == 'g') || (c0 == 's');
+    }
+
+    /**
+     * Parses the line if it is a geometry element (v, vt, vn or f) into the given vectors and
+     * returns true. Returns false for every other line. Elements are parsed right out of the
+     * [line, lineEnd) range without copies.
+     */
+    static inline bool parseGeometryLine(const char *line, const char *lineEnd,
+                                         std::vector<VertexElement> &vs,
+                                         std::vector<VertexTextureElement> &vts,
+                                         std::vector<VertexNormalElement> &vns,
+                                         std::vector<FaceElement> &fs,
+                                         std::vector<FacePoint> &ngonFacePoints) {
+        switch(getLineKind(line, lineEnd)) {
+        case LINE_V:
+            // v
+            vs.emplace_back(line, lineEnd);
+#ifdef DEBUG
+OMLOGI(" - Added VertexElement: (%f, %f, %f)", vs.back().x, vs.back().y, vs.back().z);
+#endif
+            return true;
+        case LINE_VT:
+            // vt
+            vts.emplace_back(line, lineEnd);
+            return true;
+        case LINE_VN:
+            // vn
+            vns.emplace_back(line, lineEnd);
+            return true;
+        case LINE_F:
+            // f
+            // Rem.: The points of n-gons go to the face-point pool
+            fs.emplace_back(line, lineEnd, &ngonFacePoints);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    /** Count the elements of the given line in the counts */
+    static inline void countLine(const char *line, const char *lineEnd, ObjElementCounts &counts) {
+        switch(getLineKind(line, lineEnd)) {
+        case LINE_V: ++counts.vertexNum; break;
+        case LINE_VT: ++counts.vertexTextureNum; break;
+        case LINE_VN: ++counts.vertexNormalNum; break;
+        case LINE_F: ++counts.faceNum; break;
+        case LINE_GROUPING: ++counts.groupingLineNum; break;
+        default: break;
+        }
+    }
+
+    /** Counts the elements of the whole [begin, end) memory range */
+    static ObjElementCounts countElements(const char *begin, const char *end) {
+        ObjElementCounts counts;
+        counts.fileSize = (size_t)(end - begin);
+        LineReader reader(begin, counts.fileSize);
+        const char *line, *lineEnd;
+        while(reader.next(line, lineEnd)) {
+            countLine(line, lineEnd, counts);
+        }
+        return counts;
+    }
+
+    ObjElementCounts Obj::probe(const AssetLibrary &assetLibrary, const char *path, const char *fileName) {
+        std::unique_ptr<AssetMemory> memory = assetLibrary.getAssetMemory(path, fileName);
+        if(memory) {
+            return countElements(memory->data(), memory->data() + memory->size());
+        } else {
+            // Slower, but still better than a full load - at least nothing is parsed and kept
+            ObjElementCounts counts;
+            std::unique_ptr<std::istream> input = assetLibrary.getAssetStream(path, fileName);
+            if(input) {
+                LineReader reader(*input);
+                const char *line, *lineEnd;
+                while(reader.next(line, lineEnd)) {
+                    counts.fileSize += (size_t)(lineEnd - line) + 1;
+                    countLine(line, lineEnd, counts);
+                }
+            }
+            return counts;
+        }
+    }
+
+    /** A state changing line of a chunk that is handled when merging (see ObjParseChunk) */
+    struct KeywordLine {
+        /** The offset of the line in the file data */
+        size_t offset;
+        /** The length of the line (without the line end) */
+        size_t length;
+        /** The number of faces in the chunk before the line */
+        int facePos;
+    };
+
+    /** Holds the results of parsing one chunk of the file on a worker thread */
+    struct ObjParseChunk {
+        std::vector<VertexElement> vs;
+        std::vector<VertexTextureElement> vts;
+        std::vector<VertexNormalElement> vns;
+        std::vector<FaceElement> fs;
+        /** The n-gon face-points - the offsets in the faces are local to this chunk too! */
+        std::vector<FacePoint> ngonFacePoints;
+        /**
+         * The (mtllib, usemtl, o, g, s) lines in their order - as ranges of the mapped file data -
+         * and the number of faces in the chunk before them. These lines are handled serially when
+         * merging the chunks as they depend on the state (current material, group, loaded mtllib)
+         * left behind by earlier chunks.
+         */
+        std::vector<KeywordLine> keywordLines;
+    };
+
     // Helper function for common constructor code-paths
-    void Obj::constructionHelper(const AssetLibrary &assetLibrary, const char *path, const char *fileName, int expectedVertexDataNum, int expectedFaceNum) {
+    void Obj::constructionHelper(const AssetLibrary &assetLibrary, const char *path, const char *fileName, int expectedVertexDataNum, int expectedFaceNum, ObjLoadModeFlags loadMode, int threadCount) {
 	// Save the path of the file that will be opened
 	objPath = std::string(path);
-        OMLOGI("Opening input stream for %s%s", path, fileName);
-        std::unique_ptr<std::istream> input = assetLibrary.getAssetStream(path, fileName);
-
-        OMLOGI("Initializing data vectors (expectedVertexDataNum:%d, expectedFaceNum:%d)", expectedVertexDataNum, expectedFaceNum);
-        // Initialize vectors with some meaningful default sizes
-        vs = std::vector<VertexElement>();
-        vs.reserve(expectedVertexDataNum);
-        vts = std::vector<VertexTextureElement>();
-        vts.reserve(expectedVertexDataNum);
-        vns = std::vector<VertexNormalElement>();
-        vns.reserve(expectedVertexDataNum);
-        fs = std::vector<FaceElement>();
-        fs.reserve(expectedFaceNum);
-
-        // We are holding the current material in this variable
+
+        // Prefer parsing right out of the memory (mapped file) when the asset library supports that.
+        // This way there is no iostream machinery involved and the lines are not even copied.
+        std::unique_ptr<AssetMemory> memory = assetLibrary.getAssetMemory(path, fileName);
+
+        if(memory && (((int)loadMode & ObjLoadModeFlags::EXACT_PRESCAN) != 0)) {
+            // A quick pass over the (mapped) memory that only counts lines
+            // so that we never need to grow (and copy) the vectors when parsing
+            ObjElementCounts counts = countElements(memory->data(), memory->data() + memory->size());
+            OMLOGI("Initializing data vectors with exact sizes (vs:%d, vts:%d, vns:%d, fs:%d)",
+                   counts.vertexNum, counts.vertexTextureNum, counts.vertexNormalNum, counts.faceNum);
+            vs = std::vector<VertexElement>();
+            vs.reserve(counts.vertexNum);
+            vts = std::vector<VertexTextureElement>();
+            vts.reserve(counts.vertexTextureNum);
+            vns = std::vector<VertexNormalElement>();
+            vns.reserve(counts.vertexNormalNum);
+            fs = std::vector<FaceElement>();
+            fs.reserve(counts.faceNum);
+        } else {
+            OMLOGI("Initializing data vectors (expectedVertexDataNum:%d, expectedFaceNum:%d)", expectedVertexDataNum, expectedFaceNum);
+            // Initialize vectors with some meaningful default sizes
+            vs = std::vector<VertexElement>();
+            vs.reserve(expectedVertexDataNum);
+            vts = std::vector<VertexTextureElement>();
+            vts.reserve(expectedVertexDataNum);
+            vns = std::vector<VertexNormalElement>();
+            vns.reserve(expectedVertexDataNum);
+            fs = std::vector<FaceElement>();
+            fs.reserve(expectedFaceNum);
+        }
+
+        // We are holding the id of the current material in this variable
         // Can be updated by usemtl descriptors!
-        TextureDataHoldingMaterial currentMaterial;
+        uint32_t currentMaterialId = MtlLib::NO_MATERIAL;
         // We are holding the name of the current object/group here. In case there is no group
         // this can be safely the empty string.
         std::string currentObjectGroupName;
@@ -229,57 +410,46 @@ namespace ObjMaster {
         // various cases below
         int currentLastFacesPointer = 0;
 
-        // Parse the given file line-by-line
-        OMLOGI("Reading obj data file line-by-line");
-        char line[DEFAULT_LINE_PARSE_LEN];
-        while(input->getline(line, DEFAULT_LINE_PARSE_LEN)) {
-            currentLastFacesPointer =( int)fs.size();;
-            if(VertexElement::isParsable(line)) {
-                // v
-                VertexElement v = VertexElement((const char*)line);
-                vs.push_back(v);
-#ifdef DEBUG
-OMLOGI(" - Added VertexElement: (%f, %f, %f)", v.x, v.y, v.z);
-#endif
-            } else if(VertexTextureElement::isParsable(line)) {
-                // vt
-                vts.push_back(VertexTextureElement((const char*)line));
-            } else if(VertexNormalElement::isParsable(line)) {
-                // vn
-                vns.push_back(VertexNormalElement((const char*)line));
-            } else if(FaceElement::isParsable(line)) {
-		// TODO: implement N-gons here 
-                // f
-                fs.push_back(FaceElement((const char*)line));
-            } else if(MtlLib::isParsable(line)) {
+        // Handle one non-geometry line given as a [line, lineEnd) range. The facePos is the number
+        // of faces that were before this line in the whole file. These lines are rare, so it is
+        // fine to copy them to a string for the (zero terminated) parsers.
+        auto parseKeywordLine = [&](const char *line, const char *lineEnd, int facePos) {
+            currentLastFacesPointer = facePos;
+            const size_t len = (size_t)(lineEnd - line);
+            const char c0 = (len > 0) ? line[0] : 0;
+            const char c1 = (len > 1) ? line[1] : 0;
+            if((c0 == 'm') && ObjTokenizer::isKeyword(line, lineEnd, MtlLib::KEYWORD.c_str())) {
                 // mtllib
-                mtlLib = MtlLib(line, path, assetLibrary);
-            } else if(UseMtl::isParsable(line)) {
+                std::string lineStr(line, lineEnd);
+                currentMaterialId = replaceMtlLib(MtlLib(lineStr.c_str(), path, assetLibrary), currentMaterialId);
+            } else if((c0 == 'u') && ObjTokenizer::isKeyword(line, lineEnd, "usemtl")) {
                 // usemtl
+                std::string lineStr(line, lineEnd);
                 // End the collection of the currentObjectMaterialFaceGroup
                 extendObjectMaterialGroups(currentObjectGroupName,
-                                           currentMaterial,
+                                           currentMaterialId,
                                            currentObjectMaterialFacesPointer,
                                            currentLastFacesPointer - currentObjectMaterialFacesPointer);
 
-                // Rem.: This copy is cheap as it does not contain texture data etc!
-                currentMaterial = mtlLib.getNonLoadedMaterialFor(UseMtl::fetchMtlName(line));
+                // Rem.: Only the id is kept - the groups refer to the material in the library
+                currentMaterialId = mtlLib.getOrCreateMaterialId(UseMtl::fetchMtlName(lineStr.c_str()));
 #ifdef DEBUG
-OMLOGI(" - Using current-material: %s", currentMaterial.name);
+OMLOGI(" - Using current-material: %s", mtlLib.getMaterial(currentMaterialId).name.c_str());
 #endif
                 // Set the current face start pointer to the current position
                 // so that the faces will be "collected" for the group
                 // BEWARE: This let us overindex the array if no faces are coming!!!
                 //         We need to check this overindexint below!
-                currentObjectMaterialFacesPointer = (int)fs.size();
-            } else if(ObjectGroupElement::isParsable(line)) {
+                currentObjectMaterialFacesPointer = facePos;
+            } else if(((c0 == 'o') || (c0 == 'g')) && (c1 == ' ')) {
                 // o
+                std::string lineStr(line, lineEnd);
                 // End the collection of the currentObjectMaterialFaceGroup
                 extendObjectMaterialGroups(currentObjectGroupName,
-                                           currentMaterial,
+                                           currentMaterialId,
                                            currentObjectMaterialFacesPointer,
                                            currentLastFacesPointer - currentObjectMaterialFacesPointer);
-                currentObjectGroupName = ObjectGroupElement::getObjectGroupName(line);
+                currentObjectGroupName = ObjectGroupElement::getObjectGroupName(lineStr.c_str());
 #ifdef DEBUG
 OMLOGI(" - Start of object group: %s", currentObjectGroupName);
 #endif
@@ -287,16 +457,147 @@ OMLOGI(" - Start of object group: %s", currentObjectGroupName);
                 // so that the faces will be "collected" for the group
                 // BEWARE: This let us overindex the array if no faces are coming!!!
                 //         We need to check this overindexint below!
-                currentObjectMaterialFacesPointer = (int)fs.size();
+                currentObjectMaterialFacesPointer = facePos;
+            } else if((c0 == 's') && ObjTokenizer::isBlank(c1)) {
+                // s - "s off" is the same as "s 0"
+                std::string lineStr(line, lineEnd);
+                const char *value = ObjTokenizer::skipSpaces(lineStr.c_str() + 1, lineStr.c_str() + lineStr.length());
+                unsigned int group = (strncmp(value, "off", 3) == 0) ? 0 : (unsigned int)strtoul(value, nullptr, 10);
+                if(!smoothingGroupStarts.empty() && (smoothingGroupStarts.back().faceIndex == facePos)) {
+                    // No faces in the previous group
+                    smoothingGroupStarts.pop_back();
+                }
+                unsigned int previousGroup = smoothingGroupStarts.empty() ?
+                        DEFAULT_SMOOTHING_GROUP : smoothingGroupStarts.back().smoothingGroup;
+                if(group != previousGroup) {
+                    smoothingGroupStarts.push_back(SmoothingGroupStart { facePos, group });
+                }
+            } else {
+                OMLOGW("Cannot parse line: %.*s", (int)len, line);
+            }
+        };
+
+        // Parse all the lines of the reader (lines are given as ranges - no zero terminator needed).
+        auto parseLines = [&](LineReader &reader) {
+            const char *line, *lineEnd;
+            while(reader.next(line, lineEnd)) {
+                if(!parseGeometryLine(line, lineEnd, vs, vts, vns, fs, ngonFacePoints) && !isIgnorableLine(line, lineEnd)) {
+                    parseKeywordLine(line, lineEnd, (int)fs.size());
+                }
+            }
+        };
+
+        if(memory) {
+            const char *begin = memory->data();
+            const char *end = begin + memory->size();
+
+            // Decide the number of chunks for parallel parsing - small files are not worth it
+            int chunkNum = 1;
+            if(((int)loadMode & ObjLoadModeFlags::PARALLEL_PARSE) != 0) {
+                if(threadCount <= 0) {
+                    threadCount = (int)std::thread::hardware_concurrency();
+                    size_t maxChunks = memory->size() / MIN_PARALLEL_PARSE_CHUNK_SIZE;
+                    if((size_t)threadCount > maxChunks) threadCount = (int)maxChunks;
+                }
+                chunkNum = (threadCount > 1) ? threadCount : 1;
+            }
+
+            if(chunkNum <= 1) {
+                OMLOGI("Reading obj data from memory line-by-line");
+                LineReader reader(begin, memory->size());
+                parseLines(reader);
             } else {
-                OMLOGW("Cannot parse line: %s", line);
+                OMLOGI("Reading obj data from memory using %d parallel chunks", chunkNum);
+                // Split the data to chunks on line boundaries
+                std::vector<const char*> bounds;
+                bounds.push_back(begin);
+                for(int i = 1; i < chunkNum; ++i) {
+                    const char *b = begin + (memory->size() * i) / chunkNum;
+                    if(b < bounds.back()) b = bounds.back();
+                    const char *eol = (const char*)memchr(b, '\n', end - b);
+                    bounds.push_back((eol != nullptr) ? (eol + 1) : end);
+                }
+                bounds.push_back(end);
+
+                // Parse all the chunks in parallel on a pool
+                std::vector<ObjParseChunk> chunks(chunkNum);
+                // Rem.: Only the state changing lines are kept for the merge (as offsets - no copies),
+                //      the workers drop the blank and comment lines and warn about the rest themselves.
+                auto parseChunk = [begin, &bounds, &chunks](int i) {
+                    ObjParseChunk &chunk = chunks[i];
+                    LineReader reader(bounds[i], (size_t)(bounds[i + 1] - bounds[i]));
+                    const char *line, *lineEnd;
+                    while(reader.next(line, lineEnd)) {
+                        if(parseGeometryLine(line, lineEnd, chunk.vs, chunk.vts, chunk.vns, chunk.fs, chunk.ngonFacePoints)
+                           || isIgnorableLine(line, lineEnd)) {
+                            continue;
+                        }
+                        if(isKeywordLineCandidate(line, lineEnd)) {
+                            chunk.keywordLines.push_back(KeywordLine { (size_t)(line - begin), (size_t)(lineEnd - line), (int)chunk.fs.size() });
+                        } else {
+                            OMLOGW("Cannot parse line: %.*s", (int)(lineEnd - line), line);
+                        }
+                    }
+                };
+                // Rem.: The chunks are the tasks - there are never more threads than the hardware has
+                int hardwareThreads = (int)std::thread::hardware_concurrency();
+                ThreadPool pool((hardwareThreads > 0) ? std::min(chunkNum, hardwareThreads) : chunkNum);
+                pool.parallelFor(chunkNum, parseChunk);
+
+                // Merge the chunks in their order
+                size_t vsNum = vs.size(), vtsNum = vts.size(), vnsNum = vns.size(), fsNum = fs.size();
+                for(auto &chunk : chunks) {
+                    vsNum += chunk.vs.size();
+                    vtsNum += chunk.vts.size();
+                    vnsNum += chunk.vns.size();
+                    fsNum += chunk.fs.size();
+                }
+                vs.reserve(vsNum);
+                vts.reserve(vtsNum);
+                vns.reserve(vnsNum);
+                fs.reserve(fsNum);
+                for(auto &chunk : chunks) {
+                    // Face indices refer to the whole file already - only the group face
+                    // positions are chunk-local so those get rebased with the earlier face count
+                    int faceBase = (int)fs.size();
+                    vs.insert(vs.end(), chunk.vs.begin(), chunk.vs.end());
+                    vts.insert(vts.end(), chunk.vts.begin(), chunk.vts.end());
+                    vns.insert(vns.end(), chunk.vns.begin(), chunk.vns.end());
+                    fs.insert(fs.end(), chunk.fs.begin(), chunk.fs.end());
+                    // The n-gon point offsets are chunk-local too - rebase them to the common pool
+                    if(!chunk.ngonFacePoints.empty()) {
+                        int ngonBase = (int)ngonFacePoints.size();
+                        ngonFacePoints.insert(ngonFacePoints.end(), chunk.ngonFacePoints.begin(), chunk.ngonFacePoints.end());
+                        for(size_t i = (size_t)faceBase; i < fs.size(); ++i) {
+                            if(fs[i].isNgon()) {
+                                fs[i].ngonFacePointIndex += ngonBase;
+                            }
+                        }
+                    }
+                    // Replay the state changing lines just like the serial parsing would do
+                    for(auto &keywordLine : chunk.keywordLines) {
+                        const char *line = begin + keywordLine.offset;
+                        parseKeywordLine(line, line + keywordLine.length, faceBase + keywordLine.facePos);
+                    }
+                    // Free the chunk memory as soon as possible
+                    chunk = ObjParseChunk();
+                }
             }
+        } else {
+            OMLOGI("Opening input stream for %s%s", path, fileName);
+            std::unique_ptr<std::istream> input = assetLibrary.getAssetStream(path, fileName);
+
+            // Parse the given file line-by-line
+            // Rem.: Lines longer than DEFAULT_LINE_PARSE_LEN are supported too
+            OMLOGI("Reading obj data file line-by-line");
+            LineReader reader(*input);
+            parseLines(reader);
         }
         // End the collection of the currentObjectMaterialFaceGroup by extending with the elements
         // of the last obj/material group (and pointer update is necessary here too!)
         currentLastFacesPointer = (int)fs.size();
         extendObjectMaterialGroups(currentObjectGroupName,
-                                   currentMaterial,
+                                   currentMaterialId,
                                    currentObjectMaterialFacesPointer,
                                    currentLastFacesPointer - currentObjectMaterialFacesPointer);
 
@@ -313,20 +614,40 @@ OMLOGI(" - Start of object group: %s", currentObjectGroupName);
      * Helper method used to extend the material face groups with the given data.
      */
     void Obj::extendObjectMaterialGroups(std::string &currentObjectGroupName,
-                                    TextureDataHoldingMaterial &currentMaterial,
+                                    uint32_t currentMaterialId,
                                     int currentObjectMaterialFacesPointer,
                                     int sizeOfFaceStripe) {
         // If the size is zero, we are not saving the group
         // this is not only an optimization, but this is how we handle mtllib ...; o ... after each
         // other (so that we are not creating a lot of empty and unnecessary elements!)
         if (sizeOfFaceStripe > 0) {
-            this->objectMaterialGroups[currentObjectGroupName + MAT_SEP + currentMaterial.name]
+            // Rem.: The key is made of ids - no name concatenation or material lookup for it
+            uint32_t objectGroupId = objectGroupIds.emplace(currentObjectGroupName, (uint32_t)objectGroupIds.size()).first->second;
+            this->objectMaterialGroups[ObjectMaterialFaceGroup::keyOf(objectGroupId, currentMaterialId)]
                = ObjectMaterialFaceGroup {
                     currentObjectGroupName,
-                    currentMaterial,
+                    currentMaterialId,
                     currentObjectMaterialFacesPointer,
                     sizeOfFaceStripe
                 };
         }
     }
+
+    std::string Obj::getGroupName(const ObjectMaterialFaceGroup &group) const {
+        return group.objectGroupName + MAT_SEP + getMaterialOf(group).name;
+    }
+
+    uint32_t Obj::replaceMtlLib(MtlLib &&newMtlLib, uint32_t currentMaterialId) {
+        // Rem.: The usual obj has its mtllib before any usemtl, so there is nothing to import then
+        for(auto &gPair : objectMaterialGroups) {
+            if(gPair.second.materialId != MtlLib::NO_MATERIAL) {
+                gPair.second.materialId = newMtlLib.importMaterial(mtlLib, gPair.second.materialId);
+            }
+        }
+        if(currentMaterialId != MtlLib::NO_MATERIAL) {
+            currentMaterialId = newMtlLib.importMaterial(mtlLib, currentMaterialId);
+        }
+        mtlLib = std::move(newMtlLib);
+        return currentMaterialId;
+    }
 }
@@ -10,15 +10,43 @@
 #include "VertexTextureElement.h"
 #include "VertexNormalElement.h"
 #include "FaceElement.h"
+#include "ObjTokenizer.h"
 #include "ObjCommon.h"
 #include "AssetLibrary.h"
 #include "MtlLib.h"
+#include <algorithm>
 #include <memory>
 #include <vector>
 #include <unordered_map>
 
 namespace ObjMaster {
 
+    /** Number of the various elements in an *.obj file. See Obj::probe(..) */
+    struct ObjElementCounts {
+        int vertexNum = 0;
+        int vertexTextureNum = 0;
+        int vertexNormalNum = 0;
+        int faceNum = 0;
+        /** Number of lines that look like 'o', 'g' or 'usemtl' - an upper bound for the groups */
+        int groupingLineNum = 0;
+        /** Size of the whole *.obj file in bytes */
+        size_t fileSize = 0;
+
+        /** Gets how many bytes the geometry data of an Obj with these counts would need */
+        inline size_t getGeometryDataSize() const {
+            return (size_t)vertexNum * sizeof(VertexElement)
+                + (size_t)vertexTextureNum * sizeof(VertexTextureElement)
+                + (size_t)vertexNormalNum * sizeof(VertexNormalElement)
+                + (size_t)faceNum * sizeof(FaceElement);
+        }
+    };
+
+    /** The smoothing group of the faces from faceIndex on - see Obj::getSmoothingGroup(..) */
+    struct SmoothingGroupStart {
+        int faceIndex;
+        unsigned int smoothingGroup;
+    };
+
     /**
      * Represents a *.obj file. The semantic structure of the object is the same as the file. So
      * the resulting representation after parsing is generally still not feasible for rendering.
@@ -32,12 +60,60 @@ namespace ObjMaster {
         static const int EXPECTED_VERTEX_DATA_NUM = 256;
         /** Used to initialize the vectorfor faces - should be reasonable for usual models */
         static const int EXPECTED_FACES_NUM = 128;
+        /** Parallel parsing does not use more threads than what gives this many bytes to each */
+        static const int MIN_PARALLEL_PARSE_CHUNK_SIZE = 1024 * 1024;
+        /**
+         * Smoothing group of the faces before the first 's' line (and of all faces of files
+         * without them): these are all smoothed together when normals are generated.
+         */
+        static const unsigned int DEFAULT_SMOOTHING_GROUP = (unsigned int)-1;
+
+	// Rem.: bit trickery here
+	/** Defines the loading mode */
+	enum ObjLoadModeFlags{
+		/** Parse the file line-by-line on the calling thread */
+		SERIAL_LOAD = 0,
+		/**
+		 * Split the file to chunks on line boundaries and parse those on worker threads. The
+		 * result is the very same as with serial loading. Only works when the asset library can
+		 * provide the asset as memory - otherwise we silently fall back to serial loading.
+		 */
+		PARALLEL_PARSE = 1,
+		/**
+		 * Count the lines first with a quick pass and reserve exact capacities for the data
+		 * vectors instead of growing them from the expected sizes. Only works when the asset
+		 * library can provide the asset as memory - otherwise the expectations are used.
+		 */
+		EXACT_PRESCAN = 2,
+		/** Both of the above */
+		PARALLEL_PARSE_EXACT_PRESCAN = 1+2,
+	};
 
 	// Various geometry elements 
         std::vector<VertexElement> vs;
         std::vector<VertexTextureElement> vts;
         std::vector<VertexNormalElement> vns;
         std::vector<FaceElement> fs;
+	/** Face-point pool holding all the points of the n-gon faces. See FaceElement::ngonFacePointIndex */
+	std::vector<FacePoint> ngonFacePoints;
+
+	/** Gets the (facePointCount) points of the given face - works for both triangles and n-gons */
+	inline const FacePoint* getFacePoints(const FaceElement &face) const {
+		return face.isNgon() ? &ngonFacePoints[face.ngonFacePointIndex] : face.facePoints;
+	}
+
+	/**
+	 * Where the 's' lines changed the smoothing group - ordered by faceIndex and empty when the
+	 * file has no such lines. Only used for generating normals (and not written by saveAs).
+	 */
+	std::vector<SmoothingGroupStart> smoothingGroupStarts;
+
+	/** Gets the smoothing group of the given face: zero means 's off' (flat shading) */
+	inline unsigned int getSmoothingGroup(int faceIndex) const {
+		auto next = std::upper_bound(smoothingGroupStarts.begin(), smoothingGroupStarts.end(), faceIndex,
+				[](int index, const SmoothingGroupStart &start) { return index < start.faceIndex; });
+		return (next == smoothingGroupStarts.begin()) ? DEFAULT_SMOOTHING_GROUP : (next - 1)->smoothingGroup;
+	}
 
 	/** The given path - saved on construction made nullptr in case of runtime generated or copied objects */
 	std::string objPath;
@@ -45,8 +121,20 @@ namespace ObjMaster {
         /** The material library for this obj. It can be an empty material library. */
         MtlLib mtlLib;
 
-        /** (objectgroup-name:material-name) -> (objectgroup-name, material, faces) */
-        std::unordered_map<std::string, ObjectMaterialFaceGroup> objectMaterialGroups;
+        /**
+         * ObjectMaterialFaceGroup::keyOf(objectgroup-name id, material id) -> (objectgroup-name, material id, faces)
+         * The objectgroup-name ids are given in the order of the first groups of the names - see
+         * getGroupName for the display names of the groups.
+         */
+        std::unordered_map<uint64_t, ObjectMaterialFaceGroup> objectMaterialGroups;
+
+	/** Returns the (non-loaded) material of the group from the material library - an empty one when it has none */
+	inline const TextureDataHoldingMaterial& getMaterialOf(const ObjectMaterialFaceGroup &group) const {
+		return mtlLib.getMaterial(group.materialId);
+	}
+
+	/** Returns the display name of the group: objectgroup-name:mtl:material-name */
+	std::string getGroupName(const ObjectMaterialFaceGroup &group) const;
 
 	/** Create an empty - non-loaded - obj representation */
 	Obj() {}
@@ -61,6 +149,8 @@ namespace ObjMaster {
         /**
          * Creates an Obj for the given asset. The given asset library is only used for construction
          * and is not stored so the ownership of the referenced object stays at the host code!
+         * If the asset library can provide the asset as memory (see AssetLibrary::getAssetMemory)
+         * the file is parsed right out of that (mapped) memory, otherwise we read it as a stream.
          */
         Obj(const AssetLibrary &assetLibrary, const char* path, const char* fileName);
 
@@ -75,6 +165,23 @@ namespace ObjMaster {
         Obj(const AssetLibrary &assetLibrary, const char *path, const char *fileName,
             int expectedVertexDataNum, int expectedFaceNum);
 
+        /**
+         * Creates an Obj for the given asset using the given loading mode. The threadCount is
+         * only used for parallel parsing: zero means using the hardware concurrency (but without
+         * making chunks smaller than MIN_PARALLEL_PARSE_CHUNK_SIZE), otherwise exactly the given
+         * number of chunks are parsed in parallel (on a ThreadPool of at most as many threads as
+         * the hardware has).
+         */
+        Obj(const AssetLibrary &assetLibrary, const char *path, const char *fileName,
+            ObjLoadModeFlags loadMode, int threadCount = 0);
+
+        /**
+         * Counts the elements of the given asset without parsing and keeping them. This is cheap
+         * (especially for memory mapped assets) so callers can use it to budget memory before
+         * committing to a load. The asset library is only used while this call is running.
+         */
+        static ObjElementCounts probe(const AssetLibrary &assetLibrary, const char *path, const char *fileName);
+
 	// Rem.: bit trickery here
 	/** Defines the saving mode */
 	enum ObjSaveModeFlags{
@@ -104,18 +211,29 @@ namespace ObjMaster {
 	/** Save this Obj as an (absolute) *.obj - using the given path, fileName and the provided asset-out library. By default this also saves the *.mtl */
 	void saveAs(const AssetOutputLibrary &assetOutputLibrary, const char* path, const char* fileName, bool saveAsMtlToo = true, ObjSaveModeFlags saveMode = ObjSaveModeFlags::MATERIALS_AND_GROUPS);
     private:
+        /** The ids of the objectgroup-names used in the keys of objectMaterialGroups */
+        std::unordered_map<std::string, uint32_t> objectGroupIds;
+
         void constructionHelper(const AssetLibrary &assetLibrary,
                             const char *path, const char *fileName,
-                            int expectedVertexDataNum, int expectedFaceNum);
+                            int expectedVertexDataNum, int expectedFaceNum,
+                            ObjLoadModeFlags loadMode, int threadCount);
 
         /**
          * Helper method used to extend the material face groups with the given data.
          */
         void extendObjectMaterialGroups(std::string &currentObjectGroupName,
-                                        TextureDataHoldingMaterial &currentMaterial,
+                                        uint32_t currentMaterialId,
                                         int currentObjectMaterialFacesPointer,
                                         int sizeOfFaceStripe);
 
+        /**
+         * Replaces the material library - the groups that are already there keep their materials
+         * (see MtlLib::importMaterial) as they refer to the materials by id. Returns the new id of
+         * the given (current) material id.
+         */
+        uint32_t replaceMtlLib(MtlLib &&newMtlLib, uint32_t currentMaterialId);
+
 	friend class ObjCreator;
     };
 
@@ -130,6 +248,7 @@ namespace ObjMaster {
         res &= ObjMaster::TEST_VertexTextureElement();
         res &= ObjMaster::TEST_FaceElement();
         res &= ObjMaster::TEST_FacePoint();
+        res &= ObjMaster::TEST_ObjTokenizer();
 #ifdef DEBUG
         OMLOGI("...TEST_Obj ended!");
 #endif
@@ -2,7 +2,10 @@
 #define _OBJ_COMMON_H
 
 namespace ObjMaster {
-    /** This is the maximum line length used for the line-by-line parsing */
+    /**
+     * This is the line buffer size used for the line-by-line parsing. Longer lines are supported
+     * too (see LineReader), but those need a (reused) heap buffer so this should fit most lines.
+     */
     static const int DEFAULT_LINE_PARSE_LEN = 256;
     /** The most usual delimiter in the obj file */
     static char const *OBJ_DELIMITER = " ";
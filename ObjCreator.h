@@ -146,9 +146,9 @@ namespace ObjMaster {
 		// Material library handling
 		// -------------------------
 
-		/** Set the whole MtlLib to the given one */
+		/** Set the whole MtlLib to the given one - the already finished groups keep their materials (see Obj::replaceMtlLib) */
 		inline void overWriteMtlLib(MtlLib newMtlLib) {
-			obj->mtlLib = newMtlLib;
+			obj->replaceMtlLib(std::move(newMtlLib), MtlLib::NO_MATERIAL);
 		}
 
 		/** Add new material to the material lib */
@@ -378,16 +378,16 @@ namespace ObjMaster {
 
 		/** Close down the currently opened group */
 		inline void finishCurrentGroup() {
-			// Lookup currently used material (if there is any)
-			TextureDataHoldingMaterial currentMat;
+			// Lookup the id of the currently used material (if there is any)
+			uint32_t currentMatId = MtlLib::NO_MATERIAL;
 			if(currentMatName != "") {
-				// Rem.: Implementation uses "operator[]" so this adds a new empty material
-				//       in case a bad name is provided! This is a sensible fallback here!
-				currentMat = obj->mtlLib.getNonLoadedMaterialFor(currentMatName);
+				// Rem.: This adds a new empty material in case a bad name is provided!
+				//       This is a sensible fallback here!
+				currentMatId = obj->mtlLib.getOrCreateMaterialId(currentMatName);
 			}
 			// Extend the material face groups with the group we are closing down right now
 			obj->extendObjectMaterialGroups(currentGrpName,
-							currentMat,
+							currentMatId,
 							currentObjMatFaceGroupStart, // this is the old here still!
 							obj->fs.size() - currentObjMatFaceGroupStart); // length!
 			// Next one will start exactly where we are now
@@ -1,19 +1,32 @@
 //
 // Created by rthier on 2016.04.12..
-// TODO: In multi-mesh cases the indexing is suboptimal as there can be duplications between meshes (only when they reuse vertices between two mesh - not horrible)
+// Rem.: Meshes built into separate (or shared, but not SharedMeshBuffers) vectors can duplicate the vertices they have in common
 
 // Un-comment in case of hard debugging
 /*#define DEBUG*/
 
 #include "objmasterlog.h"
 #include "ObjMeshObject.h"
+#include "PolygonTriangulator.h"
+#include "MeshOptimizer.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include "MeshBounds.h"
+#include "NormalGenerator.h"
+#include "TangentGenerator.h"
+#include "VertexCompression.h"
+#include "LayoutMeshObject.h"
 #include <memory>
-#include <unordered_map> // for hashing
+#include "VertexDedupTable.h" // for hashing
+#include "ThreadPool.h"
+#include <thread> // hardware_concurrency
+#include <cstring> // memcpy
 #include <vector> // for list-handling
 #include "VertexStructure.h"
 #include <algorithm> // for std::swap
+#include <unordered_map> // re-stored vertices of shared buffers
 
-// Used as key for hashing
+// Used as key for hashing when de-duplicating by value
 struct IndexTargetSlice {
     IndexTargetSlice(const ObjMaster::VertexElement *v_,
                      const ObjMaster::VertexTextureElement *vt_,
@@ -63,63 +76,481 @@ struct IndexTargetSlice {
 
 	return vBool && vnBool && vtBool;
     }
+
+    // Necessary for hashing - must be consistent with the operator== above!
+    uint64_t hash() const {
+        // Missing elements get a value that no float bit-pattern pair can give
+        const uint64_t MISSING = (uint64_t)-1;
+        uint64_t h = 0;
+        if(v != nullptr) {
+            h = ObjMaster::dedupCombine(h, ObjMaster::dedupFloatBits(v->x) | (ObjMaster::dedupFloatBits(v->y) << 32));
+            h = ObjMaster::dedupCombine(h, ObjMaster::dedupFloatBits(v->z));
+        } else {
+            h = ObjMaster::dedupCombine(h, MISSING);
+        }
+        h = ObjMaster::dedupCombine(h, (vt != nullptr) ? (ObjMaster::dedupFloatBits(vt->u) | (ObjMaster::dedupFloatBits(vt->v) << 32)) : MISSING);
+        if(vn != nullptr) {
+            h = ObjMaster::dedupCombine(h, ObjMaster::dedupFloatBits(vn->x) | (ObjMaster::dedupFloatBits(vn->y) << 32));
+            h = ObjMaster::dedupCombine(h, ObjMaster::dedupFloatBits(vn->z));
+        } else {
+            h = ObjMaster::dedupCombine(h, MISSING);
+        }
+        return ObjMaster::dedupMix64(h);
+    }
 };
 
-// Custom specialization of std::hash can be injected in namespace std
-namespace std
-{
-    template<> struct hash<IndexTargetSlice>
-    {
-        typedef IndexTargetSlice argument_type;
-        typedef std::size_t result_type;
-        result_type operator()(argument_type const& s) const
-        {
-            result_type hv1 = 0;
-            result_type hv2 = 0;
-            result_type hv3 = 0;
-	    if(s.v != nullptr) {
-		    hv1 = std::hash<float>()(s.v->x);
-		    hv2 = std::hash<float>()(s.v->y);
-		    hv3 = std::hash<float>()(s.v->z);
-	    }
-
-            result_type hvn1 = 0;
-            result_type hvn2 = 0;
-            result_type hvn3 = 0;
-	    if(s.vn != nullptr) {
-		    hvn1 = std::hash<float>()(s.vn->x);
-		    hvn2 = std::hash<float>()(s.vn->y);
-		    hvn3 = std::hash<float>()(s.vn->z);
-	    }
-
-            result_type hvt1 = 0;
-            result_type hvt2 = 0;
-	    if(s.vt != nullptr) {
-		    hvt1 = std::hash<float>()(s.vt->u);
-		    hvt2 = std::hash<float>()(s.vt->v);
-	    }
-
-            return (hv1 ^ (hv2 << 1)) ^ (hv3 << 1) ^
-                   ((hvn1 ^ (hvn2 << 1)) ^ (hvn3 << 1)) ^
-                   ((hvt1) ^ (hvt2 << 1));
+namespace ObjMaster {
+
+    /** Create pointers to the target data of the face-point (missing elements become nullptr) */
+    static inline IndexTargetSlice sliceFor(const Obj &obj, const FacePoint &fp) {
+        // -1 indicates a missing element so we handle it as if there is one!
+        // Rem.: The real representation type is unsigned so basically the special value is not -1, but the unsigned int max value!
+        //       because of this is why we are casting the value to unsigned int. Just to be sure we that it happens as we imagine!
+        return IndexTargetSlice(
+                (fp.vIndex != (unsigned int)(-1) ? &obj.vs[fp.vIndex] : nullptr),
+                (fp.vtIndex != (unsigned int)(-1) ? &obj.vts[fp.vtIndex] : nullptr),
+                (fp.vnIndex != (unsigned int)(-1) ? &obj.vns[fp.vnIndex] : nullptr));
+    }
+
+    /**
+     * Creates the slices of the face-points like sliceFor(..), but the vnIndex values from
+     * obj.vns.size() on refer to the generatedNormals (see GENERATE_NORMALS).
+     */
+    struct FacePointSlicer {
+        const VertexNormalElement *generatedNormals;
+
+        inline IndexTargetSlice operator()(const Obj &obj, const FacePoint &fp) const {
+            if((fp.vnIndex == (unsigned int)(-1)) || (fp.vnIndex < obj.vns.size())) {
+                return sliceFor(obj, fp);
+            }
+            IndexTargetSlice its = sliceFor(obj, FacePoint(fp.vIndex, fp.vtIndex, (unsigned int)(-1)));
+            its.vn = &generatedNormals[fp.vnIndex - obj.vns.size()];
+            return its;
         }
     };
-}
 
+    /** Create the vertex data for the vertical slice - missing position, normal or uv data becomes zero */
+    static inline VertexStructure makeVertex(const IndexTargetSlice &its) {
+        return VertexStructure {
+                its.v != nullptr ? its.v->x : 0,
+                its.v != nullptr ? its.v->y : 0,
+                its.v != nullptr ? its.v->z : 0,
+                its.vn != nullptr ? its.vn->x : 0,
+                its.vn != nullptr ? its.vn->y : 0,
+                its.vn != nullptr ? its.vn->z : 0,
+                its.vt != nullptr ? its.vt->u : 0,
+                its.vt != nullptr ? its.vt->v : 0};
+    }
 
-namespace ObjMaster {
+    /** The by value key of the vertex of the slice - that keeps which elements are missing (unlike the vertex) */
+    static inline PresenceVertexKey<VertexStructure> presenceKeyFor(const IndexTargetSlice &its, const VertexStructure &vertex) {
+        typedef PresenceVertexKey<VertexStructure> Key;
+        return Key { { vertex }, ((its.v != nullptr) ? Key::HAS_V : 0) | ((its.vt != nullptr) ? Key::HAS_VT : 0) |
+                ((its.vn != nullptr) ? Key::HAS_VN : 0) };
+    }
+
+    /**
+     * Calls addFacePoint(facePoint) for every corner of the triangles of the given faces in order.
+     * N-gons are triangulated on the way and faces with less than 3 points are skipped.
+     */
+    template<typename AddFacePoint>
+    static void forEachTriangleCorner(const Obj &obj, const FaceElement *faces, int faceCount, AddFacePoint addFacePoint) {
+        // Used for n-gons - buffers are kept between faces
+        PolygonTriangulator triangulator;
+        std::vector<const VertexElement*> ngonPositions;
+
+        for(int i = 0; i < faceCount; ++i) {
+            const FaceElement &face = faces[i];
+            if(face.facePointCount == 3) {
+                // Loop through all points in faces
+                for(int j = 0; j < face.facePointCount; ++j) {
+                    addFacePoint(face.facePoints[j]);
+                }
+            } else if(face.facePointCount > 3) {
+                // N-gons are triangulated right here while streaming into the index buffer
+                const FacePoint *points = obj.getFacePoints(face);
+                ngonPositions.resize(face.facePointCount);
+                for(int j = 0; j < face.facePointCount; ++j) {
+                    ngonPositions[j] = (points[j].vIndex != (unsigned int)(-1) ? &obj.vs[points[j].vIndex] : nullptr);
+                }
+                const std::vector<int> &corners = triangulator.triangulate(&ngonPositions[0], face.facePointCount);
+                for(int corner : corners) {
+                    addFacePoint(points[corner]);
+                }
+            } else {
+                OMLOGE(" - Found a face that has less than 3 vertices(%d) - skipping face!", face.facePointCount);
+            }
+        }
+    }
+
+    /** The number of indices forEachTriangleCorner gives at most for the faces - for exact index reservations */
+    static inline size_t triangleCornerCount(const FaceElement *faces, int faceCount) {
+        size_t cornerCount = 0;
+        for(int i = 0; i < faceCount; ++i) {
+            if(faces[i].facePointCount >= 3) {
+                cornerCount += 3 * (size_t)(faces[i].facePointCount - 2);
+            }
+        }
+        return cornerCount;
+    }
+
+    /** The crease angle of the normal generation for the build flags (see CREASE_NORMALS) */
+    static inline float normalCreaseAngle(ObjMeshObject::MeshBuildFlags buildFlags) {
+        return ((buildFlags & ObjMeshObject::MeshBuildFlags::CREASE_NORMALS) != 0) ?
+                NormalGenerator::DEFAULT_CREASE_ANGLE : NormalGenerator::NO_CREASE_ANGLE;
+    }
+
+    /** Used as key for de-duplicating the generated normals by value */
+    struct NormalKey {
+        VertexNormalElement normal;
+
+        friend bool operator==(const NormalKey& lhs, const NormalKey& rhs) {
+            return (lhs.normal.x == rhs.normal.x) && (lhs.normal.y == rhs.normal.y) && (lhs.normal.z == rhs.normal.z);
+        }
+
+        uint64_t hash() const {
+            uint64_t h = dedupCombine(0, dedupFloatBits(normal.x) | (dedupFloatBits(normal.y) << 32));
+            return dedupMix64(dedupCombine(h, dedupFloatBits(normal.z)));
+        }
+    };
+
+    /**
+     * Triangulates the faces and generates normals for the face points that have none (see
+     * GENERATE_NORMALS). The face points of the output triangles refer to the generated normals
+     * by vnIndex values from obj.vns.size() on (see FacePointSlicer) - the generated normals are
+     * de-duplicated by value so the face points can still be de-duplicated by index too.
+     * Returns false (and leaves the outputs empty) when there is nothing to generate.
+     */
+    static bool generateMissingNormals(const Obj &obj, const FaceElement *meshFaces, int meshFaceCount, float creaseAngle,
+            ThreadPool *threadPool, std::vector<FaceElement> &triangles, std::vector<VertexNormalElement> &generatedNormals) {
+        bool missing = false;
+        for(int i = 0; i < meshFaceCount; ++i) {
+            const FacePoint *points = obj.getFacePoints(meshFaces[i]);
+            for(int j = 0; j < meshFaces[i].facePointCount; ++j) {
+                if(points[j].vIndex == (unsigned int)(-1)) {
+                    OMLOGW("Cannot generate normals for face points without a position!");
+                    return false;
+                }
+                missing |= (points[j].vnIndex == (unsigned int)(-1));
+            }
+        }
+        if(!missing) {
+            return false;
+        }
+
+        // Triangle corners (and smoothing groups) - the n-gons are triangulated the same way as for the build
+        std::vector<FacePoint> corners;
+        std::vector<unsigned int> groups;
+        corners.reserve(3 * (size_t)meshFaceCount);
+        bool hasGroups = !obj.smoothingGroupStarts.empty();
+        const FaceElement *objFaces = obj.fs.empty() ? nullptr : &obj.fs[0];
+        for(int i = 0; i < meshFaceCount; ++i) {
+            forEachTriangleCorner(obj, &meshFaces[i], 1, [&](const FacePoint &fp) {
+                corners.push_back(fp);
+            });
+            if(hasGroups) {
+                // Rem.: faces that are not in the obj (runtime generated ones) are in the default group
+                bool inObj = (objFaces != nullptr) && (&meshFaces[i] >= objFaces) && (&meshFaces[i] < objFaces + obj.fs.size());
+                unsigned int group = inObj ? obj.getSmoothingGroup((int)(&meshFaces[i] - objFaces)) : Obj::DEFAULT_SMOOTHING_GROUP;
+                groups.resize(corners.size() / 3, group);
+            }
+        }
+        unsigned int triangleCount = (unsigned int)(corners.size() / 3);
+        if(triangleCount == 0) {
+            return false;
+        }
+
+        std::vector<uint32_t> positionIds(corners.size());
+        for(size_t k = 0; k < corners.size(); ++k) {
+            positionIds[k] = corners[k].vIndex;
+        }
+        std::vector<float> normals(3 * corners.size());
+        NormalGenerator::generateNormals(&obj.vs[0].x, sizeof(VertexElement), &positionIds[0], triangleCount,
+                hasGroups ? &groups[0] : nullptr, creaseAngle, &normals[0], threadPool);
 
-    ObjMeshObject::ObjMeshObject(const Obj& obj) {
+        // Only the corners without a normal get the generated ones
+        VertexDedupTable<NormalKey, unsigned int> normalNumbers(corners.size() / 6);
+        for(size_t k = 0; k < corners.size(); ++k) {
+            if(corners[k].vnIndex == (unsigned int)(-1)) {
+                NormalKey key { VertexNormalElement(normals[3 * k], normals[3 * k + 1], normals[3 * k + 2]) };
+                unsigned int normalNo = (unsigned int)generatedNormals.size();
+                const unsigned int *found = normalNumbers.findOrInsert(key, normalNo);
+                if(found != nullptr) {
+                    normalNo = *found;
+                } else {
+                    generatedNormals.push_back(key.normal);
+                }
+                corners[k].vnIndex = (unsigned int)obj.vns.size() + normalNo;
+            }
+        }
+        triangles.reserve(triangleCount);
+        for(unsigned int t = 0; t < triangleCount; ++t) {
+            triangles.push_back(FaceElement(corners[3 * t], corners[3 * t + 1], corners[3 * t + 2]));
+        }
+        return true;
+    }
+
+    /**
+     * The tables of the vertices already built (into shared buffers or into a mesh that gets faces
+     * appended) - the values are the vertex numbers. Created for the de-duplication mode on first use.
+     */
+    struct MeshDedupTables {
+        size_t expectedCount;
+        std::unique_ptr<VertexDedupTable<PresenceVertexKey<VertexStructure>, uint32_t>> byValue;
+        std::unique_ptr<VertexDedupTable<FacePointIndexKey, uint32_t>> byIndex;
+
+        /** Creates the table(s) for the mode if not yet there - the values are always looked up by value too */
+        void ensureTables(bool dedupByIndex) {
+            if(dedupByIndex && !byIndex) {
+                byIndex.reset(new VertexDedupTable<FacePointIndexKey, uint32_t>(expectedCount));
+            }
+            if(!byValue) {
+                byValue.reset(new VertexDedupTable<PresenceVertexKey<VertexStructure>, uint32_t>(dedupByIndex ? 0 : expectedCount));
+            }
+        }
+    };
+
+    SharedMeshBuffers::SharedMeshBuffers(size_t expectedVertexCount) : tables(new MeshDedupTables()) {
+        tables->expectedCount = expectedVertexCount;
+        vertexData.reserve(expectedVertexCount);
+        indices.reserve(expectedVertexCount);
+    }
+
+    // Rem.: Defined here where the tables are complete
+    SharedMeshBuffers::~SharedMeshBuffers() {}
+
+    void SharedMeshBuffers::finishBuilding() {
+        tables.reset();
+    }
+
+    /**
+     * Adds the triangles of the faces to the shared buffers: the vertices are looked up in the
+     * tables of the buffers first, so the meshes share their common vertices. The range of the mesh
+     * is from the first to the last vertex it uses and the indices are local to that range. The
+     * bounds are computed from the used vertices only (the range can have vertices of other meshes).
+     */
+    template<typename MakeSlice>
+    static void sharedDedup(const Obj &obj, const FaceElement *meshFaces, int meshFaceCount, bool dedupByIndex,
+            MakeSlice makeSlice, MeshDedupTables &tables, std::vector<VertexStructure> &vertexData,
+            std::vector<OM_INDEX_TYPE> &indices, unsigned int &rangeStart, unsigned int &vertexCount, unsigned int &indexCount,
+            BoundingVolume &bounds) {
+        tables.ensureTables(dedupByIndex);
+        size_t firstNew = vertexData.size();
+        std::vector<uint32_t> corners;
+        corners.reserve(3 * (size_t)meshFaceCount);
+        uint32_t minVertex = (uint32_t)-1;
+        uint32_t maxVertex = 0;
+        forEachTriangleCorner(obj, meshFaces, meshFaceCount, [&](const FacePoint &fp) {
+            IndexTargetSlice its = makeSlice(obj, fp);
+            VertexStructure vertex = makeVertex(its);
+            uint32_t vertexNo = (uint32_t)vertexData.size();
+            // Rem.: the numbers of the generated normals are per mesh, so those are always matched by value
+            bool byIndex = dedupByIndex && ((fp.vnIndex == (unsigned int)(-1)) || (fp.vnIndex < obj.vns.size()));
+            const uint32_t *handled = byIndex ?
+                    tables.byIndex->findOrInsert(FacePointIndexKey { fp.vIndex, fp.vtIndex, fp.vnIndex }, vertexNo) :
+                    tables.byValue->findOrInsert(presenceKeyFor(its, vertex), vertexNo);
+            if(handled != nullptr) {
+                vertexNo = *handled;
+            } else {
+                vertexData.push_back(vertex);
+            }
+            corners.push_back(vertexNo);
+            minVertex = std::min(minVertex, vertexNo);
+            maxVertex = std::max(maxVertex, vertexNo);
+        });
+
+        // Reused vertices of earlier meshes can stretch the range past what 16 bit (local) indices
+        // can address (and the indices would wrap around with 16 bit storage): those vertices are
+        // stored again after the new ones instead, so the range only has the vertices of this mesh.
+        if(!corners.empty() && (minVertex < firstNew) &&
+           ((uint64_t)maxVertex - minVertex + 1 > ObjMeshObject::MAX_16BIT_INDEXED_VERTICES)) {
+            std::unordered_map<uint32_t, uint32_t> storedAgain;
+            for(uint32_t &vertexNo : corners) {
+                if(vertexNo < firstNew) {
+                    auto found = storedAgain.find(vertexNo);
+                    if(found == storedAgain.end()) {
+                        found = storedAgain.emplace(vertexNo, (uint32_t)vertexData.size()).first;
+                        VertexStructure vertex = vertexData[vertexNo];
+                        vertexData.push_back(vertex);
+                    }
+                    vertexNo = found->second;
+                }
+            }
+            minVertex = (uint32_t)firstNew;
+            maxVertex = (uint32_t)vertexData.size() - 1;
+        }
+
+        if(corners.empty()) {
+            rangeStart = (unsigned int)vertexData.size();
+            vertexCount = indexCount = 0;
+            bounds = MeshBounds::empty();
+            return;
+        }
+        rangeStart = minVertex;
+        vertexCount = maxVertex - minVertex + 1;
+        indexCount = (unsigned int)corners.size();
+        for(uint32_t vertexNo : corners) {
+            // Rem.: Wraps around just like the lastIndex counter of the other builds would do
+            indices.push_back((OM_INDEX_TYPE)(vertexNo - minVertex));
+        }
+        if(minVertex >= firstNew) {
+            // Only new vertices - the range is the same as the used vertices
+            bounds = MeshBounds::compute(&vertexData[rangeStart], vertexCount);
+        } else {
+            std::vector<char> used(vertexCount, 0);
+            std::vector<VertexStructure> usedVertices;
+            for(uint32_t vertexNo : corners) {
+                if(!used[vertexNo - minVertex]) {
+                    used[vertexNo - minVertex] = 1;
+                    usedVertices.push_back(vertexData[vertexNo]);
+                }
+            }
+            bounds = MeshBounds::compute(&usedVertices[0], (unsigned int)usedVertices.size());
+        }
+    }
+
+    /** The state of one range of faces (chunk) in the parallel de-duplication */
+    template<typename Key>
+    struct DedupChunk {
+        DedupChunk(size_t expectedCount) : table(expectedCount) {}
+
+        /** Face-point key -> chunk-local vertex number */
+        VertexDedupTable<Key, uint32_t> table;
+        /** The first face-point of each chunk-local vertex */
+        std::vector<FacePoint> uniquePoints;
+        /** Chunk-local vertex numbers for the triangle corners */
+        std::vector<uint32_t> localIndices;
+        /** The first chunk that has the vertex and the local vertex number there (this chunk for new vertices) */
+        std::vector<int> ownerChunk;
+        std::vector<uint32_t> ownerLocal;
+        /** The order of the new (first appearing here) vertices among each other */
+        std::vector<uint32_t> newRank;
+        uint32_t newCount = 0;
+        /** Where the new vertices and the indices of the chunk start in the mesh */
+        size_t vertexBase = 0;
+        size_t indexBase = 0;
+    };
+
+    /**
+     * De-duplicates the faces in parallel chunks. The result is the very same as the serial build:
+     * every vertex is numbered by its first appearance in the faces. Vertices first appearing in
+     * an earlier chunk always precede the ones first appearing in a later chunk and they keep
+     * their order within the chunk - so after finding the first chunk of each vertex by looking up
+     * the tables of the earlier chunks, the final numbers come from a prefix sum over the chunks.
+     */
+    template<typename Key, typename MakeKey, typename MakeSlice>
+    static void parallelDedup(const Obj &obj, const FaceElement *meshFaces, int meshFaceCount,
+            int chunkNum, ThreadPool &threadPool, MakeKey makeKey, MakeSlice makeSlice, OM_INDEX_TYPE lastIndexBase,
+            std::vector<VertexStructure> &vertexData, std::vector<OM_INDEX_TYPE> &indices,
+            unsigned int &vertexCount, unsigned int &indexCount) {
+        std::vector<std::unique_ptr<DedupChunk<Key>>> chunks(chunkNum);
+
+        // 1) Every chunk de-duplicates its own range of faces using chunk-local vertex numbers
+        threadPool.parallelFor(chunkNum, [&](int c) {
+            int faceStart = (int)(((int64_t)meshFaceCount * c) / chunkNum);
+            int faceEnd = (int)(((int64_t)meshFaceCount * (c + 1)) / chunkNum);
+            chunks[c].reset(new DedupChunk<Key>(faceEnd - faceStart));
+            DedupChunk<Key> &chunk = *chunks[c];
+            chunk.uniquePoints.reserve(faceEnd - faceStart);
+            chunk.localIndices.reserve(3 * (size_t)(faceEnd - faceStart));
+            forEachTriangleCorner(obj, meshFaces + faceStart, faceEnd - faceStart, [&](const FacePoint &fp) {
+                uint32_t vertexNo = (uint32_t)chunk.uniquePoints.size();
+                const uint32_t *handled = chunk.table.findOrInsert(makeKey(obj, fp), vertexNo);
+                if(handled != nullptr) {
+                    chunk.localIndices.push_back(*handled);
+                } else {
+                    chunk.uniquePoints.push_back(fp);
+                    chunk.localIndices.push_back(vertexNo);
+                }
+            });
+        });
+
+        // 2) Find the first chunk of each vertex: the first earlier chunk that has it (or this one)
+        threadPool.parallelFor(chunkNum, [&](int c) {
+            DedupChunk<Key> &chunk = *chunks[c];
+            size_t uniqueNum = chunk.uniquePoints.size();
+            chunk.ownerChunk.resize(uniqueNum);
+            chunk.ownerLocal.resize(uniqueNum);
+            chunk.newRank.resize(uniqueNum);
+            for(size_t u = 0; u < uniqueNum; ++u) {
+                Key key = makeKey(obj, chunk.uniquePoints[u]);
+                int owner = c;
+                uint32_t ownerLocal = (uint32_t)u;
+                for(int e = 0; e < c; ++e) {
+                    const uint32_t *found = chunks[e]->table.find(key);
+                    if(found != nullptr) {
+                        owner = e;
+                        ownerLocal = *found;
+                        break;
+                    }
+                }
+                chunk.ownerChunk[u] = owner;
+                chunk.ownerLocal[u] = ownerLocal;
+                if(owner == c) {
+                    chunk.newRank[u] = chunk.newCount++;
+                }
+            }
+        });
+
+        // 3) The new vertices and the indices of the chunks follow each other in the chunk order
+        size_t vertexStart = vertexData.size();
+        size_t indexStart = indices.size();
+        size_t vertexNum = 0;
+        size_t indexNum = 0;
+        for(auto &chunk : chunks) {
+            chunk->vertexBase = vertexNum;
+            chunk->indexBase = indexNum;
+            vertexNum += chunk->newCount;
+            indexNum += chunk->localIndices.size();
+        }
+        vertexData.resize(vertexStart + vertexNum);
+        indices.resize(indexStart + indexNum);
+
+        // 4) Write the new vertices and the remapped indices right to their final place
+        threadPool.parallelFor(chunkNum, [&](int c) {
+            DedupChunk<Key> &chunk = *chunks[c];
+            std::vector<uint32_t> remap(chunk.uniquePoints.size());
+            for(size_t u = 0; u < remap.size(); ++u) {
+                const DedupChunk<Key> &owner = *chunks[chunk.ownerChunk[u]];
+                size_t vertexNo = owner.vertexBase + owner.newRank[chunk.ownerLocal[u]];
+                remap[u] = (uint32_t)vertexNo;
+                if(chunk.ownerChunk[u] == c) {
+                    vertexData[vertexStart + vertexNo] = makeVertex(makeSlice(obj, chunk.uniquePoints[u]));
+                }
+            }
+            // Rem.: Wraps around just like the serial lastIndex counter would do
+            OM_INDEX_TYPE *chunkIndices = &indices[indexStart + chunk.indexBase];
+            for(size_t k = 0; k < chunk.localIndices.size(); ++k) {
+                chunkIndices[k] = (OM_INDEX_TYPE)(lastIndexBase + remap[chunk.localIndices[k]]);
+            }
+        });
+
+        vertexCount = (unsigned int)vertexNum;
+        indexCount = (unsigned int)indexNum;
+    }
+
+    ObjMeshObject::ObjMeshObject(const Obj& obj, MeshBuildFlags buildFlags, ThreadPool *threadPool) {
         // According to the standard, vector elements are places in the memory after each other!
         // This way we can create a c-style array/pointer by referring to the address to the first!
         const FaceElement* objFaces = &(obj.fs)[0];
         // The count of mesh faces should be equal to all of the faces in this case
         int objFaceCount = (obj.fs).size();
-        creationHelper(obj, objFaces, objFaceCount, nullptr, nullptr, 0);
+        creationHelper(obj, objFaces, objFaceCount, nullptr, nullptr, 0, buildFlags, threadPool);
+    }
+
+    ObjMeshObject::ObjMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount, MeshBuildFlags buildFlags, ThreadPool *threadPool) {
+        creationHelper(obj, meshFaces, meshFaceCount, nullptr, nullptr, 0, buildFlags, threadPool);
     }
 
-    ObjMeshObject::ObjMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount) {
-        creationHelper(obj, meshFaces, meshFaceCount, nullptr, nullptr, 0);
+    ObjMeshObject::ObjMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount, SharedMeshBuffers &sharedBuffers,
+            MeshBuildFlags buildFlags) {
+        // These would change the vertices that other meshes of the buffers use too (or need parallel chunks)
+        if((buildFlags & SHARED_BUFFERS_IGNORED_FLAGS) != 0) {
+            OMLOGW("The build flags %d are ignored for meshes of shared buffers!", (int)(buildFlags & SHARED_BUFFERS_IGNORED_FLAGS));
+        }
+        MeshBuildFlags sharedBuildFlags = (MeshBuildFlags)(buildFlags & ~SHARED_BUFFERS_IGNORED_FLAGS);
+        creationHelper(obj, meshFaces, meshFaceCount, &sharedBuffers.vertexData, &sharedBuffers.indices, 0, sharedBuildFlags,
+                nullptr, &sharedBuffers);
     }
 
 	/**
@@ -162,12 +593,19 @@ namespace ObjMaster {
 		std::swap(this->indexCount, other.indexCount);
 		std::swap(this->indices, other.indices);
 		std::swap(this->lastIndex, other.lastIndex);
+		std::swap(this->bounds, other.bounds);
 		std::swap(this->ownsIndices, other.ownsIndices);
 		std::swap(this->ownsVertexData, other.ownsVertexData);
 		std::swap(this->startIndexLocation, other.startIndexLocation);
 		std::swap(this->vertexCount, other.vertexCount);
 		std::swap(this->vertexData, other.vertexData);
 		std::swap(this->inited, other.inited);
+		std::swap(this->meshlets, other.meshlets);
+		std::swap(this->meshletVertices, other.meshletVertices);
+		std::swap(this->meshletTriangles, other.meshletTriangles);
+		std::swap(this->lods, other.lods);
+		std::swap(this->lodIndices, other.lodIndices);
+		std::swap(this->tangents, other.tangents);
 
 		// But ensure that the "other" thinks he does not own anything anymore!
 		// This is necessary because we might have got ownership and other should not delete pointers then!
@@ -214,20 +652,28 @@ namespace ObjMaster {
 		this->indexCount = other.indexCount;
 		this->indices = iPtr;
 		this->lastIndex = other.lastIndex;
+		this->bounds = other.bounds;
 		this->ownsIndices = other.ownsIndices;
 		this->ownsVertexData = other.ownsVertexData;
 		this->startIndexLocation = other.startIndexLocation;
 		this->vertexCount = other.vertexCount;
 		this->vertexData = vPtr;
 		this->inited = other.inited;
+		this->meshlets = other.meshlets;
+		this->meshletVertices = other.meshletVertices;
+		this->meshletTriangles = other.meshletTriangles;
+		this->lods = other.lods;
+		this->lodIndices = other.lodIndices;
+		this->tangents = other.tangents;
 	}
 
-	ObjMeshObject::ObjMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount, std::vector<VertexStructure> *vertexVector, std::vector<OM_INDEX_TYPE> *indexVector, OM_INDEX_TYPE lastIndexBase) {
-		creationHelper(obj, meshFaces, meshFaceCount, vertexVector, indexVector, lastIndexBase);
+	ObjMeshObject::ObjMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount, std::vector<VertexStructure> *vertexVector, std::vector<OM_INDEX_TYPE> *indexVector, OM_INDEX_TYPE lastIndexBase, MeshBuildFlags buildFlags, ThreadPool *threadPool) {
+		creationHelper(obj, meshFaces, meshFaceCount, vertexVector, indexVector, lastIndexBase, buildFlags, threadPool);
 	}
 
     void ObjMeshObject::creationHelper(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount,
-		std::vector<VertexStructure> *vertexVector, std::vector<OM_INDEX_TYPE> *indexVector, OM_INDEX_TYPE lastIndexBase) {
+		std::vector<VertexStructure> *vertexVector, std::vector<OM_INDEX_TYPE> *indexVector, OM_INDEX_TYPE lastIndexBase,
+		MeshBuildFlags buildFlags, ThreadPool *threadPool, SharedMeshBuffers *sharedBuffers) {
 
 		// Handle the difference between the case when they provide the vectors to us
 		// and cases when we create and own the vectors by ourselves!
@@ -255,15 +701,63 @@ namespace ObjMaster {
 			this->startIndexLocation = indexVector->size();
 		}
 
-        // The map is used to make the index buffer refer to duplications properly
-        // without re-creating the data slice for the duplications
-        std::unordered_map<IndexTargetSlice, OM_INDEX_TYPE> alreadyHandledFacePointTargets;
+        // Loop through faces
+		indexCount = vertexCount = 0;	// In mesh counts: zero
+        lastIndex = lastIndexBase;		// Multimesh: avoids crash with earlier indices!
+        bool dedupByIndex = ((buildFlags & MeshBuildFlags::DEDUP_BY_INDEX) != 0);
 
-        // The reservations here are really just heuristics:
-        // - It would be pointless to think the indices always point at different things
-        // - In that case it would be 3*mfc (considering triangles)
-        // - So what I did is that I just heuristically applied one third of those maximums
-        if(meshFaceCount != 0) {
+        // Huge meshes can be de-duplicated in parallel chunks - small ones are not worth it
+        int chunkNum = 1;
+        std::unique_ptr<ThreadPool> ownThreadPool;
+        if((buildFlags & MeshBuildFlags::PARALLEL_DEDUP) != 0) {
+            int maxChunks = meshFaceCount / MIN_PARALLEL_DEDUP_FACES;
+            if(maxChunks > 1) {
+                if(threadPool == nullptr) {
+                    int threadCount = (int)std::thread::hardware_concurrency();
+                    ownThreadPool.reset(new ThreadPool((threadCount < maxChunks) ? threadCount : maxChunks));
+                    threadPool = ownThreadPool.get();
+                }
+                chunkNum = (threadPool->getThreadCount() < maxChunks) ? threadPool->getThreadCount() : maxChunks;
+            }
+        }
+
+        // Generated normals are referred from the (triangulated) faces just like the ones of the obj
+        std::vector<FaceElement> normalTriangles;
+        std::vector<VertexNormalElement> generatedNormals;
+        if(((buildFlags & MeshBuildFlags::GENERATE_NORMALS) != 0) &&
+           generateMissingNormals(obj, meshFaces, meshFaceCount, normalCreaseAngle(buildFlags), threadPool,
+                   normalTriangles, generatedNormals)) {
+            meshFaces = normalTriangles.empty() ? nullptr : &normalTriangles[0];
+            meshFaceCount = (int)normalTriangles.size();
+        }
+        FacePointSlicer slicer { generatedNormals.empty() ? nullptr : &generatedNormals[0] };
+
+        bool sharedDedupDone = false;
+        if((sharedBuffers != nullptr) && sharedBuffers->tables) {
+            // Vertices of the earlier meshes of the buffers are reused - this also gives the range and the bounds
+            sharedDedup(obj, meshFaces, meshFaceCount, dedupByIndex, slicer, *sharedBuffers->tables, *vertexData, *indices,
+                    baseVertexLocation, vertexCount, indexCount, bounds);
+            lastIndex = (OM_INDEX_TYPE)(lastIndexBase + vertexCount);
+            sharedDedupDone = true;
+        } else if(chunkNum > 1) {
+            OMLOGI("De-duplicating %d faces in %d parallel chunks", meshFaceCount, chunkNum);
+            if(dedupByIndex) {
+                parallelDedup<FacePointIndexKey>(obj, meshFaces, meshFaceCount, chunkNum, *threadPool,
+                        [](const Obj &, const FacePoint &fp) { return FacePointIndexKey { fp.vIndex, fp.vtIndex, fp.vnIndex }; },
+                        slicer, lastIndexBase, *vertexData, *indices, vertexCount, indexCount);
+            } else {
+                parallelDedup<IndexTargetSlice>(obj, meshFaces, meshFaceCount, chunkNum, *threadPool,
+                        slicer, slicer, lastIndexBase, *vertexData, *indices, vertexCount, indexCount);
+            }
+            // Same as what the serial incrementing would give
+            lastIndex = (OM_INDEX_TYPE)(lastIndexBase + vertexCount);
+        } else {
+            // The index count is known exactly from the faces, but the vertex reservation is
+            // really just a heuristic:
+            // - It would be pointless to think the indices always point at different things
+            // - In that case it would be 3*mfc (considering triangles)
+            // - So what I did is that I just heuristically applied one third of those maximums
+            if(meshFaceCount != 0) {
 			// Here the earlier sizes should be added
 			// as the parameter to reserve is an absolute
 			// reservation size and in case of shared
@@ -273,86 +767,64 @@ namespace ObjMaster {
 			// over-reservations as we only over-reserve by the
 			// amount of quessing error from the last mesh!!!
 			// This is why we use xxx.size() as base here!!!
-            indices->reserve(indices->size() + meshFaceCount);
-            vertexData->reserve(vertexData->size() + meshFaceCount);
-        }
+                indices->reserve(indices->size() + triangleCornerCount(meshFaces, meshFaceCount));
+                vertexData->reserve(vertexData->size() + meshFaceCount);
+            }
 
-        // Loop through faces
-		indexCount = vertexCount = 0;	// In mesh counts: zero
-        lastIndex = lastIndexBase;		// Multimesh: avoids crash with earlier indices!
-        for(int i = 0; i < meshFaceCount; ++i) {
-            FaceElement face = meshFaces[i];
-            if(face.facePointCount == 3) {
-                // Loop through all points in faces
-                for(int j = 0; j < face.facePointCount; ++j) {
-                    FacePoint fp = face.facePoints[j];
-                    // Create pointers to the target data of the face-point
-                    // (This should be faster than copy)
-					// -1 indicates a missing element so we handle it as if there is one!
-					// Rem.: The real representation type is unsigned so basically the special value is not -1, but the unsigned int max value!
-					//       because of this is why we are casting the value to unsigned int. Just to be sure we that it happens as we imagine!
-                    const VertexElement *fv = (fp.vIndex != (unsigned int)(-1) ? &obj.vs[fp.vIndex] : nullptr);
-                    const VertexTextureElement *fvt = (fp.vtIndex != (unsigned int)(-1) ? &obj.vts[fp.vtIndex] : nullptr);
-                    const VertexNormalElement *fvn = (fp.vnIndex != (unsigned int)(-1) ? &obj.vns[fp.vnIndex] : nullptr);
+            // The tables are used to make the index buffer refer to duplications properly
+            // without re-creating the data slice for the duplications. Only the one for the
+            // given mode is presized (using the same heuristics as the vertex reservation).
+            VertexDedupTable<IndexTargetSlice, OM_INDEX_TYPE> alreadyHandledFacePointTargets(dedupByIndex ? 0 : meshFaceCount);
+            VertexDedupTable<FacePointIndexKey, OM_INDEX_TYPE> alreadyHandledFacePoints(dedupByIndex ? meshFaceCount : 0);
+
+            // Adds one face-point to the buffers: either as a new vertex or just as an index to an earlier one
+            forEachTriangleCorner(obj, meshFaces, meshFaceCount, [&](const FacePoint &fp) {
+                        // Create pointers to the target data of the face-point
+                        // (This should be faster than copy)
+                        // Rem.: the slice also handle nullptrs for optional elements! Ownership of data
+                        // is not transferred as this is a read-only operation!
+                        IndexTargetSlice its = slicer(obj, fp);
 #ifdef DEBUG
 OMLOGD("Processing face:");
 OMLOGD(" - vIndex: %d", fp.vIndex);
 OMLOGD(" - vtIndex: %d", fp.vtIndex);
 OMLOGD(" - vnIndex: %d", fp.vnIndex);
 OMLOGD("with:");
-if(fv != nullptr) { OMLOGD(" - vs[vIndex]: (%f, %f, %f)", obj.vs[fp.vIndex].x, obj.vs[fp.vIndex].y, obj.vs[fp.vIndex].z); }
-if(fvt != nullptr) { OMLOGD(" - vts[vtIndex]: (%f, %f)", obj.vts[fp.vtIndex].u, obj.vts[fp.vtIndex].v); }
-if(fvn != nullptr) { OMLOGD(" - vns[vnIndex]: (%f, %f, %f)", obj.vns[fp.vnIndex].x, obj.vns[fp.vnIndex].y, obj.vns[fp.vnIndex].z); }
+if(its.v != nullptr) { OMLOGD(" - vs[vIndex]: (%f, %f, %f)", obj.vs[fp.vIndex].x, obj.vs[fp.vIndex].y, obj.vs[fp.vIndex].z); }
+if(its.vt != nullptr) { OMLOGD(" - vts[vtIndex]: (%f, %f)", obj.vts[fp.vtIndex].u, obj.vts[fp.vtIndex].v); }
+if(its.vn != nullptr) { OMLOGD(" - vns[vnIndex]: (%f, %f, %f)", its.vn->x, its.vn->y, its.vn->z); }
 #endif
-                    // Create a target slice from the target data
-                    // This slicer is only used for hashing out duplications. Ownership of data
-                    // is not transferred as this is a read-only operation!
-		    // Rem.: the slice also handle nullptrs for optional elements!
-                    IndexTargetSlice its = IndexTargetSlice(fv, fvt, fvn);
-
-                    // See if the data for this face-point can be found among the earlier ones
-                    if(alreadyHandledFacePointTargets.find(its)
-                           != alreadyHandledFacePointTargets.end()) {
+                        // See if the data for this face-point can be found among the earlier ones.
+                        // If not, the lookup also registers lastIndex for it right away.
+                        const OM_INDEX_TYPE *handledIndex = dedupByIndex ?
+                                alreadyHandledFacePoints.findOrInsert(FacePointIndexKey { fp.vIndex, fp.vtIndex, fp.vnIndex }, lastIndex) :
+                                alreadyHandledFacePointTargets.findOrInsert(its, lastIndex);
+                        if(handledIndex != nullptr) {
 #ifdef DEBUG
 OMLOGD(" - Found already handled facePoint!");
 #endif
-                        // Only add a new index into the index-buffer referencing the already
-                        // added data in case we had this variation earlier... The index points to
-                        // the earlier variation this way.
-                        indices->push_back(alreadyHandledFacePointTargets[its]);
+                            // Only add a new index into the index-buffer referencing the already
+                            // added data in case we had this variation earlier... The index points to
+                            // the earlier variation this way.
+                            indices->push_back(*handledIndex);
 						++indexCount;
-                    } else {
-                        // Collect target data in lists that represent the buffers
-                        // Basically add the data variation for the vertical slice
+                        } else {
+                            // Collect target data in lists that represent the buffers
+                            // Basically add the data variation for the vertical slice
 			// Rem.: When position, normal or uv data is missing, we provide
 			// some default value here instead of just crashing...
-                        vertexData->push_back(VertexStructure {
-                                fv != nullptr ? fv->x : 0,
-                                fv != nullptr ? fv->y : 0,
-                                fv != nullptr ? fv->z : 0,
-                                fvn != nullptr ? fvn->x : 0,
-                                fvn != nullptr ? fvn->y : 0,
-                                fvn != nullptr ? fvn->z : 0,
-                                fvt != nullptr ? fvt->u : 0,
-                                fvt != nullptr ? fvt->v : 0});
+                            vertexData->push_back(makeVertex(its));
 			++vertexCount;
 
-                        // Add an index for this new vertical slice
-                        indices->push_back(lastIndex);
+                            // Add an index for this new vertical slice
+                            indices->push_back(lastIndex);
 			++indexCount;
 
-                        // Update the hashmap for the already handled data
-                        alreadyHandledFacePointTargets[its] = lastIndex;
-
-                        // Increment the index-buffer construction variable
+                            // Increment the index-buffer construction variable
 						// invariant: this always holds max(indices)
-                        ++lastIndex;
-                    }
-                }
-            } else {
-                // TODO: Should we handle non-triangles ever?
-                OMLOGE(" - Found a face that has more than 3 vertices(%d) - skipping face!", face.facePointCount);
-            }
+                            ++lastIndex;
+                        }
+            });
         }
 
         // Log relevant counts
@@ -361,8 +833,373 @@ OMLOGD(" - Found already handled facePoint!");
         OMLOGD(" - Number of (per-mesh) vertices after conversion: %u", vertexCount);
         OMLOGD(" - Number of (per-mesh) indices after conversion: %u", indexCount);
         OMLOGD(" - Maximum indexNo in this mesh: %d", lastIndex);
+        if((uint64_t)lastIndexBase + vertexCount > (uint64_t)(OM_INDEX_TYPE)(-1) + 1) {
+            OMLOGE(" - The %u vertices of the mesh do not fit the %d bit indices - they have wrapped around! (see SPLIT_FOR_16BIT_INDICES)",
+                    vertexCount, (int)(sizeof(OM_INDEX_TYPE) * 8));
+        }
+
+        // Bounding volumes of the (per-mesh) vertices - the optimization passes do not change them
+        if(!sharedDedupDone) {
+            bounds = (vertexCount > 0) ? MeshBounds::compute(&(*vertexData)[baseVertexLocation], vertexCount) : MeshBounds::empty();
+        }
 
         // Indicate that the mesh has been initialized
         inited = true;
+
+        // Optional post-processing of the (already usable) mesh
+        if((buildFlags & MeshBuildFlags::OPTIMIZE_VERTEX_CACHE) != 0) {
+            MeshOptimizer::optimizeVertexCache(*this);
+        }
+        if((buildFlags & MeshBuildFlags::OPTIMIZE_OVERDRAW) != 0) {
+            MeshOptimizer::optimizeOverdraw(*this);
+        }
+        if((buildFlags & MeshBuildFlags::OPTIMIZE_VERTEX_FETCH) != 0) {
+            MeshOptimizer::optimizeVertexFetch(*this);
+        }
+        if((buildFlags & MeshBuildFlags::GENERATE_TANGENTS) != 0) {
+            // The tangent splits should not push a split range out of the 16 bit indices
+            bool keep16Bit = ((buildFlags & MeshBuildFlags::SPLIT_FOR_16BIT_INDICES) != 0) && (vertexCount <= MAX_16BIT_INDEXED_VERTICES);
+            TangentGenerator::generateTangents(*this, keep16Bit ? MAX_16BIT_INDEXED_VERTICES : (unsigned int)(-1));
+        }
+        if((buildFlags & MeshBuildFlags::BUILD_MESHLETS) != 0) {
+            MeshletBuilder::buildMeshlets(*this);
+        }
+        if((buildFlags & MeshBuildFlags::BUILD_LODS) != 0) {
+            MeshSimplifier::buildLodChain(*this);
+        }
     }
+
+	bool ObjMeshObject::getLocalIndices16(std::vector<uint16_t> &output) const {
+		if(getIndexWidth() != 2) {
+			OMLOGE("The %u vertices of the mesh do not fit 16 bit indices!", vertexCount);
+			return false;
+		}
+		OM_INDEX_TYPE firstIndex = (OM_INDEX_TYPE)(lastIndex - vertexCount);
+		output.resize(indexCount);
+		for(unsigned int i = 0; i < indexCount; ++i) {
+			output[i] = (uint16_t)(OM_INDEX_TYPE)((*indices)[startIndexLocation + i] - firstIndex);
+		}
+		return true;
+	}
+
+	bool ObjMeshObject::getLocalIndices32(std::vector<uint32_t> &output) const {
+		if(getIndexWidth() > sizeof(OM_INDEX_TYPE)) {
+			OMLOGE("The %u vertices of the mesh do not fit the %d bit stored indices!", vertexCount, (int)(sizeof(OM_INDEX_TYPE) * 8));
+			return false;
+		}
+		OM_INDEX_TYPE firstIndex = (OM_INDEX_TYPE)(lastIndex - vertexCount);
+		output.resize(indexCount);
+		for(unsigned int i = 0; i < indexCount; ++i) {
+			output[i] = (uint32_t)(OM_INDEX_TYPE)((*indices)[startIndexLocation + i] - firstIndex);
+		}
+		return true;
+	}
+
+	void ObjMeshObject::shareGeometryOf(const ObjMeshObject &prototype) {
+		if(&prototype == this) {
+			return;
+		}
+		if (ownsVertexData) { delete vertexData; }
+		if (ownsIndices) { delete indices; }
+		this->vertexData = prototype.vertexData;
+		this->indices = prototype.indices;
+		this->ownsVertexData = false;
+		this->ownsIndices = false;
+		this->baseVertexLocation = prototype.baseVertexLocation;
+		this->startIndexLocation = prototype.startIndexLocation;
+		this->indexCount = prototype.indexCount;
+		this->vertexCount = prototype.vertexCount;
+		this->lastIndex = prototype.lastIndex;
+		this->meshlets = prototype.meshlets;
+		this->meshletVertices = prototype.meshletVertices;
+		this->meshletTriangles = prototype.meshletTriangles;
+		this->lods = prototype.lods;
+		this->lodIndices = prototype.lodIndices;
+		this->tangents = prototype.tangents;
+	}
+
+	MeshAppendState::MeshAppendState(ObjMeshObject::MeshBuildFlags buildFlags, size_t expectedVertexCount)
+		: buildFlags(buildFlags), knownVertexCount(0), tables(new MeshDedupTables()) {
+		tables->expectedCount = expectedVertexCount;
+	}
+
+	// Rem.: These are defined here where the tables are complete
+	MeshAppendState::~MeshAppendState() {}
+	MeshAppendState::MeshAppendState(MeshAppendState &&other) = default;
+	MeshAppendState& MeshAppendState::operator=(MeshAppendState &&other) = default;
+
+	bool ObjMeshObject::appendFaces(const Obj& obj, const FaceElement *faces, int faceCount, MeshAppendState &state) {
+		if(!inited) {
+			OMLOGE("Cannot append faces to a not inited mesh!");
+			return false;
+		}
+		if((baseVertexLocation + vertexCount != vertexData->size()) || (startIndexLocation + indexCount != indices->size())) {
+			OMLOGE("The mesh is not at the end of its vectors - cannot append faces!");
+			return false;
+		}
+		if(state.knownVertexCount > vertexCount) {
+			OMLOGE("The append state belongs to another mesh - cannot append faces!");
+			return false;
+		}
+		bool dedupByIndex = ((state.buildFlags & MeshBuildFlags::DEDUP_BY_INDEX) != 0);
+		MeshDedupTables &tables = *state.tables;
+		tables.ensureTables(dedupByIndex);
+		const VertexStructure *meshVertices = (vertexCount > 0) ? &(*vertexData)[baseVertexLocation] : nullptr;
+		if(state.knownVertexCount < vertexCount) {
+			// Vertices of the mesh that are not in the tables yet - only their values are known
+			if(dedupByIndex) {
+				OMLOGW("%u vertices of the mesh are not reused by index - only the appended ones are!", vertexCount - state.knownVertexCount);
+			}
+			for(unsigned int n = state.knownVertexCount; n < vertexCount; ++n) {
+				// Rem.: Their missing elements are not known - so they are taken as present ones
+				tables.byValue->findOrInsert(PresenceVertexKey<VertexStructure> { { meshVertices[n] }, PresenceVertexKey<VertexStructure>::HAS_ALL }, n);
+			}
+		}
+
+		OM_INDEX_TYPE firstIndex = (OM_INDEX_TYPE)(lastIndex - vertexCount);
+		unsigned int oldVertexCount = vertexCount;
+		forEachTriangleCorner(obj, faces, faceCount, [&](const FacePoint &fp) {
+			IndexTargetSlice its = sliceFor(obj, fp);
+			VertexStructure vertex = makeVertex(its);
+			uint32_t vertexNo = vertexCount;
+			const uint32_t *handled = dedupByIndex ?
+					tables.byIndex->findOrInsert(FacePointIndexKey { fp.vIndex, fp.vtIndex, fp.vnIndex }, vertexNo) :
+					tables.byValue->findOrInsert(presenceKeyFor(its, vertex), vertexNo);
+			if(handled != nullptr) {
+				vertexNo = *handled;
+			} else {
+				vertexData->push_back(vertex);
+				++vertexCount;
+				++lastIndex;
+			}
+			// Rem.: Wraps around just like the lastIndex does
+			indices->push_back((OM_INDEX_TYPE)(firstIndex + vertexNo));
+			++indexCount;
+		});
+		state.knownVertexCount = vertexCount;
+		if((uint64_t)firstIndex + vertexCount > (uint64_t)(OM_INDEX_TYPE)(-1) + 1) {
+			OMLOGE(" - The %u vertices of the mesh do not fit the %d bit indices - they have wrapped around!",
+					vertexCount, (int)(sizeof(OM_INDEX_TYPE) * 8));
+		}
+
+		if(vertexCount > oldVertexCount) {
+			bounds = MeshBounds::merge(bounds, MeshBounds::compute(&(*vertexData)[baseVertexLocation + oldVertexCount], vertexCount - oldVertexCount));
+		}
+		if(!meshlets.empty() || !lods.empty() || !tangents.empty()) {
+			OMLOGW("The meshlets, LODs and tangents of the mesh are dropped as faces are appended to it!");
+			meshlets.clear();
+			meshletVertices.clear();
+			meshletTriangles.clear();
+			lods.clear();
+			lodIndices.clear();
+			tangents.clear();
+		}
+		return true;
+	}
+
+	/** Calls addFacePoint(facePoint) for all face-points of the face (triangulation of n-gons uses all of them too) */
+	template<typename AddFacePoint>
+	static inline void forEachFacePoint(const Obj &obj, const FaceElement &face, AddFacePoint addFacePoint) {
+		const FacePoint *points = obj.getFacePoints(face);
+		for(int j = 0; j < face.facePointCount; ++j) {
+			addFacePoint(points[j]);
+		}
+	}
+
+	/** Splits the faces into ranges of at most maxVertexCount unique keys (see ObjMeshObject::splitFaceRanges) */
+	template<typename Key, typename MakeKey>
+	static std::vector<std::pair<int, int>> splitFaceRangesBy(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount,
+			unsigned int maxVertexCount, MakeKey makeKey) {
+		std::vector<std::pair<int, int>> ranges;
+		int rangeStart = 0;
+		std::unique_ptr<VertexDedupTable<Key, char>> seen(new VertexDedupTable<Key, char>(maxVertexCount));
+		for(int i = 0; i < meshFaceCount; ++i) {
+			const FaceElement &face = meshFaces[i];
+			if(face.facePointCount < 3) {
+				// Skipped by the building too
+				continue;
+			}
+			// Count the new vertices first so the face can go into the next range if it does not fit
+			unsigned int newCount = 0;
+			forEachFacePoint(obj, face, [&](const FacePoint &fp) {
+				if(seen->find(makeKey(obj, fp)) == nullptr) {
+					++newCount;
+				}
+			});
+			if((seen->size() + newCount > maxVertexCount) && (i > rangeStart)) {
+				ranges.push_back(std::make_pair(rangeStart, i - rangeStart));
+				rangeStart = i;
+				seen.reset(new VertexDedupTable<Key, char>(maxVertexCount));
+			}
+			forEachFacePoint(obj, face, [&](const FacePoint &fp) {
+				seen->findOrInsert(makeKey(obj, fp), 0);
+			});
+		}
+		if((meshFaceCount > rangeStart) || ranges.empty()) {
+			ranges.push_back(std::make_pair(rangeStart, meshFaceCount - rangeStart));
+		}
+		return ranges;
+	}
+
+	/** The number of unique keys of the triangle corners of the faces - the vertex count of their mesh */
+	template<typename Key, typename MakeKey>
+	static unsigned int countUniqueCorners(const Obj& obj, const FaceElement *faces, int faceCount, MakeKey makeKey) {
+		VertexDedupTable<Key, char> seen(faceCount);
+		forEachTriangleCorner(obj, faces, faceCount, [&](const FacePoint &fp) {
+			seen.findOrInsert(makeKey(obj, fp), 0);
+		});
+		return (unsigned int)seen.size();
+	}
+
+	/**
+	 * Adds the face range to the output if its mesh fits maxVertexCount with the normals generated
+	 * for exactly those faces (like the build does) - otherwise it is split further and the parts
+	 * are checked the same way. The normal generation splits vertices by smoothing groups and
+	 * creases, which the counting of splitFaceRangesBy cannot see.
+	 */
+	static void addRangesFittingGeneratedNormals(const Obj& obj, const FaceElement *meshFaces, std::pair<int, int> range,
+			unsigned int maxVertexCount, ObjMeshObject::MeshBuildFlags buildFlags, std::vector<std::pair<int, int>> &output) {
+		std::vector<FaceElement> triangles;
+		std::vector<VertexNormalElement> generatedNormals;
+		if((range.second <= 1) || !generateMissingNormals(obj, &meshFaces[range.first], range.second, normalCreaseAngle(buildFlags),
+				nullptr, triangles, generatedNormals)) {
+			output.push_back(range);
+			return;
+		}
+		FacePointSlicer slicer { generatedNormals.empty() ? nullptr : &generatedNormals[0] };
+		unsigned int vertexCount = ((buildFlags & ObjMeshObject::MeshBuildFlags::DEDUP_BY_INDEX) != 0) ?
+				countUniqueCorners<FacePointIndexKey>(obj, &triangles[0], (int)triangles.size(),
+						[](const Obj &, const FacePoint &fp) { return FacePointIndexKey { fp.vIndex, fp.vtIndex, fp.vnIndex }; }) :
+				countUniqueCorners<IndexTargetSlice>(obj, &triangles[0], (int)triangles.size(), slicer);
+		if(vertexCount <= maxVertexCount) {
+			output.push_back(range);
+			return;
+		}
+		// Split again with the limit shrunk by the ratio of the overflow - or just halve it if that gives one range
+		unsigned int shrunkLimit = (unsigned int)((uint64_t)maxVertexCount * maxVertexCount / vertexCount);
+		std::vector<std::pair<int, int>> parts = ObjMeshObject::splitFaceRanges(obj, &meshFaces[range.first], range.second, shrunkLimit,
+				(ObjMeshObject::MeshBuildFlags)(buildFlags & ~ObjMeshObject::MeshBuildFlags::GENERATE_NORMALS));
+		if(parts.size() <= 1) {
+			int half = range.second / 2;
+			parts = { std::make_pair(0, half), std::make_pair(half, range.second - half) };
+		}
+		for(auto &part : parts) {
+			addRangesFittingGeneratedNormals(obj, meshFaces, std::make_pair(range.first + part.first, part.second),
+					maxVertexCount, buildFlags, output);
+		}
+	}
+
+	std::vector<std::pair<int, int>> ObjMeshObject::splitFaceRanges(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount,
+			unsigned int maxVertexCount, MeshBuildFlags buildFlags) {
+		std::vector<std::pair<int, int>> ranges;
+		if((buildFlags & MeshBuildFlags::DEDUP_BY_INDEX) != 0) {
+			ranges = splitFaceRangesBy<FacePointIndexKey>(obj, meshFaces, meshFaceCount, maxVertexCount,
+					[](const Obj &, const FacePoint &fp) { return FacePointIndexKey { fp.vIndex, fp.vtIndex, fp.vnIndex }; });
+		} else {
+			ranges = splitFaceRangesBy<IndexTargetSlice>(obj, meshFaces, meshFaceCount, maxVertexCount, sliceFor);
+		}
+		if((buildFlags & MeshBuildFlags::GENERATE_NORMALS) == 0) {
+			return ranges;
+		}
+		std::vector<std::pair<int, int>> fittingRanges;
+		for(auto &range : ranges) {
+			addRangesFittingGeneratedNormals(obj, meshFaces, range, maxVertexCount, buildFlags, fittingRanges);
+		}
+		return fittingRanges;
+	}
+
+	template<typename Vertex>
+	LayoutMeshObject<Vertex>::LayoutMeshObject(const Obj& obj, ObjMeshObject::MeshBuildFlags buildFlags) {
+		creationHelper(obj, obj.fs.empty() ? nullptr : &obj.fs[0], (int)obj.fs.size(), buildFlags);
+	}
+
+	template<typename Vertex>
+	LayoutMeshObject<Vertex>::LayoutMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount,
+			ObjMeshObject::MeshBuildFlags buildFlags) {
+		creationHelper(obj, meshFaces, meshFaceCount, buildFlags);
+	}
+
+	template<typename Vertex>
+	void LayoutMeshObject<Vertex>::creationHelper(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount,
+			ObjMeshObject::MeshBuildFlags buildFlags) {
+		typedef VertexLayoutTraits<Vertex> Traits;
+		const bool hasNormals = ((Traits::ATTRIBUTES & NORMAL_ATTRIBUTES) != 0);
+		const bool hasTexCoords = ((Traits::ATTRIBUTES & TEXCOORD_ATTRIBUTES) != 0);
+		bool dedupByIndex = ((buildFlags & ObjMeshObject::MeshBuildFlags::DEDUP_BY_INDEX) != 0);
+
+		// Normals are only generated when the layout has them
+		std::vector<FaceElement> normalTriangles;
+		std::vector<VertexNormalElement> generatedNormals;
+		if(hasNormals && ((buildFlags & ObjMeshObject::MeshBuildFlags::GENERATE_NORMALS) != 0) &&
+		   generateMissingNormals(obj, meshFaces, meshFaceCount, normalCreaseAngle(buildFlags), nullptr,
+				   normalTriangles, generatedNormals)) {
+			meshFaces = normalTriangles.empty() ? nullptr : &normalTriangles[0];
+			meshFaceCount = (int)normalTriangles.size();
+		}
+		FacePointSlicer slicer { generatedNormals.empty() ? nullptr : &generatedNormals[0] };
+
+		// Same reservations as in ObjMeshObject
+		indices.reserve(triangleCornerCount(meshFaces, meshFaceCount));
+		vertexData.reserve(meshFaceCount);
+		VertexDedupTable<LayoutVertexKey<Vertex>, OM_INDEX_TYPE> byValue(dedupByIndex ? 0 : meshFaceCount);
+		VertexDedupTable<FacePointIndexKey, OM_INDEX_TYPE> byIndex(dedupByIndex ? meshFaceCount : 0);
+		OM_INDEX_TYPE nextIndex = 0;
+
+		forEachTriangleCorner(obj, meshFaces, meshFaceCount, [&](const FacePoint &fp) {
+			IndexTargetSlice its = slicer(obj, fp);
+			Vertex vertex = Traits::make(its.v, its.vt, its.vn);
+			// Indices of the attributes that are not in the layout must not make a difference
+			const OM_INDEX_TYPE *handledIndex = dedupByIndex ?
+					byIndex.findOrInsert(FacePointIndexKey { fp.vIndex, hasTexCoords ? fp.vtIndex : 0, hasNormals ? fp.vnIndex : 0 }, nextIndex) :
+					byValue.findOrInsert(LayoutVertexKey<Vertex> { vertex }, nextIndex);
+			if(handledIndex != nullptr) {
+				indices.push_back(*handledIndex);
+			} else {
+				vertexData.push_back(vertex);
+				indices.push_back(nextIndex);
+				++nextIndex;
+			}
+		});
+		vertexCount = (unsigned int)vertexData.size();
+		indexCount = (unsigned int)indices.size();
+		bounds = MeshBounds::compute(vertexCount > 0 ? &vertexData[0].x : nullptr, sizeof(Vertex), vertexCount);
+		inited = true;
+
+		// Optional post-processing - the same passes as for ObjMeshObject
+		if(indexCount >= 3) {
+			if((buildFlags & ObjMeshObject::MeshBuildFlags::OPTIMIZE_VERTEX_CACHE) != 0) {
+				MeshOptimizer::optimizeVertexCache(&indices[0], indexCount, 0, vertexCount);
+			}
+			if((buildFlags & ObjMeshObject::MeshBuildFlags::OPTIMIZE_OVERDRAW) != 0) {
+				MeshOptimizer::optimizeOverdraw(&indices[0], indexCount, &vertexData[0].x, sizeof(Vertex), 0, vertexCount);
+			}
+			if((buildFlags & ObjMeshObject::MeshBuildFlags::OPTIMIZE_VERTEX_FETCH) != 0) {
+				MeshOptimizer::optimizeVertexFetch((void *)&vertexData[0], sizeof(Vertex), &indices[0], indexCount, 0, vertexCount);
+			}
+			if((buildFlags & ObjMeshObject::MeshBuildFlags::BUILD_MESHLETS) != 0) {
+				MeshletBuilder::buildMeshlets(&indices[0], indexCount, &vertexData[0].x, sizeof(Vertex), 0, vertexCount,
+						meshlets, meshletVertices, meshletTriangles);
+			}
+		}
+	}
+
+	// The supported layouts
+	template class LayoutMeshObject<PositionVertexStructure>;
+	template class LayoutMeshObject<PositionNormalVertexStructure>;
+	template class LayoutMeshObject<PositionTexCoordVertexStructure>;
+	template class LayoutMeshObject<VertexStructure>;
+
+	bool ObjMeshObject::toCompactVertices(std::vector<CompactVertexStructure> &output, VertexQuantization &quantization) const {
+		if(!inited) {
+			OMLOGE("Cannot emit compact vertices of a not inited mesh!");
+			return false;
+		}
+		const VertexStructure *meshVertices = (vertexCount > 0) ? &(*vertexData)[baseVertexLocation] : nullptr;
+		quantization = VertexCompression::computeQuantization(meshVertices, vertexCount);
+		output.resize(vertexCount);
+		if(vertexCount > 0) {
+			VertexCompression::compress(meshVertices, vertexCount, quantization, &output[0]);
+		}
+		return true;
+	}
 }
@@ -8,8 +8,13 @@
 #include "Obj.h"
 #include "FaceElement.h"
 #include "VertexStructure.h"
+#include "CompactVertexStructure.h"
+#include "MeshletStructure.h"
+#include "BoundsStructure.h"
+#include "TangentStructure.h"
 #include <memory>
 #include <vector>
+#include <utility>
 #include <stdint.h>
 
 // Define this if your device only handles 16 bit indices and want to build like that!
@@ -24,6 +29,52 @@
 #endif /* USE_16BIT_INDICES */
 
 namespace ObjMaster {
+    class ThreadPool;
+    class ObjMeshObject;
+    class MeshAppendState;
+
+    // Rem.: The vertex de-duplication tables kept alive between builds - only defined in ObjMeshObject.cpp
+    struct MeshDedupTables;
+
+    /**
+     * One vertex and one index vector that more meshes get built into, with the vertices
+     * de-duplicated across the meshes: a vertex that an earlier mesh already added is only
+     * referred to. This way a whole model is one allocation (and one upload) for each buffer.
+     * The de-duplication tables are only kept until finishBuilding() is called. Not copyable as
+     * the meshes built into the buffers point at these very vectors.
+     */
+    class SharedMeshBuffers final {
+    public:
+        /** The vertices of all the meshes (see ObjMeshObject::baseVertexLocation) */
+        std::vector<VertexStructure> vertexData;
+        /** The indices of all the meshes - these are local to the range of their mesh */
+        std::vector<OM_INDEX_TYPE> indices;
+
+        /** Create empty buffers - the expected count is a hint for presizing (like the face count of the model) */
+        SharedMeshBuffers(size_t expectedVertexCount = 0);
+        ~SharedMeshBuffers();
+
+        SharedMeshBuffers(const SharedMeshBuffers &other) = delete;
+        SharedMeshBuffers& operator=(const SharedMeshBuffers &other) = delete;
+
+        /** Frees the de-duplication tables: meshes built after this do not share vertices with the earlier ones */
+        void finishBuilding();
+    private:
+        std::unique_ptr<MeshDedupTables> tables;
+
+        friend class ObjMeshObject;
+    };
+
+    /** One simplified level of detail of a mesh: a range of its lodIndices (see MeshSimplifier) */
+    struct MeshLod {
+        /** The first index of the level in lodIndices */
+        unsigned int indexOffset;
+        /** The number of indices of the level */
+        unsigned int indexCount;
+        /** The error of the simplification - relative to the extent of the mesh */
+        float error;
+    };
+
     /**
      * A 3d mesh out of a *.OBJ file. This can be used to show the object in a scene as it has proper
      * buffers one can use with most CG rendering methods (like OpenGL).
@@ -94,18 +145,146 @@ namespace ObjMaster {
 	unsigned int vertexCount;
 	/** The biggest index value that belongs to this mesh */
 	OM_INDEX_TYPE lastIndex;
+	/** The bounding box and sphere of the vertices of this mesh - computed while building it */
+	BoundingVolume bounds = BoundingVolume { 0, 0, 0, 0, 0, 0, 0, 0, 0, -1 };
+
+	// Optional clusters of the mesh (see BUILD_MESHLETS and MeshletBuilder) - always owned
+	/** The meshlet descriptors with their culling data - empty when no meshlets were built */
+	std::vector<Meshlet> meshlets;
+	/** The vertices of the meshlets as mesh-local vertex numbers (from baseVertexLocation) */
+	std::vector<uint32_t> meshletVertices;
+	/** The triangles of the meshlets: three indices per triangle into the vertex list of the meshlet */
+	std::vector<uint8_t> meshletTriangles;
+
+	// Optional levels of detail (see BUILD_LODS and MeshSimplifier) - always owned
+	/** The levels from the most detailed to the least detailed one - empty when no LODs were built */
+	std::vector<MeshLod> lods;
+	/**
+	 * The indices of all levels. These are just like the values in indices: they refer to the very
+	 * same vertices (from baseVertexLocation) so only the index data is extra for the levels.
+	 */
+	std::vector<OM_INDEX_TYPE> lodIndices;
+
+	// Optional tangent space (see GENERATE_TANGENTS and TangentGenerator) - always owned
+	/** One tangent for each vertex of the mesh (from baseVertexLocation) - empty when not generated */
+	std::vector<TangentStructure> tangents;
+
+	// Rem.: bit trickery here
+	/** Defines how the mesh building finds the face points that can share one vertex */
+	enum MeshBuildFlags{
+		/**
+		 * Face points that refer to the very same position, texcoord and normal values share
+		 * one vertex - even if the obj file has these values duplicated under different indices.
+		 */
+		DEDUP_BY_VALUE = 0,
+		/**
+		 * Only face points with the very same v/vt/vn indices share one vertex. This is faster
+		 * as the lookups do not need to read the float data, but duplicated values of the obj
+		 * file end up as separate vertices. The result is the same for files without duplicates.
+		 */
+		DEDUP_BY_INDEX = 1,
+		/**
+		 * De-duplicate huge meshes in parallel: the faces are cut to ranges that get their own
+		 * tables on the threads of a pool and the partial results are merged. The result is the
+		 * very same as with the serial build. Meshes with less than 2*MIN_PARALLEL_DEDUP_FACES
+		 * faces are always built serially. Ignored (with a warning) for shared buffers.
+		 */
+		PARALLEL_DEDUP = 2,
+		/** Both of the above */
+		PARALLEL_DEDUP_BY_INDEX = 1+2,
+		/**
+		 * Reorder the triangles for better post-transform vertex cache usage after building the
+		 * mesh (see MeshOptimizer::optimizeVertexCache). The triangles stay the same, only their
+		 * order changes. Worth it for meshes that are rendered many times.
+		 */
+		OPTIMIZE_VERTEX_CACHE = 4,
+		/**
+		 * Reorder clusters of triangles so that the ones facing outwards are drawn first - this
+		 * reduces overdraw for the price of a slightly (see MeshOptimizer::optimizeOverdraw)
+		 * worse vertex cache usage. Runs after OPTIMIZE_VERTEX_CACHE when both are set.
+		 */
+		OPTIMIZE_OVERDRAW = 8,
+		/**
+		 * Renumber the vertices of the mesh in the order of their first use in the (final) index
+		 * buffer so the vertex data is fetched almost linearly. Always runs as the last pass.
+		 * Ignored (with a warning) for shared buffers as other meshes use the vertices too.
+		 */
+		OPTIMIZE_VERTEX_FETCH = 16,
+		/** All of the above optimization passes */
+		OPTIMIZE_ALL = 4+8+16,
+		/**
+		 * Only used when building models (see MaterializedObjModel): groups that have more unique
+		 * vertices than MAX_16BIT_INDEXED_VERTICES are split into more meshes (see splitFaceRanges)
+		 * so that every mesh fits 16 bit indices. Single meshes ignore this flag.
+		 */
+		SPLIT_FOR_16BIT_INDICES = 32,
+		/**
+		 * Partition the (final) index buffer of the mesh into meshlets with the default limits
+		 * of MeshletBuilder after all optimization passes. The index buffer itself stays usable.
+		 */
+		BUILD_MESHLETS = 64,
+		/**
+		 * Build the default LOD chain of MeshSimplifier (with locked borders) after all optimization
+		 * passes - the levels only add index data (see lods and lodIndices).
+		 */
+		BUILD_LODS = 128,
+		/**
+		 * Generate area-weighted normals (see NormalGenerator) for the face points without a
+		 * normal instead of leaving them zero. The 's' smoothing groups of the Obj are respected:
+		 * faces only share normals with the faces of their own group and 's off' faces are flat.
+		 * Face points that have their normals in the file are not changed. The ranges of
+		 * SPLIT_FOR_16BIT_INDICES count the vertices the generated normals split too.
+		 */
+		GENERATE_NORMALS = 256,
+		/**
+		 * Together with GENERATE_NORMALS: also keep the edges sharper than the crease angle of
+		 * NormalGenerator::DEFAULT_CREASE_ANGLE hard - even within one smoothing group.
+		 */
+		CREASE_NORMALS = 512,
+		/** Both of the above */
+		GENERATE_CREASED_NORMALS = 256+512,
+		/**
+		 * Generate MikkTSpace-like tangents (see TangentGenerator and tangents) after the
+		 * optimization passes. Vertices shared by triangles of mirrored and not mirrored texture
+		 * coordinates get split (appended after the other vertices of the mesh). The splits are
+		 * refused (no tangents) when they would not fit the indices - or the 16 bit range of a
+		 * mesh of SPLIT_FOR_16BIT_INDICES. Materialized meshes only do this when their material
+		 * has a bump map (F_MAP_BUMP). Ignored (with a warning) for shared buffers as the splits
+		 * would change the ranges of other meshes.
+		 */
+		GENERATE_TANGENTS = 1024,
+	};
+
+	/**
+	 * Meshes with at most this many vertices can use 16 bit (local) indices. Rem.: 0xFFFF itself is
+	 * kept free as many APIs use it as the primitive restart index.
+	 */
+	static const unsigned int MAX_16BIT_INDEXED_VERTICES = 0xFFFF;
+
+	/** The build flags that the meshes of shared buffers ignore (see the SharedMeshBuffers constructor) */
+	static const MeshBuildFlags SHARED_BUFFERS_IGNORED_FLAGS =
+			(MeshBuildFlags)(OPTIMIZE_VERTEX_FETCH | GENERATE_TANGENTS | PARALLEL_DEDUP);
+
+	/** Parallel de-duplication does not use more threads than what gives this many faces to each */
+	static const int MIN_PARALLEL_DEDUP_FACES = 16 * 1024;
+
         // Empty constructor
         ObjMeshObject() {};
 
         /** Create an obj mesh object using all faces available in the given Obj */
-        ObjMeshObject(const Obj& obj);
+        ObjMeshObject(const Obj& obj, MeshBuildFlags buildFlags = MeshBuildFlags::DEDUP_BY_VALUE, ThreadPool *threadPool = nullptr);
 
         /**
          * Create and obj mesh object using the explicitly given faces from the given Obj.
          * The parameter variables should be in synch with each other and refer to data from the
-         * same *.obj file / same Obj data.
+         * same *.obj file / same Obj data. N-gon faces are triangulated using the face-point pool
+         * of the given Obj (fan for convex and ear clipping for concave polygons).
+         *
+         * The (not owned) thread pool is only used with PARALLEL_DEDUP: when it is nullptr, a
+         * temporary pool is created for big meshes. The pool should not be busy with another
+         * parallelFor(..) that is building this mesh (the pool is not reentrant).
          */
-        ObjMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount);
+        ObjMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount, MeshBuildFlags buildFlags = MeshBuildFlags::DEDUP_BY_VALUE, ThreadPool *threadPool = nullptr);
 
         /**
          * Create and obj mesh object using the explicitly given faces from the given Obj.
@@ -121,7 +300,21 @@ namespace ObjMaster {
 	 * defining from which point the indices should start. Basically this should be max(indexVector)
 	 * if the indexVector is a non-null and non-empty pointer and zero otherwise!!!
          */
-        ObjMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount, std::vector<VertexStructure> *vertexVector, std::vector<OM_INDEX_TYPE> *indexVector, OM_INDEX_TYPE lastIndexBase);
+        ObjMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount, std::vector<VertexStructure> *vertexVector, std::vector<OM_INDEX_TYPE> *indexVector, OM_INDEX_TYPE lastIndexBase, MeshBuildFlags buildFlags = MeshBuildFlags::DEDUP_BY_VALUE, ThreadPool *threadPool = nullptr);
+
+        /**
+         * Create an obj mesh object using the explicitly given faces into the (not owned) shared
+         * buffers: the vertices that earlier meshes of the buffers have are reused (de-duplicated
+         * by the same rules as in the mesh). The mesh-range starts at the first vertex the mesh
+         * uses and the indices are local to it (from zero to lastIndex), so the meshes should be
+         * drawn with baseVertexLocation as the base vertex. The ranges of the meshes can overlap,
+         * so OPTIMIZE_VERTEX_FETCH and GENERATE_TANGENTS are ignored here (they would change the
+         * vertices of other meshes) and so is PARALLEL_DEDUP - a warning is logged when given.
+         * Earlier vertices are not reused when that would make the range too big for 16 bit
+         * indices (they are stored again instead). The buffers should outlive the mesh.
+         */
+        ObjMeshObject(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount, SharedMeshBuffers &sharedBuffers,
+                MeshBuildFlags buildFlags = MeshBuildFlags::DEDUP_BY_VALUE);
 
 	/**
 	 * The copy ctor - necessary because of the possible pointer sharing stuff!
@@ -147,15 +340,102 @@ namespace ObjMaster {
 	 */
 	ObjMeshObject& operator=(ObjMeshObject&& other);
 
+	/**
+	 * Emits the vertices of this mesh (only the per-mesh range of a shared vertex vector) in the
+	 * compact layout: the output gets vertexCount elements and the quantization gets the
+	 * transformation that gives back the positions (see CompactVertexStructure.h). The indices
+	 * can be used as they are. Returns false (leaving the outputs untouched) if not inited.
+	 */
+	bool toCompactVertices(std::vector<CompactVertexStructure> &output, VertexQuantization &quantization) const;
+
+	/**
+	 * The number of bytes per index this mesh needs when using local indices (see below): 2 when
+	 * the mesh fits 16 bit indices and 4 otherwise. This is independent of OM_INDEX_TYPE.
+	 */
+	inline unsigned int getIndexWidth() const { return (vertexCount <= MAX_16BIT_INDEXED_VERTICES) ? 2 : 4; }
+
+	/**
+	 * Copies the indices of this mesh as local indices (the first vertex of the mesh range is zero,
+	 * so these refer to the vertexCount vertices from baseVertexLocation) in 16 bits. Returns false
+	 * (leaving the output untouched) if the mesh does not fit 16 bit indices (see getIndexWidth).
+	 */
+	bool getLocalIndices16(std::vector<uint16_t> &output) const;
+
+	/**
+	 * Copies the indices of this mesh as local indices (see above) in 32 bits. Returns false (leaving
+	 * the output untouched) if the mesh needs wider indices than OM_INDEX_TYPE - the stored indices
+	 * of such meshes are wrapped around, so they cannot be made local (see USE_16BIT_INDICES).
+	 */
+	bool getLocalIndices32(std::vector<uint32_t> &output) const;
+
+	/**
+	 * Makes this mesh draw the geometry of the prototype (see MeshInstancing): the own vertex and
+	 * index vectors are freed (when owned) and the ones of the prototype are referred (not owned)
+	 * with its ranges. The meshlets, LODs and tangents are copied from the prototype too. Only the
+	 * bounds stay the ones of this mesh, as the instance transform places the prototype geometry
+	 * there. The prototype should outlive this mesh (or the pointers should be set again).
+	 */
+	void shareGeometryOf(const ObjMeshObject &prototype);
+
+	/**
+	 * Splits the given faces into consecutive ranges so that the mesh of each range has at most
+	 * maxVertexCount vertices when built with the given (de-duplication) flags. Returns the ranges
+	 * as (offset from meshFaces, face count) pairs - just one range when everything fits.
+	 * With GENERATE_NORMALS the normals are generated for the ranges (like for their meshes) and
+	 * the ranges that do not fit because of the split vertices are split further.
+	 * A single face is never split, so maxVertexCount should be at least the biggest face size.
+	 */
+	static std::vector<std::pair<int, int>> splitFaceRanges(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount,
+			unsigned int maxVertexCount = MAX_16BIT_INDEXED_VERTICES, MeshBuildFlags buildFlags = MeshBuildFlags::DEDUP_BY_VALUE);
+
+	/**
+	 * Appends the triangles of the given faces to this mesh: only the new faces are de-duplicated,
+	 * the vertices of the mesh are looked up in the tables of the state that is kept between the
+	 * appends. The new vertices and indices go to the end of the vectors of the mesh, so the ones
+	 * already there (and uploaded) stay the same - the ranges from the earlier vertexCount and
+	 * indexCount on are the changed ones. The mesh should be the last one in its vectors (like
+	 * owned ones). De-duplication is done by the flags of the state - other build flags are not
+	 * applied and the meshlets, LODs and tangents are dropped as they would not cover the new
+	 * faces. Returns false (and changes nothing) if the faces cannot be appended.
+	 */
+	bool appendFaces(const Obj& obj, const FaceElement *faces, int faceCount, MeshAppendState &state);
+
 	// The destructor needs to delete the pointed vectors only in case we own them!
 	~ObjMeshObject() {
 		if (ownsVertexData) { delete vertexData; }
 		if (ownsIndices) { delete indices; }
 	}
     private:
-        void creationHelper(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount, std::vector<VertexStructure> *vertexVector, std::vector<OM_INDEX_TYPE> *indexVector, OM_INDEX_TYPE lastIndexBase);
+        void creationHelper(const Obj& obj, const FaceElement *meshFaces, int meshFaceCount, std::vector<VertexStructure> *vertexVector, std::vector<OM_INDEX_TYPE> *indexVector, OM_INDEX_TYPE lastIndexBase, MeshBuildFlags buildFlags, ThreadPool *threadPool, SharedMeshBuffers *sharedBuffers = nullptr);
 	void copyHelper(const ObjMeshObject &other);
 	void moveHelper(ObjMeshObject &&other);
     };
+
+    /**
+     * The de-duplication state of a mesh that faces get appended to (see ObjMeshObject::appendFaces).
+     * The vertices the mesh already had on the first append are added to the tables then - with
+     * DEDUP_BY_INDEX only the appended face points can be found (so the mesh should start empty).
+     * Keys by value tell missing elements from zero values just like the mesh build, so an empty
+     * mesh that gets all the faces appended is the same as the one built from them at once.
+     */
+    class MeshAppendState final {
+    public:
+        /** Create the state for the de-duplication given by the build flags - the expected count is a hint for presizing */
+        MeshAppendState(ObjMeshObject::MeshBuildFlags buildFlags = ObjMeshObject::MeshBuildFlags::DEDUP_BY_VALUE,
+                size_t expectedVertexCount = 0);
+        ~MeshAppendState();
+
+        MeshAppendState(MeshAppendState &&other);
+        MeshAppendState& operator=(MeshAppendState &&other);
+        MeshAppendState(const MeshAppendState &other) = delete;
+        MeshAppendState& operator=(const MeshAppendState &other) = delete;
+    private:
+        ObjMeshObject::MeshBuildFlags buildFlags;
+        /** The number of mesh vertices that are already in the tables */
+        unsigned int knownVertexCount;
+        std::unique_ptr<MeshDedupTables> tables;
+
+        friend class ObjMeshObject;
+    };
 }
 #endif
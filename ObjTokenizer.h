@@ -0,0 +1,277 @@
+//
+// Single-pass, pointer-advancing tokenizer helpers used by the element parsers.
+//
+// All of these work on a [p, end) character range and never modify it, so they can
+// parse right out of memory mapped data without copying lines or needing a zero terminator.
+//
+
+#ifndef _OBJMASTER_OBJ_TOKENIZER_H
+#define _OBJMASTER_OBJ_TOKENIZER_H
+
+#include <cstdint>
+#include <cstdlib>  /* strtod */
+#include <cstring>  /* memcpy */
+#include <cfloat>   /* FLT_EVAL_METHOD */
+#include <string>   /* long tokens */
+#include "objmasterlog.h"
+
+// The fast float path is only exact when double operations are not evaluated in higher precision
+// (otherwise the product / quotient below can get rounded twice). On such targets (like x87) we
+// always use the strtod fallback - this keeps the results bit-identical with the earlier atof.
+#if !defined(FLT_EVAL_METHOD) || (FLT_EVAL_METHOD == 0)
+#define OBJMASTER_FAST_FLOAT_PATH 1
+#endif
+
+namespace ObjMaster {
+
+    class ObjTokenizer final {
+    public:
+        /** Whitespace that separates tokens of a line (the '\r' of windows line endings included) */
+        static inline bool isSpace(char c) {
+            return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\v') || (c == '\f');
+        }
+
+        /** Separator right after the element keys (like in "v 1.0 2.0 3.0") - only space or tab */
+        static inline bool isBlank(char c) {
+            return (c == ' ') || (c == '\t');
+        }
+
+        static inline bool isDigit(char c) {
+            return (unsigned char)(c - '0') < 10;
+        }
+
+        /** Returns the first non-space position in [p, end) - or end */
+        static inline const char* skipSpaces(const char *p, const char *end) {
+            while((p < end) && isSpace(*p)) ++p;
+            return p;
+        }
+
+        /** Returns the position right after the current token (the first space position) - or end */
+        static inline const char* skipToken(const char *p, const char *end) {
+            while((p < end) && !isSpace(*p)) ++p;
+            return p;
+        }
+
+        /**
+         * Returns true if [p, end) starts with the given keyword that is followed by a space or
+         * the end of the range. Useful for "usemtl", "mtllib" and similar multi-character keys.
+         */
+        static inline bool isKeyword(const char *p, const char *end, const char *keyword) {
+            size_t len = strlen(keyword);
+            return ((size_t)(end - p) >= len)
+                && (memcmp(p, keyword, len) == 0)
+                && ((p + len == end) || isSpace(p[len]));
+        }
+
+        /**
+         * Parses a float from the range and advances p after it. Leading spaces are skipped.
+         * The result is exactly the same as (float)atof(token) would give: simple decimal numbers
+         * are converted with the exact fast path of Clinger's algorithm, everything else (long
+         * mantissas, big exponents, inf, nan, hex floats...) falls back to strtod on a copy of the token.
+         * Returns 0 when there is no more token in the range.
+         */
+        static inline float parseFloat(const char *&p, const char *end) {
+            p = skipSpaces(p, end);
+            const char *start = p;
+
+            bool negative = false;
+            if((p < end) && ((*p == '-') || (*p == '+'))) {
+                negative = (*p == '-');
+                ++p;
+            }
+
+            // Collect the significant digits into the mantissa and count the decimal exponent
+            uint64_t mantissa = 0;
+            int significantDigits = 0;
+            int exponent = 0;
+            bool anyDigit = false;
+            while((p < end) && isDigit(*p)) {
+                if((mantissa != 0) || (*p != '0')) ++significantDigits;
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                anyDigit = true;
+                ++p;
+            }
+            if((p < end) && (*p == '.')) {
+                ++p;
+                while((p < end) && isDigit(*p)) {
+                    if((mantissa != 0) || (*p != '0')) ++significantDigits;
+                    mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                    --exponent;
+                    anyDigit = true;
+                    ++p;
+                }
+            }
+            // Exponent part - only when there are digits after the (signed) 'e' just like strtod
+            if(anyDigit && (p < end) && ((*p == 'e') || (*p == 'E'))) {
+                const char *ep = p + 1;
+                bool expNegative = false;
+                if((ep < end) && ((*ep == '-') || (*ep == '+'))) {
+                    expNegative = (*ep == '-');
+                    ++ep;
+                }
+                if((ep < end) && isDigit(*ep)) {
+                    int expValue = 0;
+                    while((ep < end) && isDigit(*ep)) {
+                        // Saturate - anything this big is handled by the slow path anyways
+                        if(expValue < 100000) expValue = expValue * 10 + (*ep - '0');
+                        ++ep;
+                    }
+                    exponent += expNegative ? -expValue : expValue;
+                    p = ep;
+                }
+            }
+
+#ifdef OBJMASTER_FAST_FLOAT_PATH
+            // Fast path: the whole token is a plain decimal number with an exactly representable
+            // mantissa and power of ten - in this case one multiplication / division is exact.
+            if(anyDigit && ((p == end) || isSpace(*p)) && (significantDigits <= 19)) {
+                if(mantissa == 0) {
+                    return negative ? -0.0f : 0.0f;
+                }
+                if((mantissa <= (1ull << 53)) && (exponent >= -22) && (exponent <= 22)) {
+                    static const double POW10[] = {
+                        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+                    };
+                    double value = (double)mantissa;
+                    value = (exponent < 0) ? (value / POW10[-exponent]) : (value * POW10[exponent]);
+                    return (float)(negative ? -value : value);
+                }
+            }
+#endif
+            // Slow path: let the C library handle the token
+            p = skipToken(start, end);
+            return slowParseFloat(start, p);
+        }
+
+        /**
+         * Parses a (signed) decimal integer from the range and advances p after it the same way atoi
+         * would do. Returns false and leaves p and value untouched if there are no digits at p.
+         */
+        static inline bool parseInt(const char *&p, const char *end, int &value) {
+            const char *q = p;
+            bool negative = false;
+            if((q < end) && ((*q == '-') || (*q == '+'))) {
+                negative = (*q == '-');
+                ++q;
+            }
+            if((q >= end) || !isDigit(*q)) {
+                return false;
+            }
+            unsigned int result = 0;
+            while((q < end) && isDigit(*q)) {
+                result = result * 10 + (unsigned int)(*q - '0');
+                ++q;
+            }
+            value = (int)(negative ? (0u - result) : result);
+            p = q;
+            return true;
+        }
+
+        /**
+         * Parses one v, v/vt, v//vn or v/vt/vn face point token and advances p after the token.
+         * Indices in the file start from 1, the returned ones start from zero.
+         * Missing indices are returned as (unsigned int)-1 just like it is in FacePoint.
+         */
+        static inline void parseIndexTriplet(const char *&p, const char *end,
+                unsigned int &vIndex, unsigned int &vtIndex, unsigned int &vnIndex) {
+            int value;
+            vIndex = vtIndex = vnIndex = (unsigned int)-1;
+            if(parseInt(p, end, value)) vIndex = (unsigned int)(value - 1);
+            if((p < end) && (*p == '/')) {
+                ++p;
+                if(parseInt(p, end, value)) vtIndex = (unsigned int)(value - 1);
+                if((p < end) && (*p == '/')) {
+                    ++p;
+                    if(parseInt(p, end, value)) vnIndex = (unsigned int)(value - 1);
+                }
+            }
+            // Skip anything unexpected that still belongs to this token
+            p = skipToken(p, end);
+        }
+
+    private:
+        static inline float slowParseFloat(const char *tokenStart, const char *tokenEnd) {
+            // Usual tokens fit on the stack - longer ones (like numbers with many digits) are
+            // copied to the heap with their whole length, so no characters are lost
+            char copy[128];
+            size_t len = (size_t)(tokenEnd - tokenStart);
+            if(len > sizeof(copy) - 1) {
+                std::string longCopy(tokenStart, len);
+                return (float)strtod(longCopy.c_str(), nullptr);
+            }
+            memcpy(copy, tokenStart, len);
+            copy[len] = 0;
+            return (float)strtod(copy, nullptr);
+        }
+    };
+
+// Very simple unit-testing approach
+// it is better to have these run on the device itself and callable as normal functions than to
+// test it compile-time with some unit testing framework as this way we rule out architectural
+// differences better. Tests will start by logging test starts to error (when #DEBUG is set!)
+// and info logs and the method returns false when anything has failed...
+    static bool TEST_ObjTokenizer() {
+#ifdef DEBUG
+        OMLOGI("TEST_ObjTokenizer...");
+#endif
+        // The parsers should give the very same floats as atof does
+        // Rem.: The last one is longer than the stack buffer of the slow path
+        const char *floats[] = { "1.0", "-2.5", "0.000123", "-0", "3.14159265358979", "1e-3",
+                                 "6.02E+23", "123456789012345678901", "inf", "0x1p3", "1.0f",
+                                 "0.000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000001e+137" };
+        for(const char *f : floats) {
+            const char *p = f;
+            float parsed = ObjTokenizer::parseFloat(p, f + strlen(f));
+            float expected = (float)atof(f);
+            if((memcmp(&parsed, &expected, sizeof(float)) != 0) || (*p != 0)) {
+                OMLOGE("Bad float parse of %s: %f instead of %f", f, parsed, expected);
+                return false;
+            }
+        }
+
+        // Ranges must not be read over their end (there is no zero terminator in mapped files)
+        const char *line = "v 1.5 2.25 3.125999";
+        const char *p = line + 1;
+        const char *end = line + 16; // "v 1.5 2.25 3.125"
+        float x = ObjTokenizer::parseFloat(p, end);
+        float y = ObjTokenizer::parseFloat(p, end);
+        float z = ObjTokenizer::parseFloat(p, end);
+        if((x != 1.5f) || (y != 2.25f) || (z != 3.125f) || (p != end)) {
+            OMLOGE("Bad range parse of %.16s: %f %f %f", line, x, y, z);
+            return false;
+        }
+
+        // Face point triplets with all kinds of missing indices
+        const char *face = "1/2/3 4//6 7/8 9";
+        const char *faceEnd = face + strlen(face);
+        const unsigned int M = (unsigned int)-1;
+        const unsigned int expected[4][3] = { {0, 1, 2}, {3, M, 5}, {6, 7, M}, {8, M, M} };
+        p = face;
+        for(int i = 0; i < 4; ++i) {
+            unsigned int v, vt, vn;
+            p = ObjTokenizer::skipSpaces(p, faceEnd);
+            ObjTokenizer::parseIndexTriplet(p, faceEnd, v, vt, vn);
+            if((v != expected[i][0]) || (vt != expected[i][1]) || (vn != expected[i][2])) {
+                OMLOGE("Bad face point %d in %s: %u/%u/%u", i, face, v, vt, vn);
+                return false;
+            }
+        }
+
+        // Keywords
+        const char *usemtl = "usemtl material";
+        if(!ObjTokenizer::isKeyword(usemtl, usemtl + strlen(usemtl), "usemtl")
+           || ObjTokenizer::isKeyword(usemtl, usemtl + 3, "usemtl")
+           || ObjTokenizer::isKeyword(usemtl, usemtl + strlen(usemtl), "use")) {
+            OMLOGE("Bad keyword check on: %s", usemtl);
+            return false;
+        }
+
+#ifdef DEBUG
+        OMLOGI("...TEST_ObjTokenizer completed (OK)");
+#endif
+        return true;
+    }
+}
+
+#endif // _OBJMASTER_OBJ_TOKENIZER_H
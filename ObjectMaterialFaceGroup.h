@@ -5,10 +5,9 @@
 #ifndef NFTSIMPLEPROJ_MATERIALFACEGROUP_H
 #define NFTSIMPLEPROJ_MATERIALFACEGROUP_H
 
-#include "TextureDataHoldingMaterial.h"
-#include "NopTexturePreparationLibrary.h"
 #include "FaceElement.h"
 #include <string>
+#include <stdint.h>
 
 namespace ObjMaster {
     /**
@@ -23,17 +22,23 @@ namespace ObjMaster {
         std::string objectGroupName;
 
         /**
-         * The material for the faces in the group - texture data should not be loaded here!
-         * We do not own the pointed object, it is owned by the parent object our life-cycle is
-         * bound to (for example an object with class Obj or some object with the same life-span)
+         * The id of the material for the faces in the group (MtlLib::NO_MATERIAL when there is none).
+         * The material is owned by the library of the parent object our life-cycle is bound to
+         * (for example an object with class Obj or some object with the same life-span), so it is
+         * looked up there - see Obj::getMaterialOf.
          */
-        TextureDataHoldingMaterial textureDataHoldingMaterial;
+        uint32_t materialId;
 
         /** Index of the first faceElement for this object name and material */
         int faceIndex;
 
         /** Defines how many faces are in the group with this material after the pointed address */
         int meshFaceCount;
+
+        /** The key of the groups of an obj: the id of the object-group name and the material id packed together */
+        static inline uint64_t keyOf(uint32_t objectGroupId, uint32_t materialId) {
+            return ((uint64_t)objectGroupId << 32) | materialId;
+        }
     };
 }
 
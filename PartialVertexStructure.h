@@ -0,0 +1,40 @@
+//
+// Vertex layouts for models that miss some of the attributes - in parallel to VertexStructure.
+// This code should be able to get included as a C-header, because it is used in the interop facade layer!
+//
+// BECAUSE OF THIS: NO C++ FEATURES SHOULD BE USED HERE EVER!
+//
+
+#ifndef OBJMASTER_PARTIALVERTEXSTRUCTURE_H
+#define OBJMASTER_PARTIALVERTEXSTRUCTURE_H
+
+/**
+ * These are the same as VertexStructure, but without the attributes a model file does not have
+ * (no "vn" and/or no "vt" lines). The same rules apply: the structures start with the position
+ * and you should refer to the attributes by their first element, for example:
+ * glVertexAttribPointer(positionAttribLocation, 3, GL_FLOAT, GL_FALSE, sizeof(PositionVertexStructure), &modelVertices[0].x);
+ */
+
+/** Position only - 12 bytes instead of 32 */
+struct PositionVertexStructure {
+    // position
+    float x, y, z;
+};
+
+/** Position and normal - 24 bytes instead of 32 */
+struct PositionNormalVertexStructure {
+    // position
+    float x, y, z;
+    // normal
+    float i, j, k;
+};
+
+/** Position and texture0 uv - 20 bytes instead of 32 */
+struct PositionTexCoordVertexStructure {
+    // position
+    float x, y, z;
+    // texture0 uv
+    float u, v;
+};
+
+#endif //OBJMASTER_PARTIALVERTEXSTRUCTURE_H
@@ -0,0 +1,144 @@
+//
+// Triangulation of the n-gon faces of obj files
+//
+
+#include "PolygonTriangulator.h"
+#include <cmath> /* fabs */
+
+namespace ObjMaster {
+
+	/** Twice the signed area of the (a, b, c) 2D triangle - positive for counter-clockwise */
+	static inline double cross2d(double ax, double ay, double bx, double by, double cx, double cy) {
+		return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+	}
+
+	void PolygonTriangulator::fan(int pointCount) {
+		for(int i = 1; i + 1 < pointCount; ++i) {
+			triangles.push_back(0);
+			triangles.push_back(i);
+			triangles.push_back(i + 1);
+		}
+	}
+
+	const std::vector<int>& PolygonTriangulator::triangulate(const VertexElement *const *positions, int pointCount) {
+		triangles.clear();
+		if(pointCount < 3) {
+			return triangles;
+		}
+		triangles.reserve(3 * (pointCount - 2));
+		if(pointCount == 3) {
+			fan(pointCount);
+			return triangles;
+		}
+		// Without positions we cannot do better than a fan
+		for(int i = 0; i < pointCount; ++i) {
+			if(positions[i] == nullptr) {
+				fan(pointCount);
+				return triangles;
+			}
+		}
+
+		// Newell's method for the normal of the polygon plane (works for concave ones too)
+		double nx = 0, ny = 0, nz = 0;
+		for(int i = 0; i < pointCount; ++i) {
+			const VertexElement *cur = positions[i];
+			const VertexElement *next = positions[(i + 1) % pointCount];
+			nx += ((double)cur->y - next->y) * ((double)cur->z + next->z);
+			ny += ((double)cur->z - next->z) * ((double)cur->x + next->x);
+			nz += ((double)cur->x - next->x) * ((double)cur->y + next->y);
+		}
+		double ax = fabs(nx), ay = fabs(ny), az = fabs(nz);
+		if((ax == 0) && (ay == 0) && (az == 0)) {
+			// Degenerate (zero area) polygon
+			fan(pointCount);
+			return triangles;
+		}
+
+		// Project to the plane of the two other axes than the dominant normal axis. The second
+		// coordinate is mirrored when necessary, so that the polygon is counter-clockwise in 2D.
+		xs.resize(pointCount);
+		ys.resize(pointCount);
+		for(int i = 0; i < pointCount; ++i) {
+			const VertexElement *p = positions[i];
+			if((az >= ax) && (az >= ay)) {
+				xs[i] = p->x; ys[i] = (nz > 0) ? p->y : -p->y;
+			} else if(ax >= ay) {
+				xs[i] = p->y; ys[i] = (nx > 0) ? p->z : -p->z;
+			} else {
+				xs[i] = p->z; ys[i] = (ny > 0) ? p->x : -p->x;
+			}
+		}
+
+		// Convex polygons (collinear points are fine) are cut as a fan
+		bool convex = true;
+		for(int i = 0; convex && (i < pointCount); ++i) {
+			int a = (i + pointCount - 1) % pointCount;
+			int c = (i + 1) % pointCount;
+			convex = (cross2d(xs[a], ys[a], xs[i], ys[i], xs[c], ys[c]) >= 0);
+		}
+		if(convex) {
+			fan(pointCount);
+			return triangles;
+		}
+
+		// Ear clipping for concave polygons
+		remaining.resize(pointCount);
+		for(int i = 0; i < pointCount; ++i) {
+			remaining[i] = i;
+		}
+		size_t start = 0;
+		while(remaining.size() > 3) {
+			size_t m = remaining.size();
+			bool clipped = false;
+			for(size_t k = 0; (k < m) && !clipped; ++k) {
+				size_t idx = (start + k) % m;
+				int a = remaining[(idx + m - 1) % m];
+				int b = remaining[idx];
+				int c = remaining[(idx + 1) % m];
+				// Reflex or collinear corners are never ears
+				if(cross2d(xs[a], ys[a], xs[b], ys[b], xs[c], ys[c]) <= 0) {
+					continue;
+				}
+				// No other (reflex) corner can be inside the ear
+				bool ear = true;
+				for(size_t j = 0; ear && (j < m); ++j) {
+					int p = remaining[j];
+					if((p == a) || (p == b) || (p == c)) continue;
+					// Duplicated points (touching the ear corners) do not break the ear
+					if(((xs[p] == xs[a]) && (ys[p] == ys[a])) ||
+					   ((xs[p] == xs[b]) && (ys[p] == ys[b])) ||
+					   ((xs[p] == xs[c]) && (ys[p] == ys[c]))) continue;
+					int pp = remaining[(j + m - 1) % m];
+					int pn = remaining[(j + 1) % m];
+					if(cross2d(xs[pp], ys[pp], xs[p], ys[p], xs[pn], ys[pn]) > 0) continue; // convex corners cannot be inside
+					ear = !((cross2d(xs[a], ys[a], xs[b], ys[b], xs[p], ys[p]) >= 0) &&
+					        (cross2d(xs[b], ys[b], xs[c], ys[c], xs[p], ys[p]) >= 0) &&
+					        (cross2d(xs[c], ys[c], xs[a], ys[a], xs[p], ys[p]) >= 0));
+				}
+				if(ear) {
+					triangles.push_back(a);
+					triangles.push_back(b);
+					triangles.push_back(c);
+					remaining.erase(remaining.begin() + idx);
+					// Continue from the previous corner as that might have become an ear now
+					start = (idx + (m - 1) - 1) % (m - 1);
+					clipped = true;
+				}
+			}
+			if(!clipped) {
+				// Self-intersecting or strongly non-planar polygon: cut the rest as a fan
+				OMLOGW("Could not find an ear when triangulating a %d-gon - using a fan for the rest!", pointCount);
+				for(size_t i = 1; i + 1 < remaining.size(); ++i) {
+					triangles.push_back(remaining[0]);
+					triangles.push_back(remaining[i]);
+					triangles.push_back(remaining[i + 1]);
+				}
+				return triangles;
+			}
+		}
+		triangles.push_back(remaining[0]);
+		triangles.push_back(remaining[1]);
+		triangles.push_back(remaining[2]);
+		return triangles;
+	}
+}
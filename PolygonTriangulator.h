@@ -0,0 +1,88 @@
+//
+// Triangulation of the n-gon faces of obj files
+//
+
+#ifndef OBJMASTER_POLYGONTRIANGULATOR_H
+#define OBJMASTER_POLYGONTRIANGULATOR_H
+
+#include "VertexElement.h"
+#include "objmasterlog.h"
+#include <vector>
+
+namespace ObjMaster {
+
+	/**
+	 * Cuts (planar or nearly planar) polygons into triangles. Convex polygons are cut as a fan
+	 * and concave ones with ear clipping in the plane of the polygon (the plane normal is
+	 * computed with Newell's method, so the polygon can be in any orientation in space).
+	 * The winding of the resulting triangles is the same as the winding of the polygon.
+	 *
+	 * The object keeps its buffers between calls so it is worth reusing it for many faces.
+	 */
+	class PolygonTriangulator final {
+	public:
+		/**
+		 * Triangulate the polygon with the given corner positions (in order). Any of the positions
+		 * can be nullptr (missing data) - then the polygon is simply cut as a fan.
+		 * Returns the corners of the triangles as indices into the positions (three per triangle).
+		 * Rem.: The returned reference is valid until the next call on this object!
+		 */
+		const std::vector<int>& triangulate(const VertexElement *const *positions, int pointCount);
+
+	private:
+		/** Add the fan triangulation of the corners [0..pointCount) */
+		void fan(int pointCount);
+
+		std::vector<int> triangles;
+		// Scratch buffers for ear clipping
+		std::vector<int> remaining;
+		std::vector<double> xs;
+		std::vector<double> ys;
+	};
+
+// Very simple unit-testing approach
+// it is better to have these run on the device itself and callable as normal functions than to
+// test it compile-time with some unit testing framework as this way we rule out architectural
+// differences better. Tests will start by logging test starts to error (when #DEBUG is set!)
+// and info logs and the method returns false when anything has failed...
+	static bool TEST_PolygonTriangulator() {
+#ifdef DEBUG
+		OMLOGI("TEST_PolygonTriangulator...");
+#endif
+		PolygonTriangulator triangulator;
+
+		// A convex quad should become a fan
+		VertexElement quad[] = { {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0} };
+		const VertexElement *quadPtrs[] = { &quad[0], &quad[1], &quad[2], &quad[3] };
+		const std::vector<int> &quadTris = triangulator.triangulate(quadPtrs, 4);
+		const int quadExpected[] = { 0, 1, 2, 0, 2, 3 };
+		if(quadTris.size() != 6) { OMLOGE("Bad triangle index count for quad: %d", (int)quadTris.size()); return false; }
+		for(int i = 0; i < 6; ++i) {
+			if(quadTris[i] != quadExpected[i]) { OMLOGE("Bad quad fan at %d: %d", i, quadTris[i]); return false; }
+		}
+
+		// A concave (U-shaped) polygon in the YZ plane - a fan from corner zero would be wrong here
+		VertexElement u[] = { {0, 0, 0}, {0, 3, 0}, {0, 3, 3}, {0, 2, 3}, {0, 2, 1}, {0, 1, 1}, {0, 1, 3}, {0, 0, 3} };
+		const VertexElement *uPtrs[8];
+		for(int i = 0; i < 8; ++i) uPtrs[i] = &u[i];
+		const std::vector<int> &uTris = triangulator.triangulate(uPtrs, 8);
+		if(uTris.size() != 3 * 6) { OMLOGE("Bad triangle index count for concave polygon: %d", (int)uTris.size()); return false; }
+		// All triangles should have the same orientation as the polygon (+X normal) and the
+		// area should sum up to the polygon area (3*3 - 1*2 = 7)
+		float area = 0;
+		for(size_t i = 0; i < uTris.size(); i += 3) {
+			const VertexElement &a = u[uTris[i]], &b = u[uTris[i + 1]], &c = u[uTris[i + 2]];
+			float cross = (b.y - a.y) * (c.z - a.z) - (b.z - a.z) * (c.y - a.y);
+			if(cross <= 0) { OMLOGE("Flipped or degenerate triangle in concave polygon at %d", (int)i / 3); return false; }
+			area += cross * 0.5f;
+		}
+		if((area < 6.999f) || (area > 7.001f)) { OMLOGE("Bad area of the triangulated concave polygon: %f", area); return false; }
+
+#ifdef DEBUG
+		OMLOGI("...TEST_PolygonTriangulator completed (OK)");
+#endif
+		return true;
+	}
+}
+
+#endif //OBJMASTER_POLYGONTRIANGULATOR_H
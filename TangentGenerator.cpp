@@ -0,0 +1,196 @@
+//
+// Generation of tangent space data (MikkTSpace-like) for normal mapped meshes.
+//
+
+#include "TangentGenerator.h"
+#include <algorithm>
+#include <stdint.h>
+
+namespace ObjMaster {
+
+    static inline float dot3(const float *a, const float *b) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    /** Removes the part along the (unit or zero) normal and normalizes the rest if it is not zero */
+    static inline void projectAndNormalize(const float *normal, float *v) {
+        float along = dot3(normal, v);
+        v[0] -= along * normal[0];
+        v[1] -= along * normal[1];
+        v[2] -= along * normal[2];
+        float length = std::sqrt(dot3(v, v));
+        if(length > 0) {
+            v[0] /= length;
+            v[1] /= length;
+            v[2] /= length;
+        }
+    }
+
+    /** Bits of the triangle orientations using a vertex */
+    static const uint8_t PRESERVING = 1;
+    static const uint8_t MIRRORING = 2;
+
+    bool TangentGenerator::generateTangents(std::vector<VertexStructure> &vertices, size_t baseVertex, unsigned int &vertexCount,
+            OM_INDEX_TYPE *indices, unsigned int indexCount, OM_INDEX_TYPE firstIndex, std::vector<TangentStructure> &tangents,
+            unsigned int maxVertexCount) {
+        if(vertices.size() != baseVertex + vertexCount) {
+            OMLOGE("The vertices of the mesh are not at the end of the vertex data - cannot generate tangents!");
+            return false;
+        }
+        const unsigned int triangleCount = indexCount / 3;
+        for(unsigned int i = 0; i < 3 * triangleCount; ++i) {
+            OM_INDEX_TYPE local = (OM_INDEX_TYPE)(indices[i] - firstIndex);
+            if(local >= vertexCount) {
+                OMLOGE("Index %u (%u) is out of the mesh vertex range - not generating tangents!", i, (unsigned int)indices[i]);
+                return false;
+            }
+        }
+        const VertexStructure *meshVertices = (vertexCount > 0) ? &vertices[baseVertex] : nullptr;
+
+        // 1) The unit uv tangent of each triangle - flipped for the mirrored ones (see MikkTSpace)
+        std::vector<float> faceTangents(3 * (size_t)triangleCount, 0.0f);
+        std::vector<uint8_t> orientations(triangleCount, 0);
+        std::vector<uint8_t> vertexOrientations(vertexCount, 0);
+        for(unsigned int t = 0; t < triangleCount; ++t) {
+            const VertexStructure &a = meshVertices[(OM_INDEX_TYPE)(indices[3 * t] - firstIndex)];
+            const VertexStructure &b = meshVertices[(OM_INDEX_TYPE)(indices[3 * t + 1] - firstIndex)];
+            const VertexStructure &c = meshVertices[(OM_INDEX_TYPE)(indices[3 * t + 2] - firstIndex)];
+            float d1[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+            float d2[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+            float t21[2] = { b.u - a.u, b.v - a.v };
+            float t31[2] = { c.u - a.u, c.v - a.v };
+            float signedUvArea = t21[0] * t31[1] - t21[1] * t31[0];
+            if(std::fabs(signedUvArea) <= 1e-20f) {
+                // Degenerate uvs: no tangent and no vote on the orientation of the vertices
+                continue;
+            }
+            float sign = (signedUvArea > 0) ? 1.0f : -1.0f;
+            float *faceTangent = &faceTangents[3 * t];
+            for(int k = 0; k < 3; ++k) {
+                faceTangent[k] = t31[1] * d1[k] - t21[1] * d2[k];
+            }
+            float length = std::sqrt(dot3(faceTangent, faceTangent));
+            if(length > 0) {
+                for(int k = 0; k < 3; ++k) {
+                    faceTangent[k] *= sign / length;
+                }
+            }
+            orientations[t] = (signedUvArea > 0) ? PRESERVING : MIRRORING;
+            for(int corner = 0; corner < 3; ++corner) {
+                vertexOrientations[(OM_INDEX_TYPE)(indices[3 * t + corner] - firstIndex)] |= orientations[t];
+            }
+        }
+
+        // 2) Split the vertices used by both orientations: the mirrored triangles get the copies
+        std::vector<uint32_t> copyOf(vertexCount, (uint32_t)-1);
+        unsigned int splitCount = 0;
+        for(unsigned int v = 0; v < vertexCount; ++v) {
+            if(vertexOrientations[v] == (PRESERVING | MIRRORING)) {
+                copyOf[v] = vertexCount + splitCount++;
+            }
+        }
+        // The split vertices should still be addressable from firstIndex (and fit the given limit)
+        uint64_t vertexLimit = std::min((uint64_t)maxVertexCount, (uint64_t)(OM_INDEX_TYPE)(-1) + 1 - firstIndex);
+        if((splitCount > 0) && ((uint64_t)vertexCount + splitCount > vertexLimit)) {
+            OMLOGE("The %u tangent splits of the %u vertices would not fit the %u vertex limit - not generating tangents!",
+                    splitCount, vertexCount, (unsigned int)std::min(vertexLimit, (uint64_t)(unsigned int)(-1)));
+            return false;
+        }
+        if(splitCount > 0) {
+            vertices.reserve(vertices.size() + splitCount);
+            for(unsigned int v = 0; v < vertexCount; ++v) {
+                if(copyOf[v] != (uint32_t)-1) {
+                    // Rem.: push_back could reallocate, so the vertex is copied through its index
+                    VertexStructure copy = vertices[baseVertex + v];
+                    vertices.push_back(copy);
+                }
+            }
+            for(unsigned int t = 0; t < triangleCount; ++t) {
+                if(orientations[t] != MIRRORING) {
+                    continue;
+                }
+                for(int corner = 0; corner < 3; ++corner) {
+                    OM_INDEX_TYPE local = (OM_INDEX_TYPE)(indices[3 * t + corner] - firstIndex);
+                    if(copyOf[local] != (uint32_t)-1) {
+                        // Rem.: Wraps around just like the lastIndex of the mesh does
+                        indices[3 * t + corner] = (OM_INDEX_TYPE)(firstIndex + copyOf[local]);
+                    }
+                }
+            }
+            vertexOrientations.resize(vertexCount + splitCount, MIRRORING);
+            for(unsigned int v = 0; v < vertexCount; ++v) {
+                if(copyOf[v] != (uint32_t)-1) {
+                    vertexOrientations[v] = PRESERVING;
+                }
+            }
+            vertexCount += splitCount;
+            meshVertices = &vertices[baseVertex];
+        }
+
+        // 3) Sum the triangle tangents projected to the normal planes - weighted by the corner angles
+        std::vector<float> sums(3 * (size_t)vertexCount, 0.0f);
+        for(unsigned int t = 0; t < triangleCount; ++t) {
+            if(orientations[t] == 0) {
+                continue;
+            }
+            for(int corner = 0; corner < 3; ++corner) {
+                OM_INDEX_TYPE local = (OM_INDEX_TYPE)(indices[3 * t + corner] - firstIndex);
+                const VertexStructure &p = meshVertices[local];
+                const VertexStructure &prev = meshVertices[(OM_INDEX_TYPE)(indices[3 * t + (corner + 2) % 3] - firstIndex)];
+                const VertexStructure &next = meshVertices[(OM_INDEX_TYPE)(indices[3 * t + (corner + 1) % 3] - firstIndex)];
+                float normal[3] = { p.i, p.j, p.k };
+                float toPrev[3] = { prev.x - p.x, prev.y - p.y, prev.z - p.z };
+                float toNext[3] = { next.x - p.x, next.y - p.y, next.z - p.z };
+                projectAndNormalize(normal, toPrev);
+                projectAndNormalize(normal, toNext);
+                float angle = std::acos(std::max(-1.0f, std::min(1.0f, dot3(toPrev, toNext))));
+                float tangent[3] = { faceTangents[3 * t], faceTangents[3 * t + 1], faceTangents[3 * t + 2] };
+                projectAndNormalize(normal, tangent);
+                for(int k = 0; k < 3; ++k) {
+                    sums[3 * (size_t)local + k] += angle * tangent[k];
+                }
+            }
+        }
+
+        // 4) Normalize - vertices without a usable tangent get any vector orthogonal to their normal
+        tangents.resize(vertexCount);
+        for(unsigned int v = 0; v < vertexCount; ++v) {
+            const VertexStructure &p = meshVertices[v];
+            float normal[3] = { p.i, p.j, p.k };
+            float *sum = &sums[3 * (size_t)v];
+            float length = std::sqrt(dot3(sum, sum));
+            if(length <= 1e-20f) {
+                // The axis that is the least parallel with the normal
+                float absNormal[3] = { std::fabs(normal[0]), std::fabs(normal[1]), std::fabs(normal[2]) };
+                int axis = (absNormal[0] <= absNormal[1]) ? ((absNormal[0] <= absNormal[2]) ? 0 : 2) : ((absNormal[1] <= absNormal[2]) ? 1 : 2);
+                sum[0] = sum[1] = sum[2] = 0;
+                sum[axis] = 1;
+                projectAndNormalize(normal, sum);
+                length = 1;
+            }
+            tangents[v] = TangentStructure { sum[0] / length, sum[1] / length, sum[2] / length,
+                    (vertexOrientations[v] == MIRRORING) ? -1.0f : 1.0f };
+        }
+        return true;
+    }
+
+    bool TangentGenerator::generateTangents(ObjMeshObject &mesh, unsigned int maxVertexCount) {
+        if(!mesh.inited) {
+            OMLOGE("Cannot generate tangents for a not inited mesh!");
+            return false;
+        }
+        unsigned int vertexCount = mesh.vertexCount;
+        OM_INDEX_TYPE firstIndex = (OM_INDEX_TYPE)(mesh.lastIndex - mesh.vertexCount);
+        OM_INDEX_TYPE *indices = (mesh.indexCount > 0) ? &(*mesh.indices)[mesh.startIndexLocation] : nullptr;
+        if(!generateTangents(*mesh.vertexData, mesh.baseVertexLocation, vertexCount, indices, mesh.indexCount,
+                firstIndex, mesh.tangents, maxVertexCount)) {
+            return false;
+        }
+        if(vertexCount != mesh.vertexCount) {
+            OMLOGI(" - %u vertices are split because of mirrored texture coordinates", vertexCount - mesh.vertexCount);
+            mesh.lastIndex = (OM_INDEX_TYPE)(firstIndex + vertexCount);
+            mesh.vertexCount = vertexCount;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,120 @@
+//
+// Generation of tangent space data (MikkTSpace-like) for normal mapped meshes.
+//
+
+#ifndef OBJMASTER_TANGENTGENERATOR_H
+#define OBJMASTER_TANGENTGENERATOR_H
+
+#include "ObjMeshObject.h"
+#include "VertexStructure.h"
+#include "TangentStructure.h"
+#include "objmasterlog.h"
+#include <vector>
+#include <cmath>
+
+namespace ObjMaster {
+
+    /**
+     * Generates the tangents similarly to MikkTSpace, but not compatible with it: the tangent of
+     * each triangle comes from its uv derivatives, the per corner tangents are projected to the
+     * plane of the vertex normal and summed weighted by the angle of the triangle at that corner.
+     * There is no grouping of the corners of a vertex (MikkTSpace splits the vertices whose
+     * tangents differ too much) - only the uv orientation splits the vertices here. Triangles
+     * with mirrored uvs (negative uv area) give the opposite bitangent sign, so vertices that are
+     * used by both kinds of triangles are split: the copy is appended after the vertices of the
+     * mesh and the indices of the mirrored triangles are changed to refer to it. Triangles with
+     * degenerate uvs do not add to the tangents (and cause no splits).
+     */
+    class TangentGenerator final {
+    public:
+        /**
+         * Generates the tangents for the mesh-range of the vertex vector: the vertexCount vertices
+         * from baseVertex on are referred by the indices as [firstIndex, firstIndex + vertexCount).
+         * The vertices of the range should be the last ones in the vector as the split vertices
+         * get appended to it - vertexCount is increased by the number of the splits. The tangents
+         * are replaced with one tangent for each (mesh-local) vertex. Returns false (and changes
+         * nothing) if the range is not at the end of the vector, an index is outside of it or the
+         * split vertices would make the range bigger than maxVertexCount or than what OM_INDEX_TYPE
+         * can address from firstIndex on.
+         */
+        static bool generateTangents(std::vector<VertexStructure> &vertices, size_t baseVertex, unsigned int &vertexCount,
+                OM_INDEX_TYPE *indices, unsigned int indexCount, OM_INDEX_TYPE firstIndex, std::vector<TangentStructure> &tangents,
+                unsigned int maxVertexCount = (unsigned int)(-1));
+
+        /**
+         * The same as above, but for the mesh-range of the mesh - the results go into the tangents
+         * of the mesh and the vertexCount and lastIndex of the mesh grow with the split vertices.
+         * The mesh is left unchanged (without tangents) when the splits would not fit.
+         */
+        static bool generateTangents(ObjMeshObject &mesh, unsigned int maxVertexCount = (unsigned int)(-1));
+    };
+
+// Very simple unit-testing approach
+// it is better to have these run on the device itself and callable as normal functions than to
+// test it compile-time with some unit testing framework as this way we rule out architectural
+// differences better. Tests will start by logging test starts to error (when #DEBUG is set!)
+// and info logs and the method returns false when anything has failed...
+    static bool TEST_TangentGenerator() {
+#ifdef DEBUG
+        OMLOGI("TEST_TangentGenerator...");
+#endif
+        // Two quads (facing +z) side by side sharing the x = 1 edge. The right quad has its uvs
+        // mirrored horizontally (like the two halves of a symmetric model) - u shrinks along x there.
+        std::vector<VertexStructure> vertices = {
+            { 9, 9, 9, 0, 0, 1, 0, 0 },  // not in the mesh-range
+            { 0, 0, 0, 0, 0, 1, 0, 0 },
+            { 1, 0, 0, 0, 0, 1, 1, 0 },
+            { 1, 1, 0, 0, 0, 1, 1, 1 },
+            { 0, 1, 0, 0, 0, 1, 0, 1 },
+            { 2, 0, 0, 0, 0, 1, 0, 0 },
+            { 2, 1, 0, 0, 0, 1, 0, 1 },
+        };
+        std::vector<OM_INDEX_TYPE> indices = { 1, 2, 3,  1, 3, 4,  2, 5, 6,  2, 6, 3 };
+        std::vector<TangentStructure> tangents;
+        unsigned int vertexCount = 6;
+        // The splits are refused (without changes) when they would not fit the limit
+        std::vector<OM_INDEX_TYPE> unsplitIndices = indices;
+        if(TangentGenerator::generateTangents(vertices, 1, vertexCount, &indices[0], (unsigned int)indices.size(), 1, tangents, 7) ||
+           (vertexCount != 6) || (vertices.size() != 7) || (indices != unsplitIndices)) {
+            OMLOGE("Tangent generation did not refuse the splits over the limit!");
+            return false;
+        }
+        if(!TangentGenerator::generateTangents(vertices, 1, vertexCount, &indices[0], (unsigned int)indices.size(), 1, tangents)) {
+            OMLOGE("Tangent generation failed!");
+            return false;
+        }
+        // The two vertices of the shared edge are split
+        if((vertexCount != 8) || (vertices.size() != 9) || (tangents.size() != 8)) {
+            OMLOGE("Bad vertex count after tangent generation: %u!", vertexCount);
+            return false;
+        }
+        for(unsigned int i = 0; i < 12; ++i) {
+            bool mirrored = (i >= 6);
+            const TangentStructure &t = tangents[indices[i] - 1];
+            if((std::fabs(t.x - (mirrored ? -1.0f : 1.0f)) > 0.0001f) || (std::fabs(t.y) > 0.0001f) || (std::fabs(t.z) > 0.0001f) ||
+               (t.w != (mirrored ? -1.0f : 1.0f))) {
+                OMLOGE("Bad tangent (%f, %f, %f, %f) for index %u!", t.x, t.y, t.z, t.w, i);
+                return false;
+            }
+            // The copies are the same vertices
+            const VertexStructure &v = vertices[indices[i]];
+            if((indices[i] > 6) && ((v.x != 1) || (v.u != 1))) {
+                OMLOGE("Bad split vertex!");
+                return false;
+            }
+        }
+        // Bad ranges are rejected
+        unsigned int badCount = 5;
+        if(TangentGenerator::generateTangents(vertices, 1, badCount, &indices[0], (unsigned int)indices.size(), 1, tangents)) {
+            OMLOGE("Tangent generation accepted a bad range!");
+            return false;
+        }
+
+#ifdef DEBUG
+        OMLOGI("...TEST_TangentGenerator completed (OK)");
+#endif
+        return true;
+    }
+}
+
+#endif //OBJMASTER_TANGENTGENERATOR_H
@@ -0,0 +1,25 @@
+//
+// Per-vertex tangent space data for normal (bump) mapping - in parallel to VertexStructure.
+// This code should be able to get included as a C-header, because it is used in the interop facade layer!
+//
+// BECAUSE OF THIS: NO C++ FEATURES SHOULD BE USED HERE EVER!
+//
+
+#ifndef OBJMASTER_TANGENTSTRUCTURE_H
+#define OBJMASTER_TANGENTSTRUCTURE_H
+
+/**
+ * The tangent of one vertex (the direction of growing u on the surface, orthogonal to the normal)
+ * and the sign of the bitangent - just like the MikkTSpace output. Shaders should compute the
+ * bitangent like this: bitangent = w * cross(normal, tangent.xyz). These are in a separate array
+ * (one for each vertex of the mesh) so the VertexStructure stays the same for meshes without them:
+ * glVertexAttribPointer(tangentAttribLocation, 4, GL_FLOAT, GL_FALSE, sizeof(TangentStructure), &meshTangents[0].x);
+ */
+struct TangentStructure {
+    // tangent
+    float x, y, z;
+    // bitangent sign: 1 or -1
+    float w;
+};
+
+#endif //OBJMASTER_TANGENTSTRUCTURE_H
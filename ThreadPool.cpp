@@ -0,0 +1,89 @@
+//
+// Small fixed-size thread pool for the parallel (build) operations of the library.
+//
+
+#include "ThreadPool.h"
+
+namespace ObjMaster {
+
+    ThreadPool::ThreadPool(int threadCount) : nextIndex(0) {
+        if(threadCount <= 0) {
+            threadCount = (int)std::thread::hardware_concurrency();
+        }
+        // The calling thread of parallelFor(..) works too
+        for(int i = 1; i < threadCount; ++i) {
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for(auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::parallelFor(int count, const std::function<void(int)> &task) {
+        if(count <= 0) {
+            return;
+        }
+        // Not worth waking anyone up
+        if(workers.empty() || (count == 1)) {
+            for(int i = 0; i < count; ++i) {
+                task(i);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            currentTask = &task;
+            currentCount = count;
+            nextIndex = 0;
+            ++generation;
+        }
+        wakeUp.notify_all();
+        runTasks(task, count);
+
+        // Wait for the workers that still run the last tasks
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busyWorkers == 0; });
+        currentTask = nullptr;
+    }
+
+    void ThreadPool::runTasks(const std::function<void(int)> &task, int count) {
+        int i;
+        while((i = nextIndex.fetch_add(1)) < count) {
+            task(i);
+        }
+    }
+
+    void ThreadPool::workerLoop() {
+        unsigned int seenGeneration = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true) {
+            wakeUp.wait(lock, [this, &seenGeneration] { return stopping || (generation != seenGeneration); });
+            if(stopping) {
+                return;
+            }
+            seenGeneration = generation;
+            // A worker waking up late might find all the indices taken already - that is fine
+            // as runTasks then just returns without touching the task.
+            const std::function<void(int)> *task = currentTask;
+            int count = currentCount;
+            ++busyWorkers;
+            lock.unlock();
+            if(task != nullptr) {
+                runTasks(*task, count);
+            }
+            lock.lock();
+            if(--busyWorkers == 0) {
+                done.notify_all();
+            }
+        }
+    }
+}
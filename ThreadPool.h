@@ -0,0 +1,101 @@
+//
+// Small fixed-size thread pool for the parallel (build) operations of the library.
+//
+
+#ifndef OBJMASTER_THREADPOOL_H
+#define OBJMASTER_THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include "objmasterlog.h"
+
+namespace ObjMaster {
+
+    /**
+     * Fixed set of worker threads that can run the index range of a parallel-for. The workers
+     * are started once and sleep between the parallelFor(..) calls, so one pool can be reused
+     * for many parallel operations without paying for the thread creation each time.
+     *
+     * Rem.: The pool is not reentrant - do not call parallelFor(..) from within a task!
+     */
+    class ThreadPool final {
+    public:
+        /**
+         * Create a pool with the given number of threads - the thread calling parallelFor(..) is
+         * counted too, so threadCount-1 workers get started. Zero or negative threadCount means
+         * using the number of hardware threads.
+         */
+        ThreadPool(int threadCount = 0);
+
+        // Threads are not copyable
+        ThreadPool(const ThreadPool &other) = delete;
+        ThreadPool& operator=(const ThreadPool &other) = delete;
+
+        /** Stops and joins all the worker threads */
+        ~ThreadPool();
+
+        /** The number of threads that work on a parallelFor(..) - including the calling thread */
+        inline int getThreadCount() const { return (int)workers.size() + 1; }
+
+        /**
+         * Runs task(i) for all i in [0, count) using the workers and the calling thread and returns
+         * when all of them are finished. The order of execution is not defined (indices are handed
+         * out one-by-one), so tasks should write their results to per-index slots if the order
+         * of the results matters.
+         */
+        void parallelFor(int count, const std::function<void(int)> &task);
+
+    private:
+        void workerLoop();
+        /** Takes and runs indices until there is none left */
+        void runTasks(const std::function<void(int)> &task, int count);
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wakeUp;
+        std::condition_variable done;
+
+        // The currently running parallelFor - guarded by the mutex (except nextIndex)
+        const std::function<void(int)> *currentTask = nullptr;
+        int currentCount = 0;
+        std::atomic<int> nextIndex;
+        /** Increased for each parallelFor so that the workers can see there is new work */
+        unsigned int generation = 0;
+        int busyWorkers = 0;
+        bool stopping = false;
+    };
+
+// Very simple unit-testing approach
+// it is better to have these run on the device itself and callable as normal functions than to
+// test it compile-time with some unit testing framework as this way we rule out architectural
+// differences better. Tests will start by logging test starts to error (when #DEBUG is set!)
+// and info logs and the method returns false when anything has failed...
+    static bool TEST_ThreadPool() {
+#ifdef DEBUG
+        OMLOGI("TEST_ThreadPool...");
+#endif
+        ThreadPool pool(4);
+        // Reuse the pool a few times with different counts - all indices should run exactly once
+        for(int count : { 0, 1, 3, 1000 }) {
+            std::vector<int> runs(count, 0);
+            pool.parallelFor(count, [&runs](int i) { ++runs[i]; });
+            for(int i = 0; i < count; ++i) {
+                if(runs[i] != 1) {
+                    OMLOGE("Task %d of %d has run %d times!", i, count, runs[i]);
+                    return false;
+                }
+            }
+        }
+
+#ifdef DEBUG
+        OMLOGI("...TEST_ThreadPool completed (OK)");
+#endif
+        return true;
+    }
+}
+
+#endif //OBJMASTER_THREADPOOL_H
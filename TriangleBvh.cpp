@@ -0,0 +1,580 @@
+//
+// Bounding volume hierarchy over the triangles of meshes and models - for ray queries and picking.
+//
+
+#include "TriangleBvh.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define OM_BVH_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace ObjMaster {
+
+    /** Returns the mesh-local vertex number of the index (wraps around just like the index building does) */
+    static inline unsigned int localVertex(OM_INDEX_TYPE index, OM_INDEX_TYPE firstIndex) {
+        return (OM_INDEX_TYPE)(index - firstIndex);
+    }
+
+    /** Below this depth the splits follow the surface area heuristic, from there on they halve the triangles */
+    static const unsigned int BALANCED_SPLIT_DEPTH = 32;
+    /** The deepest the traversal can go - the balanced splits above keep the tree within this */
+    static const unsigned int MAX_DEPTH = 64;
+    /** Nodes with this many triangles get binned by the thread pool too */
+    static const unsigned int PARALLEL_BINNING_TRIANGLES = 65536;
+    /** The smallest subtree that is built as a separate parallel task */
+    static const unsigned int MIN_PARALLEL_SUBTREE_TRIANGLES = 4096;
+    /** The number of rays of the batched queries that go to a thread at once */
+    static const unsigned int RAY_BATCH_SIZE = 64;
+
+    struct BvhBox {
+        float minPos[3];
+        float maxPos[3];
+    };
+
+    static inline BvhBox emptyBox() {
+        return BvhBox { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+    }
+
+    static inline void grow(BvhBox &box, const float point[3]) {
+        for(int k = 0; k < 3; ++k) {
+            box.minPos[k] = std::min(box.minPos[k], point[k]);
+            box.maxPos[k] = std::max(box.maxPos[k], point[k]);
+        }
+    }
+
+    static inline void grow(BvhBox &box, const BvhBox &other) {
+        for(int k = 0; k < 3; ++k) {
+            box.minPos[k] = std::min(box.minPos[k], other.minPos[k]);
+            box.maxPos[k] = std::max(box.maxPos[k], other.maxPos[k]);
+        }
+    }
+
+    /** Half of the surface area - the heuristic only needs the ratios */
+    static inline float halfArea(const BvhBox &box) {
+        float d[3] = { box.maxPos[0] - box.minPos[0], box.maxPos[1] - box.minPos[1], box.maxPos[2] - box.minPos[2] };
+        return (d[0] < 0) ? 0 : d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+    }
+
+    /** What the build needs to know of a triangle */
+    struct BvhBuildTriangle {
+        BvhBox bounds;
+        float centroid[3];
+        unsigned int meshIndex;
+        unsigned int triangleIndex;
+    };
+
+    struct BvhBin {
+        BvhBox bounds;
+        BvhBox centroidBounds;
+        unsigned int count;
+    };
+
+    /** A node that is still to be split: its triangles are [first, first + count) */
+    struct BvhBuildTask {
+        unsigned int nodeIndex;
+        unsigned int first;
+        unsigned int count;
+        unsigned int depth;
+        BvhBox centroidBounds;
+    };
+
+    typedef std::array<std::array<BvhBin, TriangleBvh::BIN_COUNT>, 3> BvhBins;
+
+    static inline unsigned int binOf(float centroid, float minCentroid, float scale) {
+        return std::min((unsigned int)((centroid - minCentroid) * scale), TriangleBvh::BIN_COUNT - 1);
+    }
+
+    static inline void setBox(BvhNode &node, const BvhBox &box) {
+        node.minX = box.minPos[0];
+        node.minY = box.minPos[1];
+        node.minZ = box.minPos[2];
+        node.maxX = box.maxPos[0];
+        node.maxY = box.maxPos[1];
+        node.maxZ = box.maxPos[2];
+    }
+
+    /** Puts the triangles into the bins of all three axes (axes with zero centroid extent are left out) */
+    static void binTriangles(const BvhBuildTriangle *triangles, unsigned int count, const BvhBox &centroidBounds, BvhBins &bins) {
+        for(int axis = 0; axis < 3; ++axis) {
+            for(BvhBin &bin : bins[axis]) {
+                bin = BvhBin { emptyBox(), emptyBox(), 0 };
+            }
+            float extent = centroidBounds.maxPos[axis] - centroidBounds.minPos[axis];
+            if(extent <= 0) {
+                continue;
+            }
+            float scale = TriangleBvh::BIN_COUNT / extent;
+            for(unsigned int i = 0; i < count; ++i) {
+                BvhBin &bin = bins[axis][binOf(triangles[i].centroid[axis], centroidBounds.minPos[axis], scale)];
+                grow(bin.bounds, triangles[i].bounds);
+                grow(bin.centroidBounds, triangles[i].centroid);
+                ++bin.count;
+            }
+        }
+    }
+
+    /** The bounds of the triangles of the task (for the splits that are not using the bins) */
+    static void boundsOf(const BvhBuildTriangle *triangles, unsigned int count, BvhBox &bounds, BvhBox &centroidBounds) {
+        bounds = emptyBox();
+        centroidBounds = emptyBox();
+        for(unsigned int i = 0; i < count; ++i) {
+            grow(bounds, triangles[i].bounds);
+            grow(centroidBounds, triangles[i].centroid);
+        }
+    }
+
+    /**
+     * Splits the node of the task into two new nodes (at the end of nodes) and writes their tasks
+     * into children - or makes the node a leaf (referencing its first triangle for now) and returns false.
+     */
+    static bool splitNode(std::vector<BvhNode> &nodes, const BvhBuildTask &task, std::vector<BvhBuildTriangle> &triangles,
+                          BvhBuildTask children[2], ThreadPool *threadPool) {
+        if(task.count <= TriangleBvh::MAX_LEAF_TRIANGLES) {
+            nodes[task.nodeIndex].childOrPacket = task.first;
+            nodes[task.nodeIndex].triangleCount = task.count;
+            return false;
+        }
+        BvhBuildTriangle *first = &triangles[task.first];
+        const BvhBox &centroidBounds = task.centroidBounds;
+        int bestAxis = -1;
+        unsigned int bestBin = 0;
+        BvhBox childBounds[2], childCentroidBounds[2];
+        unsigned int leftCount = 0;
+        if(task.depth < BALANCED_SPLIT_DEPTH) {
+            // Surface area heuristic over the bins
+            BvhBins bins;
+            if((threadPool != nullptr) && (task.count >= PARALLEL_BINNING_TRIANGLES)) {
+                int chunkCount = threadPool->getThreadCount() * 4;
+                unsigned int chunkSize = (task.count + chunkCount - 1) / chunkCount;
+                std::vector<BvhBins> chunkBins(chunkCount);
+                threadPool->parallelFor(chunkCount, [first, &task, chunkSize, &centroidBounds, &chunkBins](int c) {
+                    unsigned int begin = std::min(c * chunkSize, task.count);
+                    binTriangles(first + begin, std::min(begin + chunkSize, task.count) - begin, centroidBounds, chunkBins[c]);
+                });
+                for(int axis = 0; axis < 3; ++axis) {
+                    for(unsigned int b = 0; b < TriangleBvh::BIN_COUNT; ++b) {
+                        bins[axis][b] = BvhBin { emptyBox(), emptyBox(), 0 };
+                        for(BvhBins &chunk : chunkBins) {
+                            grow(bins[axis][b].bounds, chunk[axis][b].bounds);
+                            grow(bins[axis][b].centroidBounds, chunk[axis][b].centroidBounds);
+                            bins[axis][b].count += chunk[axis][b].count;
+                        }
+                    }
+                }
+            } else {
+                binTriangles(first, task.count, centroidBounds, bins);
+            }
+            float bestCost = FLT_MAX;
+            for(int axis = 0; axis < 3; ++axis) {
+                if(centroidBounds.maxPos[axis] - centroidBounds.minPos[axis] <= 0) {
+                    continue;
+                }
+                // Sweep from the right for the costs of the right sides, then from the left
+                float rightCosts[TriangleBvh::BIN_COUNT];
+                BvhBox box = emptyBox();
+                unsigned int count = 0;
+                for(unsigned int b = TriangleBvh::BIN_COUNT - 1; b > 0; --b) {
+                    grow(box, bins[axis][b].bounds);
+                    count += bins[axis][b].count;
+                    rightCosts[b - 1] = (count > 0) ? halfArea(box) * count : -1;
+                }
+                box = emptyBox();
+                count = 0;
+                for(unsigned int b = 0; b + 1 < TriangleBvh::BIN_COUNT; ++b) {
+                    grow(box, bins[axis][b].bounds);
+                    count += bins[axis][b].count;
+                    float cost = halfArea(box) * count + rightCosts[b];
+                    if((count > 0) && (rightCosts[b] >= 0) && (cost < bestCost)) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestBin = b;
+                    }
+                }
+            }
+            if(bestAxis >= 0) {
+                for(int side = 0; side < 2; ++side) {
+                    childBounds[side] = emptyBox();
+                    childCentroidBounds[side] = emptyBox();
+                }
+                for(unsigned int b = 0; b < TriangleBvh::BIN_COUNT; ++b) {
+                    int side = (b <= bestBin) ? 0 : 1;
+                    grow(childBounds[side], bins[bestAxis][b].bounds);
+                    grow(childCentroidBounds[side], bins[bestAxis][b].centroidBounds);
+                    leftCount += (side == 0) ? bins[bestAxis][b].count : 0;
+                }
+                float minCentroid = centroidBounds.minPos[bestAxis];
+                float scale = TriangleBvh::BIN_COUNT / (centroidBounds.maxPos[bestAxis] - minCentroid);
+                std::partition(first, first + task.count, [bestAxis, bestBin, minCentroid, scale](const BvhBuildTriangle &t) {
+                    return binOf(t.centroid[bestAxis], minCentroid, scale) <= bestBin;
+                });
+            }
+        }
+        if(bestAxis < 0) {
+            // Too deep or every centroid is the same: halve the triangles along the longest centroid extent
+            int axis = 0;
+            for(int k = 1; k < 3; ++k) {
+                if(centroidBounds.maxPos[k] - centroidBounds.minPos[k] > centroidBounds.maxPos[axis] - centroidBounds.minPos[axis]) {
+                    axis = k;
+                }
+            }
+            leftCount = task.count / 2;
+            std::nth_element(first, first + leftCount, first + task.count, [axis](const BvhBuildTriangle &a, const BvhBuildTriangle &b) {
+                return a.centroid[axis] < b.centroid[axis];
+            });
+            boundsOf(first, leftCount, childBounds[0], childCentroidBounds[0]);
+            boundsOf(first + leftCount, task.count - leftCount, childBounds[1], childCentroidBounds[1]);
+        }
+
+        unsigned int childIndex = (unsigned int)nodes.size();
+        nodes.resize(nodes.size() + 2);
+        nodes[task.nodeIndex].childOrPacket = childIndex;
+        nodes[task.nodeIndex].triangleCount = 0;
+        for(int side = 0; side < 2; ++side) {
+            setBox(nodes[childIndex + side], childBounds[side]);
+        }
+        children[0] = BvhBuildTask { childIndex, task.first, leftCount, task.depth + 1, childCentroidBounds[0] };
+        children[1] = BvhBuildTask { childIndex + 1, task.first + leftCount, task.count - leftCount, task.depth + 1,
+                                     childCentroidBounds[1] };
+        return true;
+    }
+
+    /**
+     * Builds the (sub)tree of the task depth-first. Tasks with at most deferredCount triangles are
+     * not split but collected into deferred (if it is not null).
+     */
+    static void buildTree(std::vector<BvhNode> &nodes, const BvhBuildTask &root, std::vector<BvhBuildTriangle> &triangles,
+                          ThreadPool *threadPool, unsigned int deferredCount, std::vector<BvhBuildTask> *deferred) {
+        std::vector<BvhBuildTask> stack = { root };
+        BvhBuildTask children[2];
+        while(!stack.empty()) {
+            BvhBuildTask task = stack.back();
+            stack.pop_back();
+            if((deferred != nullptr) && (task.count <= deferredCount)) {
+                deferred->push_back(task);
+            } else if(splitNode(nodes, task, triangles, children, threadPool)) {
+                stack.push_back(children[1]);
+                stack.push_back(children[0]);
+            }
+        }
+    }
+
+    /** The positions of the corners of the triangle of the mesh */
+    static inline void cornersOf(const ObjMeshObject &mesh, unsigned int triangleIndex, const VertexStructure *corners[3]) {
+        OM_INDEX_TYPE firstIndex = (OM_INDEX_TYPE)(mesh.lastIndex - mesh.vertexCount);
+        for(int k = 0; k < 3; ++k) {
+            OM_INDEX_TYPE index = (*mesh.indices)[mesh.startIndexLocation + 3 * triangleIndex + k];
+            corners[k] = &(*mesh.vertexData)[mesh.baseVertexLocation + localVertex(index, firstIndex)];
+        }
+    }
+
+    bool TriangleBvh::build(const std::vector<const ObjMeshObject *> &meshes, ThreadPool *threadPool) {
+        nodes.clear();
+        packets.clear();
+        triangleCount = 0;
+
+        std::vector<BvhBuildTriangle> triangles;
+        for(unsigned int m = 0; m < meshes.size(); ++m) {
+            const ObjMeshObject &mesh = *meshes[m];
+            OM_INDEX_TYPE firstIndex = (OM_INDEX_TYPE)(mesh.lastIndex - mesh.vertexCount);
+            for(unsigned int i = 0; i < mesh.indexCount; ++i) {
+                if(localVertex((*mesh.indices)[mesh.startIndexLocation + i], firstIndex) >= mesh.vertexCount) {
+                    OMLOGE("Cannot build BVH: index %u of mesh %u is out of its vertex range!", i, m);
+                    return false;
+                }
+            }
+            for(unsigned int t = 0; t < mesh.indexCount / 3; ++t) {
+                const VertexStructure *corners[3];
+                cornersOf(mesh, t, corners);
+                BvhBuildTriangle triangle;
+                triangle.bounds = emptyBox();
+                for(const VertexStructure *corner : corners) {
+                    grow(triangle.bounds, &corner->x);
+                }
+                for(int k = 0; k < 3; ++k) {
+                    triangle.centroid[k] = (triangle.bounds.minPos[k] + triangle.bounds.maxPos[k]) / 2;
+                }
+                triangle.meshIndex = m;
+                triangle.triangleIndex = t;
+                triangles.push_back(triangle);
+            }
+        }
+        if(triangles.empty()) {
+            return true;
+        }
+
+        BvhBox bounds, centroidBounds;
+        boundsOf(&triangles[0], (unsigned int)triangles.size(), bounds, centroidBounds);
+        nodes.push_back(BvhNode());
+        setBox(nodes[0], bounds);
+        BvhBuildTask root = BvhBuildTask { 0, 0, (unsigned int)triangles.size(), 0, centroidBounds };
+        if(threadPool == nullptr) {
+            buildTree(nodes, root, triangles, nullptr, 0, nullptr);
+        } else {
+            // The top of the tree with parallel binning, then the subtrees in parallel - and finally
+            // the subtrees get appended with their child indices shifted by their new position
+            std::vector<BvhBuildTask> deferred;
+            unsigned int deferredCount = std::max(root.count / (threadPool->getThreadCount() * 8), MIN_PARALLEL_SUBTREE_TRIANGLES);
+            buildTree(nodes, root, triangles, threadPool, deferredCount, &deferred);
+            std::vector<std::vector<BvhNode>> subtrees(deferred.size());
+            threadPool->parallelFor((int)deferred.size(), [this, &deferred, &subtrees, &triangles](int i) {
+                subtrees[i].push_back(nodes[deferred[i].nodeIndex]);
+                BvhBuildTask task = deferred[i];
+                task.nodeIndex = 0;
+                buildTree(subtrees[i], task, triangles, nullptr, 0, nullptr);
+            });
+            for(size_t i = 0; i < deferred.size(); ++i) {
+                unsigned int shift = (unsigned int)nodes.size() - 1;
+                for(size_t k = 0; k < subtrees[i].size(); ++k) {
+                    BvhNode node = subtrees[i][k];
+                    if(node.triangleCount == 0) {
+                        node.childOrPacket += shift;
+                    }
+                    if(k == 0) {
+                        nodes[deferred[i].nodeIndex] = node;
+                    } else {
+                        nodes.push_back(node);
+                    }
+                }
+            }
+        }
+
+        // The triangles of the leaves go into packets - in the order of the nodes
+        for(BvhNode &node : nodes) {
+            if(node.triangleCount == 0) {
+                continue;
+            }
+            BvhTrianglePacket packet = BvhTrianglePacket();
+            for(unsigned int k = 0; k < node.triangleCount; ++k) {
+                const BvhBuildTriangle &triangle = triangles[node.childOrPacket + k];
+                const VertexStructure *corners[3];
+                cornersOf(*meshes[triangle.meshIndex], triangle.triangleIndex, corners);
+                packet.v0x[k] = corners[0]->x;
+                packet.v0y[k] = corners[0]->y;
+                packet.v0z[k] = corners[0]->z;
+                packet.e1x[k] = corners[1]->x - corners[0]->x;
+                packet.e1y[k] = corners[1]->y - corners[0]->y;
+                packet.e1z[k] = corners[1]->z - corners[0]->z;
+                packet.e2x[k] = corners[2]->x - corners[0]->x;
+                packet.e2y[k] = corners[2]->y - corners[0]->y;
+                packet.e2z[k] = corners[2]->z - corners[0]->z;
+                packet.meshIndex[k] = triangle.meshIndex;
+                packet.triangleIndex[k] = triangle.triangleIndex;
+            }
+            node.childOrPacket = (unsigned int)packets.size();
+            packets.push_back(packet);
+        }
+        triangleCount = (unsigned int)triangles.size();
+        OMLOGI(" - BVH: %u nodes and %u leaves for %u triangles", (unsigned int)nodes.size(), (unsigned int)packets.size(), triangleCount);
+        return true;
+    }
+
+    /** What the traversal needs of the ray - prepared only once */
+    struct BvhRayData {
+        float origin[4];
+        /** The inverse direction - with huge values instead of infinities to avoid 0 * inf in the slab tests */
+        float inverseDirection[4];
+#if OM_BVH_SSE
+        __m128 originVector;
+        __m128 inverseVector;
+#endif
+    };
+
+    static inline BvhRayData prepare(const BvhRay &ray) {
+        BvhRayData data;
+        const float direction[3] = { ray.directionX, ray.directionY, ray.directionZ };
+        data.origin[0] = ray.originX;
+        data.origin[1] = ray.originY;
+        data.origin[2] = ray.originZ;
+        data.origin[3] = 0;
+        for(int k = 0; k < 3; ++k) {
+            data.inverseDirection[k] = (std::fabs(direction[k]) > 1e-20f) ? 1 / direction[k] : std::copysign(1e20f, direction[k]);
+        }
+        data.inverseDirection[3] = 0;
+#if OM_BVH_SSE
+        data.originVector = _mm_loadu_ps(data.origin);
+        data.inverseVector = _mm_loadu_ps(data.inverseDirection);
+#endif
+        return data;
+    }
+
+    /** The slab test: true if the ray enters the box before maxDistance - the entry distance goes to enter */
+    static inline bool hitsBox(const BvhNode &node, const BvhRayData &ray, float maxDistance, float &enter) {
+#if OM_BVH_SSE
+        // Rem.: the fourth lanes have the integers of the node - they get replaced before they matter
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.minX), ray.originVector), ray.inverseVector);
+        __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.maxX), ray.originVector), ray.inverseVector);
+        __m128 tNear = _mm_min_ps(t1, t2);
+        __m128 tFar = _mm_max_ps(t1, t2);
+        tNear = _mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(0, 2, 1, 0));
+        tFar = _mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(0, 2, 1, 0));
+        tNear = _mm_max_ps(tNear, _mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(1, 0, 3, 2)));
+        tNear = _mm_max_ps(tNear, _mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(2, 3, 0, 1)));
+        tFar = _mm_min_ps(tFar, _mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(1, 0, 3, 2)));
+        tFar = _mm_min_ps(tFar, _mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(2, 3, 0, 1)));
+        enter = std::max(_mm_cvtss_f32(tNear), 0.0f);
+        return enter <= std::min(_mm_cvtss_f32(tFar), maxDistance);
+#else
+        const float *minPos = &node.minX, *maxPos = &node.maxX;
+        float tNear = 0, tFar = maxDistance;
+        for(int k = 0; k < 3; ++k) {
+            float t1 = (minPos[k] - ray.origin[k]) * ray.inverseDirection[k];
+            float t2 = (maxPos[k] - ray.origin[k]) * ray.inverseDirection[k];
+            tNear = std::max(tNear, std::min(t1, t2));
+            tFar = std::min(tFar, std::max(t1, t2));
+        }
+        enter = tNear;
+        return tNear <= tFar;
+#endif
+    }
+
+    /**
+     * Moller-Trumbore intersection of the ray with the triangles of the packet (both sides). Updates
+     * the hit if a triangle is hit closer than hit.distance and returns true in that case.
+     */
+    static inline bool intersectPacket(const BvhTrianglePacket &packet, unsigned int count, const BvhRay &ray, BvhHit &hit) {
+        float u[4], v[4], distance[4];
+        unsigned int hitMask = 0;
+#if OM_BVH_SSE
+        __m128 dx = _mm_set1_ps(ray.directionX), dy = _mm_set1_ps(ray.directionY), dz = _mm_set1_ps(ray.directionZ);
+        __m128 e1x = _mm_loadu_ps(packet.e1x), e1y = _mm_loadu_ps(packet.e1y), e1z = _mm_loadu_ps(packet.e1z);
+        __m128 e2x = _mm_loadu_ps(packet.e2x), e2y = _mm_loadu_ps(packet.e2y), e2z = _mm_loadu_ps(packet.e2z);
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        __m128 sx = _mm_sub_ps(_mm_set1_ps(ray.originX), _mm_loadu_ps(packet.v0x));
+        __m128 sy = _mm_sub_ps(_mm_set1_ps(ray.originY), _mm_loadu_ps(packet.v0y));
+        __m128 sz = _mm_sub_ps(_mm_set1_ps(ray.originZ), _mm_loadu_ps(packet.v0z));
+        __m128 uVector = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), det);
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        __m128 vVector = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), det);
+        __m128 tVector = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), det);
+        __m128 zero = _mm_setzero_ps();
+        __m128 mask = _mm_and_ps(_mm_cmpneq_ps(det, zero), _mm_cmpge_ps(uVector, zero));
+        mask = _mm_and_ps(mask, _mm_cmpge_ps(vVector, zero));
+        mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(uVector, vVector), _mm_set1_ps(1)));
+        mask = _mm_and_ps(mask, _mm_cmpge_ps(tVector, zero));
+        mask = _mm_and_ps(mask, _mm_cmplt_ps(tVector, _mm_set1_ps(hit.distance)));
+        hitMask = (unsigned int)_mm_movemask_ps(mask) & ((1u << count) - 1);
+        _mm_storeu_ps(u, uVector);
+        _mm_storeu_ps(v, vVector);
+        _mm_storeu_ps(distance, tVector);
+#else
+        for(unsigned int k = 0; k < count; ++k) {
+            float p[3] = { ray.directionY * packet.e2z[k] - ray.directionZ * packet.e2y[k],
+                           ray.directionZ * packet.e2x[k] - ray.directionX * packet.e2z[k],
+                           ray.directionX * packet.e2y[k] - ray.directionY * packet.e2x[k] };
+            float det = packet.e1x[k] * p[0] + packet.e1y[k] * p[1] + packet.e1z[k] * p[2];
+            if(det == 0) {
+                continue;
+            }
+            float s[3] = { ray.originX - packet.v0x[k], ray.originY - packet.v0y[k], ray.originZ - packet.v0z[k] };
+            u[k] = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+            float q[3] = { s[1] * packet.e1z[k] - s[2] * packet.e1y[k], s[2] * packet.e1x[k] - s[0] * packet.e1z[k],
+                           s[0] * packet.e1y[k] - s[1] * packet.e1x[k] };
+            v[k] = (ray.directionX * q[0] + ray.directionY * q[1] + ray.directionZ * q[2]) / det;
+            distance[k] = (packet.e2x[k] * q[0] + packet.e2y[k] * q[1] + packet.e2z[k] * q[2]) / det;
+            if((u[k] >= 0) && (v[k] >= 0) && (u[k] + v[k] <= 1) && (distance[k] >= 0) && (distance[k] < hit.distance)) {
+                hitMask |= 1u << k;
+            }
+        }
+#endif
+        if(hitMask == 0) {
+            return false;
+        }
+        // The closest of the hits (the first one on ties)
+        int best = -1;
+        for(unsigned int k = 0; k < count; ++k) {
+            if(((hitMask >> k) & 1) && ((best < 0) || (distance[k] < distance[best]))) {
+                best = k;
+            }
+        }
+        hit = BvhHit { (int)packet.meshIndex[best], (int)packet.triangleIndex[best], distance[best], u[best], v[best] };
+        return true;
+    }
+
+    bool TriangleBvh::traverse(const BvhRay &ray, BvhHit &hit, bool anyHit) const {
+        hit = BvhHit { -1, -1, ray.maxDistance, 0, 0 };
+        if(nodes.empty()) {
+            return false;
+        }
+        BvhRayData data = prepare(ray);
+        float enter;
+        if(!hitsBox(nodes[0], data, ray.maxDistance, enter)) {
+            return false;
+        }
+        // The far children waiting for a visit with their entry distances
+        unsigned int stack[MAX_DEPTH];
+        float stackEnter[MAX_DEPTH];
+        unsigned int stackSize = 0;
+        unsigned int current = 0;
+        while(true) {
+            const BvhNode &node = nodes[current];
+            if(node.triangleCount > 0) {
+                if(intersectPacket(packets[node.childOrPacket], node.triangleCount, ray, hit) && anyHit) {
+                    return true;
+                }
+            } else {
+                unsigned int nearChild = node.childOrPacket, farChild = nearChild + 1;
+                float nearEnter, farEnter;
+                bool hitsNear = hitsBox(nodes[nearChild], data, hit.distance, nearEnter);
+                bool hitsFar = hitsBox(nodes[farChild], data, hit.distance, farEnter);
+                if(hitsNear && hitsFar) {
+                    if(farEnter < nearEnter) {
+                        std::swap(nearChild, farChild);
+                        std::swap(nearEnter, farEnter);
+                    }
+                    stack[stackSize] = farChild;
+                    stackEnter[stackSize] = farEnter;
+                    ++stackSize;
+                    current = nearChild;
+                    continue;
+                } else if(hitsNear || hitsFar) {
+                    current = hitsNear ? nearChild : farChild;
+                    continue;
+                }
+            }
+            // Pop the next far child that can still have a closer hit
+            while((stackSize > 0) && (stackEnter[stackSize - 1] > hit.distance)) {
+                --stackSize;
+            }
+            if(stackSize == 0) {
+                break;
+            }
+            current = stack[--stackSize];
+        }
+        return hit.meshIndex >= 0;
+    }
+
+    bool TriangleBvh::intersect(const BvhRay &ray, BvhHit &hit) const {
+        return traverse(ray, hit, false);
+    }
+
+    bool TriangleBvh::isOccluded(const BvhRay &ray) const {
+        BvhHit hit;
+        return traverse(ray, hit, true);
+    }
+
+    void TriangleBvh::intersect(const BvhRay *rays, unsigned int rayCount, BvhHit *hits, ThreadPool *threadPool) const {
+        int batchCount = (int)((rayCount + RAY_BATCH_SIZE - 1) / RAY_BATCH_SIZE);
+        auto intersectBatch = [this, rays, rayCount, hits](int batch) {
+            unsigned int end = std::min((batch + 1) * RAY_BATCH_SIZE, rayCount);
+            for(unsigned int i = batch * RAY_BATCH_SIZE; i < end; ++i) {
+                traverse(rays[i], hits[i], false);
+            }
+        };
+        if((threadPool != nullptr) && (batchCount > 1)) {
+            threadPool->parallelFor(batchCount, intersectBatch);
+        } else {
+            for(int batch = 0; batch < batchCount; ++batch) {
+                intersectBatch(batch);
+            }
+        }
+    }
+}
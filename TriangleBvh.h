@@ -0,0 +1,254 @@
+//
+// Bounding volume hierarchy over the triangles of meshes and models - for ray queries and picking.
+//
+
+#ifndef OBJMASTER_TRIANGLEBVH_H
+#define OBJMASTER_TRIANGLEBVH_H
+
+#include "ObjMeshObject.h"
+#include "MaterializedObjModel.h"
+#include "VertexStructure.h"
+#include "ThreadPool.h"
+#include "objmasterlog.h"
+#include <vector>
+#include <cmath>
+
+namespace ObjMaster {
+
+    /** A ray (or segment) to intersect: the points origin + t * direction for t in [0, maxDistance] */
+    struct BvhRay {
+        float originX, originY, originZ;
+        /** Does not need to be normalized - distances are measured in direction lengths then */
+        float directionX, directionY, directionZ;
+        float maxDistance;
+    };
+
+    /** The closest intersection of a ray */
+    struct BvhHit {
+        /** The index of the mesh that is hit (in the order given to the build) or -1 if nothing is hit */
+        int meshIndex;
+        /** The index of the hit triangle in the mesh: its indices start at startIndexLocation + 3 * triangleIndex */
+        int triangleIndex;
+        /** The t of the hit point along the ray */
+        float distance;
+        /** Barycentrics: the hit point is (1 - u - v) * a + u * b + v * c for the triangle (a, b, c) */
+        float u, v;
+    };
+
+    /**
+     * One node of the flattened hierarchy (32 bytes, so two of them share a cache line). The two
+     * children of an inner node are next to each other, so only the first one is referenced.
+     */
+    struct BvhNode {
+        float minX, minY, minZ;
+        /** Inner nodes: the index of the first child - leaves: the index of their triangle packet */
+        unsigned int childOrPacket;
+        float maxX, maxY, maxZ;
+        /** The number of triangles of leaves - zero for inner nodes */
+        unsigned int triangleCount;
+    };
+
+    /**
+     * The (at most four) triangles of a leaf in SIMD friendly (structure of arrays) layout with the
+     * data the intersection needs: the first vertex and the two edges from it. Unused slots have
+     * zero edges, so they never get hit.
+     */
+    struct BvhTrianglePacket {
+        float v0x[4], v0y[4], v0z[4];
+        float e1x[4], e1y[4], e1z[4];
+        float e2x[4], e2y[4], e2z[4];
+        unsigned int meshIndex[4];
+        unsigned int triangleIndex[4];
+    };
+
+    /**
+     * Bounding volume hierarchy over the triangles of one or more meshes (usually all meshes of a
+     * model). The build uses binned surface area heuristic splits; with a thread pool the top of
+     * the tree gets binned in parallel and then the subtrees get built in parallel. The queries
+     * use SSE for the ray/box and the four-triangles-at-once ray/triangle tests when the compiler
+     * targets it and plain floats otherwise - the results are the same.
+     *
+     * The hierarchy keeps copies of the triangle positions, so it stays valid when the meshes are
+     * changed or destroyed - but of course it does not follow those changes.
+     */
+    class TriangleBvh final {
+    public:
+        /** Leaves are one packet */
+        static const unsigned int MAX_LEAF_TRIANGLES = 4;
+        /** The number of bins per axis when searching for the best split */
+        static const unsigned int BIN_COUNT = 16;
+
+        /** The hierarchy of the root node - see BvhNode for the layout */
+        std::vector<BvhNode> nodes;
+        /** The triangles of the leaves */
+        std::vector<BvhTrianglePacket> packets;
+
+        /** Creates an empty hierarchy - nothing gets hit */
+        TriangleBvh() {}
+
+        /** Builds the hierarchy over the triangles of the meshes - see build(..) */
+        explicit TriangleBvh(const std::vector<const ObjMeshObject *> &meshes, ThreadPool *threadPool = nullptr) {
+            build(meshes, threadPool);
+        }
+
+        /** Builds the hierarchy over the triangles of the meshes of the model - hits refer to model.meshes */
+        template<class TexturePreparationLibrary>
+        explicit TriangleBvh(const MaterializedObjModel<TexturePreparationLibrary> &model, ThreadPool *threadPool = nullptr) {
+            std::vector<const ObjMeshObject *> meshes;
+            for(auto &mesh : model.meshes) {
+                meshes.push_back(&mesh);
+            }
+            build(meshes, threadPool);
+        }
+
+        /**
+         * (Re)builds the hierarchy over the triangles of the meshes. Returns false (leaving the
+         * hierarchy empty) if an index of a mesh is outside of its vertex range.
+         */
+        bool build(const std::vector<const ObjMeshObject *> &meshes, ThreadPool *threadPool = nullptr);
+
+        /** Finds the closest hit of the ray - returns false and sets hit.meshIndex to -1 if there is none */
+        bool intersect(const BvhRay &ray, BvhHit &hit) const;
+
+        /** Says if anything is hit by the ray - cheaper than intersect(..) for line of sight queries */
+        bool isOccluded(const BvhRay &ray) const;
+
+        /** Finds the closest hits of many rays (in parallel with a thread pool) - the same as intersect(..) one-by-one */
+        void intersect(const BvhRay *rays, unsigned int rayCount, BvhHit *hits, ThreadPool *threadPool = nullptr) const;
+
+        /** The number of triangles in the hierarchy */
+        inline unsigned int getTriangleCount() const { return triangleCount; }
+
+    private:
+        /** Finds the closest hit when anyHit is false, otherwise stops at the first one */
+        bool traverse(const BvhRay &ray, BvhHit &hit, bool anyHit) const;
+
+        unsigned int triangleCount = 0;
+    };
+
+    /** Test helper: the closest hit by testing every triangle of the meshes (the slow way) */
+    static BvhHit bruteForceIntersect(const std::vector<const ObjMeshObject *> &meshes, const BvhRay &ray) {
+        BvhHit hit = BvhHit { -1, -1, ray.maxDistance, 0, 0 };
+        for(unsigned int m = 0; m < meshes.size(); ++m) {
+            const ObjMeshObject &mesh = *meshes[m];
+            OM_INDEX_TYPE firstIndex = (OM_INDEX_TYPE)(mesh.lastIndex - mesh.vertexCount);
+            for(unsigned int t = 0; t < mesh.indexCount / 3; ++t) {
+                const VertexStructure *corners[3];
+                for(int k = 0; k < 3; ++k) {
+                    OM_INDEX_TYPE index = (*mesh.indices)[mesh.startIndexLocation + 3 * t + k];
+                    corners[k] = &(*mesh.vertexData)[mesh.baseVertexLocation + (OM_INDEX_TYPE)(index - firstIndex)];
+                }
+                // Moller-Trumbore
+                float e1[3] = { corners[1]->x - corners[0]->x, corners[1]->y - corners[0]->y, corners[1]->z - corners[0]->z };
+                float e2[3] = { corners[2]->x - corners[0]->x, corners[2]->y - corners[0]->y, corners[2]->z - corners[0]->z };
+                float p[3] = { ray.directionY * e2[2] - ray.directionZ * e2[1], ray.directionZ * e2[0] - ray.directionX * e2[2],
+                               ray.directionX * e2[1] - ray.directionY * e2[0] };
+                float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+                if(det == 0) {
+                    continue;
+                }
+                float s[3] = { ray.originX - corners[0]->x, ray.originY - corners[0]->y, ray.originZ - corners[0]->z };
+                float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+                float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+                float v = (ray.directionX * q[0] + ray.directionY * q[1] + ray.directionZ * q[2]) / det;
+                float distance = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+                if((u >= 0) && (v >= 0) && (u + v <= 1) && (distance >= 0) && (distance < hit.distance)) {
+                    hit = BvhHit { (int)m, (int)t, distance, u, v };
+                }
+            }
+        }
+        return hit;
+    }
+
+// Very simple unit-testing approach
+// it is better to have these run on the device itself and callable as normal functions than to
+// test it compile-time with some unit testing framework as this way we rule out architectural
+// differences better. Tests will start by logging test starts to error (when #DEBUG is set!)
+// and info logs and the method returns false when anything has failed...
+    static bool TEST_TriangleBvh() {
+#ifdef DEBUG
+        OMLOGI("TEST_TriangleBvh...");
+#endif
+        // Two parallel grids facing +z (at z = 0 and z = -1) in two meshes sharing the buffers
+        const int SIZE = 9;
+        std::vector<VertexStructure> vertices;
+        std::vector<OM_INDEX_TYPE> indices;
+        ObjMeshObject grids[2];
+        for(int g = 0; g < 2; ++g) {
+            grids[g].startIndexLocation = (unsigned int)indices.size();
+            grids[g].baseVertexLocation = (unsigned int)vertices.size();
+            for(int y = 0; y < SIZE; ++y) {
+                for(int x = 0; x < SIZE; ++x) {
+                    vertices.push_back(VertexStructure { (float)x, (float)y, (float)-g, 0, 0, 1, 0, 0 });
+                }
+            }
+            for(int y = 0; y + 1 < SIZE; ++y) {
+                for(int x = 0; x + 1 < SIZE; ++x) {
+                    OM_INDEX_TYPE a = (OM_INDEX_TYPE)(grids[g].baseVertexLocation + y * SIZE + x), b = a + 1, c = a + SIZE, d = c + 1;
+                    indices.insert(indices.end(), { a, b, d, a, d, c });
+                }
+            }
+            grids[g].indexCount = (unsigned int)indices.size() - grids[g].startIndexLocation;
+            grids[g].vertexCount = SIZE * SIZE;
+            grids[g].lastIndex = (OM_INDEX_TYPE)vertices.size();
+        }
+        for(ObjMeshObject &grid : grids) {
+            grid.vertexData = &vertices;
+            grid.indices = &indices;
+        }
+        std::vector<const ObjMeshObject *> meshes = { &grids[0], &grids[1] };
+        ThreadPool pool(3);
+        TriangleBvh bvh(meshes, &pool);
+        if((bvh.getTriangleCount() != 2 * 2 * (SIZE - 1) * (SIZE - 1)) || bvh.nodes.empty()) {
+            OMLOGE("Bad BVH triangle count: %u!", bvh.getTriangleCount());
+            return false;
+        }
+
+        // Straight down onto the cell (2, 3): the triangle (a, d, c) of the cell is hit at z = 0
+        BvhHit hit;
+        BvhRay ray = BvhRay { 2.25f, 3.75f, 10, 0, 0, -1, 100 };
+        if(!bvh.intersect(ray, hit) || (hit.meshIndex != 0) || (hit.triangleIndex != 2 * (3 * (SIZE - 1) + 2) + 1) ||
+           (std::fabs(hit.distance - 10) > 0.0001f) || (std::fabs(hit.u - 0.25f) > 0.0001f) || (std::fabs(hit.v - 0.5f) > 0.0001f)) {
+            OMLOGE("Bad BVH hit: mesh %d triangle %d at %f (%f, %f)!", hit.meshIndex, hit.triangleIndex, hit.distance, hit.u, hit.v);
+            return false;
+        }
+        // From between the grids only the second one is in front
+        ray = BvhRay { 2.25f, 3.75f, -0.5f, 0, 0, -1, 100 };
+        if(!bvh.intersect(ray, hit) || (hit.meshIndex != 1) || (std::fabs(hit.distance - 0.5f) > 0.0001f)) {
+            OMLOGE("Bad BVH hit from between the grids!");
+            return false;
+        }
+        // Too short, beside and parallel rays miss
+        for(const BvhRay &missing : { BvhRay { 2.25f, 3.75f, 10, 0, 0, -1, 9.5f }, BvhRay { 20, 3, 10, 0, 0, -1, 100 },
+                                      BvhRay { -1, 3, 0.5f, 1, 0, 0, 100 } }) {
+            if(bvh.intersect(missing, hit) || (hit.meshIndex != -1) || bvh.isOccluded(missing)) {
+                OMLOGE("A missing ray hits the BVH!");
+                return false;
+            }
+        }
+
+        // Slanted rays: the same as testing every triangle - one by one and in a batch
+        std::vector<BvhRay> rays;
+        for(int i = 0; i < 200; ++i) {
+            rays.push_back(BvhRay { (float)(i % 13) - 2, (i % 7) + 0.3f, 5, 0.1f * (i % 5) + 0.05f, 0.07f * (i % 3), -1, 100 });
+        }
+        std::vector<BvhHit> hits(rays.size());
+        bvh.intersect(&rays[0], (unsigned int)rays.size(), &hits[0], &pool);
+        for(size_t i = 0; i < rays.size(); ++i) {
+            BvhHit expected = bruteForceIntersect(meshes, rays[i]);
+            if((hits[i].meshIndex != expected.meshIndex) || (std::fabs(hits[i].distance - expected.distance) > 0.0001f) ||
+               (bvh.isOccluded(rays[i]) != (expected.meshIndex >= 0))) {
+                OMLOGE("Ray %d hits mesh %d at %f instead of mesh %d at %f!", (int)i, hits[i].meshIndex, hits[i].distance,
+                       expected.meshIndex, expected.distance);
+                return false;
+            }
+        }
+
+#ifdef DEBUG
+        OMLOGI("...TEST_TriangleBvh completed (OK)");
+#endif
+        return true;
+    }
+}
+
+#endif //OBJMASTER_TRIANGLEBVH_H
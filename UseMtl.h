@@ -16,7 +16,7 @@ namespace ObjMaster {
     public:
         /** Defines if the given fields of an obj file line can be parsed as a UseMtl or not */
         static bool isParsable(const char *fields) {
-            if((fields != nullptr) && fields[0] == 'u' && isStartsWith(std::string(fields), "usemtl")) {
+            if((fields != nullptr) && fields[0] == 'u' && (strncmp(fields, "usemtl", 6) == 0)) {
                 return true;
             } else {
                 return false;
@@ -0,0 +1,173 @@
+//
+// Conversion between VertexStructure and the compact (quantized) vertex layouts.
+//
+
+#include "VertexCompression.h"
+#include <cstring>
+#include <algorithm>
+
+namespace ObjMaster {
+
+    uint16_t VertexCompression::floatToHalf(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+        uint32_t abs = bits & 0x7fffffff;
+        if(abs >= 0x7f800000) {
+            // Infinity or NaN (keep it a NaN)
+            return (uint16_t)(sign | 0x7c00 | ((abs > 0x7f800000) ? 0x0200 : 0));
+        }
+        if(abs >= 0x477ff000) {
+            // Would round to 65520 or more - which is infinity already
+            return (uint16_t)(sign | 0x7c00);
+        }
+        if(abs < 0x38800000) {
+            // Denormal half: the mantissa is simply value * 2^24 rounded (exact float multiplication)
+            float absValue;
+            memcpy(&absValue, &abs, sizeof(absValue));
+            return (uint16_t)(sign | (uint16_t)std::nearbyint(absValue * 16777216.0f));
+        }
+        // Normal half: rebias the exponent (127 -> 15) and round the mantissa to nearest even.
+        // Rem.: a mantissa overflow correctly carries into the exponent.
+        uint32_t half = (abs - 0x38000000) >> 13;
+        uint32_t rest = abs & 0x1fff;
+        if((rest > 0x1000) || ((rest == 0x1000) && ((half & 1) != 0))) {
+            ++half;
+        }
+        return (uint16_t)(sign | half);
+    }
+
+    float VertexCompression::halfToFloat(uint16_t half) {
+        uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+        uint32_t exponent = (half >> 10) & 0x1f;
+        uint32_t mantissa = half & 0x3ff;
+        if(exponent == 0) {
+            float value = (float)mantissa / 16777216.0f;
+            return (sign != 0) ? -value : value;
+        }
+        uint32_t bits;
+        if(exponent == 31) {
+            bits = sign | 0x7f800000 | (mantissa << 13);
+        } else {
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        }
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    /** Sign that is never zero - needed for the octahedral folding */
+    static inline float signNotZero(float value) {
+        return (value >= 0.0f) ? 1.0f : -1.0f;
+    }
+
+    /** Normalized signed 16 bit value of the [-1, 1] value */
+    static inline int16_t toSnorm16(float value) {
+        return (int16_t)std::lround(std::max(-1.0f, std::min(1.0f, value)) * 32767.0f);
+    }
+
+    void VertexCompression::encodeOctahedral(float x, float y, float z, int16_t &outI, int16_t &outJ) {
+        float l1 = std::fabs(x) + std::fabs(y) + std::fabs(z);
+        if(l1 == 0.0f) {
+            outI = 0;
+            outJ = 0;
+            return;
+        }
+        float px = x / l1;
+        float py = y / l1;
+        if(z < 0.0f) {
+            // Fold the lower hemisphere over the diagonals
+            float foldedX = (1.0f - std::fabs(py)) * signNotZero(px);
+            float foldedY = (1.0f - std::fabs(px)) * signNotZero(py);
+            px = foldedX;
+            py = foldedY;
+        }
+        outI = toSnorm16(px);
+        outJ = toSnorm16(py);
+    }
+
+    void VertexCompression::decodeOctahedral(int16_t i, int16_t j, float &outX, float &outY, float &outZ) {
+        // Rem.: -32768 is clamped to -1 just like the GPU does with normalized values
+        float x = std::max(-1.0f, (float)i / 32767.0f);
+        float y = std::max(-1.0f, (float)j / 32767.0f);
+        float z = 1.0f - std::fabs(x) - std::fabs(y);
+        if(z < 0.0f) {
+            float unfoldedX = (1.0f - std::fabs(y)) * signNotZero(x);
+            float unfoldedY = (1.0f - std::fabs(x)) * signNotZero(y);
+            x = unfoldedX;
+            y = unfoldedY;
+        }
+        float length = std::sqrt(x * x + y * y + z * z);
+        outX = x / length;
+        outY = y / length;
+        outZ = z / length;
+    }
+
+    VertexQuantization VertexCompression::computeQuantization(const VertexStructure *vertices, unsigned int vertexCount) {
+        if(vertexCount == 0) {
+            return VertexQuantization { 0, 0, 0, 1, 1, 1 };
+        }
+        float minPos[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+        float maxPos[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+        for(unsigned int v = 1; v < vertexCount; ++v) {
+            const float pos[3] = { vertices[v].x, vertices[v].y, vertices[v].z };
+            for(int k = 0; k < 3; ++k) {
+                minPos[k] = std::min(minPos[k], pos[k]);
+                maxPos[k] = std::max(maxPos[k], pos[k]);
+            }
+        }
+        // Rem.: zero scale (flat axis) is handled by the compression
+        return VertexQuantization { minPos[0], minPos[1], minPos[2],
+                                    maxPos[0] - minPos[0], maxPos[1] - minPos[1], maxPos[2] - minPos[2] };
+    }
+
+    void VertexCompression::dequantizationMatrix(const VertexQuantization &quantization, float out[16]) {
+        for(int k = 0; k < 16; ++k) {
+            out[k] = 0.0f;
+        }
+        out[0] = quantization.scaleX;
+        out[5] = quantization.scaleY;
+        out[10] = quantization.scaleZ;
+        out[12] = quantization.offsetX;
+        out[13] = quantization.offsetY;
+        out[14] = quantization.offsetZ;
+        out[15] = 1.0f;
+    }
+
+    /** Normalized unsigned 16 bit value of the position along one axis of the bounding box */
+    static inline uint16_t quantize(float value, float offset, float scale) {
+        if(scale <= 0.0f) {
+            return 0;
+        }
+        return (uint16_t)std::lround(std::max(0.0f, std::min(1.0f, (value - offset) / scale)) * 65535.0f);
+    }
+
+    void VertexCompression::compress(const VertexStructure *vertices, unsigned int vertexCount,
+            const VertexQuantization &quantization, CompactVertexStructure *out) {
+        for(unsigned int v = 0; v < vertexCount; ++v) {
+            const VertexStructure &in = vertices[v];
+            CompactVertexStructure &compact = out[v];
+            compact.x = quantize(in.x, quantization.offsetX, quantization.scaleX);
+            compact.y = quantize(in.y, quantization.offsetY, quantization.scaleY);
+            compact.z = quantize(in.z, quantization.offsetZ, quantization.scaleZ);
+            compact.w = 0;
+            encodeOctahedral(in.i, in.j, in.k, compact.i, compact.j);
+            compact.u = floatToHalf(in.u);
+            compact.v = floatToHalf(in.v);
+        }
+    }
+
+    void VertexCompression::decompress(const CompactVertexStructure *vertices, unsigned int vertexCount,
+            const VertexQuantization &quantization, VertexStructure *out) {
+        for(unsigned int v = 0; v < vertexCount; ++v) {
+            const CompactVertexStructure &compact = vertices[v];
+            VertexStructure &vertex = out[v];
+            vertex.x = quantization.offsetX + quantization.scaleX * ((float)compact.x / 65535.0f);
+            vertex.y = quantization.offsetY + quantization.scaleY * ((float)compact.y / 65535.0f);
+            vertex.z = quantization.offsetZ + quantization.scaleZ * ((float)compact.z / 65535.0f);
+            decodeOctahedral(compact.i, compact.j, vertex.i, vertex.j, vertex.k);
+            vertex.u = halfToFloat(compact.u);
+            vertex.v = halfToFloat(compact.v);
+        }
+    }
+}
@@ -0,0 +1,138 @@
+//
+// Conversion between VertexStructure and the compact (quantized) vertex layouts.
+//
+
+#ifndef OBJMASTER_VERTEXCOMPRESSION_H
+#define OBJMASTER_VERTEXCOMPRESSION_H
+
+#include "VertexStructure.h"
+#include "CompactVertexStructure.h"
+#include "objmasterlog.h"
+#include <vector>
+#include <cmath>
+#include <stdint.h>
+
+namespace ObjMaster {
+
+    /**
+     * Selectable layouts of the render-ready vertex data. The "bigger changes by new structures in
+     * parallel" promise of VertexStructure.h is kept this way: the float layout stays as it is.
+     */
+    enum VertexLayout {
+        /** VertexStructure: 32 bytes of floats */
+        FLOAT_VERTEX_LAYOUT = 0,
+        /** CompactVertexStructure: 16 bytes - quantized positions, octahedral normals and half float uvs */
+        COMPACT_VERTEX_LAYOUT = 1,
+    };
+
+    /**
+     * Encoding and decoding of the compact vertex attributes. The decoding methods do the very
+     * same as the shaders should do (see CompactVertexStructure.h) - useful for CPU-side use.
+     */
+    class VertexCompression final {
+    public:
+        /** Converts to IEEE half float - rounds to nearest even, too big values become infinity */
+        static uint16_t floatToHalf(float value);
+
+        /** Converts an IEEE half float back to float */
+        static float halfToFloat(uint16_t half);
+
+        /** Octahedral encoding of the (not necessarily normalized) vector as normalized 16 bit values */
+        static void encodeOctahedral(float x, float y, float z, int16_t &outI, int16_t &outJ);
+
+        /** Decodes the octahedral encoded vector to a unit vector */
+        static void decodeOctahedral(int16_t i, int16_t j, float &outX, float &outY, float &outZ);
+
+        /** Computes the quantization of the positions: the bounding box of the vertices */
+        static VertexQuantization computeQuantization(const VertexStructure *vertices, unsigned int vertexCount);
+
+        /**
+         * Writes the column-major 4x4 matrix of the quantization to out - multiply the model
+         * matrix with this to dequantize the positions without any extra shader work.
+         */
+        static void dequantizationMatrix(const VertexQuantization &quantization, float out[16]);
+
+        /** Converts the vertices to the compact layout using the given quantization for positions */
+        static void compress(const VertexStructure *vertices, unsigned int vertexCount,
+                const VertexQuantization &quantization, CompactVertexStructure *out);
+
+        /** Converts the compact vertices back to the float layout (with the precision loss of course) */
+        static void decompress(const CompactVertexStructure *vertices, unsigned int vertexCount,
+                const VertexQuantization &quantization, VertexStructure *out);
+    };
+
+// Very simple unit-testing approach
+// it is better to have these run on the device itself and callable as normal functions than to
+// test it compile-time with some unit testing framework as this way we rule out architectural
+// differences better. Tests will start by logging test starts to error (when #DEBUG is set!)
+// and info logs and the method returns false when anything has failed...
+    static bool TEST_VertexCompression() {
+#ifdef DEBUG
+        OMLOGI("TEST_VertexCompression...");
+#endif
+        // Half floats: exact values, rounding, denormals and overflow
+        for(float f : { 0.0f, 1.0f, -2.5f, 0.125f, 65504.0f, -0.000061035156f /* smallest normal */ }) {
+            if(VertexCompression::halfToFloat(VertexCompression::floatToHalf(f)) != f) {
+                OMLOGE("Half float conversion is not exact for %f!", f);
+                return false;
+            }
+        }
+        for(float f : { 0.1f, -3.14159f, 1000.7f, 0.00001f /* denormal */ }) {
+            float back = VertexCompression::halfToFloat(VertexCompression::floatToHalf(f));
+            if(std::fabs(back - f) > std::fabs(f) * 0.001f + 0.0000001f) {
+                OMLOGE("Half float conversion is too imprecise for %f: %f!", f, back);
+                return false;
+            }
+        }
+        if((VertexCompression::floatToHalf(70000.0f) != 0x7c00) || (VertexCompression::floatToHalf(1.0f) != 0x3c00)) {
+            OMLOGE("Bad half float encoding!");
+            return false;
+        }
+
+        // Octahedral normals: all octants
+        const float normals[][3] = { { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 }, { 0, -1, 0 },
+                                     { 0.267f, -0.535f, 0.802f }, { -0.577f, -0.577f, -0.577f }, { 0.6f, 0.8f, -0.0001f } };
+        for(const float *n : normals) {
+            int16_t i, j;
+            float x, y, z;
+            VertexCompression::encodeOctahedral(n[0], n[1], n[2], i, j);
+            VertexCompression::decodeOctahedral(i, j, x, y, z);
+            float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if((std::fabs(x - n[0] / length) > 0.001f) || (std::fabs(y - n[1] / length) > 0.001f) ||
+               (std::fabs(z - n[2] / length) > 0.001f)) {
+                OMLOGE("Octahedral normal (%f, %f, %f) came back as (%f, %f, %f)!", n[0], n[1], n[2], x, y, z);
+                return false;
+            }
+        }
+
+        // Positions: the corners of the bounding box should come back exactly, the rest within the step
+        std::vector<VertexStructure> vertices = {
+            { -1.5f, 2, 10, 0, 1, 0, 0.25f, 0.75f },
+            { 3.5f, 7, 10, 0, 0, 0, 1, 0 },
+            { 0.1234f, 3.3f, 10, 1, 0, 0, -2, 4 },
+        };
+        VertexQuantization quantization = VertexCompression::computeQuantization(&vertices[0], (unsigned int)vertices.size());
+        std::vector<CompactVertexStructure> compact(vertices.size());
+        std::vector<VertexStructure> back(vertices.size());
+        VertexCompression::compress(&vertices[0], (unsigned int)vertices.size(), quantization, &compact[0]);
+        VertexCompression::decompress(&compact[0], (unsigned int)compact.size(), quantization, &back[0]);
+        for(size_t v = 0; v < vertices.size(); ++v) {
+            if((std::fabs(back[v].x - vertices[v].x) > 5.0f / 65535) || (std::fabs(back[v].y - vertices[v].y) > 5.0f / 65535) ||
+               (back[v].z != vertices[v].z) || (back[v].u != vertices[v].u) || (back[v].v != vertices[v].v)) {
+                OMLOGE("Vertex %d did not survive the compression!", (int)v);
+                return false;
+            }
+        }
+        if((back[0].x != -1.5f) || (back[1].y != 7.0f) || (compact[1].i != 0) || (compact[1].j != 0)) {
+            OMLOGE("Bad compression of the bounding box corners or the missing normal!");
+            return false;
+        }
+
+#ifdef DEBUG
+        OMLOGI("...TEST_VertexCompression completed (OK)");
+#endif
+        return true;
+    }
+}
+
+#endif //OBJMASTER_VERTEXCOMPRESSION_H
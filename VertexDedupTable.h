@@ -0,0 +1,294 @@
+//
+// Flat hash table for de-duplicating face points while building meshes.
+//
+
+#ifndef OBJMASTER_VERTEXDEDUPTABLE_H
+#define OBJMASTER_VERTEXDEDUPTABLE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "objmasterlog.h"
+
+namespace ObjMaster {
+
+    /**
+     * Open-addressing (linear probing) hash table that maps keys to values - used to find the
+     * already added vertices when building the vertex and index buffers of meshes.
+     *
+     * The key type should provide an uint64_t hash() const method and operator==. Entries are
+     * stored densely in the insertion order and the probed slot array only holds the full hash
+     * and the position of the entry. This way probing touches 8 bytes per slot, most mismatches
+     * are sorted out without comparing the keys and growing only needs to re-place the slots.
+     * There is no per-entry heap allocation and one lookup is enough for both hits and misses.
+     */
+    template<typename Key, typename Value>
+    class VertexDedupTable final {
+    public:
+        /**
+         * Create a table presized for the expected number of (unique) entries - it grows when needed.
+         * A table that expects no entries allocates nothing before its first insertion.
+         */
+        VertexDedupTable(size_t expectedCount) {
+            if(expectedCount == 0) {
+                return;
+            }
+            size_t capacity = MIN_CAPACITY;
+            while(capacity * MAX_LOAD_NUM < expectedCount * MAX_LOAD_DENOM) {
+                capacity <<= 1;
+            }
+            slots.resize(capacity);
+            entries.reserve(expectedCount);
+        }
+
+        /**
+         * Returns a pointer to the value of the key if it is already in the table. Otherwise adds
+         * the key with the given value and returns nullptr. The returned pointer is only valid
+         * until the next insertion.
+         */
+        inline const Value* findOrInsert(const Key &key, Value value) {
+            if(slots.empty()) {
+                slots.resize(MIN_CAPACITY);
+            }
+            uint64_t hash = key.hash();
+            uint32_t shortHash = (uint32_t)(hash >> 32);
+            size_t mask = slots.size() - 1;
+            size_t i = (size_t)hash & mask;
+            while(slots[i].entryNo != 0) {
+                const Slot &slot = slots[i];
+                if((slot.hash == shortHash) && (entries[slot.entryNo - 1].key == key)) {
+                    return &entries[slot.entryNo - 1].value;
+                }
+                i = (i + 1) & mask;
+            }
+
+            // Not found: add as a new entry (grow first if the table would get too full)
+            entries.push_back(Entry { key, value, hash });
+            if((entries.size() * MAX_LOAD_DENOM) > (slots.size() * MAX_LOAD_NUM)) {
+                grow();
+            } else {
+                slots[i] = Slot { shortHash, (uint32_t)entries.size() };
+            }
+            return nullptr;
+        }
+
+        /**
+         * Returns a pointer to the value of the key or nullptr if it is not in the table. This does
+         * not change the table so it is safe to call concurrently when nobody inserts meanwhile.
+         */
+        inline const Value* find(const Key &key) const {
+            if(slots.empty()) {
+                return nullptr;
+            }
+            uint64_t hash = key.hash();
+            uint32_t shortHash = (uint32_t)(hash >> 32);
+            size_t mask = slots.size() - 1;
+            size_t i = (size_t)hash & mask;
+            while(slots[i].entryNo != 0) {
+                const Slot &slot = slots[i];
+                if((slot.hash == shortHash) && (entries[slot.entryNo - 1].key == key)) {
+                    return &entries[slot.entryNo - 1].value;
+                }
+                i = (i + 1) & mask;
+            }
+            return nullptr;
+        }
+
+        /** The number of entries in the table */
+        inline size_t size() const { return entries.size(); }
+
+        /** The number of slots in the table - always a power of two (zero before the first insertion when no entries were expected) */
+        inline size_t capacity() const { return slots.size(); }
+
+    private:
+        // Keep the load factor under 7/10 - linear probing gets slow above that
+        static const size_t MAX_LOAD_NUM = 7;
+        static const size_t MAX_LOAD_DENOM = 10;
+        static const size_t MIN_CAPACITY = 16;
+
+        struct Slot {
+            /** The upper half of the full hash (the lower bits are implied by the position) */
+            uint32_t hash;
+            /** The position of the entry plus one - zero means an empty slot */
+            uint32_t entryNo;
+        };
+
+        struct Entry {
+            Key key;
+            Value value;
+            uint64_t hash;
+        };
+
+        /** Double the slot count and re-place all entries (including the just added last one) */
+        void grow() {
+            slots.assign(slots.size() * 2, Slot { 0, 0 });
+            size_t mask = slots.size() - 1;
+            for(size_t e = 0; e < entries.size(); ++e) {
+                size_t i = (size_t)entries[e].hash & mask;
+                while(slots[i].entryNo != 0) {
+                    i = (i + 1) & mask;
+                }
+                slots[i] = Slot { (uint32_t)(entries[e].hash >> 32), (uint32_t)(e + 1) };
+            }
+        }
+
+        std::vector<Slot> slots;
+        std::vector<Entry> entries;
+    };
+
+    /**
+     * Finalizer of the MurmurHash3 64 bit hash - mixes all input bits into all output bits.
+     * Useful for combining field hashes into a hash where any bits can be used for indexing.
+     */
+    static inline uint64_t dedupMix64(uint64_t k) {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+        return k;
+    }
+
+    /**
+     * Adds one field (word) to a running hash. Cheap - the result should be finished with
+     * dedupMix64 before it is used, as the lowest bits are weak before that.
+     */
+    static inline uint64_t dedupCombine(uint64_t hash, uint64_t word) {
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+        return (hash << 31) | (hash >> 33);
+    }
+
+    /** The bits of the float for hashing - the two zeroes compare equal so they must give the same bits */
+    static inline uint64_t dedupFloatBits(float f) {
+        if(f == 0) {
+            return 0;
+        }
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        return bits;
+    }
+
+    /** Used as key for hashing when de-duplicating by the face point indices */
+    struct FacePointIndexKey {
+        unsigned int vIndex;
+        unsigned int vtIndex;
+        unsigned int vnIndex;
+
+        friend bool operator==(const FacePointIndexKey& lhs, const FacePointIndexKey& rhs) {
+            return (lhs.vIndex == rhs.vIndex) && (lhs.vtIndex == rhs.vtIndex) && (lhs.vnIndex == rhs.vnIndex);
+        }
+
+        uint64_t hash() const {
+            uint64_t h = dedupCombine(0, ((uint64_t)vIndex << 32) | vtIndex);
+            h = dedupCombine(h, vnIndex);
+            return dedupMix64(h);
+        }
+    };
+
+    /**
+     * Used as key for hashing when de-duplicating layout vertices by value: only the floats of
+     * the layout are hashed and compared (all the supported layouts are made of floats only).
+     */
+    template<typename Vertex>
+    struct LayoutVertexKey {
+        static const int FLOAT_COUNT = sizeof(Vertex) / sizeof(float);
+        static_assert(sizeof(Vertex) == FLOAT_COUNT * sizeof(float), "Layouts should only have float attributes!");
+
+        Vertex vertex;
+
+        friend bool operator==(const LayoutVertexKey& lhs, const LayoutVertexKey& rhs) {
+            const float *l = (const float *)&lhs.vertex;
+            const float *r = (const float *)&rhs.vertex;
+            for(int i = 0; i < FLOAT_COUNT; ++i) {
+                if(l[i] != r[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        uint64_t hash() const {
+            const float *f = (const float *)&vertex;
+            uint64_t h = 0;
+            int i = 0;
+            for(; i + 1 < FLOAT_COUNT; i += 2) {
+                h = dedupCombine(h, dedupFloatBits(f[i]) | (dedupFloatBits(f[i + 1]) << 32));
+            }
+            if(i < FLOAT_COUNT) {
+                h = dedupCombine(h, dedupFloatBits(f[i]));
+            }
+            return dedupMix64(h);
+        }
+    };
+
+    /**
+     * Like LayoutVertexKey, but also keeps which elements (position, texcoord, normal) the face point
+     * had, so a missing element does not match a zero valued one - just like the keys of the mesh
+     * build do not. Used where the elements cannot be referred in the Obj (shared and appended meshes).
+     */
+    template<typename Vertex>
+    struct PresenceVertexKey {
+        /** The bits of the present elements */
+        static const uint32_t HAS_V = 1, HAS_VT = 2, HAS_VN = 4;
+        static const uint32_t HAS_ALL = HAS_V | HAS_VT | HAS_VN;
+
+        LayoutVertexKey<Vertex> value;
+        uint32_t presence;
+
+        friend bool operator==(const PresenceVertexKey& lhs, const PresenceVertexKey& rhs) {
+            return (lhs.presence == rhs.presence) && (lhs.value == rhs.value);
+        }
+
+        uint64_t hash() const {
+            return dedupMix64(dedupCombine(value.hash(), presence));
+        }
+    };
+
+// Very simple unit-testing approach
+// it is better to have these run on the device itself and callable as normal functions than to
+// test it compile-time with some unit testing framework as this way we rule out architectural
+// differences better. Tests will start by logging test starts to error (when #DEBUG is set!)
+// and info logs and the method returns false when anything has failed...
+    /** Key for the test - the hash is deliberately bad to test probing over collisions */
+    struct TEST_VertexDedupKey {
+        unsigned int value;
+        uint64_t hash() const { return (uint64_t)(value % 7); }
+        friend bool operator==(const TEST_VertexDedupKey &lhs, const TEST_VertexDedupKey &rhs) {
+            return lhs.value == rhs.value;
+        }
+    };
+
+    static bool TEST_VertexDedupTable() {
+#ifdef DEBUG
+        OMLOGI("TEST_VertexDedupTable...");
+#endif
+        // Presized way too small on purpose so that the table must grow many times
+        VertexDedupTable<TEST_VertexDedupKey, unsigned int> table(2);
+        const unsigned int COUNT = 1000;
+        for(unsigned int i = 0; i < COUNT; ++i) {
+            if(table.findOrInsert(TEST_VertexDedupKey { i * 3 }, i) != nullptr) {
+                OMLOGE("Key %u is found before it was added!", i * 3);
+                return false;
+            }
+        }
+        for(unsigned int i = 0; i < COUNT; ++i) {
+            const unsigned int *found = table.findOrInsert(TEST_VertexDedupKey { i * 3 }, 0);
+            if((found == nullptr) || (*found != i)) {
+                OMLOGE("Key %u is not found properly after growing!", i * 3);
+                return false;
+            }
+        }
+        if((table.size() != COUNT) || (table.capacity() * 7 < COUNT * 10)) {
+            OMLOGE("Bad size (%d) or capacity (%d) of the table!", (int)table.size(), (int)table.capacity());
+            return false;
+        }
+
+#ifdef DEBUG
+        OMLOGI("...TEST_VertexDedupTable completed (OK)");
+#endif
+        return true;
+    }
+}
+
+#endif //OBJMASTER_VERTEXDEDUPTABLE_H
@@ -31,6 +31,9 @@ namespace ObjMaster {
 
         VertexElement(const char *fields);
 
+        /** Parse the [fields, fieldsEnd) range - it does not need to be zero terminated */
+        VertexElement(const char *fields, const char *fieldsEnd);
+
         static bool isParsable(const char *fields);
 
 	/** Gets the textual representation */
@@ -38,7 +41,7 @@ namespace ObjMaster {
 		return "v " + std::to_string(x) + " " + std::to_string(y) + " " + std::to_string(z);
 	}
     private:
-        void constructionHelper(char *fields);
+        void constructionHelper(const char *fields, const char *fieldsEnd);
     };
 
 // Very simple unit-testing approach
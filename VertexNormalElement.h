@@ -31,13 +31,16 @@ namespace ObjMaster {
 
         VertexNormalElement(const char *fields);
 
+        /** Parse the [fields, fieldsEnd) range - it does not need to be zero terminated */
+        VertexNormalElement(const char *fields, const char *fieldsEnd);
+
         static bool isParsable(const char *fields);
 	/** Gets the textual representation */
 	inline std::string asText() {
 		return "vn " + std::to_string(x) + " " + std::to_string(y) + " " + std::to_string(z);
 	}
     private:
-        void constructionHelper(char *fields);
+        void constructionHelper(const char *fields, const char *fieldsEnd);
     };
 
 // Very simple unit-testing approach
@@ -4,10 +4,8 @@
 
 //#include "objmasterlog.h"
 #include "VertexTextureElement.h"
-#include <cstring>    /* strtok_r */
-#include <cstdlib>     /* atof */
-#include "ObjCommon.h"
-#include "wincompat.h" // msvc hax
+#include <cstring>    /* strlen */
+#include "ObjTokenizer.h"
 
 namespace ObjMaster {
     bool VertexTextureElement::isParsable(const char *fields) {
@@ -17,31 +15,26 @@ namespace ObjMaster {
     }
 
     VertexTextureElement::VertexTextureElement(const char *fields) {
-        // The strtok_r changes the string so we need to duplicate it
-        char copy[256];	// The line never should be longer than this anyways...
-	copy[255] = 0;	// ensure terminator
-        strncpy(copy, fields, 254);
-        constructionHelper(copy);
-	// Remark: The original code below makes very small malloc and free pairs and fragment memory!
-        // char *copy = strdup(fields);
-        // constructionHelper(copy);
-        // free(copy);
+        // No copy is necessary anymore as the tokenizer never modifies the string
+        constructionHelper(fields, fields + strlen(fields));
     }
 
-    // This variant modifies the provided 'string' but is it faster as it do this without the copy
+    // Kept for compatibility: earlier this variant was the in-place one, now both are the same
     VertexTextureElement::VertexTextureElement(char *fields) {
-        constructionHelper(fields);
+        constructionHelper(fields, fields + strlen(fields));
     }
 
-    void VertexTextureElement::constructionHelper(char *fields) {
-        if (isParsable(fields)) {
-            char *savePtr;
-            char *key = strtok_r(fields, OBJ_DELIMITER, &savePtr);
-            char *uStr = strtok_r(nullptr, OBJ_DELIMITER, &savePtr);
-            char *vStr = strtok_r(nullptr, OBJ_DELIMITER, &savePtr);
+    VertexTextureElement::VertexTextureElement(const char *fields, const char *fieldsEnd) {
+        constructionHelper(fields, fieldsEnd);
+    }
 
-            u = (float)atof(uStr);
-            v = (float)atof(vStr);
+    void VertexTextureElement::constructionHelper(const char *fields, const char *fieldsEnd) {
+        // Same check as isParsable(..) but without reading over the end of the range
+        if((fieldsEnd - fields > 2) && (fields[0] == 'v') && (fields[1] == 't') && ObjTokenizer::isBlank(fields[2])) {
+            // Single pass: step over the key and parse the numbers one after the other
+            const char *p = fields + 2;
+            u = ObjTokenizer::parseFloat(p, fieldsEnd);
+            v = ObjTokenizer::parseFloat(p, fieldsEnd);
         }
     }
 }
@@ -30,6 +30,9 @@ namespace ObjMaster {
 
         VertexTextureElement(const char *fields);
 
+        /** Parse the [fields, fieldsEnd) range - it does not need to be zero terminated */
+        VertexTextureElement(const char *fields, const char *fieldsEnd);
+
         static bool isParsable(const char *fields);
 
 	/** Gets the textual representation */
@@ -37,7 +40,7 @@ namespace ObjMaster {
 		return "vt " + std::to_string(u) + " " + std::to_string(v);
 	}
     private:
-        void constructionHelper(char *fields);
+        void constructionHelper(const char *fields, const char *fieldsEnd);
     };
 
 // Very simple unit-testing approach
@@ -24,15 +24,14 @@
  */
 #define MODEL_PATH_MAX_LEN 512
 
-// Define this if your device only handles 16 bit indices and want to build like that!
-// This means that less model data will fit in the per-group or per-mesh memory, but
-// devices like Raspberry or Orange Pis and old phones will not complain. Of course 
-// you can also save graphics memory this way or let the 32 bit indices work and do 
-// post-processing on your own (for example you can cut a too big object to fit).
+// Define USE_16BIT_INDICES if your device only handles 16 bit indices and want to build like that!
+// Devices like Raspberry or Orange Pis and old phones will not complain this way as the too big
+// groups of the model get split into more meshes then (see SPLIT_FOR_16BIT_INDICES). Otherwise
+// the GlMesh still uses 16 bit indices for every mesh that fits - saving graphics memory.
 #if USE_16BIT_INDICES
-#define OM_GL_INDEX_TYPE_ENUM GL_UNSIGNED_SHORT
+#define OM_MODEL_BUILD_FLAGS ObjMaster::ObjMeshObject::MeshBuildFlags::SPLIT_FOR_16BIT_INDICES
 #else
-#define OM_GL_INDEX_TYPE_ENUM GL_UNSIGNED_INT
+#define OM_MODEL_BUILD_FLAGS ObjMaster::ObjMeshObject::MeshBuildFlags::DEDUP_BY_VALUE
 #endif /* USE_16BIT_INDICES */
 
 #define GL_GLEXT_PROTOTYPES
@@ -135,9 +134,9 @@ static void draw_model(ObjMaster::GlMesh &mesh, GLfloat *transform, const GLfloa
 	glBindTexture(GL_TEXTURE_2D, binding.material->tex_kd.handle);
 
 	printGlError("Before glDrawElements");
-	// Some devices does not support 32 bit indices (orange pi, raspberry pi, etc)
-	//glDrawElements(GL_TRIANGLES, binding.indexCount, GL_UNSIGNED_SHORT, 0);
-	glDrawElements(GL_TRIANGLES, binding.indexCount, OM_GL_INDEX_TYPE_ENUM, 0);
+	// The index type is chosen per mesh: 16 bit whenever the mesh fits. Some devices does not
+	// support 32 bit indices (orange pi, raspberry pi, etc) - see SPLIT_FOR_16BIT_INDICES for those!
+	glDrawElements(GL_TRIANGLES, binding.indexCount, binding.indexType, 0);
 	printGlError("After glDrawElements");
 }
 
@@ -169,7 +168,7 @@ static void draw() {
 	if(model.inited && model.meshes.size() > 0 && firstRun) {
 		firstRun = false;
 		for(auto &mesh : model.meshes) {
-			renderables.emplace_back(0, 1, 2, &mesh.material, mesh);
+			renderables.emplace_back(0, 1, 2, model.getLoadableMaterialOf(mesh), mesh);
 		}
 	}
 
@@ -407,7 +406,7 @@ static void init_with_model(char* modelFileNameAndPath) {
 			}
 		}
 	}
-	model = ObjMaster::MaterializedObjModel<ObjMasterExt::GlGpuTexturePreparationLibrary>(obj);
+	model = ObjMaster::MaterializedObjModel<ObjMasterExt::GlGpuTexturePreparationLibrary>(obj, OM_MODEL_BUILD_FLAGS);
  
 	// Load data onto the GPU and setup buffers for rendering
 	if(model.inited && model.meshes.size() > 0) {
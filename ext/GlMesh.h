@@ -19,6 +19,15 @@
 #include "../objmasterlog.h"
 #include "../MaterializedObjMeshObject.h"
 #include "../TextureDataHoldingMaterial.h"
+#include "../VertexCompression.h"
+#include <cstddef>
+
+/* Half float vertex attributes are core since GL 3.0 and ES 3.0 - ES 2.0 needs OES_vertex_half_float */
+#ifdef GL_HALF_FLOAT
+#define OM_GL_HALF_FLOAT GL_HALF_FLOAT
+#else
+#define OM_GL_HALF_FLOAT GL_HALF_FLOAT_OES
+#endif /* GL_HALF_FLOAT */
 
 namespace ObjMaster {
 
@@ -35,6 +44,9 @@ namespace ObjMaster {
 		GLuint texCoord_loc;
 		GLuint vbo = 0;
 		GLuint ibo = 0;
+		VertexLayout layout = FLOAT_VERTEX_LAYOUT;
+		VertexQuantization quantization = VertexQuantization { 0, 0, 0, 1, 1, 1 };
+		GLenum indexType = GL_UNSIGNED_SHORT;
 #ifdef USE_VAO
 		GLuint vao = 0; // if using VAOs via OES_vertex_array_object
 #else
@@ -53,7 +65,25 @@ namespace ObjMaster {
 				GLuint texCoord_loc,
 				size_t posOffset,
 				size_t normalOffset,
-				size_t texCoordOffset) {
+				size_t texCoordOffset,
+				VertexLayout layout = FLOAT_VERTEX_LAYOUT) {
+
+			if(layout == COMPACT_VERTEX_LAYOUT) {
+				// The compact layout has fixed offsets and needs the shader to decode (see CompactVertexStructure.h)
+				glVertexAttribPointer(position_loc, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertexStructure),
+						(const GLvoid *) offsetof(CompactVertexStructure, x));
+				glVertexAttribPointer(normal_loc, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertexStructure),
+						(const GLvoid *) offsetof(CompactVertexStructure, i));
+				glVertexAttribPointer(texCoord_loc, 2, OM_GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertexStructure),
+						(const GLvoid *) offsetof(CompactVertexStructure, u));
+				printGlError("after compact attrib pointers");
+
+				glEnableVertexAttribArray(position_loc);
+				glEnableVertexAttribArray(normal_loc);
+				glEnableVertexAttribArray(texCoord_loc);
+				printGlError("after enabling vertex attributes");
+				return;
+			}
 
 			// By design, we know that the positions are the first elements in the VertexStructure
 			// so we can use zero as the pointer/index in the vertex data!
@@ -88,30 +118,55 @@ namespace ObjMaster {
 		 * @param texCoordLoc The shader location for UVs (see shaders and see example)
 		 * @param mat The material of the mesh
 		 * @param mesh The mesh object reference
+		 * @param vertexLayout The layout of the vertex data on the GPU. With the compact layout the
+		 *                     shader needs to decode the attributes and apply getQuantization()
+		 *                     to the positions (see CompactVertexStructure.h)
 		 */
 		inline GlMesh(
 				GLuint positionLoc,
 				GLuint normalLoc,
 				GLuint texCoordLoc,
 				TextureDataHoldingMaterial *mat,
-				ObjMaster::ObjMeshObject &mesh) noexcept
-				: material(mat), position_loc(positionLoc), normal_loc(normalLoc), texCoord_loc(texCoordLoc) {
+				ObjMaster::ObjMeshObject &mesh,
+				VertexLayout vertexLayout = FLOAT_VERTEX_LAYOUT) noexcept
+				: material(mat), position_loc(positionLoc), normal_loc(normalLoc), texCoord_loc(texCoordLoc), layout(vertexLayout) {
 
 			printGlError("Before setup_buffers");
 			if(mesh.inited && (mesh.vertexCount > 0) && (mesh.indexCount > 0)) {
 				// Generate vertex buffer object
 				glGenBuffers(1, &vbo);
 				glBindBuffer(GL_ARRAY_BUFFER, vbo);
-				glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(VertexStructure),
-						&((*(mesh.vertexData))[0].x), GL_STATIC_DRAW);
+				if(layout == COMPACT_VERTEX_LAYOUT) {
+					std::vector<CompactVertexStructure> compactVertices;
+					mesh.toCompactVertices(compactVertices, quantization);
+					glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(CompactVertexStructure),
+							&compactVertices[0], GL_STATIC_DRAW);
+				} else {
+					glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(VertexStructure),
+							&((*(mesh.vertexData))[mesh.baseVertexLocation].x), GL_STATIC_DRAW);
+				}
 
-				// Generate index buffer object
+				// Generate index buffer object - with 16 bit indices whenever the mesh fits
+				// (independent of OM_INDEX_TYPE). The indices are made local to the mesh
+				// so meshes of shared buffers work too. Use getIndexType() when drawing!
 				glGenBuffers(1, &ibo);
 				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-				glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-						mesh.indexCount * sizeof((*(mesh.indices))[0]),
-						&((*(mesh.indices))[0]),
-						GL_STATIC_DRAW);
+				GLsizei uploadedIndexCount = (GLsizei)mesh.indexCount;
+				if(mesh.getIndexWidth() == 2) {
+					std::vector<uint16_t> localIndices;
+					mesh.getLocalIndices16(localIndices);
+					glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexCount * sizeof(uint16_t), &localIndices[0], GL_STATIC_DRAW);
+					indexType = GL_UNSIGNED_SHORT;
+				} else {
+					std::vector<uint32_t> localIndices;
+					// Rem.: Meshes that do not fit the stored (16 bit) indices get an empty buffer - and draw nothing
+					if(mesh.getLocalIndices32(localIndices)) {
+						glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexCount * sizeof(uint32_t), &localIndices[0], GL_STATIC_DRAW);
+					} else {
+						uploadedIndexCount = 0;
+					}
+					indexType = GL_UNSIGNED_INT;
+				}
 
 #ifdef USE_VAO
 				// Use VAO if present
@@ -153,7 +208,8 @@ namespace ObjMaster {
 						texCoord_loc,
 						posOffset,
 						normalOffset,
-						texCoordOffset);
+						texCoordOffset,
+						layout);
 
 				// Bind the index buffer object we have created - this is needed so VAO captures it being bound
 				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
@@ -170,7 +226,7 @@ namespace ObjMaster {
 				glBindBuffer(GL_ARRAY_BUFFER, 0);
 				/*if (!vao)*/ glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-				indexCount = mesh.indexCount;
+				indexCount = uploadedIndexCount;
 				uploaded = true;
 
 				printGlError("after setup_buffers");
@@ -204,6 +260,18 @@ namespace ObjMaster {
 			}
 		}
 
+		/** The layout of the vertex data on the GPU */
+		inline VertexLayout getLayout() const { return layout; }
+
+		/**
+		 * The dequantization of the positions for the compact layout (identity for the float one).
+		 * See VertexCompression::dequantizationMatrix for folding it into the model matrix.
+		 */
+		inline const VertexQuantization& getQuantization() const { return quantization; }
+
+		/** The type of the indices in the index buffer (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT) - use this in glDrawElements */
+		inline GLenum getIndexType() const { return indexType; }
+
 		friend class GlMeshBinding;
 	};
 
@@ -218,10 +286,13 @@ namespace ObjMaster {
 		size_t posOffset = 0;
 		size_t normalOffset = 0;
 		size_t texCoordOffset = 0;
+		VertexLayout layout = FLOAT_VERTEX_LAYOUT;
 #endif
 	public:
 		bool uploaded = false;
 		GLsizei indexCount = 0;
+		/** The type of the indices (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT) - use this in glDrawElements */
+		GLenum indexType = GL_UNSIGNED_SHORT;
 		GLuint position_loc;
 		GLuint normal_loc;
 		GLuint texCoord_loc;
@@ -237,9 +308,11 @@ namespace ObjMaster {
 				posOffset(mesh.posOffset),
 				normalOffset(mesh.normalOffset),
 				texCoordOffset(mesh.texCoordOffset),
+				layout(mesh.layout),
 #endif
 				uploaded(mesh.uploaded),
 				indexCount(mesh.indexCount),
+				indexType(mesh.indexType),
 				position_loc(mesh.position_loc),
 				normal_loc(mesh.normal_loc),
 				texCoord_loc(mesh.texCoord_loc),
@@ -264,7 +337,8 @@ namespace ObjMaster {
 					texCoord_loc,
 					posOffset,
 					normalOffset,
-					texCoordOffset);
+					texCoordOffset,
+					layout);
 #endif /* USE_VAO */
 		}
 
@@ -5,8 +5,16 @@
 #include "../../NopTexturePreparationLibrary.h"
 #include "../../FileAssetLibrary.h"
 #include "../../TextureDataHoldingMaterial.h"
+#include "../../MeshInstancing.h"
 #include <algorithm>
 
+// 16 bit builds split the too big groups of models into more meshes so that the indices never wrap around
+#if USE_16BIT_INDICES
+#define OM_FACADE_MODEL_BUILD_FLAGS ObjMaster::ObjMeshObject::MeshBuildFlags::SPLIT_FOR_16BIT_INDICES
+#else
+#define OM_FACADE_MODEL_BUILD_FLAGS ObjMaster::ObjMeshObject::MeshBuildFlags::DEDUP_BY_VALUE
+#endif /* USE_16BIT_INDICES */
+
 /** This is a mapping of all the already loaded models - caching them in case of reload. The key is (path+filename) */
 static std::unordered_map<std::string, int> modelMap;
 
@@ -17,6 +25,33 @@ static std::vector<ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparat
 /** The vector of ObjCreators - for saving and generating *.obj files */
 static std::vector<ObjMaster::ObjCreator> creators;
 
+/** The (handle, meshIndex) pairs of the loaded meshes by geometry fingerprint - in load order. For finding instances across models. */
+static std::unordered_map<uint64_t, std::vector<std::pair<int, int>>> exactMeshFingerprints;
+/** The same as above, but with fingerprints modulo rigid transforms */
+static std::unordered_map<uint64_t, std::vector<std::pair<int, int>>> rigidMeshFingerprints;
+
+/** Removes the meshes of the model from the fingerprint maps */
+static void unregisterMeshFingerprints(int handle) {
+	for (auto fingerprints : { &exactMeshFingerprints, &rigidMeshFingerprints }) {
+		for (auto &fPair : *fingerprints) {
+			auto &entries = fPair.second;
+			entries.erase(std::remove_if(entries.begin(), entries.end(),
+				[handle](const std::pair<int, int> &entry) { return entry.first == handle; }), entries.end());
+		}
+	}
+}
+
+/** Adds the meshes of the (just loaded) model to the fingerprint maps */
+static void registerMeshFingerprints(int handle) {
+	for (int i = 0; i < (int)models[handle].meshes.size(); ++i) {
+		const ObjMaster::MaterializedObjMeshObject &mesh = models[handle].meshes[i];
+		if (mesh.indexCount > 0) {
+			exactMeshFingerprints[ObjMaster::MeshInstancing::fingerprint(mesh, false)].push_back(std::make_pair(handle, i));
+			rigidMeshFingerprints[ObjMaster::MeshInstancing::fingerprint(mesh, true)].push_back(std::make_pair(handle, i));
+		}
+	}
+}
+
 /** This block contains the public interface of the dynamic library */
 extern "C" {
 #pragma region PUBLIC_DLL_API
@@ -54,6 +89,7 @@ extern "C" {
 				// If the model is inited, replace it with an empty model (this should free most resources while keeping other handles intact)
 				if (models[handle].inited) {
 					models[handle] = ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary>();
+					unregisterMeshFingerprints(handle);
 				}
 				// If we are here, the model is already unloaded - either by us or someone else earlier!
 				return true;
@@ -78,6 +114,8 @@ extern "C" {
 			models = std::vector<ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary>>();
 			// Of course the cache should get to be empty once again now too!
 			modelMap = std::unordered_map<std::string, int>();
+			exactMeshFingerprints = std::unordered_map<uint64_t, std::vector<std::pair<int, int>>>();
+			rigidMeshFingerprints = std::unordered_map<uint64_t, std::vector<std::pair<int, int>>>();
 			// Close all factories - as they are also resources
 			closeAllFactories(); // In the terminology here, we call them factories...
 
@@ -131,13 +169,13 @@ extern "C" {
 	}
 
 	/**
-	 * Returns the name of the material for the given mesh. The returned pointer is bound to the std::string in the C++ side of the loaded material in the mesh, so users better make an instant copy!
+	 * Returns the name of the material for the given mesh. The returned pointer is bound to the std::string in the C++ side of the material in the library of the model, so users better make an instant copy!
 	 */
 	const char* getModelMeshMaterialName(int handle, int meshIndex) {
 		try {
 			if ((int)models.size() > handle && (int)models[handle].meshes.size() > meshIndex) {
 				// Return the pointer to the underlying c_str. This is okay as the user will immediately copy it as they are told to...
-				return models[handle].meshes[meshIndex].material.name.c_str();
+				return models[handle].mtlLib.getMaterial(models[handle].meshes[meshIndex].materialId).name.c_str();
 			}
 			else {
 				// Invalid handle or mesh index! Return a nullptr!
@@ -159,58 +197,24 @@ extern "C" {
 			if ((int)models.size() > handle && (int)models[handle].meshes.size() > meshIndex) {
 				// Prepare the simple material to return
 				SimpleMaterial sm;
+				// Rem.: The fixed-size colors of the material structure already have the defaults for the missing components (and the alpha)
+				MaterialStructure colors = models[handle].mtlLib.getMaterialStructure(models[handle].meshes[meshIndex].materialId);
 				// enabled fields (useful for further queries too) TODO: what if we have more fields than the uint??
-				sm.enabledFields = (unsigned int) models[handle].meshes[meshIndex].material.enabledFields.to_ulong();
+				sm.enabledFields = colors.enabledFields;
 
 				// Direct color fields
-				// ka
-				if (models[handle].meshes[meshIndex].material.ka.size() > 0) {
-					sm.kar = models[handle].meshes[meshIndex].material.ka[0];
-				}
-				if (models[handle].meshes[meshIndex].material.ka.size() > 1) {
-					sm.kag = models[handle].meshes[meshIndex].material.ka[1];
-				}
-				if (models[handle].meshes[meshIndex].material.ka.size() > 2) {
-					sm.kab = models[handle].meshes[meshIndex].material.ka[2];
-				}
-				if (models[handle].meshes[meshIndex].material.ka.size() > 3) {
-					sm.kaa = models[handle].meshes[meshIndex].material.ka[3];
-				}
-				else {
-					sm.kaa = 1.0f;
-				}
-				// kd
-				if (models[handle].meshes[meshIndex].material.kd.size() > 0) {
-					sm.kdr = models[handle].meshes[meshIndex].material.kd[0];
-				}
-				if (models[handle].meshes[meshIndex].material.kd.size() > 1) {
-					sm.kdg = models[handle].meshes[meshIndex].material.kd[1];
-				}
-				if (models[handle].meshes[meshIndex].material.kd.size() > 2) {
-					sm.kdb = models[handle].meshes[meshIndex].material.kd[2];
-				}
-				if (models[handle].meshes[meshIndex].material.kd.size() > 3) {
-					sm.kda = models[handle].meshes[meshIndex].material.kd[3];
-				}
-				else {
-					sm.kda = 1.0f;
-				}
-				// ks
-				if (models[handle].meshes[meshIndex].material.ks.size() > 0) {
-					sm.ksr = models[handle].meshes[meshIndex].material.ks[0];
-				}
-				if (models[handle].meshes[meshIndex].material.ks.size() > 1) {
-					sm.ksg = models[handle].meshes[meshIndex].material.ks[1];
-				}
-				if (models[handle].meshes[meshIndex].material.ks.size() > 2) {
-					sm.ksb = models[handle].meshes[meshIndex].material.ks[2];
-				}
-				if (models[handle].meshes[meshIndex].material.ks.size() > 3) {
-					sm.ksa = models[handle].meshes[meshIndex].material.ks[3];
-				}
-				else {
-					sm.ksa = 1.0f;
-				}
+				sm.kar = colors.ka[0];
+				sm.kag = colors.ka[1];
+				sm.kab = colors.ka[2];
+				sm.kaa = colors.ka[3];
+				sm.kdr = colors.kd[0];
+				sm.kdg = colors.kd[1];
+				sm.kdb = colors.kd[2];
+				sm.kda = colors.kd[3];
+				sm.ksr = colors.ks[0];
+				sm.ksg = colors.ks[1];
+				sm.ksb = colors.ks[2];
+				sm.ksa = colors.ks[3];
 
 				// Return the created SimpleMaterial
 				return sm;
@@ -366,6 +370,151 @@ extern "C" {
 		}
 	}
 
+	/**
+	 * Tells the number of bytes per index the given mesh of the handle needs when using local indices
+	 * (see below): 2 if the mesh fits 16 bit indices and 4 otherwise. Returns -1 in case of errors.
+	 */
+	int getModelMeshIndexWidth(int handle, int meshIndex) {
+		try {
+			if ((int)models.size() > handle && (int)models[handle].meshes.size() > meshIndex) {
+				// If we are here, we have valid handle and mesh index
+				return (int)models[handle].meshes[meshIndex].getIndexWidth();
+			}
+			else {
+				return -1; // -1 indicates error
+			}
+		}
+		catch (...) {
+			return -1;	// Exceptions will not pass through the boundaries of the library!
+		}
+	}
+
+	/**
+	 * Copies the indices of the given mesh of the handle as local 16 bit indices into output.
+	 * The output should have room for getModelMeshIndicesCount elements!
+	 *
+	 * Returns -1 in case of errors (also when getModelMeshIndexWidth is not 2), otherwise the number of indices.
+	 */
+	int getModelMeshLocalIndices16(int handle, int meshIndex, unsigned short int* output) {
+		try {
+			if ((int)models.size() > handle && (int)models[handle].meshes.size() > meshIndex) {
+				std::vector<uint16_t> localIndices;
+				if (!models[handle].meshes[meshIndex].getLocalIndices16(localIndices)) {
+					return -1;	// does not fit 16 bits
+				}
+				std::copy(localIndices.begin(), localIndices.end(), output);
+				return (int)localIndices.size();	// Indicate success
+			}
+			else {
+				return -1;	// error because of invalid handle or index
+			}
+		}
+		catch (...) {
+			return -1;	// Exceptions will not pass through the boundaries of the library!
+		}
+	}
+
+	/**
+	 * The same as getModelMeshLocalIndices16, but with 32 bit indices - this works for every mesh,
+	 * except when the library is built with USE_16BIT_INDICES and the mesh does not fit those.
+	 */
+	int getModelMeshLocalIndices32(int handle, int meshIndex, unsigned int* output) {
+		try {
+			if ((int)models.size() > handle && (int)models[handle].meshes.size() > meshIndex) {
+				std::vector<uint32_t> localIndices;
+				if (!models[handle].meshes[meshIndex].getLocalIndices32(localIndices)) {
+					return -1;	// the stored indices are wrapped around
+				}
+				std::copy(localIndices.begin(), localIndices.end(), output);
+				return (int)localIndices.size();	// Indicate success
+			}
+			else {
+				return -1;	// error because of invalid handle or index
+			}
+		}
+		catch (...) {
+			return -1;	// Exceptions will not pass through the boundaries of the library!
+		}
+	}
+
+	/**
+	 * Copies the bounding box and sphere of the given mesh of the handle into output (see BoundsStructure.h).
+	 * Returns false in case of errors. Meshes without vertices have a negative radius.
+	 */
+	bool getModelMeshBounds(int handle, int meshIndex, BoundingVolume* output) {
+		try {
+			if ((int)models.size() > handle && (int)models[handle].meshes.size() > meshIndex && output != nullptr) {
+				*output = models[handle].meshes[meshIndex].bounds;
+				return true;	// Indicate success
+			}
+			else {
+				return false;	// error because of invalid handle or index
+			}
+		}
+		catch (...) {
+			return false;	// Exceptions will not pass through the boundaries of the library!
+		}
+	}
+
+	/** Copies the bounding box and sphere of the whole model (all of its meshes) into output. Returns false in case of errors. */
+	bool getModelBounds(int handle, BoundingVolume* output) {
+		try {
+			if ((int)models.size() > handle && output != nullptr) {
+				*output = models[handle].bounds;
+				return true;	// Indicate success
+			}
+			else {
+				return false;	// error because of invalid handle
+			}
+		}
+		catch (...) {
+			return false;	// Exceptions will not pass through the boundaries of the library!
+		}
+	}
+
+
+	/**
+	 * Tells which mesh has the geometry to draw for the given mesh of the handle: the first loaded mesh (of any
+	 * loaded model) with identical geometry - or with moduloRigidTransform, geometry that is rotated and moved.
+	 * Meshes with no earlier identical mesh refer to themselves with the identity transform. The buffers of the
+	 * referred mesh can be uploaded once and drawn with the transform for all of its instances. Returns false in case of errors.
+	 */
+	bool getModelMeshInstance(int handle, int meshIndex, bool moduloRigidTransform, SimpleMeshInstance* output) {
+		try {
+			if ((int)models.size() > handle && (int)models[handle].meshes.size() > meshIndex && output != nullptr) {
+				const ObjMaster::MaterializedObjMeshObject &mesh = models[handle].meshes[meshIndex];
+				SimpleMeshInstance instance;
+				instance.handle = handle;
+				instance.meshIndex = meshIndex;
+				ObjMaster::MeshInstancing::setIdentity(instance.transform);
+				auto &fingerprints = moduloRigidTransform ? rigidMeshFingerprints : exactMeshFingerprints;
+				auto found = fingerprints.find(ObjMaster::MeshInstancing::fingerprint(mesh, moduloRigidTransform));
+				if (mesh.indexCount > 0 && found != fingerprints.end()) {
+					// The first (still loaded) mesh in load order that really has the same geometry
+					for (auto &entry : found->second) {
+						if (entry.first == handle && entry.second == meshIndex) {
+							break;
+						}
+						if (models[entry.first].inited && (int)models[entry.first].meshes.size() > entry.second &&
+							ObjMaster::MeshInstancing::matchInstance(models[entry.first].meshes[entry.second], mesh,
+								moduloRigidTransform, ObjMaster::MeshInstancing::DEFAULT_TOLERANCE, instance.transform)) {
+							instance.handle = entry.first;
+							instance.meshIndex = entry.second;
+							break;
+						}
+					}
+				}
+				*output = instance;
+				return true;	// Indicate success
+			}
+			else {
+				return false;	// error because of invalid handle or index
+			}
+		}
+		catch (...) {
+			return false;	// Exceptions will not pass through the boundaries of the library!
+		}
+	}
 
 	// Rem.: The handle is the index in the loadedModels vector
 	/** 
@@ -417,16 +566,19 @@ extern "C" {
 			// We do not have any texture preparation library as the unity side is the one that should handle that somehow
 			if (needToReloadEarlier) {
 				// Exchange the old array element with the newly loaded model
-				models[earlierLoadIndex] = std::move(ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary>(obj));
+				models[earlierLoadIndex] = std::move(ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary>(obj, OM_FACADE_MODEL_BUILD_FLAGS));
+				unregisterMeshFingerprints(earlierLoadIndex);
+				registerMeshFingerprints(earlierLoadIndex);
 				// Return earlier handle as it is at that position now too after reload!
 				return earlierLoadIndex;
 			}
 			else {
 				// Add the new model to the end of the vector
-				models.push_back(std::move(ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary>(obj)));
+				models.push_back(std::move(ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary>(obj, OM_FACADE_MODEL_BUILD_FLAGS)));
 
 				// Calculate the "handle" as the model index
 				int modelIndex = (int)models.size() - 1;
+				registerMeshFingerprints(modelIndex);
 
 				// Return handle
 				return modelIndex;
@@ -446,7 +598,7 @@ extern "C" {
 		try {
 			if ((int)models.size() > handle && (int)models[handle].meshes.size() > meshIndex) {
 				// We have valid handle and mesh
-				return models[handle].meshes[meshIndex].material.map_ka.c_str();
+				return models[handle].mtlLib.getMaterial(models[handle].meshes[meshIndex].materialId).map_ka.c_str();
 			}
 			else {
 				return nullptr;	// error because of invalid handle or index
@@ -464,7 +616,7 @@ extern "C" {
 		try {
 			if ((int)models.size() > handle && (int)models[handle].meshes.size() > meshIndex) {
 				// We have valid handle and mesh
-				return models[handle].meshes[meshIndex].material.map_kd.c_str();
+				return models[handle].mtlLib.getMaterial(models[handle].meshes[meshIndex].materialId).map_kd.c_str();
 			}
 			else {
 				return nullptr;	// error because of invalid handle or index
@@ -482,7 +634,7 @@ extern "C" {
 		try {
 			if ((int)models.size() > handle && (int)models[handle].meshes.size() > meshIndex) {
 				// We have valid handle and mesh
-				return models[handle].meshes[meshIndex].material.map_ks.c_str();
+				return models[handle].mtlLib.getMaterial(models[handle].meshes[meshIndex].materialId).map_ks.c_str();
 			}
 			else {
 				return nullptr;	// error because of invalid handle or index
@@ -500,7 +652,7 @@ extern "C" {
 		try {
 			if ((int)models.size() > handle && (int)models[handle].meshes.size() > meshIndex) {
 				// We have valid handle and mesh
-				return models[handle].meshes[meshIndex].material.map_bump.c_str();
+				return models[handle].mtlLib.getMaterial(models[handle].meshes[meshIndex].materialId).map_bump.c_str();
 			}
 			else {
 				return nullptr;	// error because of invalid handle or index
@@ -18,6 +18,7 @@
 #endif
 
 #include "../../VertexStructure.h"
+#include "../../BoundsStructure.h"
 
 // (!) We might build the facade with 16 bit indices thus we need to change output bit width (!)
 #if USE_16BIT_INDICES
@@ -48,6 +49,13 @@ extern "C" {
 		float ksr, ksg, ksb, ksa;	// Only relevant if enabledFields shows it is!
 	};
 
+	/** Refers to the mesh (of any loaded model) that has the geometry to draw for a mesh - see getModelMeshInstance */
+	struct SimpleMeshInstance {
+		int handle;				// The model of the mesh with the geometry
+		int meshIndex;			// The mesh with the geometry in that model
+		float transform[12];	// Row-major 3x4 rotation and translation of that geometry (see MeshInstanceStructure.h)
+	};
+
 	/** 
 	 * Load the given obj with the objmaster system and return the handle for referencing it.
 	 * The system uses caching so asking for the same, already loaded model ends up returning the same model reference.
@@ -145,6 +153,44 @@ extern "C" {
 	 */
 	DLL_API int getModelMeshIndices(int handle, int meshIndex, OM_OUT_INDICES_TYPE** output);
 
+	/**
+	 * Tells the number of bytes per index the given mesh of the handle needs when using local indices
+	 * (see below): 2 if the mesh fits 16 bit indices and 4 otherwise. Returns -1 in case of errors.
+	 */
+	DLL_API int getModelMeshIndexWidth(int handle, int meshIndex);
+
+	/**
+	 * Copies the indices of the given mesh of the handle as local 16 bit indices into output. Local
+	 * means that the indices refer to the vertices of the mesh from zero (the base vertex offset is
+	 * already substracted). The output should have room for getModelMeshIndicesCount elements!
+	 *
+	 * Returns -1 in case of errors (also when getModelMeshIndexWidth is not 2), otherwise the number of indices.
+	 */
+	DLL_API int getModelMeshLocalIndices16(int handle, int meshIndex, unsigned short int* output);
+
+	/**
+	 * The same as getModelMeshLocalIndices16, but with 32 bit indices - this works for every mesh,
+	 * except when the library is built with USE_16BIT_INDICES and the mesh does not fit those.
+	 */
+	DLL_API int getModelMeshLocalIndices32(int handle, int meshIndex, unsigned int* output);
+
+	/**
+	 * Copies the bounding box and sphere of the given mesh of the handle into output (see BoundsStructure.h).
+	 * Returns false in case of errors. Meshes without vertices have a negative radius.
+	 */
+	DLL_API bool getModelMeshBounds(int handle, int meshIndex, BoundingVolume* output);
+
+	/** Copies the bounding box and sphere of the whole model (all of its meshes) into output. Returns false in case of errors. */
+	DLL_API bool getModelBounds(int handle, BoundingVolume* output);
+
+	/**
+	 * Tells which mesh has the geometry to draw for the given mesh of the handle: the first loaded mesh (of any
+	 * loaded model) with identical geometry - or with moduloRigidTransform, geometry that is rotated and moved.
+	 * Meshes with no earlier identical mesh refer to themselves with the identity transform. The buffers of the
+	 * referred mesh can be uploaded once and drawn with the transform for all of its instances. Returns false in case of errors.
+	 */
+	DLL_API bool getModelMeshInstance(int handle, int meshIndex, bool moduloRigidTransform, SimpleMeshInstance* output);
+
 	/**
 	 * Returns the pointer to the null terminated fileName or nullptr in case of errors. If there is no texture file for the one asked for, we return an empty string!
 	 */
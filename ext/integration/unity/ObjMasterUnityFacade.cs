@@ -176,6 +176,22 @@ public class ObjMasterUnityFacade : MonoBehaviour
             return "VertexPosNorUv(" + x + "," + y + "," + z + "; " + i + "," + j + "," + k + "; " + u + "," + v + ")";
         }
     }
+
+    /// <summary>
+    /// Axis aligned bounding box and bounding sphere of a mesh or model - for culling.
+    /// This should be the same as it is in BoundsStructure.h in the c/c++ code because we are blitting it against each other!
+    /// A negative radius means that there are no vertices at all.
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct BoundingVolume
+    {
+        // axis aligned bounding box
+        public float minX, minY, minZ;
+        public float maxX, maxY, maxZ;
+        // bounding sphere
+        public float centerX, centerY, centerZ;
+        public float radius;
+    }
     #endregion
     #region Imported DLL functions
 
@@ -300,6 +316,56 @@ public class ObjMasterUnityFacade : MonoBehaviour
     [DllImport(DLL_NAME, EntryPoint = "getModelMeshIndices", CallingConvention = CallingConvention.Cdecl)]
     public static extern int getModelMeshIndices(int handle, int meshIndex, out IntPtr output);
 
+    /// <summary>
+    /// Tells the number of bytes per index the mesh needs when using local indices: 2 if the mesh
+    /// fits 16 bit indices and 4 otherwise.
+    /// </summary>
+    /// <param name="handle">The handle of the model</param>
+    /// <param name="meshIndex">The index of the mesh - should be smaller than getModelMeshNo</param>
+    /// <returns>2 or 4 - or -1 in case of errors</returns>
+    [DllImport(DLL_NAME, EntryPoint = "getModelMeshIndexWidth", CallingConvention = CallingConvention.Cdecl)]
+    public static extern int getModelMeshIndexWidth(int handle, int meshIndex);
+
+    /// <summary>
+    /// Copies the indices of the mesh as local (the base vertex offset is already substracted) 16 bit
+    /// indices into the output array - that should have room for getModelMeshIndicesCount elements.
+    /// </summary>
+    /// <param name="handle">The handle of the model</param>
+    /// <param name="meshIndex">The index of the mesh - should be smaller than getModelMeshNo</param>
+    /// <param name="output">The array to copy the indices into</param>
+    /// <returns>The number of indices or -1 in case of errors (also when getModelMeshIndexWidth is not 2)</returns>
+    [DllImport(DLL_NAME, EntryPoint = "getModelMeshLocalIndices16", CallingConvention = CallingConvention.Cdecl)]
+    public static extern int getModelMeshLocalIndices16(int handle, int meshIndex, [Out] ushort[] output);
+
+    /// <summary>
+    /// The same as getModelMeshLocalIndices16, but with 32 bit indices - this works for every mesh.
+    /// </summary>
+    /// <param name="handle">The handle of the model</param>
+    /// <param name="meshIndex">The index of the mesh - should be smaller than getModelMeshNo</param>
+    /// <param name="output">The array to copy the indices into</param>
+    /// <returns>The number of indices or -1 in case of errors</returns>
+    [DllImport(DLL_NAME, EntryPoint = "getModelMeshLocalIndices32", CallingConvention = CallingConvention.Cdecl)]
+    public static extern int getModelMeshLocalIndices32(int handle, int meshIndex, [Out] uint[] output);
+
+    /// <summary>
+    /// Gets the bounding box and sphere of the mesh.
+    /// </summary>
+    /// <param name="handle">The handle of the model</param>
+    /// <param name="meshIndex">The index of the mesh - should be smaller than getModelMeshNo</param>
+    /// <param name="output">The bounding volume of the mesh</param>
+    /// <returns>false in case of errors</returns>
+    [DllImport(DLL_NAME, EntryPoint = "getModelMeshBounds", CallingConvention = CallingConvention.Cdecl)]
+    public static extern bool getModelMeshBounds(int handle, int meshIndex, out BoundingVolume output);
+
+    /// <summary>
+    /// Gets the bounding box and sphere of the whole model (all of its meshes).
+    /// </summary>
+    /// <param name="handle">The handle of the model</param>
+    /// <param name="output">The bounding volume of the model</param>
+    /// <returns>false in case of errors</returns>
+    [DllImport(DLL_NAME, EntryPoint = "getModelBounds", CallingConvention = CallingConvention.Cdecl)]
+    public static extern bool getModelBounds(int handle, out BoundingVolume output);
+
     /// <summary>
     /// Returns a pointer to the CSTR of the Ambient texture filename. Returns nullptr in case of errors, and points to empty CSTR if there is no such texture.
     /// </summary>
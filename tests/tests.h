@@ -18,6 +18,22 @@
 #include "../StbImgTexturePreparationLibrary.h"
 #include "../ext/GlGpuTexturePreparationLibrary.h"
 #include "../ObjCreator.h"
+#include "../PolygonTriangulator.h"
+#include "../VertexDedupTable.h"
+#include "../ThreadPool.h"
+#include "../MeshOptimizer.h"
+#include "../VertexCompression.h"
+#include "../LayoutMeshObject.h"
+#include "../MeshletBuilder.h"
+#include "../MeshSimplifier.h"
+#include "../MeshBounds.h"
+#include "../TriangleBvh.h"
+#include "../NormalGenerator.h"
+#include "../TangentGenerator.h"
+#include "../MeshInstancing.h"
+#include "../IncrementalMeshBuilder.h"
+#include "../AllocationCounter.h"
+#include "../NopTexturePreparationLibrary.h"
 
 // For output testing of elements
 #include "../VertexElement.h"
@@ -28,6 +44,8 @@
 #include "../LineElement.h"
 #include "../ObjectGroupElement.h"
 #include "../Material.h"
+#include <sstream> // std::istringstream
+#include <fstream> // std::ifstream
 
 // At least we can try testing the facade as if we would see it from plain C...
 #include "../ext/integration/ObjMasterIntegrationFacade.h"
@@ -83,6 +101,1480 @@ namespace ObjMasterTest {
 		}
 	}
 	
+	/** Asset library that hides the memory mapping capability of the file library - forces the stream code paths */
+	class StreamOnlyAssetLibrary : public AssetLibrary {
+	public:
+		std::unique_ptr<std::istream> getAssetStream(const char *path, const char *assetFileName) const {
+			const AssetLibrary &files = fileLibrary;
+			return files.getAssetStream(path, assetFileName);
+		}
+	private:
+		ObjMaster::FileAssetLibrary fileLibrary;
+	};
+
+	/** Asset library that serves the same text for every asset - optionally as memory too */
+	class StringAssetLibrary : public AssetLibrary {
+	public:
+		StringAssetLibrary(std::string text, bool asMemory) : text(text), asMemory(asMemory) {}
+		std::unique_ptr<std::istream> getAssetStream(const char *path, const char *assetFileName) const {
+			return std::unique_ptr<std::istream>(new std::istringstream(text));
+		}
+		std::unique_ptr<AssetMemory> getAssetMemory(const char *path, const char *assetFileName) const {
+			if(!asMemory) return nullptr;
+			return std::unique_ptr<AssetMemory>(new StringAssetMemory(text));
+		}
+	private:
+		class StringAssetMemory : public AssetMemory {
+		public:
+			StringAssetMemory(const std::string &text) : text(text) {}
+			const char *data() const { return text.data(); }
+			size_t size() const { return text.size(); }
+		private:
+			const std::string &text;
+		};
+		std::string text;
+		bool asMemory;
+	};
+
+	/** Lines longer than the line buffer should be read completely - both from memory and streams */
+	int testLongLines() {
+		OMLOGI("Testing long lines...");
+		std::string groupName(600, 'a');
+		std::string objText = "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+			"o " + groupName + "\n"
+			"f 1 2 3" + std::string(300, ' ') + "\n"
+			"# " + std::string(1000, '#') + "\n"
+			"v 5 5 5";
+		int errorCount = 0;
+		for(bool asMemory : {false, true}) {
+			ObjMaster::Obj obj = ObjMaster::Obj(StringAssetLibrary(objText, asMemory), "", "long.obj");
+			if((obj.vs.size() != 4) || (obj.fs.size() != 1) || (obj.vs[3].x != 5.0f)) {
+				OMLOGE("Bad element counts after long lines (memory: %d)!", (int)asMemory);
+				++errorCount;
+			} else if((obj.fs[0].facePointCount != 3) || (obj.fs[0].facePoints[2].vIndex != 2)) {
+				OMLOGE("Bad face parsed from a long line (memory: %d)!", (int)asMemory);
+				++errorCount;
+			}
+			if((obj.objectMaterialGroups.size() != 1) ||
+			   (obj.objectMaterialGroups.begin()->second.objectGroupName != groupName)) {
+				OMLOGE("Long group name is not read properly (memory: %d)!", (int)asMemory);
+				++errorCount;
+			}
+		}
+		OMLOGI("...tested long lines with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** N-gons should be kept with all their points and triangulated when creating meshes */
+	int testNgons() {
+		OMLOGI("Testing n-gons...");
+		int errorCount = 0;
+		if(!ObjMaster::TEST_PolygonTriangulator()) {
+			++errorCount;
+		}
+		// The test model is a single concave 8-gon
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, "ngon.obj");
+		if((obj.fs.size() != 1) || (obj.fs[0].facePointCount != 8) || !obj.fs[0].isNgon()) {
+			OMLOGE("N-gon is not parsed properly!");
+			return errorCount + 1;
+		}
+		const ObjMaster::FacePoint *points = obj.getFacePoints(obj.fs[0]);
+		if((points[0].vIndex != 3) || (points[7].vIndex != 2) || (points[7].vnIndex != 0)) {
+			OMLOGE("Bad n-gon face points!");
+			++errorCount;
+		}
+		ObjMaster::ObjMeshObject mesh(obj);
+		if(mesh.indexCount != 3 * 6) {
+			OMLOGE("Bad index count for the triangulated n-gon: %d", (int)mesh.indexCount);
+			++errorCount;
+		}
+		// Parallel parsing should rebase the face-point pool offsets properly
+		ObjMaster::Obj parallelObj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, "ngon.obj",
+				ObjMaster::Obj::ObjLoadModeFlags::PARALLEL_PARSE, 3);
+		if((parallelObj.fs.size() != 1) || (parallelObj.getFacePoints(parallelObj.fs[0])[7].vIndex != 2)) {
+			OMLOGE("Bad n-gon after parallel parsing!");
+			++errorCount;
+		}
+		// The textual representation should contain all the points
+		std::string text = obj.fs[0].asText(points, obj.fs[0].facePointCount);
+		if(text != "f 4/0/1 6/0/1 8/0/1 7/0/1 5/0/1 2/0/1 1/0/1 3/0/1 ") {
+			OMLOGE("Bad n-gon output: %s", text.c_str());
+			++errorCount;
+		}
+		OMLOGI("...tested n-gons with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Both de-duplication modes should give meshes that index the same data as the faces */
+	int testMeshDedup() {
+		OMLOGI("Testing mesh vertex de-duplication...");
+		int errorCount = 0;
+		if(!ObjMaster::TEST_VertexDedupTable()) {
+			++errorCount;
+		}
+		// The fourth vertex duplicates the value of the first one under a different index
+		std::string objText = "v 0 0 0\nv 1 0 0\nv 0 1 0\nv -0 0 0\nf 1 2 3\nf 4 2 3\nf 1 3 2\n";
+		ObjMaster::Obj smallObj = ObjMaster::Obj(StringAssetLibrary(objText, true), "", "dedup.obj");
+		ObjMaster::ObjMeshObject byValue(smallObj);
+		ObjMaster::ObjMeshObject byIndex(smallObj, ObjMaster::ObjMeshObject::MeshBuildFlags::DEDUP_BY_INDEX);
+		if((byValue.vertexCount != 3) || (byValue.indexCount != 9)) {
+			OMLOGE("Bad counts when de-duplicating by value: %u vertices, %u indices", byValue.vertexCount, byValue.indexCount);
+			++errorCount;
+		}
+		if((byIndex.vertexCount != 4) || (byIndex.indexCount != 9)) {
+			OMLOGE("Bad counts when de-duplicating by index: %u vertices, %u indices", byIndex.vertexCount, byIndex.indexCount);
+			++errorCount;
+		}
+
+		// On the real model every index should point to the data of the corresponding face point
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		for(int mode = 0; mode < 2; ++mode) {
+			ObjMaster::ObjMeshObject mesh(obj, (ObjMaster::ObjMeshObject::MeshBuildFlags)mode);
+			if(mesh.indexCount != 3 * obj.fs.size()) {
+				OMLOGE("Bad index count in mode %d: %u", mode, mesh.indexCount);
+				++errorCount;
+				continue;
+			}
+			for(unsigned int i = 0; i < mesh.indexCount; ++i) {
+				const ObjMaster::FacePoint &fp = obj.fs[i / 3].facePoints[i % 3];
+				const VertexStructure &vertex = (*mesh.vertexData)[(*mesh.indices)[i]];
+				const ObjMaster::VertexElement &v = obj.vs[fp.vIndex];
+				if((vertex.x != v.x) || (vertex.y != v.y) || (vertex.z != v.z)) {
+					OMLOGE("Index %u points to a bad vertex in mode %d!", i, mode);
+					++errorCount;
+					break;
+				}
+			}
+		}
+		OMLOGI("...tested mesh vertex de-duplication with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Parallel model building should give the very same meshes in the very same order as serial building */
+	int testParallelModelBuild() {
+		OMLOGI("Testing parallel model building of %s...", TEST_MODEL);
+		int errorCount = 0;
+		if(!ObjMaster::TEST_ThreadPool()) {
+			++errorCount;
+		}
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+
+		// Const material lookups should not add materials for bad names
+		int materialCount = obj.mtlLib.getMaterialCount();
+		const ObjMaster::MtlLib &constLib = obj.mtlLib;
+		constLib.getNonLoadedMaterialFor("there_is_no_such_material");
+		if(obj.mtlLib.getMaterialCount() != materialCount) {
+			OMLOGE("Const material lookup has changed the material library!");
+			++errorCount;
+		}
+
+		typedef ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary> Model;
+		Model serial(obj);
+		Model parallel(obj, ObjMaster::ObjMeshObject::MeshBuildFlags::DEDUP_BY_VALUE, Model::ModelBuildModeFlags::PARALLEL_BUILD, 3);
+		if(serial.meshes.size() != parallel.meshes.size()) {
+			OMLOGE("Parallel building resulted in %d meshes instead of %d!", (int)parallel.meshes.size(), (int)serial.meshes.size());
+			return errorCount + 1;
+		}
+		for(size_t m = 0; m < serial.meshes.size(); ++m) {
+			const ObjMaster::MaterializedObjMeshObject &a = serial.meshes[m];
+			const ObjMaster::MaterializedObjMeshObject &b = parallel.meshes[m];
+			if((a.name != b.name) || (a.vertexCount != b.vertexCount) || (a.indexCount != b.indexCount) ||
+			   (memcmp(&(*a.vertexData)[0], &(*b.vertexData)[0], a.vertexCount * sizeof(VertexStructure)) != 0) ||
+			   (memcmp(&(*a.indices)[0], &(*b.indices)[0], a.indexCount * sizeof(OM_INDEX_TYPE)) != 0)) {
+				OMLOGE("Parallel building resulted in a different mesh at %d (%s)!", (int)m, b.name.c_str());
+				++errorCount;
+			}
+		}
+		OMLOGI("...tested parallel model building with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/**
+	 * Builds a textual obj grid of quads (as two triangles or one quad). With per-quad uvs the uvs
+	 * repeat so there are duplicates, otherwise the neighbouring quads share their vertices.
+	 */
+	std::string createGridObjText(int size, bool perQuadUvs = true) {
+		std::ostringstream text;
+		for(int y = 0; y < size; ++y) {
+			for(int x = 0; x < size; ++x) {
+				text << "v " << x << " " << y << " 0\n";
+			}
+		}
+		text << "vt 0 0\nvt 1 0\nvt 0 1\nvt 1 1\nvn 0 0 1\n";
+		const char *uv[] = { "/1/", "/2/", "/3/", "/4/" };
+		if(!perQuadUvs) {
+			uv[0] = uv[1] = uv[2] = uv[3] = "//";
+		}
+		for(int y = 0; y + 1 < size; ++y) {
+			for(int x = 0; x + 1 < size; ++x) {
+				int a = y * size + x + 1, b = a + 1, c = a + size, d = c + 1;
+				if((x + y) % 7 == 0) {
+					text << "f " << a << uv[0] << "1 " << b << uv[1] << "1 " << d << uv[3] << "1 " << c << uv[2] << "1\n";
+				} else {
+					text << "f " << a << uv[0] << "1 " << b << uv[1] << "1 " << d << uv[3] << "1\n";
+					text << "f " << a << uv[0] << "1 " << d << uv[3] << "1 " << c << uv[2] << "1\n";
+				}
+			}
+		}
+		return text.str();
+	}
+
+	/** Returns true if the two meshes have exactly the same counts and data */
+	bool isSameMesh(const ObjMaster::ObjMeshObject &a, const ObjMaster::ObjMeshObject &b) {
+		return (a.vertexCount == b.vertexCount) && (a.indexCount == b.indexCount) && (a.lastIndex == b.lastIndex) &&
+		   (memcmp(&(*a.vertexData)[a.baseVertexLocation], &(*b.vertexData)[b.baseVertexLocation], a.vertexCount * sizeof(VertexStructure)) == 0) &&
+		   (memcmp(&(*a.indices)[a.startIndexLocation], &(*b.indices)[b.startIndexLocation], a.indexCount * sizeof(OM_INDEX_TYPE)) == 0);
+	}
+
+	/** Parallel de-duplication within one huge group should give the very same mesh as the serial build */
+	int testParallelDedup() {
+		OMLOGI("Testing parallel de-duplication...");
+		int errorCount = 0;
+		ObjMaster::Obj obj = ObjMaster::Obj(StringAssetLibrary(createGridObjText(260), true), "", "grid.obj");
+		ObjMaster::ThreadPool pool(4);
+		for(int byIndex = 0; byIndex < 2; ++byIndex) {
+			ObjMaster::ObjMeshObject::MeshBuildFlags serialFlags = (ObjMaster::ObjMeshObject::MeshBuildFlags)byIndex;
+			ObjMaster::ObjMeshObject::MeshBuildFlags parallelFlags = (ObjMaster::ObjMeshObject::MeshBuildFlags)(byIndex | ObjMaster::ObjMeshObject::MeshBuildFlags::PARALLEL_DEDUP);
+			ObjMaster::ObjMeshObject serial(obj, serialFlags);
+			ObjMaster::ObjMeshObject parallel(obj, parallelFlags, &pool);
+			if(!isSameMesh(serial, parallel)) {
+				OMLOGE("Parallel de-duplication resulted in a different mesh (by index: %d)!", byIndex);
+				++errorCount;
+			}
+			// Also when appending to shared buffers
+			std::vector<VertexStructure> serialVertices(5), parallelVertices(5);
+			std::vector<OM_INDEX_TYPE> serialIndices(7), parallelIndices(7);
+			ObjMaster::ObjMeshObject serialShared(obj, &obj.fs[0], (int)obj.fs.size(), &serialVertices, &serialIndices, 5, serialFlags);
+			ObjMaster::ObjMeshObject parallelShared(obj, &obj.fs[0], (int)obj.fs.size(), &parallelVertices, &parallelIndices, 5, parallelFlags, &pool);
+			if(!isSameMesh(serialShared, parallelShared) || (serialIndices != parallelIndices)) {
+				OMLOGE("Parallel de-duplication resulted in a different shared mesh (by index: %d)!", byIndex);
+				++errorCount;
+			}
+		}
+		// The model should use the threads within the single big group
+		typedef ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary> Model;
+		Model serialModel(obj);
+		Model parallelModel(obj, ObjMaster::ObjMeshObject::MeshBuildFlags::DEDUP_BY_VALUE, Model::ModelBuildModeFlags::PARALLEL_BUILD, 3);
+		if((serialModel.meshes.size() != 1) || (parallelModel.meshes.size() != 1) || !isSameMesh(serialModel.meshes[0], parallelModel.meshes[0])) {
+			OMLOGE("Parallel model building of a single group resulted in a different mesh!");
+			++errorCount;
+		}
+		OMLOGI("...tested parallel de-duplication with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Vertex cache optimization should only reorder the triangles of the mesh range and improve the ACMR */
+	int testVertexCacheOptimization() {
+		OMLOGI("Testing vertex cache optimization...");
+		int errorCount = 0;
+		if(!ObjMaster::TEST_MeshOptimizer()) {
+			++errorCount;
+		}
+		ObjMaster::Obj obj = ObjMaster::Obj(StringAssetLibrary(createGridObjText(64, false), true), "", "grid.obj");
+		// Use shared buffers with some earlier data to see the ranges are respected
+		std::vector<VertexStructure> vertices(3);
+		std::vector<OM_INDEX_TYPE> indices = { 0, 1, 2 };
+		ObjMaster::ObjMeshObject plain(obj, &obj.fs[0], (int)obj.fs.size(), &vertices, &indices, 3);
+		std::vector<VertexStructure> optimizedVertices(3);
+		std::vector<OM_INDEX_TYPE> optimizedIndices = { 0, 1, 2 };
+		ObjMaster::ObjMeshObject optimized(obj, &obj.fs[0], (int)obj.fs.size(), &optimizedVertices, &optimizedIndices, 3,
+				ObjMaster::ObjMeshObject::MeshBuildFlags::OPTIMIZE_VERTEX_CACHE);
+		if((optimizedIndices[0] != 0) || (optimizedIndices[1] != 1) || (optimizedIndices[2] != 2) ||
+		   (optimized.indexCount != plain.indexCount) || (optimizedVertices.size() != vertices.size()) ||
+		   (memcmp(&optimizedVertices[0], &vertices[0], vertices.size() * sizeof(VertexStructure)) != 0)) {
+			OMLOGE("Vertex cache optimization has changed data outside of the index range of the mesh!");
+			++errorCount;
+		}
+		float before = ObjMaster::MeshOptimizer::computeACMR(&indices[3], plain.indexCount, 3, plain.vertexCount);
+		float after = ObjMaster::MeshOptimizer::computeACMR(&optimizedIndices[3], optimized.indexCount, 3, optimized.vertexCount);
+		OMLOGI("ACMR of the grid: %f -> %f", before, after);
+		if(!(after < before)) {
+			OMLOGE("Vertex cache optimization has not improved the ACMR: %f -> %f", before, after);
+			++errorCount;
+		}
+		OMLOGI("...tested vertex cache optimization with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Returns the triangles of the mesh by their vertex values (rotated to start with the smallest vertex and sorted) */
+	std::vector<std::vector<float>> meshTrianglesByValue(const ObjMaster::ObjMeshObject &mesh) {
+		std::vector<std::vector<float>> triangles;
+		const int FLOATS = sizeof(VertexStructure) / sizeof(float);
+		OM_INDEX_TYPE firstIndex = (OM_INDEX_TYPE)(mesh.lastIndex - mesh.vertexCount);
+		for(unsigned int i = 0; i < mesh.indexCount; i += 3) {
+			std::vector<std::vector<float>> corners;
+			for(int k = 0; k < 3; ++k) {
+				OM_INDEX_TYPE local = (OM_INDEX_TYPE)((*mesh.indices)[mesh.startIndexLocation + i + k] - firstIndex);
+				const float *data = (const float *)&(*mesh.vertexData)[mesh.baseVertexLocation + local];
+				corners.push_back(std::vector<float>(data, data + FLOATS));
+			}
+			std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+			std::vector<float> triangle;
+			for(auto &corner : corners) {
+				triangle.insert(triangle.end(), corner.begin(), corner.end());
+			}
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	/** Tests the overdraw and vertex fetch optimizations on a mesh in shared buffers. Returns the number of errors. */
+	int testOverdrawAndVertexFetchOptimization() {
+		OMLOGI("Testing overdraw and vertex fetch optimization...");
+		int errorCount = 0;
+		ObjMaster::Obj obj = ObjMaster::Obj(StringAssetLibrary(createGridObjText(64, false), true), "", "grid.obj");
+		std::vector<VertexStructure> vertices(3);
+		std::vector<OM_INDEX_TYPE> indices = { 0, 1, 2 };
+		ObjMaster::ObjMeshObject cacheOnly(obj, &obj.fs[0], (int)obj.fs.size(), &vertices, &indices, 3,
+				ObjMaster::ObjMeshObject::MeshBuildFlags::OPTIMIZE_VERTEX_CACHE);
+		std::vector<VertexStructure> optimizedVertices(3);
+		std::vector<OM_INDEX_TYPE> optimizedIndices = { 0, 1, 2 };
+		ObjMaster::ObjMeshObject optimized(obj, &obj.fs[0], (int)obj.fs.size(), &optimizedVertices, &optimizedIndices, 3,
+				ObjMaster::ObjMeshObject::MeshBuildFlags::OPTIMIZE_ALL);
+		if((optimizedIndices[0] != 0) || (optimizedIndices[1] != 1) || (optimizedIndices[2] != 2) ||
+		   (optimizedVertices.size() != vertices.size()) ||
+		   (memcmp(&optimizedVertices[0], &vertices[0], 3 * sizeof(VertexStructure)) != 0)) {
+			OMLOGE("Overdraw or vertex fetch optimization has changed data outside of the range of the mesh!");
+			++errorCount;
+		}
+		if(meshTrianglesByValue(cacheOnly) != meshTrianglesByValue(optimized)) {
+			OMLOGE("Overdraw or vertex fetch optimization has changed the rendered triangles!");
+			++errorCount;
+		}
+		// Vertices should be used in their order in the vertex buffer
+		unsigned int nextNew = 0;
+		for(unsigned int i = 0; i < optimized.indexCount; ++i) {
+			unsigned int local = (OM_INDEX_TYPE)(optimizedIndices[3 + i] - 3);
+			if(local > nextNew) {
+				OMLOGE("Vertex %u is used before vertex %u!", local, nextNew);
+				++errorCount;
+				break;
+			}
+			if(local == nextNew) ++nextNew;
+		}
+		float cacheAcmr = ObjMaster::MeshOptimizer::computeACMR(&indices[3], cacheOnly.indexCount, 3, cacheOnly.vertexCount);
+		float allAcmr = ObjMaster::MeshOptimizer::computeACMR(&optimizedIndices[3], optimized.indexCount, 3, optimized.vertexCount);
+		OMLOGI("ACMR of the grid: %f (vertex cache only) -> %f (all optimizations)", cacheAcmr, allAcmr);
+		if(allAcmr > cacheAcmr * ObjMaster::MeshOptimizer::DEFAULT_OVERDRAW_THRESHOLD + 0.01f) {
+			OMLOGE("Overdraw optimization has made the ACMR worse than allowed: %f -> %f", cacheAcmr, allAcmr);
+			++errorCount;
+		}
+		OMLOGI("...tested overdraw and vertex fetch optimization with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Tests emitting the compact vertex layout of a mesh in shared buffers. Returns the number of errors. */
+	int testCompactVertices() {
+		OMLOGI("Testing compact vertex layout of %s...", TEST_MODEL);
+		int errorCount = 0;
+		if(!ObjMaster::TEST_VertexCompression()) {
+			++errorCount;
+		}
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		// Some earlier far away data in the shared buffer - should not affect the quantization of the mesh
+		std::vector<VertexStructure> vertices = { { 1000, 1000, 1000, 0, 0, 1, 0, 0 } };
+		std::vector<OM_INDEX_TYPE> indices = { 0, 0, 0 };
+		ObjMaster::ObjMeshObject mesh(obj, &obj.fs[0], (int)obj.fs.size(), &vertices, &indices, 1);
+		std::vector<CompactVertexStructure> compact;
+		VertexQuantization quantization;
+		if(!mesh.toCompactVertices(compact, quantization) || (compact.size() != mesh.vertexCount)) {
+			OMLOGE("Could not emit the compact vertices!");
+			return errorCount + 1;
+		}
+		std::vector<VertexStructure> back(compact.size());
+		ObjMaster::VertexCompression::decompress(&compact[0], (unsigned int)compact.size(), quantization, &back[0]);
+		float maxScale = std::max(quantization.scaleX, std::max(quantization.scaleY, quantization.scaleZ));
+		if(maxScale >= 1000) {
+			OMLOGE("The quantization of the mesh covers data outside the mesh!");
+			++errorCount;
+		}
+		for(unsigned int v = 0; v < mesh.vertexCount; ++v) {
+			const VertexStructure &original = vertices[mesh.baseVertexLocation + v];
+			float length = std::sqrt(original.i * original.i + original.j * original.j + original.k * original.k);
+			bool positionOk = (std::fabs(back[v].x - original.x) <= maxScale / 65535) &&
+				(std::fabs(back[v].y - original.y) <= maxScale / 65535) &&
+				(std::fabs(back[v].z - original.z) <= maxScale / 65535);
+			bool normalOk = (length == 0) ||
+				((std::fabs(back[v].i - original.i / length) < 0.001f) &&
+				 (std::fabs(back[v].j - original.j / length) < 0.001f) &&
+				 (std::fabs(back[v].k - original.k / length) < 0.001f));
+			bool uvOk = (std::fabs(back[v].u - original.u) <= std::fabs(original.u) / 1024 + 0.0001f) &&
+				(std::fabs(back[v].v - original.v) <= std::fabs(original.v) / 1024 + 0.0001f);
+			if(!positionOk || !normalOk || !uvOk) {
+				OMLOGE("Compact vertex %u is too far from the original (position: %d, normal: %d, uv: %d)!",
+						v, positionOk, normalOk, uvOk);
+				++errorCount;
+				break;
+			}
+		}
+		OMLOGI("Vertex data: %u -> %u bytes", (unsigned int)(mesh.vertexCount * sizeof(VertexStructure)),
+				(unsigned int)(compact.size() * sizeof(CompactVertexStructure)));
+		OMLOGI("...tested compact vertex layout with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Returns the obj text without the normals and/or texture coordinates (also removes them from the faces) */
+	std::string stripObjAttributes(const std::string &objText, bool keepNormals, bool keepTexCoords) {
+		std::istringstream in(objText);
+		std::ostringstream out;
+		std::string line;
+		while(std::getline(in, line)) {
+			if((!keepNormals && (line.compare(0, 3, "vn ") == 0)) || (!keepTexCoords && (line.compare(0, 3, "vt ") == 0))) {
+				continue;
+			}
+			if(line.compare(0, 2, "f ") != 0) {
+				out << line << "\n";
+				continue;
+			}
+			std::istringstream points(line.substr(2));
+			std::string point;
+			out << "f";
+			while(points >> point) {
+				// v/vt/vn -> only the kept parts
+				size_t first = point.find('/');
+				size_t second = point.find('/', first + 1);
+				std::string v = point.substr(0, first);
+				std::string vt = point.substr(first + 1, second - first - 1);
+				std::string vn = point.substr(second + 1);
+				out << " " << v;
+				if(keepNormals) {
+					out << "/" << (keepTexCoords ? vt : "") << "/" << vn;
+				} else if(keepTexCoords) {
+					out << "/" << vt;
+				}
+			}
+			out << "\n";
+		}
+		return out.str();
+	}
+
+	/** Tests the meshes with compile-time specialized vertex layouts against ObjMeshObject. Returns the number of errors. */
+	int testLayoutMeshObjects() {
+		OMLOGI("Testing layout specialized meshes...");
+		int errorCount = 0;
+		std::string gridText = createGridObjText(32);
+		const size_t expectedSizes[] = { sizeof(PositionVertexStructure), sizeof(PositionNormalVertexStructure),
+				sizeof(PositionTexCoordVertexStructure), sizeof(VertexStructure) };
+		for(int attributes = 0; attributes < 4; ++attributes) {
+			bool hasNormals = ((attributes & ObjMaster::NORMAL_ATTRIBUTES) != 0);
+			bool hasTexCoords = ((attributes & ObjMaster::TEXCOORD_ATTRIBUTES) != 0);
+			ObjMaster::Obj obj = ObjMaster::Obj(StringAssetLibrary(stripObjAttributes(gridText, hasNormals, hasTexCoords), true), "", "grid.obj");
+			ObjMaster::ObjMeshObject full(obj);
+			ObjMaster::withLayoutMeshObject(obj, &obj.fs[0], (int)obj.fs.size(), ObjMaster::ObjMeshObject::MeshBuildFlags::DEDUP_BY_VALUE,
+					[&](auto &mesh) {
+				typedef typename std::decay<decltype(mesh.vertexData[0])>::type Vertex;
+				const int FLOATS = sizeof(Vertex) / sizeof(float);
+				if((sizeof(Vertex) != expectedSizes[attributes]) || (mesh.vertexCount != full.vertexCount) ||
+				   (mesh.indices != *full.indices)) {
+					OMLOGE("Layout mesh (attributes: %d, vertex size: %d) differs from the full mesh!", attributes, (int)sizeof(Vertex));
+					++errorCount;
+					return;
+				}
+				for(unsigned int v = 0; v < mesh.vertexCount; ++v) {
+					const VertexStructure &fullVertex = (*full.vertexData)[v];
+					// The layout has the position first and then the normal and uv if they are present
+					std::vector<float> expected = { fullVertex.x, fullVertex.y, fullVertex.z };
+					if(hasNormals) expected.insert(expected.end(), { fullVertex.i, fullVertex.j, fullVertex.k });
+					if(hasTexCoords) expected.insert(expected.end(), { fullVertex.u, fullVertex.v });
+					const float *data = (const float *)&mesh.vertexData[v];
+					if((FLOATS != (int)expected.size()) || !std::equal(expected.begin(), expected.end(), data)) {
+						OMLOGE("Layout mesh vertex %u (attributes: %d) differs from the full mesh!", v, attributes);
+						++errorCount;
+						return;
+					}
+				}
+				OMLOGI("Vertex data with attributes %d: %u -> %u bytes", attributes,
+						(unsigned int)(full.vertexCount * sizeof(VertexStructure)), (unsigned int)(mesh.vertexCount * sizeof(Vertex)));
+			});
+		}
+
+		// Attributes not in the layout should not split vertices - not even when de-duplicating by index
+		ObjMaster::Obj obj = ObjMaster::Obj(StringAssetLibrary(gridText, true), "", "grid.obj");
+		ObjMaster::LayoutMeshObject<PositionVertexStructure> positions(obj, ObjMaster::ObjMeshObject::MeshBuildFlags::DEDUP_BY_INDEX);
+		if(positions.vertexCount != obj.vs.size()) {
+			OMLOGE("Position only mesh has %u vertices instead of %u!", positions.vertexCount, (unsigned int)obj.vs.size());
+			++errorCount;
+		}
+		OMLOGI("...tested layout specialized meshes with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Tests the per-mesh index width selection and the splitting of too big groups. Returns the number of errors. */
+	int testIndexWidthAndSplit() {
+		OMLOGI("Testing index width selection and splitting for 16 bit indices...");
+		int errorCount = 0;
+
+		// Small mesh in shared buffers: the local indices should be the same in both widths
+		ObjMaster::Obj small = ObjMaster::Obj(StringAssetLibrary(createGridObjText(16), true), "", "grid.obj");
+		std::vector<VertexStructure> vertices(5);
+		std::vector<OM_INDEX_TYPE> indices(5, 0);
+		ObjMaster::ObjMeshObject smallMesh(small, &small.fs[0], (int)small.fs.size(), &vertices, &indices, 5);
+		std::vector<uint16_t> indices16;
+		std::vector<uint32_t> indices32;
+		if(!smallMesh.getLocalIndices32(indices32) || (smallMesh.getIndexWidth() != 2) || !smallMesh.getLocalIndices16(indices16) ||
+		   !std::equal(indices16.begin(), indices16.end(), indices32.begin()) || (indices32.size() != smallMesh.indexCount) ||
+		   (*std::max_element(indices32.begin(), indices32.end()) + 1 != smallMesh.vertexCount)) {
+			OMLOGE("Bad local indices of a small mesh!");
+			++errorCount;
+		}
+
+		// Face ranges should be consecutive and their meshes should fit the limit
+		const unsigned int MAX_VERTICES = 100;
+		auto ranges = ObjMaster::ObjMeshObject::splitFaceRanges(small, &small.fs[0], (int)small.fs.size(), MAX_VERTICES);
+		int nextFace = 0;
+		for(auto &range : ranges) {
+			ObjMaster::ObjMeshObject part(small, &small.fs[range.first], range.second);
+			if((range.first != nextFace) || (range.second <= 0) || (part.vertexCount > MAX_VERTICES)) {
+				OMLOGE("Bad face range (%d, %d) with %u vertices!", range.first, range.second, part.vertexCount);
+				++errorCount;
+			}
+			nextFace = range.first + range.second;
+		}
+		if((nextFace != (int)small.fs.size()) || (ranges.size() < 2)) {
+			OMLOGE("The face ranges do not cover the faces properly!");
+			++errorCount;
+		}
+
+		// The vertices split by the generated (flat) normals of a corrugated grid should be counted too
+		std::ostringstream corrugatedText;
+		corrugatedText << "s off\n";
+		for(int y = 0; y < 16; ++y) {
+			for(int x = 0; x < 16; ++x) {
+				corrugatedText << "v " << x << " " << y << " " << (x % 2) << "\n";
+			}
+		}
+		for(int y = 0; y + 1 < 16; ++y) {
+			for(int x = 0; x + 1 < 16; ++x) {
+				int a = y * 16 + x + 1, b = a + 1, c = a + 16, d = c + 1;
+				corrugatedText << "f " << a << " " << b << " " << d << "\nf " << a << " " << d << " " << c << "\n";
+			}
+		}
+		ObjMaster::Obj corrugated = ObjMaster::Obj(StringAssetLibrary(corrugatedText.str(), true), "", "corrugated.obj");
+		ObjMaster::ObjMeshObject::MeshBuildFlags normalFlags = ObjMaster::ObjMeshObject::MeshBuildFlags::GENERATE_NORMALS;
+		ranges = ObjMaster::ObjMeshObject::splitFaceRanges(corrugated, &corrugated.fs[0], (int)corrugated.fs.size(), MAX_VERTICES, normalFlags);
+		nextFace = 0;
+		for(auto &range : ranges) {
+			ObjMaster::ObjMeshObject part(corrugated, &corrugated.fs[range.first], range.second, normalFlags);
+			if((range.first != nextFace) || (range.second <= 0) || (part.vertexCount > MAX_VERTICES)) {
+				OMLOGE("Bad face range (%d, %d) with %u vertices after the normal generation!", range.first, range.second, part.vertexCount);
+				++errorCount;
+			}
+			nextFace = range.first + range.second;
+		}
+		if(nextFace != (int)corrugated.fs.size()) {
+			OMLOGE("The face ranges with normal generation do not cover the faces properly!");
+			++errorCount;
+		}
+
+		// A group that is too big for 16 bit indices should be split into more meshes
+		ObjMaster::Obj big = ObjMaster::Obj(StringAssetLibrary(createGridObjText(260, false), true), "", "grid.obj");
+		ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary> whole(big);
+		ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary> split(big,
+				ObjMaster::ObjMeshObject::MeshBuildFlags::SPLIT_FOR_16BIT_INDICES);
+		unsigned int splitIndexCount = 0;
+		for(auto &mesh : split.meshes) {
+			splitIndexCount += mesh.indexCount;
+			if((mesh.getIndexWidth() != 2) || !mesh.getLocalIndices16(indices16)) {
+				OMLOGE("Mesh %s of the split model does not fit 16 bit indices!", mesh.name.c_str());
+				++errorCount;
+			}
+		}
+		if((whole.meshes.size() != 1) || (whole.meshes[0].getIndexWidth() != 4) || (split.meshes.size() < 2) ||
+		   (splitIndexCount != whole.meshes[0].indexCount) || (split.meshes[1].name != whole.meshes[0].name + "#1")) {
+			OMLOGE("Bad split of the big group: %d meshes!", (int)split.meshes.size());
+			++errorCount;
+		}
+		// The wrapped around stored indices of the big mesh cannot be made local with 16 bit storage
+		std::vector<uint32_t> wholeIndices;
+		if(!whole.meshes.empty() && (whole.meshes[0].getLocalIndices32(wholeIndices) != (sizeof(OM_INDEX_TYPE) == 4))) {
+			OMLOGE("The big mesh is not refused by getLocalIndices32 exactly with 16 bit index storage!");
+			++errorCount;
+		}
+		OMLOGI("...tested index width selection and splitting with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Checks if the meshlets give back exactly the triangles (in any order) of the local indices - returns false otherwise */
+	bool isSameAsMeshlets(const std::vector<uint32_t> &localIndices, const std::vector<Meshlet> &meshlets,
+			const std::vector<uint32_t> &meshletVertices, const std::vector<uint8_t> &meshletTriangles) {
+		std::vector<uint32_t> fromMeshlets;
+		for(const Meshlet &meshlet : meshlets) {
+			if((meshlet.vertexCount > ObjMaster::MeshletBuilder::DEFAULT_MAX_VERTICES) ||
+			   (meshlet.triangleCount > ObjMaster::MeshletBuilder::DEFAULT_MAX_TRIANGLES)) {
+				return false;
+			}
+			for(unsigned int t = 0; t < meshlet.triangleCount * 3; ++t) {
+				fromMeshlets.push_back(meshletVertices[meshlet.vertexOffset + meshletTriangles[meshlet.triangleOffset + t]]);
+			}
+		}
+		return ObjMaster::sortedTriangles(localIndices) == ObjMaster::sortedTriangles(fromMeshlets);
+	}
+
+	/** Tests building meshlets for meshes, models and layout specialized meshes. Returns the number of errors. */
+	int testMeshlets() {
+		OMLOGI("Testing meshlet building...");
+		int errorCount = 0;
+		if(!ObjMaster::TEST_MeshletBuilder()) {
+			++errorCount;
+		}
+		ObjMaster::ObjMeshObject::MeshBuildFlags flags = (ObjMaster::ObjMeshObject::MeshBuildFlags)(
+				ObjMaster::ObjMeshObject::MeshBuildFlags::OPTIMIZE_ALL | ObjMaster::ObjMeshObject::MeshBuildFlags::BUILD_MESHLETS);
+
+		// Mesh in shared buffers: the meshlets use local vertex numbers and survive copying
+		ObjMaster::Obj obj = ObjMaster::Obj(StringAssetLibrary(createGridObjText(40), true), "", "grid.obj");
+		std::vector<VertexStructure> vertices(3);
+		std::vector<OM_INDEX_TYPE> indices(3, 0);
+		ObjMaster::ObjMeshObject mesh(obj, &obj.fs[0], (int)obj.fs.size(), &vertices, &indices, 3, flags);
+		ObjMaster::ObjMeshObject copy = mesh;
+		std::vector<uint32_t> localIndices;
+		mesh.getLocalIndices32(localIndices);
+		if(mesh.meshlets.empty() || !isSameAsMeshlets(localIndices, copy.meshlets, copy.meshletVertices, copy.meshletTriangles)) {
+			OMLOGE("The meshlets of the mesh do not give back its triangles!");
+			++errorCount;
+		}
+		ObjMaster::ObjMeshObject plain(obj, &obj.fs[0], (int)obj.fs.size(), ObjMaster::ObjMeshObject::MeshBuildFlags::OPTIMIZE_ALL);
+		if(!plain.meshlets.empty()) {
+			OMLOGE("Meshlets are built without BUILD_MESHLETS!");
+			++errorCount;
+		}
+
+		// Meshes of a model (all in one shared buffer) and a layout specialized mesh
+		ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary> model(obj, flags);
+		for(auto &modelMesh : model.meshes) {
+			modelMesh.getLocalIndices32(localIndices);
+			if(!isSameAsMeshlets(localIndices, modelMesh.meshlets, modelMesh.meshletVertices, modelMesh.meshletTriangles)) {
+				OMLOGE("The meshlets of model mesh %s do not give back its triangles!", modelMesh.name.c_str());
+				++errorCount;
+			}
+		}
+		ObjMaster::LayoutMeshObject<PositionVertexStructure> layoutMesh(obj, flags);
+		localIndices.assign(layoutMesh.indices.begin(), layoutMesh.indices.end());
+		if(layoutMesh.meshlets.empty() ||
+		   !isSameAsMeshlets(localIndices, layoutMesh.meshlets, layoutMesh.meshletVertices, layoutMesh.meshletTriangles)) {
+			OMLOGE("The meshlets of the layout specialized mesh do not give back its triangles!");
+			++errorCount;
+		}
+		OMLOGI("...tested meshlet building with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Tests building the LOD chains of the meshes of a model. Returns the number of errors. */
+	int testLodChains() {
+		OMLOGI("Testing LOD chain building of %s...", TEST_MODEL);
+		int errorCount = 0;
+		if(!ObjMaster::TEST_MeshSimplifier()) {
+			++errorCount;
+		}
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary> model(obj,
+				(ObjMaster::ObjMeshObject::MeshBuildFlags)(ObjMaster::ObjMeshObject::MeshBuildFlags::OPTIMIZE_ALL |
+				ObjMaster::ObjMeshObject::MeshBuildFlags::BUILD_LODS));
+		unsigned int lodCount = 0;
+		for(auto &mesh : model.meshes) {
+			// Levels should get smaller and refer to the vertices of the mesh only
+			OM_INDEX_TYPE firstIndex = (OM_INDEX_TYPE)(mesh.lastIndex - mesh.vertexCount);
+			unsigned int previousCount = mesh.indexCount;
+			for(const ObjMaster::MeshLod &lod : mesh.lods) {
+				if((lod.indexCount >= previousCount) || (lod.indexCount % 3 != 0) || (lod.error > 0.04f) ||
+				   (lod.indexOffset + lod.indexCount > mesh.lodIndices.size())) {
+					OMLOGE("Bad LOD of mesh %s: %u indices with %f error!", mesh.name.c_str(), lod.indexCount, lod.error);
+					++errorCount;
+					continue;
+				}
+				for(unsigned int i = lod.indexOffset; i < lod.indexOffset + lod.indexCount; ++i) {
+					if((OM_INDEX_TYPE)(mesh.lodIndices[i] - firstIndex) >= mesh.vertexCount) {
+						OMLOGE("LOD index of mesh %s is out of its vertex range!", mesh.name.c_str());
+						++errorCount;
+						break;
+					}
+				}
+				previousCount = lod.indexCount;
+				++lodCount;
+			}
+		}
+		if(lodCount == 0) {
+			OMLOGE("No LODs are built for the model!");
+			++errorCount;
+		}
+		ObjMaster::ObjMeshObject copy = model.meshes[0];
+		if((copy.lods.size() != model.meshes[0].lods.size()) || (copy.lodIndices != model.meshes[0].lodIndices)) {
+			OMLOGE("The LODs do not survive copying the mesh!");
+			++errorCount;
+		}
+		OMLOGI("...tested LOD chain building (%u levels) with %d errors!", lodCount, errorCount);
+		return errorCount;
+	}
+
+	/** Tests the bounding volumes of the meshes and the model. Returns the number of errors. */
+	int testBounds() {
+		OMLOGI("Testing bounding volumes of %s...", TEST_MODEL);
+		int errorCount = 0;
+		if(!ObjMaster::TEST_MeshBounds()) {
+			++errorCount;
+		}
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary> model(obj,
+				ObjMaster::ObjMeshObject::MeshBuildFlags::OPTIMIZE_ALL);
+		for(auto &mesh : model.meshes) {
+			// Compare with a plain walk over the (optimized) vertices of the mesh
+			const VertexStructure *vertices = &(*mesh.vertexData)[mesh.baseVertexLocation];
+			float minX = vertices[0].x, maxX = vertices[0].x, minZ = vertices[0].z, maxZ = vertices[0].z;
+			for(unsigned int i = 0; i < mesh.vertexCount; ++i) {
+				minX = std::min(minX, vertices[i].x);
+				maxX = std::max(maxX, vertices[i].x);
+				minZ = std::min(minZ, vertices[i].z);
+				maxZ = std::max(maxZ, vertices[i].z);
+				float dx = vertices[i].x - mesh.bounds.centerX, dy = vertices[i].y - mesh.bounds.centerY,
+				      dz = vertices[i].z - mesh.bounds.centerZ;
+				if(std::sqrt(dx * dx + dy * dy + dz * dz) > mesh.bounds.radius * 1.0001f) {
+					OMLOGE("A vertex of mesh %s is outside of its bounding sphere!", mesh.name.c_str());
+					++errorCount;
+					break;
+				}
+			}
+			if((minX != mesh.bounds.minX) || (maxX != mesh.bounds.maxX) || (minZ != mesh.bounds.minZ) || (maxZ != mesh.bounds.maxZ)) {
+				OMLOGE("Bad bounding box of mesh %s!", mesh.name.c_str());
+				++errorCount;
+			}
+			// The model bounds should contain every mesh
+			if((mesh.bounds.minX < model.bounds.minX) || (mesh.bounds.maxY > model.bounds.maxY) ||
+			   (mesh.bounds.minZ < model.bounds.minZ) || (mesh.bounds.radius > model.bounds.radius * 1.0001f)) {
+				OMLOGE("The model bounds do not contain mesh %s!", mesh.name.c_str());
+				++errorCount;
+			}
+		}
+		ObjMaster::LayoutMeshObject<PositionVertexStructure> layoutMesh(obj);
+		if(ObjMaster::MeshBounds::isEmpty(layoutMesh.bounds) || (layoutMesh.bounds.minX != model.bounds.minX) ||
+		   (layoutMesh.bounds.maxY != model.bounds.maxY)) {
+			OMLOGE("Bad bounds of the layout specialized mesh!");
+			++errorCount;
+		}
+		OMLOGI("...tested bounding volumes with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Tests ray queries against the BVH of a model by comparing them with testing every triangle. Returns the number of errors. */
+	int testBvh() {
+		OMLOGI("Testing BVH ray queries on %s...", TEST_MODEL);
+		int errorCount = 0;
+		if(!ObjMaster::TEST_TriangleBvh()) {
+			++errorCount;
+		}
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary> model(obj);
+		std::vector<const ObjMaster::ObjMeshObject *> meshes;
+		for(auto &mesh : model.meshes) {
+			meshes.push_back(&mesh);
+		}
+		ObjMaster::ThreadPool pool(4);
+		ObjMaster::TriangleBvh serialBvh(model);
+		ObjMaster::TriangleBvh parallelBvh(model, &pool);
+		if((serialBvh.getTriangleCount() != parallelBvh.getTriangleCount()) || (serialBvh.nodes.size() != parallelBvh.nodes.size())) {
+			OMLOGE("Serial and parallel BVH builds differ!");
+			++errorCount;
+		}
+		// Rays from a sphere around the model towards (jittered) points near its center
+		const BoundingVolume &bounds = model.bounds;
+		std::vector<ObjMaster::BvhRay> rays;
+		for(int i = 0; i < 500; ++i) {
+			float theta = 0.37f * i, phi = 0.11f * i;
+			float from[3] = { bounds.centerX + 2 * bounds.radius * std::cos(theta) * std::sin(phi),
+			                  bounds.centerY + 2 * bounds.radius * std::cos(phi),
+			                  bounds.centerZ + 2 * bounds.radius * std::sin(theta) * std::sin(phi) };
+			float to[3] = { bounds.centerX + 0.3f * bounds.radius * std::sin(1.3f * i),
+			                bounds.centerY + 0.3f * bounds.radius * std::cos(0.7f * i),
+			                bounds.centerZ + 0.3f * bounds.radius * std::sin(0.9f * i) };
+			rays.push_back(ObjMaster::BvhRay { from[0], from[1], from[2], to[0] - from[0], to[1] - from[1], to[2] - from[2], 2 });
+		}
+		std::vector<ObjMaster::BvhHit> hits(rays.size());
+		parallelBvh.intersect(&rays[0], (unsigned int)rays.size(), &hits[0], &pool);
+		int hitCount = 0;
+		for(size_t i = 0; i < rays.size(); ++i) {
+			ObjMaster::BvhHit expected = ObjMaster::bruteForceIntersect(meshes, rays[i]);
+			ObjMaster::BvhHit serialHit;
+			serialBvh.intersect(rays[i], serialHit);
+			if((hits[i].meshIndex != expected.meshIndex) || (std::fabs(hits[i].distance - expected.distance) > 0.00001f) ||
+			   (serialHit.meshIndex != expected.meshIndex) || (serialBvh.isOccluded(rays[i]) != (expected.meshIndex >= 0))) {
+				OMLOGE("BVH ray %d hits mesh %d at %f instead of mesh %d at %f!", (int)i, hits[i].meshIndex, hits[i].distance,
+				       expected.meshIndex, expected.distance);
+				++errorCount;
+			}
+			hitCount += (expected.meshIndex >= 0) ? 1 : 0;
+		}
+		if(hitCount == 0) {
+			OMLOGE("No test ray hits the model!");
+			++errorCount;
+		}
+		OMLOGI("...tested BVH ray queries (%d of %d rays hit) with %d errors!", hitCount, (int)rays.size(), errorCount);
+		return errorCount;
+	}
+
+	/** Tests smoothing group parsing and normal generation for a model without normals. Returns the number of errors. */
+	int testNormalGeneration() {
+		OMLOGI("Testing normal generation...");
+		int errorCount = 0;
+		if(!ObjMaster::TEST_NormalGenerator()) {
+			++errorCount;
+		}
+		// A cube: back and front faces in the default group, bottom is 's off', left, top and right are in 's 1'
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, "smoothgroups.obj");
+		ObjMaster::Obj parallelObj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, "smoothgroups.obj",
+				ObjMaster::Obj::ObjLoadModeFlags::PARALLEL_PARSE, 3);
+		const unsigned int expectedGroups[] = { ObjMaster::Obj::DEFAULT_SMOOTHING_GROUP, ObjMaster::Obj::DEFAULT_SMOOTHING_GROUP, 0, 1, 1, 1 };
+		if((obj.fs.size() != 6) || (obj.smoothingGroupStarts.size() != 2) || (parallelObj.smoothingGroupStarts.size() != 2)) {
+			OMLOGE("Bad smoothing groups: %d starts for %d faces!", (int)obj.smoothingGroupStarts.size(), (int)obj.fs.size());
+			return errorCount + 1;
+		}
+		for(int i = 0; i < 6; ++i) {
+			if((obj.getSmoothingGroup(i) != expectedGroups[i]) || (parallelObj.getSmoothingGroup(i) != expectedGroups[i])) {
+				OMLOGE("Bad smoothing group %u for face %d!", obj.getSmoothingGroup(i), i);
+				++errorCount;
+			}
+		}
+
+		// Without the flag the normals stay zero - just as before
+		ObjMaster::ObjMeshObject plainMesh(obj);
+		if((plainMesh.vertexCount != 8) || ((*plainMesh.vertexData)[0].i != 0) || ((*plainMesh.vertexData)[0].j != 0) ||
+		   ((*plainMesh.vertexData)[0].k != 0)) {
+			OMLOGE("Normals were generated without GENERATE_NORMALS!");
+			++errorCount;
+		}
+
+		// The faces follow each other in the index buffer (two triangles each)
+		const float faceNormals[6][3] = { { 0, 0, -1 }, { 0, 0, 1 }, { 0, -1, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 1, 0, 0 } };
+		for(bool crease : { false, true }) {
+			ObjMaster::ObjMeshObject mesh(obj, crease ? ObjMaster::ObjMeshObject::MeshBuildFlags::GENERATE_CREASED_NORMALS :
+					ObjMaster::ObjMeshObject::MeshBuildFlags::GENERATE_NORMALS);
+			int smoothedCount = 0;
+			for(unsigned int i = 0; i < mesh.indexCount; ++i) {
+				const VertexStructure &v = (*mesh.vertexData)[(*mesh.indices)[i]];
+				const float *faceNormal = faceNormals[i / 6];
+				float along = v.i * faceNormal[0] + v.j * faceNormal[1] + v.k * faceNormal[2];
+				if((std::fabs(v.i * v.i + v.j * v.j + v.k * v.k - 1) > 0.0001f) || (along <= 0)) {
+					OMLOGE("Bad generated normal (%f, %f, %f) for face %d!", v.i, v.j, v.k, (int)(i / 6));
+					++errorCount;
+					break;
+				}
+				// Only the faces of 's 1' share their edges within their group
+				bool smoothed = (along < 0.9999f);
+				if(smoothed && (crease || (i / 6 < 3))) {
+					OMLOGE("Face %d is smoothed across a crease or out of its smoothing group!", (int)(i / 6));
+					++errorCount;
+					break;
+				}
+				smoothedCount += smoothed ? 1 : 0;
+			}
+			if((smoothedCount == 0) != crease) {
+				OMLOGE("Bad smoothing in smoothing group 1 (crease: %d)!", (int)crease);
+				++errorCount;
+			}
+			if(crease && (mesh.vertexCount != 24)) {
+				OMLOGE("The creased cube has %u vertices instead of 24!", mesh.vertexCount);
+				++errorCount;
+			}
+		}
+
+		// Layouts should get the generated normals too
+		ObjMaster::withLayoutMeshObject(obj, &obj.fs[0], (int)obj.fs.size(), ObjMaster::ObjMeshObject::MeshBuildFlags::GENERATE_NORMALS,
+				[&](auto &mesh) {
+			if((ObjMaster::VertexLayoutTraits<typename std::decay<decltype(mesh.vertexData[0])>::type>::ATTRIBUTES &
+			    ObjMaster::NORMAL_ATTRIBUTES) == 0) {
+				OMLOGE("The layout of generated normals has no normals!");
+				++errorCount;
+			}
+		});
+		ObjMaster::LayoutMeshObject<PositionNormalVertexStructure> layoutMesh(obj, ObjMaster::ObjMeshObject::MeshBuildFlags::GENERATE_NORMALS);
+		ObjMaster::ObjMeshObject mesh(obj, ObjMaster::ObjMeshObject::MeshBuildFlags::GENERATE_NORMALS);
+		if((layoutMesh.vertexCount != mesh.vertexCount) || (layoutMesh.vertexData[0].i != (*mesh.vertexData)[0].i) ||
+		   (layoutMesh.vertexData[0].j != (*mesh.vertexData)[0].j)) {
+			OMLOGE("The layout specialized mesh got different normals!");
+			++errorCount;
+		}
+		OMLOGI("...tested normal generation with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Tests tangent generation for meshes with and without bump mapped materials. Returns the number of errors. */
+	int testTangents() {
+		OMLOGI("Testing tangent generation on %s...", TEST_MODEL);
+		int errorCount = 0;
+		if(!ObjMaster::TEST_TangentGenerator()) {
+			++errorCount;
+		}
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		// The materials of the test model have no bump maps - so nothing gets generated for them
+		ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary> model(obj,
+				ObjMaster::ObjMeshObject::MeshBuildFlags::GENERATE_TANGENTS);
+		for(auto &mesh : model.meshes) {
+			if(!mesh.tangents.empty()) {
+				OMLOGE("Tangents are generated for mesh %s without a bump map!", mesh.name.c_str());
+				++errorCount;
+			}
+		}
+		ObjMaster::Material bumpMaterial;
+		bumpMaterial.name = "bump";
+		bumpMaterial.setAndEnableMapBump("bump.png");
+		obj.mtlLib.addRuntimeGeneratedMaterial(bumpMaterial);
+		uint32_t bumpMaterialId = obj.mtlLib.getMaterialId("bump");
+		ObjMaster::MaterializedObjMeshObject plainMesh(obj, &obj.fs[0], (int)obj.fs.size(), bumpMaterialId, "plain",
+				ObjMaster::ObjMeshObject::MeshBuildFlags::OPTIMIZE_ALL);
+		ObjMaster::MaterializedObjMeshObject bumpMesh(obj, &obj.fs[0], (int)obj.fs.size(), bumpMaterialId, "bump",
+				(ObjMaster::ObjMeshObject::MeshBuildFlags)(ObjMaster::ObjMeshObject::MeshBuildFlags::OPTIMIZE_ALL |
+				ObjMaster::ObjMeshObject::MeshBuildFlags::GENERATE_TANGENTS));
+		if((bumpMesh.tangents.size() != bumpMesh.vertexCount) || (bumpMesh.vertexCount < plainMesh.vertexCount) ||
+		   (bumpMesh.indexCount != plainMesh.indexCount) || (bumpMesh.vertexData->size() != bumpMesh.vertexCount)) {
+			OMLOGE("Bad tangent count %u for %u vertices!", (unsigned int)bumpMesh.tangents.size(), bumpMesh.vertexCount);
+			return errorCount + 1;
+		}
+		for(unsigned int v = 0; v < bumpMesh.vertexCount; ++v) {
+			const TangentStructure &t = bumpMesh.tangents[v];
+			const VertexStructure &vertex = (*bumpMesh.vertexData)[v];
+			float length = std::sqrt(t.x * t.x + t.y * t.y + t.z * t.z);
+			float normalLength = std::sqrt(vertex.i * vertex.i + vertex.j * vertex.j + vertex.k * vertex.k);
+			float along = (t.x * vertex.i + t.y * vertex.j + t.z * vertex.k) / normalLength;
+			if((std::fabs(length - 1) > 0.001f) || (std::fabs(along) > 0.001f) || (std::fabs(t.w) != 1)) {
+				OMLOGE("Bad tangent (%f, %f, %f, %f) of vertex %u!", t.x, t.y, t.z, t.w, v);
+				++errorCount;
+				break;
+			}
+		}
+		// The split vertices are copies: the triangles should still be the same
+		for(unsigned int i = 0; i < bumpMesh.indexCount; ++i) {
+			if((*bumpMesh.indices)[i] >= bumpMesh.lastIndex) {
+				OMLOGE("Index %u is out of the vertices after the tangent splits!", i);
+				++errorCount;
+				break;
+			}
+		}
+		ObjMaster::ObjMeshObject copied(bumpMesh);
+		if(copied.tangents.size() != bumpMesh.tangents.size()) {
+			OMLOGE("The tangents do not survive copying the mesh!");
+			++errorCount;
+		}
+		OMLOGI("...tested tangent generation (%u split vertices) with %d errors!",
+				bumpMesh.vertexCount - plainMesh.vertexCount, errorCount);
+		return errorCount;
+	}
+
+	/** Tests building the meshes of a model into shared buffers against building them separately. Returns the number of errors. */
+	int testSharedBuffers() {
+		OMLOGI("Testing shared mesh buffers on %s...", TEST_MODEL);
+		int errorCount = 0;
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		typedef ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary> Model;
+		for(int mode = 0; mode < 2; ++mode) {
+			ObjMaster::ObjMeshObject::MeshBuildFlags buildFlags = (mode == 0) ?
+					ObjMaster::ObjMeshObject::MeshBuildFlags::DEDUP_BY_VALUE :
+					(ObjMaster::ObjMeshObject::MeshBuildFlags)(ObjMaster::ObjMeshObject::MeshBuildFlags::DEDUP_BY_INDEX |
+					ObjMaster::ObjMeshObject::MeshBuildFlags::OPTIMIZE_VERTEX_CACHE);
+			Model separate(obj, buildFlags);
+			Model builtShared(obj, buildFlags, Model::ModelBuildModeFlags::SHARED_BUFFERS);
+			// The buffers are not copied with the moved model
+			Model shared(std::move(builtShared));
+			if(!shared.sharedBuffers || (shared.meshes.size() != separate.meshes.size())) {
+				OMLOGE("Bad shared model (mode %d)!", mode);
+				return errorCount + 1;
+			}
+			unsigned int separateVertexCount = 0;
+			for(size_t m = 0; m < shared.meshes.size(); ++m) {
+				const ObjMaster::MaterializedObjMeshObject &a = separate.meshes[m];
+				const ObjMaster::MaterializedObjMeshObject &b = shared.meshes[m];
+				separateVertexCount += a.vertexCount;
+				if((b.vertexData != &shared.sharedBuffers->vertexData) || (b.indices != &shared.sharedBuffers->indices) ||
+				   (b.indexCount != a.indexCount) || (b.lastIndex != b.vertexCount)) {
+					OMLOGE("Bad shared mesh %s (mode %d)!", b.name.c_str(), mode);
+					++errorCount;
+					continue;
+				}
+				// The same triangles - made of the same vertices
+				OM_INDEX_TYPE aFirst = (OM_INDEX_TYPE)(a.lastIndex - a.vertexCount);
+				for(unsigned int i = 0; i < b.indexCount; ++i) {
+					OM_INDEX_TYPE bIndex = (*b.indices)[b.startIndexLocation + i];
+					if(bIndex >= b.vertexCount) {
+						OMLOGE("Index %u of shared mesh %s is out of its range!", i, b.name.c_str());
+						++errorCount;
+						break;
+					}
+					const VertexStructure &va = (*a.vertexData)[a.baseVertexLocation + (OM_INDEX_TYPE)((*a.indices)[a.startIndexLocation + i] - aFirst)];
+					const VertexStructure &vb = (*b.vertexData)[b.baseVertexLocation + bIndex];
+					if(memcmp(&va, &vb, sizeof(VertexStructure)) != 0) {
+						OMLOGE("Vertex of index %u differs in shared mesh %s!", i, b.name.c_str());
+						++errorCount;
+						break;
+					}
+				}
+				if(memcmp(&a.bounds, &b.bounds, sizeof(BoundingVolume)) != 0) {
+					OMLOGE("Bounds of shared mesh %s differ!", b.name.c_str());
+					++errorCount;
+				}
+			}
+			if(shared.sharedBuffers->vertexData.size() > separateVertexCount) {
+				OMLOGE("Shared buffers have more vertices (%u) than the separate meshes (%u)!",
+						(unsigned int)shared.sharedBuffers->vertexData.size(), separateVertexCount);
+				++errorCount;
+			}
+			OMLOGI(" - mode %d: %u shared vertices instead of %u", mode,
+					(unsigned int)shared.sharedBuffers->vertexData.size(), separateVertexCount);
+		}
+		// The vertices of the same faces are all reused - until the building is finished
+		ObjMaster::SharedMeshBuffers buffers;
+		int half = (int)obj.fs.size() / 2;
+		ObjMaster::ObjMeshObject first(obj, &obj.fs[0], half, buffers);
+		size_t firstSize = buffers.vertexData.size();
+		ObjMaster::ObjMeshObject again(obj, &obj.fs[0], half, buffers);
+		if((buffers.vertexData.size() != firstSize) || (again.baseVertexLocation != first.baseVertexLocation) ||
+		   (again.vertexCount != first.vertexCount) || (again.startIndexLocation != first.indexCount)) {
+			OMLOGE("The vertices of the same faces are not reused in the shared buffers!");
+			++errorCount;
+		}
+		buffers.finishBuilding();
+		ObjMaster::ObjMeshObject after(obj, &obj.fs[0], half, buffers);
+		if((buffers.vertexData.size() != 2 * firstSize) || (after.baseVertexLocation != firstSize) || (after.vertexCount != first.vertexCount)) {
+			OMLOGE("Bad mesh in the shared buffers after finishing the building!");
+			++errorCount;
+		}
+		// Vertices far before the new ones are stored again instead of stretching the range past 16 bit indices
+		ObjMaster::Obj big = ObjMaster::Obj(StringAssetLibrary(createGridObjText(260), true), "", "grid.obj");
+		ObjMaster::SharedMeshBuffers bigBuffers;
+		ObjMaster::ObjMeshObject whole(big, &big.fs[0], (int)big.fs.size(), bigBuffers);
+		std::vector<ObjMaster::FaceElement> farFaces = { big.fs.front(), big.fs.back() };
+		size_t wholeSize = bigBuffers.vertexData.size();
+		ObjMaster::ObjMeshObject farMesh(big, &farFaces[0], (int)farFaces.size(), bigBuffers);
+		if((farMesh.getIndexWidth() != 2) || (farMesh.baseVertexLocation != wholeSize) ||
+		   (farMesh.vertexCount != bigBuffers.vertexData.size() - wholeSize) || (farMesh.vertexCount > 8)) {
+			OMLOGE("Bad range of a shared mesh that reuses far away vertices: %u vertices from %u!", farMesh.vertexCount, farMesh.baseVertexLocation);
+			++errorCount;
+		}
+		OMLOGI("...tested shared mesh buffers with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Finds the mesh of the model whose name starts with the given object name - returns -1 if there is none */
+	template<class Model>
+	int findMeshByObjectName(const Model &model, const char *objectName) {
+		for(int i = 0; i < (int)model.meshes.size(); ++i) {
+			if(model.meshes[i].name.find(objectName) == 0) {
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	/** Tests finding the instances among the box props of the instancing test model. Returns the number of errors. */
+	int testInstancing() {
+		OMLOGI("Testing mesh instancing on instances.obj...");
+		int errorCount = 0;
+		if(!ObjMaster::TEST_MeshInstancing()) {
+			++errorCount;
+		}
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, "instances.obj");
+		typedef ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary> Model;
+		Model original(obj);
+		int a = findMeshByObjectName(original, "PropA");
+		int b = findMeshByObjectName(original, "PropB");
+		int c = findMeshByObjectName(original, "PropC");
+		if((original.meshes.size() != 5) || (a < 0) || (b < 0) || (c < 0)) {
+			OMLOGE("Bad instancing test model!");
+			return errorCount + 1;
+		}
+		// Rem.: the props are in the (unordered) group order - the prototype is the one that comes first
+		int first = std::min(a, b);
+		int second = std::max(a, b);
+		int rigidFirst = std::min(first, c);
+		for(int rigid = 0; rigid < 2; ++rigid) {
+			Model model(obj);
+			int instanceCount = model.shareInstancedGeometry(rigid != 0);
+			int prototypeMesh = (rigid != 0) ? rigidFirst : first;
+			if((instanceCount != 1 + rigid) || (model.instances.size() != model.meshes.size()) ||
+			   (model.instances[second].prototypeMesh != prototypeMesh) ||
+			   (model.meshes[second].vertexData != model.meshes[prototypeMesh].vertexData)) {
+				OMLOGE("Bad instances (rigid: %d): %d instead of %d!", rigid, instanceCount, 1 + rigid);
+				++errorCount;
+				continue;
+			}
+			// The transforms place the prototype geometry where the copies originally were
+			for(int i : { a, b, c }) {
+				const MeshInstance &instance = model.instances[i];
+				const ObjMaster::ObjMeshObject &prototype = model.meshes[instance.prototypeMesh];
+				const ObjMaster::ObjMeshObject &placed = original.meshes[i];
+				const float *m = instance.transform;
+				if((rigid == 0) && (i == c)) {
+					continue;
+				}
+				for(unsigned int v = 0; v < placed.vertexCount; ++v) {
+					const VertexStructure &p = (*prototype.vertexData)[prototype.baseVertexLocation + v];
+					const VertexStructure &q = (*placed.vertexData)[placed.baseVertexLocation + v];
+					if((std::fabs(m[0] * p.x + m[1] * p.y + m[2] * p.z + m[3] - q.x) > 0.0001f) ||
+					   (std::fabs(m[4] * p.x + m[5] * p.y + m[6] * p.z + m[7] - q.y) > 0.0001f) ||
+					   (std::fabs(m[8] * p.x + m[9] * p.y + m[10] * p.z + m[11] - q.z) > 0.0001f)) {
+						OMLOGE("The instance transform of mesh %d does not place vertex %u!", i, v);
+						++errorCount;
+						break;
+					}
+				}
+				if(memcmp(&model.meshes[i].bounds, &placed.bounds, sizeof(BoundingVolume)) != 0) {
+					OMLOGE("The bounds of the instance are not the placed ones!");
+					++errorCount;
+				}
+			}
+			// Copies refer to their own prototypes
+			Model copied(model);
+			if((copied.meshes[second].vertexData != copied.meshes[first].vertexData) ||
+			   (copied.meshes[second].vertexData == model.meshes[first].vertexData)) {
+				OMLOGE("The instances of the copied model do not refer to the copied prototypes!");
+				++errorCount;
+			}
+		}
+
+		// Across models of the facade: the same file under another path is another model
+		int handle = loadObjModel(TEST_MODEL_PATH, "instances.obj");
+		int otherHandle = loadObjModel("objmaster/tests/../tests/models/", "instances.obj");
+		SimpleMeshInstance instance;
+		if((handle < 0) || (otherHandle == handle) ||
+		   !getModelMeshInstance(otherHandle, a, false, &instance) || (instance.handle != handle) || (instance.meshIndex != first) ||
+		   !getModelMeshInstance(handle, rigidFirst, true, &instance) || (instance.handle != handle) || (instance.meshIndex != rigidFirst) ||
+		   !getModelMeshInstance(otherHandle, c, true, &instance) || (instance.handle != handle) || (instance.meshIndex != rigidFirst)) {
+			OMLOGE("Bad instances across the models of the facade!");
+			++errorCount;
+		}
+		// Unloaded models are not referred
+		unloadObjModel(handle);
+		if(!getModelMeshInstance(otherHandle, second, false, &instance) || (instance.handle != otherHandle) || (instance.meshIndex != first)) {
+			OMLOGE("Bad instance after unloading the prototype model!");
+			++errorCount;
+		}
+		unloadObjModel(otherHandle);
+		OMLOGI("...tested mesh instancing with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Tests if incremental mesh building gives the meshes of a model build and reports only the appended ranges. Returns the number of errors. */
+	int testIncrementalBuild() {
+		OMLOGI("Testing incremental mesh building...");
+		int errorCount = 0;
+		typedef ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary> Model;
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		Model model(obj);
+		ObjMaster::IncrementalMeshBuilder builder;
+		auto updates = builder.update(obj);
+		if((builder.meshes.size() != model.meshes.size()) || (updates.size() != model.meshes.size()) ||
+		   (builder.getAbsorbedFaceCount() != (int)obj.fs.size()) ||
+		   (memcmp(&builder.bounds, &model.bounds, sizeof(BoundingVolume)) != 0)) {
+			OMLOGE("The incremental build of %s has other meshes than the model!", TEST_MODEL);
+			return errorCount + 1;
+		}
+		for(auto &mesh : builder.meshes) {
+			int m = findMeshByObjectName(model, mesh.name.c_str());
+			if((m < 0) || (model.meshes[m].vertexCount != mesh.vertexCount) || (model.meshes[m].indexCount != mesh.indexCount)) {
+				OMLOGE("The incrementally built mesh %s differs from the model!", mesh.name.c_str());
+				++errorCount;
+				continue;
+			}
+			const ObjMaster::ObjMeshObject &built = model.meshes[m];
+			if(memcmp(&(*mesh.vertexData)[0], &(*built.vertexData)[0], mesh.vertexCount * sizeof(VertexStructure)) != 0 ||
+			   memcmp(&(*mesh.indices)[0], &(*built.indices)[0], mesh.indexCount * sizeof(OM_INDEX_TYPE)) != 0) {
+				OMLOGE("The incrementally built mesh %s has other data than the model!", mesh.name.c_str());
+				++errorCount;
+			}
+		}
+		if(!builder.update(obj).empty()) {
+			OMLOGE("The incremental build reports changes when nothing is appended!");
+			++errorCount;
+		}
+		// A missing texture coordinate is not the same as a zero one - for the full build neither
+		ObjMaster::Obj missing = ObjMaster::Obj(StringAssetLibrary("v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nf 1 2 3\nf 1/1 2/1 3/1\n", true), "", "missing.obj");
+		Model missingModel(missing);
+		ObjMaster::IncrementalMeshBuilder missingBuilder;
+		missingBuilder.update(missing);
+		if((missingModel.meshes.size() != 1) || (missingBuilder.meshes.size() != 1) ||
+		   (missingModel.meshes[0].vertexCount != 6) || (missingBuilder.meshes[0].vertexCount != 6)) {
+			OMLOGE("The incremental build de-duplicates missing and zero texture coordinates differently!");
+			++errorCount;
+		}
+
+		// Appending with the creator: a red triangle, then a blue one, then more red with a reused and a new vertex
+		ObjMaster::ObjCreator creator;
+		ObjMaster::Material red;
+		red.name = "red";
+		ObjMaster::Material blue;
+		blue.name = "blue";
+		creator.addRuntimeGeneratedMaterial(red);
+		creator.addRuntimeGeneratedMaterial(blue);
+		creator.unsafeAddVertexStructure(VertexStructure{ 0, 0, 0,  0, 1, 0,  0, 0 });
+		creator.unsafeAddVertexStructure(VertexStructure{ 0, 0, 1,  0, 1, 0,  0, 1 });
+		creator.unsafeAddVertexStructure(VertexStructure{ 1, 0, 1,  0, 1, 0,  1, 1 });
+		creator.unsafeAddVertexStructure(VertexStructure{ 1, 0, 0,  0, 1, 0,  1, 0 });
+		creator.useMaterial("red");
+		creator.addFace(0, 1, 2);
+		ObjMaster::IncrementalMeshBuilder creatorBuilder;
+		updates = creatorBuilder.update(creator);
+		if((updates.size() != 1) || !updates[0].isNewMesh || (updates[0].vertexCount != 3) || (updates[0].indexCount != 3)) {
+			OMLOGE("Bad update of the first triangle!");
+			return errorCount + 1;
+		}
+		int redMesh = updates[0].meshIndex;
+		creator.useMaterial("blue");
+		creator.addFace(0, 2, 3);
+		updates = creatorBuilder.update(creator);
+		if((updates.size() != 1) || !updates[0].isNewMesh || (updates[0].meshIndex == redMesh) ||
+		   (updates[0].firstVertex != 0) || (updates[0].vertexCount != 3)) {
+			OMLOGE("Bad update of the blue triangle!");
+			++errorCount;
+		}
+		creator.useMaterial("red");
+		creator.addFace(0, 2, 3);
+		creator.addFace(0, 1, 2);
+		updates = creatorBuilder.update(creator);
+		const ObjMaster::MaterializedObjMeshObject &redTriangles = creatorBuilder.meshes[redMesh];
+		if((updates.size() != 1) || updates[0].isNewMesh || (updates[0].meshIndex != redMesh) ||
+		   (updates[0].firstVertex != 3) || (updates[0].vertexCount != 1) ||
+		   (updates[0].firstIndex != 3) || (updates[0].indexCount != 6) ||
+		   (redTriangles.vertexCount != 4) || (redTriangles.indexCount != 9) ||
+		   ((*redTriangles.indices)[5] != 3) || ((*redTriangles.indices)[8] != 2) ||
+		   (creatorBuilder.getAbsorbedFaceCount() != 4)) {
+			OMLOGE("Bad update of the appended red triangles!");
+			++errorCount;
+		}
+		OMLOGI("...tested incremental mesh building with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Tests if building a model stays within its allocation budget (when allocations are counted). Returns the number of errors. */
+	int testModelAllocations() {
+		OMLOGI("Testing the allocations of building %s...", TEST_MODEL);
+		int errorCount = 0;
+		if(!ObjMaster::TEST_AllocationCounter()) {
+			++errorCount;
+		}
+		if(!ObjMaster::AllocationCounter::isCounting()) {
+			OMLOGI("...allocations are not counted (see OBJMASTER_COUNT_ALLOCATIONS) - tested with %d errors!", errorCount);
+			return errorCount;
+		}
+		// The vertex and index vectors (and their reservations), the two dedup table vectors and the
+		// name - with some room for the growth of the vertices. The materials are only copied once
+		// per model (the strings of the material and its lookup node).
+		const uint64_t MAX_ALLOCATIONS_PER_MESH = 8;
+		const uint64_t MAX_ALLOCATIONS_PER_MATERIAL = 5;
+		ObjMaster::AllocationCounter loadCounter;
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		uint64_t loadAllocations = loadCounter.getAllocationsSince();
+		typedef ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary> Model;
+		for(int shared = 0; shared < 2; ++shared) {
+			ObjMaster::AllocationCounter buildCounter;
+			Model model = (shared != 0) ?
+					Model(obj, ObjMaster::ObjMeshObject::MeshBuildFlags::DEDUP_BY_VALUE, Model::SHARED_BUFFERS) :
+					Model(obj);
+			uint64_t buildAllocations = buildCounter.getAllocationsSince();
+			OMLOGI(" - %d allocations for loading the obj and %d for building the model (shared buffers: %d)",
+					(int)loadAllocations, (int)buildAllocations, shared);
+			// Rem.: Plus the vector of the meshes, the list of the mesh parts and the vectors of the material library
+			if(buildAllocations > MAX_ALLOCATIONS_PER_MESH * model.meshes.size() +
+					MAX_ALLOCATIONS_PER_MATERIAL * model.mtlLib.getMaterialCount() + 9) {
+				OMLOGE("Building the model needed %d allocations for %d meshes!", (int)buildAllocations, (int)model.meshes.size());
+				++errorCount;
+			}
+		}
+		OMLOGI("...tested the allocations of building the model with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Tests the material ids of the groups and the plain old data table of the material library. Returns the number of errors. */
+	int testMaterialTable() {
+		OMLOGI("Testing the material table of %s...", TEST_MODEL);
+		int errorCount = 0;
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		for(auto &gPair : obj.objectMaterialGroups) {
+			uint32_t id = gPair.second.materialId;
+			const ObjMaster::TextureDataHoldingMaterial &material = obj.getMaterialOf(gPair.second);
+			MaterialStructure expected = material.asStructure();
+			MaterialStructure fromTable = obj.mtlLib.getMaterialStructure(id);
+			if((id == ObjMaster::MtlLib::NO_MATERIAL) || (obj.mtlLib.getMaterialId(material.name) != id) ||
+			   (gPair.first != ObjMaster::ObjectMaterialFaceGroup::keyOf((uint32_t)(gPair.first >> 32), id)) ||
+			   (obj.getGroupName(gPair.second) != gPair.second.objectGroupName + ":mtl:" + material.name) ||
+			   (memcmp(&fromTable, &expected, sizeof(MaterialStructure)) != 0) ||
+			   (memcmp(&obj.mtlLib.getMaterialTable()[id], &expected, sizeof(MaterialStructure)) != 0)) {
+				OMLOGE("Bad material (id: %d) for group %s!", (int)id, obj.getGroupName(gPair.second).c_str());
+				++errorCount;
+			}
+		}
+
+		// The meshes of a model refer to the materials of its own library (copies too) - without material copies per mesh
+		typedef ObjMaster::MaterializedObjModel<ObjMaster::NopTexturePreparationLibrary> Model;
+		Model model(obj);
+		Model copy = model;
+		for(size_t i = 0; i < model.meshes.size(); ++i) {
+			const ObjMaster::MaterializedObjMeshObject &mesh = model.meshes[i];
+			const ObjMaster::TextureDataHoldingMaterial *material = model.getLoadableMaterialOf(mesh);
+			if((material == nullptr) || (material != &model.getMaterialOf(mesh)) ||
+			   (copy.getLoadableMaterialOf(copy.meshes[i]) == material) ||
+			   (copy.getMaterialOf(copy.meshes[i]).name != material->name) ||
+			   (mesh.name.find(":mtl:" + material->name) == std::string::npos)) {
+				OMLOGE("Bad material (id: %d) for mesh %s!", (int)mesh.materialId, mesh.name.c_str());
+				++errorCount;
+			}
+		}
+
+		// Missing color components: zeros - except the alpha
+		ObjMaster::Material red;
+		red.name = "red";
+		red.setAndEnableKd({1.0f, 0.0f, 0.0f});
+		MaterialStructure redColors = red.asStructure();
+		if((redColors.kd[0] != 1.0f) || (redColors.kd[3] != 1.0f) || (redColors.ka[0] != 0.0f) || (redColors.ka[3] != 1.0f) ||
+		   (redColors.enabledFields != (1u << ObjMaster::Material::F_KD))) {
+			OMLOGE("Bad plain old data of a material!");
+			++errorCount;
+		}
+
+		// Overwriting keeps the id - groups see the new material
+		ObjMaster::ObjCreator creator;
+		creator.addRuntimeGeneratedMaterial(red);
+		creator.llAddVertex(0, 0, 0);
+		creator.llAddVertex(1, 0, 0);
+		creator.llAddVertex(0, 1, 0);
+		creator.useMaterial("red");
+		creator.addFace(0, 1, 2);
+		ObjMaster::Obj *created = creator.getOwnedObj();
+		uint32_t redId = created->mtlLib.getMaterialId("red");
+		red.setAndEnableKd({0.5f, 0.0f, 0.0f});
+		creator.addRuntimeGeneratedMaterial(red);
+		if((created->objectMaterialGroups.size() != 1) || (created->mtlLib.getMaterialId("red") != redId) ||
+		   (created->getMaterialOf(created->objectMaterialGroups.begin()->second).kd[0] != 0.5f) ||
+		   (created->mtlLib.getMaterialStructure(redId).kd[0] != 0.5f)) {
+			OMLOGE("Overwriting a material has not kept its id!");
+			++errorCount;
+		}
+		// The plain old data of a material changed through the loadable pointer is not stale
+		created->mtlLib.getLoadableMaterial(redId)->setAndEnableKd({0.25f, 0.0f, 0.0f});
+		if((created->mtlLib.getMaterialStructure(redId).kd[0] != 0.25f) || (created->mtlLib.getMaterialTable()[redId].kd[0] != 0.25f)) {
+			OMLOGE("The plain old data of a changed material is stale!");
+			++errorCount;
+		}
+		created->mtlLib.getLoadableMaterial(redId)->setAndEnableKd({0.5f, 0.0f, 0.0f});
+		// A new library keeps the materials of the groups that are already there
+		creator.overWriteMtlLib(ObjMaster::MtlLib());
+		if((created->mtlLib.getMaterialCount() != 1) ||
+		   (created->getMaterialOf(created->objectMaterialGroups.begin()->second).kd[0] != 0.5f)) {
+			OMLOGE("Replacing the material library has lost the material of a group!");
+			++errorCount;
+		}
+		OMLOGI("...tested the material table with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Tests if parsing from (mapped) memory and parsing from streams give the same results. Returns the number of errors. */
+	int testMemoryAndStreamLoad() {
+		OMLOGI("Testing memory and stream loading of %s...", TEST_MODEL);
+		ObjMaster::Obj memObj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		ObjMaster::Obj streamObj = ObjMaster::Obj(StreamOnlyAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		int errorCount = 0;
+		if((memObj.vs.size() != streamObj.vs.size()) ||
+		   (memObj.vts.size() != streamObj.vts.size()) ||
+		   (memObj.vns.size() != streamObj.vns.size()) ||
+		   (memObj.fs.size() != streamObj.fs.size()) ||
+		   (memObj.objectMaterialGroups.size() != streamObj.objectMaterialGroups.size())) {
+			OMLOGE("Memory and stream loading resulted in different element counts!");
+			++errorCount;
+		} else {
+			for(size_t i = 0; i < memObj.vs.size(); ++i) {
+				if((memObj.vs[i].x != streamObj.vs[i].x) || (memObj.vs[i].y != streamObj.vs[i].y) || (memObj.vs[i].z != streamObj.vs[i].z)) {
+					OMLOGE("Memory and stream loading resulted in different vertex at %d!", (int)i);
+					++errorCount;
+					break;
+				}
+			}
+		}
+		OMLOGI("...tested memory and stream loading with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Parallel (chunked) parsing should give the very same Obj as the serial parsing */
+	int testParallelParse() {
+		OMLOGI("Testing parallel parsing of %s...", TEST_MODEL);
+		ObjMaster::Obj serialObj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		int errorCount = 0;
+		// Try with various chunk numbers so chunk boundaries fall at different places
+		for(int threadCount : {2, 3, 7}) {
+			ObjMaster::Obj parallelObj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL,
+					ObjMaster::Obj::ObjLoadModeFlags::PARALLEL_PARSE, threadCount);
+			if((serialObj.vs.size() != parallelObj.vs.size()) ||
+			   (serialObj.vts.size() != parallelObj.vts.size()) ||
+			   (serialObj.vns.size() != parallelObj.vns.size()) ||
+			   (serialObj.fs.size() != parallelObj.fs.size()) ||
+			   (serialObj.objectMaterialGroups.size() != parallelObj.objectMaterialGroups.size())) {
+				OMLOGE("Serial and parallel (%d) parsing resulted in different element counts!", threadCount);
+				++errorCount;
+				continue;
+			}
+			if((memcmp(serialObj.vs.data(), parallelObj.vs.data(), serialObj.vs.size() * sizeof(ObjMaster::VertexElement)) != 0) ||
+			   (memcmp(serialObj.vts.data(), parallelObj.vts.data(), serialObj.vts.size() * sizeof(ObjMaster::VertexTextureElement)) != 0) ||
+			   (memcmp(serialObj.vns.data(), parallelObj.vns.data(), serialObj.vns.size() * sizeof(ObjMaster::VertexNormalElement)) != 0)) {
+				OMLOGE("Serial and parallel (%d) parsing resulted in different vertex data!", threadCount);
+				++errorCount;
+			}
+			for(size_t i = 0; i < serialObj.fs.size(); ++i) {
+				const ObjMaster::FaceElement &a = serialObj.fs[i];
+				const ObjMaster::FaceElement &b = parallelObj.fs[i];
+				bool same = (a.facePointCount == b.facePointCount);
+				for(int j = 0; same && (j < a.facePointCount); ++j) {
+					same = (a.facePoints[j].vIndex == b.facePoints[j].vIndex) &&
+					       (a.facePoints[j].vtIndex == b.facePoints[j].vtIndex) &&
+					       (a.facePoints[j].vnIndex == b.facePoints[j].vnIndex);
+				}
+				if(!same) {
+					OMLOGE("Serial and parallel (%d) parsing resulted in different face at %d!", threadCount, (int)i);
+					++errorCount;
+					break;
+				}
+			}
+			for(auto &gPair : serialObj.objectMaterialGroups) {
+				auto it = parallelObj.objectMaterialGroups.find(gPair.first);
+				if((it == parallelObj.objectMaterialGroups.end()) ||
+				   (it->second.faceIndex != gPair.second.faceIndex) ||
+				   (it->second.meshFaceCount != gPair.second.meshFaceCount)) {
+					OMLOGE("Serial and parallel (%d) parsing resulted in different group: %s", threadCount, serialObj.getGroupName(gPair.second).c_str());
+					++errorCount;
+				}
+			}
+		}
+		OMLOGI("...tested parallel parsing with %d errors!", errorCount);
+		return errorCount;
+	}
+
+	/** Probing should give the element counts of a real load and prescan should reserve exactly that */
+	int testProbeAndPrescan() {
+		OMLOGI("Testing probe and exact prescan of %s...", TEST_MODEL);
+		ObjMaster::ObjElementCounts counts = ObjMaster::Obj::probe(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		ObjMaster::ObjElementCounts streamCounts = ObjMaster::Obj::probe(StreamOnlyAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL);
+		ObjMaster::Obj obj = ObjMaster::Obj(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_MODEL,
+				ObjMaster::Obj::ObjLoadModeFlags::EXACT_PRESCAN);
+		int errorCount = 0;
+		if((counts.vertexNum != (int)obj.vs.size()) ||
+		   (counts.vertexTextureNum != (int)obj.vts.size()) ||
+		   (counts.vertexNormalNum != (int)obj.vns.size()) ||
+		   (counts.faceNum != (int)obj.fs.size()) ||
+		   (counts.groupingLineNum < (int)obj.objectMaterialGroups.size())) {
+			OMLOGE("Probe counts (v:%d, vt:%d, vn:%d, f:%d) are not the same as the loaded ones!",
+					counts.vertexNum, counts.vertexTextureNum, counts.vertexNormalNum, counts.faceNum);
+			++errorCount;
+		}
+		if((counts.vertexNum != streamCounts.vertexNum) ||
+		   (counts.faceNum != streamCounts.faceNum) ||
+		   (counts.fileSize == 0)) {
+			OMLOGE("Probing memory and stream gave different counts!");
+			++errorCount;
+		}
+		if((obj.vs.capacity() != obj.vs.size()) ||
+		   (obj.vts.capacity() != obj.vts.size()) ||
+		   (obj.vns.capacity() != obj.vns.size()) ||
+		   (obj.fs.capacity() != obj.fs.size())) {
+			OMLOGE("Exact prescan did not reserve exact capacities!");
+			++errorCount;
+		}
+		OMLOGI("...tested probe and exact prescan with %d errors!", errorCount);
+		return errorCount;
+	}
+
 	/** Used in testMemoryLeakage */
 	int leakTest1() {
 		// Get memory usage in the beginning
@@ -214,13 +1706,28 @@ namespace ObjMasterTest {
 		obj.saveAs(ObjMaster::FileAssetLibrary(), TEST_MODEL_PATH, TEST_OUT_MODEL);
 		OMLOGI("See %s for the results!", TEST_OUT_MODEL);
 
+		// The materials are written in the order of their ids (so the runtime added one is the last)
+		int errorCount = 0;
+		std::vector<std::string> writtenNames;
+		std::ifstream mtlInput(std::string(TEST_MODEL_PATH) + "test_out.mtl");
+		std::string mtlLine;
+		while(std::getline(mtlInput, mtlLine)) {
+			if(mtlLine.compare(0, 7, "newmtl ") == 0) {
+				writtenNames.push_back(mtlLine.substr(7));
+			}
+		}
+		if((writtenNames != obj.mtlLib.getAllMaterialNames()) || writtenNames.empty() || (writtenNames.back() != "runtime_added_material")) {
+			OMLOGE("The materials are not written in the order of their ids!");
+			++errorCount;
+		}
+
 		OMLOGI("...tested *.obj (re-)saving!");
 
 		OMLOGI("Testing *.obj creation and saving...");
 		// TODO: Test these when they are implemented
 		OMLOGI("...tested *.obj creation and saving!");
 
-		return 0;
+		return errorCount;
 	}
 
 	/** Tests the "asText()" calls to the various *Element classes */
@@ -526,6 +2033,30 @@ namespace ObjMasterTest {
 		errorCount += testObjOutput();
 		errorCount += testObjCreator();
 		errorCount += testIntegrationFacade();
+		errorCount += testMemoryAndStreamLoad();
+		errorCount += testParallelParse();
+		errorCount += testProbeAndPrescan();
+		errorCount += testLongLines();
+		errorCount += testNgons();
+		errorCount += testMeshDedup();
+		errorCount += testParallelModelBuild();
+		errorCount += testParallelDedup();
+		errorCount += testVertexCacheOptimization();
+		errorCount += testOverdrawAndVertexFetchOptimization();
+		errorCount += testCompactVertices();
+		errorCount += testLayoutMeshObjects();
+		errorCount += testIndexWidthAndSplit();
+		errorCount += testMeshlets();
+		errorCount += testLodChains();
+		errorCount += testBounds();
+		errorCount += testBvh();
+		errorCount += testNormalGeneration();
+		errorCount += testTangents();
+		errorCount += testSharedBuffers();
+		errorCount += testInstancing();
+		errorCount += testIncrementalBuild();
+		errorCount += testModelAllocations();
+		errorCount += testMaterialTable();
 		// Return sum of error counts
 		return errorCount;
 	}